@@ -0,0 +1,101 @@
+#include "decodeloadcontroller.h"
+
+#include <algorithm>
+
+DecodeLoadController::DecodeLoadController()
+{
+    reset(Clock::now());
+}
+
+void DecodeLoadController::reset(Clock::time_point now)
+{
+    m_state = DecodeLoadState();
+    m_lastLevelChangeTime = now;
+    m_windowStartTime = now;
+    m_windowBusyUs = 0;
+    m_windowQueueDelayUs = 0;
+    m_windowPackets = 0;
+    m_exitBusyRatio = 0;
+    for (int i = 0; i < DECODE_LOAD_LEVEL_COUNT; i++)
+    {
+        m_levelCostFactors[i] = 0;
+    }
+    m_isRecoveryProbing = false;
+}
+
+bool DecodeLoadController::update(int64_t busyUs, int64_t queueDelayUs, int64_t frameIntervalUs, Clock::time_point now)
+{
+    m_windowBusyUs += std::max<int64_t>(busyUs, 0);
+    m_windowQueueDelayUs += std::max<int64_t>(queueDelayUs, 0);
+    m_windowPackets++;
+
+    auto windowUs = std::chrono::duration_cast<std::chrono::microseconds>(now - m_windowStartTime).count();
+    if (windowUs < DECODE_LOAD_WINDOW_MS * 1000)
+    {
+        return false;
+    }
+
+    int level = m_state.m_level;
+    double busyRatio = static_cast<double>(m_windowBusyUs) / windowUs;
+    int64_t queueDelayAverageUs = m_windowQueueDelayUs / m_windowPackets;
+    m_state.m_busyRatio = busyRatio;
+    m_state.m_averageQueueDelayUs = queueDelayAverageUs;
+    m_state.m_frameIntervalUs = frameIntervalUs;
+    m_windowStartTime = now;
+    m_windowBusyUs = 0;
+    m_windowQueueDelayUs = 0;
+    m_windowPackets = 0;
+
+    auto sinceLastChange = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastLevelChangeTime).count();
+    if (level > DECODE_LOAD_LEVEL_NORMAL && m_levelCostFactors[level] == 0 && sinceLastChange >= DECODE_LOAD_ESCALATE_HOLD_MS && busyRatio > 0)
+    {
+        // 降级时队列里积压的包已经消化掉，和降级前比较得到两级开销的比值
+        // 降级前的占用比例可能已经到顶，得到的比值偏小，恢复得太早时由下面加倍的恢复等待时间兜底
+        m_levelCostFactors[level] = std::max(m_exitBusyRatio / busyRatio, 1.0);
+    }
+
+    if (m_isRecoveryProbing && sinceLastChange >= m_state.m_recoverHoldMs)
+    {
+        // 恢复后稳定了一个等待时间，恢复的等待时间回到默认值
+        m_isRecoveryProbing = false;
+        m_state.m_recoverHoldMs = DECODE_LOAD_RECOVER_HOLD_MS;
+    }
+
+    bool isOverloaded = busyRatio > DECODE_LOAD_HIGH_RATIO || queueDelayAverageUs > DECODE_LOAD_MAX_LAG_FRAMES * frameIntervalUs;
+    int newLevel = level;
+    if (isOverloaded && level < DECODE_LOAD_LEVEL_KEYFRAME_ONLY && sinceLastChange >= DECODE_LOAD_ESCALATE_HOLD_MS)
+    {
+        newLevel = level + 1;
+        m_exitBusyRatio = busyRatio;
+        m_levelCostFactors[newLevel] = 0;
+        if (m_isRecoveryProbing)
+        {
+            m_isRecoveryProbing = false;
+            m_state.m_recoverHoldMs = std::min<int64_t>(m_state.m_recoverHoldMs * 2, DECODE_LOAD_MAX_RECOVER_HOLD_MS);
+        }
+    }
+    else if (!isOverloaded && level > DECODE_LOAD_LEVEL_NORMAL && sinceLastChange >= m_state.m_recoverHoldMs && queueDelayAverageUs < frameIntervalUs)
+    {
+        // 按两级开销的比值估计恢复以后的占用比例，只有上一级也有余量时才恢复
+        double costFactor = m_levelCostFactors[level] > 0 ? m_levelCostFactors[level] : 1.0;
+        if (busyRatio * costFactor < DECODE_LOAD_LOW_RATIO)
+        {
+            newLevel = level - 1;
+            m_isRecoveryProbing = true;
+        }
+    }
+
+    if (newLevel == level)
+    {
+        return false;
+    }
+
+    m_state.m_level = newLevel;
+    m_lastLevelChangeTime = now;
+    return true;
+}
+
+const DecodeLoadState &DecodeLoadController::state() const
+{
+    return m_state;
+}
@@ -0,0 +1,64 @@
+#ifndef DECODELOADCONTROLLER_H
+#define DECODELOADCONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "type.h"
+
+// 每隔这么久按这段时间里的统计评估一次
+#define DECODE_LOAD_WINDOW_MS 500
+// 解码占用的时间比例(不算输出回调)超过HIGH，或者包平均排队超过这么多个帧间隔时降一级
+#define DECODE_LOAD_HIGH_RATIO 0.9
+#define DECODE_LOAD_MAX_LAG_FRAMES 3
+// 估计恢复到上一级后的占用比例低于LOW，并且包基本不排队时才恢复一级
+#define DECODE_LOAD_LOW_RATIO 0.5
+// 降级后至少等这么久再看要不要继续降级，恢复要等更久，避免来回切换
+#define DECODE_LOAD_ESCALATE_HOLD_MS 1000
+#define DECODE_LOAD_RECOVER_HOLD_MS 3000
+// 恢复后一个恢复等待时间之内又降级，说明估计错了，下次恢复的等待时间加倍，最长到这个值
+#define DECODE_LOAD_MAX_RECOVER_HOLD_MS 60000
+
+// 最近一个窗口的评估结果
+struct DecodeLoadState
+{
+    int m_level = DECODE_LOAD_LEVEL_NORMAL;
+    double m_busyRatio = 0;
+    int64_t m_averageQueueDelayUs = 0;
+    int64_t m_frameIntervalUs = 0;
+    int64_t m_recoverHoldMs = DECODE_LOAD_RECOVER_HOLD_MS;
+};
+
+// 解码降级的控制器，决定现在应该处于哪一级(DECODE_LOAD_LEVEL_*)
+// 按窗口而不是按包评估：降级以后每个包的耗时会变短，只看单个包的耗时会马上恢复再马上降级
+// 只做判断，不接触解码器；时间由调用方传入
+class DecodeLoadController
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    DecodeLoadController();
+
+    void reset(Clock::time_point now);
+
+    // 累计一个包的解码占用时间和排队时间，一个窗口结束时评估，级别变化时返回true
+    bool update(int64_t busyUs, int64_t queueDelayUs, int64_t frameIntervalUs, Clock::time_point now);
+
+    const DecodeLoadState &state() const;
+
+private:
+    DecodeLoadState m_state;
+    Clock::time_point m_lastLevelChangeTime;
+    Clock::time_point m_windowStartTime;
+    int64_t m_windowBusyUs = 0;
+    int64_t m_windowQueueDelayUs = 0;
+    int64_t m_windowPackets = 0;
+    // 降级前最后一个窗口的占用比例
+    double m_exitBusyRatio = 0;
+    // 上一级的开销是这一级的几倍，降级后稳定下来时测量，0表示还没有测量
+    double m_levelCostFactors[DECODE_LOAD_LEVEL_COUNT] = {0};
+    // 恢复以后还没有稳定一个恢复等待时间
+    bool m_isRecoveryProbing = false;
+};
+
+#endif // DECODELOADCONTROLLER_H
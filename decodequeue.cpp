@@ -0,0 +1,221 @@
+#include "decodequeue.h"
+
+#include <thread>
+
+DecodeQueue::DecodeQueue()
+{
+}
+
+DecodeQueue::~DecodeQueue()
+{
+    close();
+    clear();
+}
+
+void DecodeQueue::open(size_t capacity, int policy)
+{
+    if (m_pQueue == nullptr || m_pQueue->capacity() < capacity)
+    {
+        clear();
+        m_pQueue = std::make_unique<SpscQueue<DecodeQueueItem>>(capacity);
+    }
+
+    m_policy = policy;
+    m_isClosed = false;
+}
+
+void DecodeQueue::close()
+{
+    m_isClosed = true;
+
+    std::lock_guard<std::mutex> lock(m_waitMutex);
+    m_consumerCondition.notify_all();
+    m_producerCondition.notify_all();
+}
+
+void DecodeQueue::clear()
+{
+    if (m_pQueue != nullptr)
+    {
+        dropAll();
+    }
+}
+
+int DecodeQueue::push(DecodeQueueItem &&item)
+{
+    if (m_isClosed)
+    {
+        av_buffer_unref(&item.m_pBuffer);
+        return DECODE_QUEUE_CLOSED;
+    }
+
+    item.m_enqueueTime = std::chrono::steady_clock::now();
+    int result = DECODE_QUEUE_PUSHED;
+
+    if (!m_pQueue->tryPush(std::move(item)))
+    {
+        m_overflowCount++;
+
+        if (m_policy == DECODE_QUEUE_POLICY_BLOCK)
+        {
+            // 等解码线程取走一个包
+            auto waitStartTime = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(m_waitMutex);
+            m_isProducerWaiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!m_pQueue->tryPush(std::move(item)))
+            {
+                if (m_isClosed)
+                {
+                    m_isProducerWaiting = false;
+                    av_buffer_unref(&item.m_pBuffer);
+                    return DECODE_QUEUE_CLOSED;
+                }
+                m_producerCondition.wait(lock);
+            }
+            m_isProducerWaiting = false;
+
+            auto waitTime = std::chrono::steady_clock::now() - waitStartTime;
+            m_producerWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(waitTime).count();
+        }
+        else if (m_policy == DECODE_QUEUE_POLICY_DROP_OLDEST)
+        {
+            // 生产者自己取出最老的包丢掉，解码线程可能同时也在取，所以要循环
+            DecodeQueueItem oldest;
+            while (!m_pQueue->tryPush(std::move(item)))
+            {
+                if (m_pQueue->tryPop(oldest))
+                {
+                    av_buffer_unref(&oldest.m_pBuffer);
+                    m_dropped++;
+                }
+            }
+            result = DECODE_QUEUE_DROPPED;
+        }
+        else
+        {
+            // 队列里的包都依赖前面的参考帧，只丢一部分也是花屏，直接全部丢掉
+            m_dropped += dropAll();
+            if (!item.m_isKeyFrame)
+            {
+                av_buffer_unref(&item.m_pBuffer);
+                m_dropped++;
+                return DECODE_QUEUE_FLUSHED;
+            }
+
+            // 这个包本身就是IDR，要放进去让解码器从它开始
+            // 队列满时生产者的下一个槽位就是队头，解码线程可能刚用CAS取走它但还没更新序号，这时放不进去，等它放手
+            while (!m_pQueue->tryPush(std::move(item)))
+            {
+                std::this_thread::yield();
+            }
+            result = DECODE_QUEUE_DROPPED;
+        }
+    }
+
+    m_pushed++;
+    size_t currentDepth = m_pQueue->size();
+    if (currentDepth > m_maxDepth)
+    {
+        m_maxDepth = currentDepth;
+    }
+
+    wakeConsumer();
+    return result;
+}
+
+bool DecodeQueue::pop(DecodeQueueItem &item)
+{
+    while (!m_isClosed)
+    {
+        if (m_pQueue->tryPop(item))
+        {
+            m_popped++;
+
+            auto queueDelay = std::chrono::steady_clock::now() - item.m_enqueueTime;
+            uint64_t queueDelayUs = std::chrono::duration_cast<std::chrono::microseconds>(queueDelay).count();
+            m_lastQueueDelayUs = queueDelayUs;
+            if (queueDelayUs > m_maxQueueDelayUs)
+            {
+                m_maxQueueDelayUs = queueDelayUs;
+            }
+
+            wakeProducer();
+            return true;
+        }
+
+        // 队列空了，睡眠等待网络线程入队
+        auto waitStartTime = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(m_waitMutex);
+            m_isConsumerWaiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (m_pQueue->isEmpty() && !m_isClosed)
+            {
+                m_consumerCondition.wait(lock);
+            }
+            m_isConsumerWaiting = false;
+        }
+
+        auto waitTime = std::chrono::steady_clock::now() - waitStartTime;
+        m_consumerIdleUs += std::chrono::duration_cast<std::chrono::microseconds>(waitTime).count();
+    }
+
+    return false;
+}
+
+size_t DecodeQueue::depth() const
+{
+    return m_pQueue != nullptr ? m_pQueue->size() : 0;
+}
+
+DecodeQueueStats DecodeQueue::stats() const
+{
+    DecodeQueueStats stats;
+    stats.m_pushed = m_pushed;
+    stats.m_popped = m_popped;
+    stats.m_dropped = m_dropped;
+    stats.m_overflowCount = m_overflowCount;
+    stats.m_depth = depth();
+    stats.m_maxDepth = m_maxDepth;
+    stats.m_producerWaitUs = m_producerWaitUs;
+    stats.m_consumerIdleUs = m_consumerIdleUs;
+    stats.m_lastQueueDelayUs = m_lastQueueDelayUs;
+    stats.m_maxQueueDelayUs = m_maxQueueDelayUs;
+    return stats;
+}
+
+size_t DecodeQueue::dropAll()
+{
+    size_t droppedCount = 0;
+    DecodeQueueItem item;
+    while (m_pQueue->tryPop(item))
+    {
+        av_buffer_unref(&item.m_pBuffer);
+        droppedCount++;
+    }
+
+    wakeProducer();
+    return droppedCount;
+}
+
+// 对方先标记等待再检查队列，这边先改队列再检查标记，两边都有全屏障，不会错过唤醒
+void DecodeQueue::wakeConsumer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_isConsumerWaiting.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_consumerCondition.notify_one();
+    }
+}
+
+void DecodeQueue::wakeProducer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_isProducerWaiting.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_producerCondition.notify_one();
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef DECODEQUEUE_H
+#define DECODEQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+extern "C"
+{
+#include <libavutil/buffer.h>
+}
+
+#include "type.h"
+#include "spscqueue.h"
+
+// push的结果
+#define DECODE_QUEUE_PUSHED 0
+#define DECODE_QUEUE_DROPPED 1  // 队列满，丢掉了队列里的包，这个包已经入队
+#define DECODE_QUEUE_FLUSHED 2  // 队列满，队列清空且这个包也被丢掉，之后要从IDR开始
+#define DECODE_QUEUE_CLOSED -1
+
+// 交给解码线程的一个包
+struct DecodeQueueItem
+{
+    AVBufferRef *m_pBuffer = nullptr;
+    size_t m_length = 0;
+    int64_t m_pts = 0;
+    bool m_isKeyFrame = false;
+    // 连接的序号，解码线程发现它变了就先重置解码器
+    uint64_t m_generation = 0;
+    std::chrono::steady_clock::time_point m_enqueueTime;
+};
+
+struct DecodeQueueStats
+{
+    uint64_t m_pushed = 0;
+    uint64_t m_popped = 0;
+    uint64_t m_dropped = 0;         // 队列满时按策略丢掉的包
+    uint64_t m_overflowCount = 0;   // 入队时队列已满的次数
+    size_t m_depth = 0;
+    size_t m_maxDepth = 0;
+    uint64_t m_producerWaitUs = 0;  // 阻塞策略下网络线程等待的总时间
+    uint64_t m_consumerIdleUs = 0;  // 解码线程等待数据的总时间
+    uint64_t m_lastQueueDelayUs = 0; // 包在队列里停留的时间
+    uint64_t m_maxQueueDelayUs = 0;
+};
+
+// 网络线程和解码线程之间的包队列
+// 入队出队走无锁队列，只有一端需要睡眠等待时才用到互斥锁和条件变量
+// 解码跟不上导致队列满时按策略处理：阻塞网络线程、丢掉最老的包、或者清空队列等下一个IDR
+class DecodeQueue
+{
+public:
+    DecodeQueue();
+    ~DecodeQueue();
+
+    // 开始使用前调用，容量变化时重新分配
+    void open(size_t capacity, int policy);
+    // 唤醒等待的两端，之后push返回DECODE_QUEUE_CLOSED，pop返回false
+    void close();
+    // 释放队列里剩下的包，只在两端都不再使用时调用
+    void clear();
+
+    // 网络线程调用，包的引用交给队列，失败时由队列释放
+    int push(DecodeQueueItem &&item);
+    // 解码线程调用，没有数据时等待，关闭后返回false
+    bool pop(DecodeQueueItem &item);
+
+    size_t depth() const;
+    DecodeQueueStats stats() const;
+
+private:
+    size_t dropAll();
+    void wakeConsumer();
+    void wakeProducer();
+
+private:
+    std::unique_ptr<SpscQueue<DecodeQueueItem>> m_pQueue;
+    int m_policy = DECODE_QUEUE_POLICY_DROP_TO_IDR;
+    std::atomic_bool m_isClosed = true;
+
+    std::mutex m_waitMutex;
+    std::condition_variable m_consumerCondition;
+    std::condition_variable m_producerCondition;
+    std::atomic_bool m_isConsumerWaiting = false;
+    std::atomic_bool m_isProducerWaiting = false;
+
+    std::atomic<uint64_t> m_pushed = 0;
+    std::atomic<uint64_t> m_popped = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::atomic<uint64_t> m_overflowCount = 0;
+    std::atomic<size_t> m_maxDepth = 0;
+    std::atomic<uint64_t> m_producerWaitUs = 0;
+    std::atomic<uint64_t> m_consumerIdleUs = 0;
+    std::atomic<uint64_t> m_lastQueueDelayUs = 0;
+    std::atomic<uint64_t> m_maxQueueDelayUs = 0;
+};
+
+#endif // DECODEQUEUE_H
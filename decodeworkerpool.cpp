@@ -0,0 +1,97 @@
+#include "decodeworkerpool.h"
+
+#include <algorithm>
+#include <future>
+
+DecodeWorkerPool::DecodeWorkerPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (auto &worker : m_workers)
+    {
+        Worker *pWorker = worker.get();
+        pWorker->m_thread = std::thread([this, pWorker]()
+                                        { this->doRunWorker(pWorker); });
+    }
+}
+
+DecodeWorkerPool::~DecodeWorkerPool()
+{
+    m_isRunning = false;
+    for (auto &worker : m_workers)
+    {
+        {
+            std::lock_guard<std::mutex> lock(worker->m_mutex);
+        }
+        worker->m_condition.notify_one();
+    }
+
+    for (auto &worker : m_workers)
+    {
+        if (worker->m_thread.joinable())
+        {
+            worker->m_thread.join();
+        }
+    }
+}
+
+size_t DecodeWorkerPool::threadCount() const
+{
+    return m_workers.size();
+}
+
+size_t DecodeWorkerPool::assignWorker()
+{
+    return m_nextWorker++ % m_workers.size();
+}
+
+void DecodeWorkerPool::post(size_t workerIndex, decodeTask &&task)
+{
+    Worker *worker = m_workers[workerIndex % m_workers.size()].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->m_mutex);
+        worker->m_tasks.push_back(std::move(task));
+    }
+    worker->m_condition.notify_one();
+}
+
+void DecodeWorkerPool::waitIdle(size_t workerIndex)
+{
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    post(workerIndex, [&done]()
+         { done.set_value(); });
+    future.wait();
+}
+
+void DecodeWorkerPool::doRunWorker(Worker *worker)
+{
+    while (true)
+    {
+        decodeTask task;
+        {
+            std::unique_lock<std::mutex> lock(worker->m_mutex);
+            worker->m_condition.wait(lock, [this, worker]()
+                                     { return !worker->m_tasks.empty() || !m_isRunning; });
+
+            // 退出前把剩下的任务执行完，任务里持有的缓冲区才能释放
+            if (worker->m_tasks.empty())
+            {
+                break;
+            }
+
+            task = std::move(worker->m_tasks.front());
+            worker->m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
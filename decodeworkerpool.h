@@ -0,0 +1,50 @@
+#ifndef DECODEWORKERPOOL_H
+#define DECODEWORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using decodeTask = std::function<void()>;
+
+// 固定大小的解码线程池，多路视频流共用
+// 每路流固定分配到一个线程，同一路流的包按顺序解码，不需要额外同步解码器
+class DecodeWorkerPool
+{
+public:
+    // threadCount为0时使用CPU核数
+    explicit DecodeWorkerPool(size_t threadCount = 0);
+    ~DecodeWorkerPool();
+
+    size_t threadCount() const;
+
+    // 按轮询的方式给一路新的流分配线程，返回线程下标
+    size_t assignWorker();
+
+    void post(size_t workerIndex, decodeTask &&task);
+    // 等待这个线程已经投递的任务全部执行完
+    void waitIdle(size_t workerIndex);
+
+private:
+    struct Worker
+    {
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::deque<decodeTask> m_tasks;
+    };
+
+    void doRunWorker(Worker *worker);
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic_bool m_isRunning = true;
+    std::atomic<size_t> m_nextWorker = 0;
+};
+
+#endif // DECODEWORKERPOOL_H
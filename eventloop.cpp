@@ -0,0 +1,416 @@
+#include "eventloop.h"
+
+#ifdef PLATFORM_LINUX
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <cstring>
+#include <iostream>
+
+// 单次最多处理的事件数
+#define EVENTLOOP_MAX_EVENTS 64
+
+#ifdef PLATFORM_WINDOWS
+// WSAPoll没有类似eventfd的唤醒手段，只能限制单次等待的最长时间
+#define EVENTLOOP_MAX_WAIT_MS 50
+#endif
+
+EventLoop::EventLoop()
+{
+#ifdef PLATFORM_LINUX
+    m_epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFD < 0)
+    {
+        std::cerr << "epoll_create1 failed" << std::endl;
+    }
+
+    m_wakeupFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeupFD < 0)
+    {
+        std::cerr << "eventfd create failed" << std::endl;
+    }
+    else
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = m_wakeupFD;
+        epoll_ctl(m_epollFD, EPOLL_CTL_ADD, m_wakeupFD, &event);
+    }
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+#ifdef PLATFORM_LINUX
+    if (m_wakeupFD >= 0)
+    {
+        close(m_wakeupFD);
+        m_wakeupFD = -1;
+    }
+
+    if (m_epollFD >= 0)
+    {
+        close(m_epollFD);
+        m_epollFD = -1;
+    }
+#endif
+}
+
+void EventLoop::run()
+{
+    m_loopThreadID.store(std::this_thread::get_id(), std::memory_order_release);
+
+#ifdef PLATFORM_LINUX
+    struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+#endif
+
+    while (!m_isQuitRequested)
+    {
+        int timeoutMs = nextTimeoutMs();
+
+#ifdef PLATFORM_LINUX
+        // 没有事件也没有定时器到期时线程一直睡在内核里
+        int eventCount = epoll_wait(m_epollFD, events, EVENTLOOP_MAX_EVENTS, timeoutMs);
+        if (eventCount < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "epoll_wait failed" << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < eventCount; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == m_wakeupFD)
+            {
+                // 非阻塞的eventfd，计数已经被清掉时返回EAGAIN，不是错误
+                uint64_t value = 0;
+                if (read(m_wakeupFD, &value, sizeof(value)) < 0 && errno != EAGAIN && errno != EINTR)
+                {
+                    std::cerr << "read wakeup eventfd error: " << strerror(errno) << std::endl;
+                }
+                continue;
+            }
+
+            auto iter = m_ioHandlers.find(fd);
+            if (iter == m_ioHandlers.end())
+            {
+                continue;
+            }
+
+            int readyEvents = 0;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP))
+            {
+                readyEvents |= EVENTLOOP_READ;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                readyEvents |= EVENTLOOP_WRITE;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                readyEvents |= EVENTLOOP_ERROR;
+            }
+
+            // 先拷贝一份，回调里可能会removeFd
+            std::shared_ptr<IOHandler> handler = iter->second;
+            handler->m_callback(readyEvents);
+        }
+#elif PLATFORM_WINDOWS
+        if (timeoutMs < 0 || timeoutMs > EVENTLOOP_MAX_WAIT_MS)
+        {
+            timeoutMs = EVENTLOOP_MAX_WAIT_MS;
+        }
+
+        std::vector<WSAPOLLFD> pollFDs;
+        pollFDs.reserve(m_ioHandlers.size());
+        for (auto &item : m_ioHandlers)
+        {
+            WSAPOLLFD pollFD;
+            pollFD.fd = static_cast<SOCKET>(item.first);
+            pollFD.events = 0;
+            pollFD.revents = 0;
+            if (item.second->m_events & EVENTLOOP_READ)
+            {
+                pollFD.events |= POLLRDNORM;
+            }
+            if (item.second->m_events & EVENTLOOP_WRITE)
+            {
+                pollFD.events |= POLLWRNORM;
+            }
+            pollFDs.push_back(pollFD);
+        }
+
+        int eventCount = 0;
+        if (pollFDs.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        }
+        else
+        {
+            eventCount = WSAPoll(pollFDs.data(), static_cast<ULONG>(pollFDs.size()), timeoutMs);
+            if (eventCount == SOCKET_ERROR)
+            {
+                std::cerr << "WSAPoll failed, error: " << WSAGetLastError() << std::endl;
+                break;
+            }
+        }
+
+        for (int i = 0; eventCount > 0 && i < static_cast<int>(pollFDs.size()); i++)
+        {
+            if (pollFDs[i].revents == 0)
+            {
+                continue;
+            }
+
+            auto iter = m_ioHandlers.find(static_cast<int>(pollFDs[i].fd));
+            if (iter == m_ioHandlers.end())
+            {
+                continue;
+            }
+
+            int readyEvents = 0;
+            if (pollFDs[i].revents & (POLLRDNORM | POLLHUP))
+            {
+                readyEvents |= EVENTLOOP_READ;
+            }
+            if (pollFDs[i].revents & POLLWRNORM)
+            {
+                readyEvents |= EVENTLOOP_WRITE;
+            }
+            if (pollFDs[i].revents & (POLLERR | POLLNVAL))
+            {
+                readyEvents |= EVENTLOOP_ERROR;
+            }
+
+            std::shared_ptr<IOHandler> handler = iter->second;
+            handler->m_callback(readyEvents);
+        }
+#endif
+
+        runExpiredTimers();
+        runPendingTasks();
+    }
+
+    // 退出时才清掉退出请求，这一次run之前调用的quit仍然有效，之后可以再次run(比如停止后重新连接)
+    m_isQuitRequested = false;
+    m_loopThreadID.store(std::thread::id(), std::memory_order_release);
+}
+
+void EventLoop::quit()
+{
+    m_isQuitRequested = true;
+    wakeup();
+}
+
+bool EventLoop::addFd(int fd, int events, ioEventCallback &&callback)
+{
+    auto handler = std::make_shared<IOHandler>();
+    handler->m_fd = fd;
+    handler->m_events = events;
+    handler->m_callback = std::move(callback);
+
+#ifdef PLATFORM_LINUX
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = fd;
+    if (events & EVENTLOOP_READ)
+    {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & EVENTLOOP_WRITE)
+    {
+        event.events |= EPOLLOUT;
+    }
+
+    if (epoll_ctl(m_epollFD, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        std::cerr << "epoll_ctl add failed" << std::endl;
+        return false;
+    }
+#endif
+
+    m_ioHandlers[fd] = handler;
+    return true;
+}
+
+bool EventLoop::modifyFd(int fd, int events)
+{
+    auto iter = m_ioHandlers.find(fd);
+    if (iter == m_ioHandlers.end())
+    {
+        return false;
+    }
+
+#ifdef PLATFORM_LINUX
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = fd;
+    if (events & EVENTLOOP_READ)
+    {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & EVENTLOOP_WRITE)
+    {
+        event.events |= EPOLLOUT;
+    }
+
+    if (epoll_ctl(m_epollFD, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        std::cerr << "epoll_ctl modify failed" << std::endl;
+        return false;
+    }
+#endif
+
+    iter->second->m_events = events;
+    return true;
+}
+
+void EventLoop::removeFd(int fd)
+{
+    auto iter = m_ioHandlers.find(fd);
+    if (iter == m_ioHandlers.end())
+    {
+        return;
+    }
+
+#ifdef PLATFORM_LINUX
+    epoll_ctl(m_epollFD, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+    m_ioHandlers.erase(iter);
+}
+
+int EventLoop::addTimer(int intervalMs, bool repeat, timerCallback &&callback)
+{
+    int timerID = m_nextTimerID++;
+
+    Timer timer;
+    timer.m_intervalMs = intervalMs;
+    timer.m_repeat = repeat;
+    timer.m_expireTime = Clock::now() + std::chrono::milliseconds(intervalMs);
+    timer.m_callback = std::move(callback);
+
+    m_timerQueue.emplace(timer.m_expireTime, timerID);
+    m_timers[timerID] = std::move(timer);
+
+    return timerID;
+}
+
+void EventLoop::removeTimer(int timerID)
+{
+    // 队列里的记录在到期时再惰性清理
+    m_timers.erase(timerID);
+}
+
+void EventLoop::post(loopTask &&task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_taskMutex);
+        m_pendingTasks.push_back(std::move(task));
+    }
+    wakeup();
+}
+
+bool EventLoop::isInLoopThread() const
+{
+    return m_loopThreadID.load(std::memory_order_acquire) == std::this_thread::get_id();
+}
+
+int EventLoop::nextTimeoutMs()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_taskMutex);
+        if (!m_pendingTasks.empty())
+        {
+            return 0;
+        }
+    }
+
+    while (!m_timerQueue.empty())
+    {
+        auto iter = m_timerQueue.begin();
+        auto timerIter = m_timers.find(iter->second);
+        // 已经被删除或者重新计时的定时器直接丢掉
+        if (timerIter == m_timers.end() || timerIter->second.m_expireTime != iter->first)
+        {
+            m_timerQueue.erase(iter);
+            continue;
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(iter->first - Clock::now()).count();
+        // 向上取整到毫秒，避免提前醒来空转一次
+        return remaining < 0 ? 0 : static_cast<int>(remaining) + 1;
+    }
+
+    // 没有定时器则无限等待
+    return -1;
+}
+
+void EventLoop::runExpiredTimers()
+{
+    Clock::time_point now = Clock::now();
+
+    while (!m_timerQueue.empty() && m_timerQueue.begin()->first <= now)
+    {
+        auto iter = m_timerQueue.begin();
+        int timerID = iter->second;
+        Clock::time_point expireTime = iter->first;
+        m_timerQueue.erase(iter);
+
+        auto timerIter = m_timers.find(timerID);
+        if (timerIter == m_timers.end() || timerIter->second.m_expireTime != expireTime)
+        {
+            continue;
+        }
+
+        // 回调里可能删除定时器，先拷贝一份
+        timerCallback callback = timerIter->second.m_callback;
+        if (timerIter->second.m_repeat)
+        {
+            timerIter->second.m_expireTime = now + std::chrono::milliseconds(timerIter->second.m_intervalMs);
+            m_timerQueue.emplace(timerIter->second.m_expireTime, timerID);
+        }
+        else
+        {
+            m_timers.erase(timerIter);
+        }
+
+        callback();
+    }
+}
+
+void EventLoop::runPendingTasks()
+{
+    std::vector<loopTask> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_taskMutex);
+        tasks.swap(m_pendingTasks);
+    }
+
+    for (auto &task : tasks)
+    {
+        task();
+    }
+}
+
+void EventLoop::wakeup()
+{
+#ifdef PLATFORM_LINUX
+    if (m_wakeupFD >= 0)
+    {
+        // 计数快要溢出时返回EAGAIN，这时循环本来就会被唤醒
+        uint64_t value = 1;
+        if (write(m_wakeupFD, &value, sizeof(value)) < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            std::cerr << "write wakeup eventfd error: " << strerror(errno) << std::endl;
+        }
+    }
+#endif
+}
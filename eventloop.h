@@ -0,0 +1,103 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#ifdef PLATFORM_LINUX
+#include <sys/epoll.h>
+#elif PLATFORM_WINDOWS
+#include <winsock2.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 监听的事件类型，可以按位组合
+#define EVENTLOOP_READ 0x1
+#define EVENTLOOP_WRITE 0x2
+#define EVENTLOOP_ERROR 0x4
+
+using ioEventCallback = std::function<void(int events)>;
+using timerCallback = std::function<void()>;
+using loopTask = std::function<void()>;
+
+// 基于epoll的事件循环(Windows下用WSAPoll)
+// 套接字只有在可读/可写时才会回调，定时器到期时才会唤醒，空闲时线程一直阻塞在内核里
+// addFd/addTimer等接口需要在循环线程里调用(或者在run之前调用)，其他线程通过post投递任务
+class EventLoop
+{
+public:
+    EventLoop();
+    ~EventLoop();
+
+    // 阻塞运行直到quit被调用，返回后可以再次调用
+    void run();
+    // 可以在任意线程调用
+    void quit();
+
+    bool addFd(int fd, int events, ioEventCallback &&callback);
+    bool modifyFd(int fd, int events);
+    void removeFd(int fd);
+
+    // 返回定时器ID，repeat为true时周期触发
+    int addTimer(int intervalMs, bool repeat, timerCallback &&callback);
+    void removeTimer(int timerID);
+
+    // 投递任务到循环线程执行，可以在任意线程调用
+    void post(loopTask &&task);
+
+    bool isInLoopThread() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct IOHandler
+    {
+        int m_fd = -1;
+        int m_events = 0;
+        ioEventCallback m_callback;
+    };
+
+    struct Timer
+    {
+        int m_intervalMs = 0;
+        bool m_repeat = false;
+        Clock::time_point m_expireTime;
+        timerCallback m_callback;
+    };
+
+    int nextTimeoutMs();
+    void runExpiredTimers();
+    void runPendingTasks();
+    void wakeup();
+
+private:
+#ifdef PLATFORM_LINUX
+    int m_epollFD = -1;
+    // 用eventfd唤醒阻塞在epoll_wait里的循环线程
+    int m_wakeupFD = -1;
+#endif
+
+    // run之前就调用quit也能正常退出
+    std::atomic_bool m_isQuitRequested = false;
+    // run里设置，其他线程通过isInLoopThread读取
+    std::atomic<std::thread::id> m_loopThreadID;
+
+    // 用shared_ptr保存，回调里删除自己时不会悬空
+    std::unordered_map<int, std::shared_ptr<IOHandler>> m_ioHandlers;
+
+    int m_nextTimerID = 1;
+    std::unordered_map<int, Timer> m_timers;
+    // 按到期时间排序，方便取出最近的一个定时器
+    std::multimap<Clock::time_point, int> m_timerQueue;
+
+    std::mutex m_taskMutex;
+    std::vector<loopTask> m_pendingTasks;
+};
+
+#endif // EVENTLOOP_H
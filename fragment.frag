@@ -1,31 +1,30 @@
+#version 330 core
+
 //三个分量的纹理采样器
 uniform sampler2D uni_textureY;
 uniform sampler2D uni_textureU;
 uniform sampler2D uni_textureV;
 
-varying vec2 out_uv;
+//YUV转RGB的矩阵和偏移，按帧的色彩空间、范围和位深在CPU上算好
+//已经包含了有限范围的拉伸和10位数据的放大，这里只需要一次矩阵乘法
+uniform mat3 uni_colorMatrix;
+uniform vec3 uni_colorOffset;
+
+in vec2 out_uv;
+out vec4 frag_color;
 
 void main(void)
 {
     vec3 yuv;
-    vec3 rgb;
 
     //根据纹理单元和纹理坐标获取每个分量的纹理信息
     //因为这里yuv分别都是单通道，单通道数据实际存储在红色通道
-    //y亮度值是0到1
-    yuv.x = texture2D(uni_textureY, out_uv).r;
-    //uv分别是红色和蓝色的色差，范围是-0.5到0.5，而其获取到的原始范围是0到1，所以需要减0.5
-    yuv.y = texture2D(uni_textureU, out_uv).r - 0.5;
-    yuv.z = texture2D(uni_textureV, out_uv).r - 0.5;
+    //8位是GL_R8，更高的位深是GL_R16，采样出来都是0到1
+    yuv.x = texture(uni_textureY, out_uv).r;
+    yuv.y = texture(uni_textureU, out_uv).r;
+    yuv.z = texture(uni_textureV, out_uv).r;
 
-    /* yuv转rgb的公式：
-    *   rgb = mat3(
-    *    1,       1,       1,        // 第一列
-    *    0,       -0.39465, 2.03211, // 第二列
-    *    1.13983, -0.58060, 0        // 第三列
-    *    ) * yuv;
-      */
-    rgb = mat3( 1,1,1, 0,-0.39465,2.03211,1.13983,-0.58060,0) * yuv;
+    vec3 rgb = uni_colorMatrix * yuv + uni_colorOffset;
     //添加一个透明分量，得到一个vec4的最终颜色
-    gl_FragColor = vec4(rgb, 1);
+    frag_color = vec4(rgb, 1);
 }
@@ -0,0 +1,23 @@
+#version 330 core
+
+//半平面格式(nv12、p010)：亮度一个单通道纹理，UV交错存放在一个双通道纹理里
+uniform sampler2D uni_textureY;
+uniform sampler2D uni_textureUV;
+
+//和fragment.frag一样，按帧的色彩空间、范围和位深在CPU上算好
+uniform mat3 uni_colorMatrix;
+uniform vec3 uni_colorOffset;
+
+in vec2 out_uv;
+out vec4 frag_color;
+
+void main(void)
+{
+    vec3 yuv;
+    yuv.x = texture(uni_textureY, out_uv).r;
+    //U在红色通道，V在绿色通道
+    yuv.yz = texture(uni_textureUV, out_uv).rg;
+
+    vec3 rgb = uni_colorMatrix * yuv + uni_colorOffset;
+    frag_color = vec4(rgb, 1);
+}
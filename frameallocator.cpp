@@ -0,0 +1,73 @@
+#include "frameallocator.h"
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+}
+
+size_t FrameAllocator::computeFrameLayout(AVCodecContext *context, const AVFrame *frame, int linesizes[4], size_t offsets[4])
+{
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    int width = frame->width;
+    int height = frame->height;
+    int strideAlign[AV_NUM_DATA_POINTERS];
+    if (context != nullptr)
+    {
+        avcodec_align_dimensions2(context, &width, &height, strideAlign);
+    }
+    else
+    {
+        for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+        {
+            strideAlign[i] = FRAME_PLANE_ALIGN;
+        }
+    }
+
+    // 宽度逐步加大，直到每个分量的行宽都满足解码器的对齐要求
+    bool isUnaligned = false;
+    do
+    {
+        if (av_image_fill_linesizes(linesizes, format, width) < 0)
+        {
+            return 0;
+        }
+        width += width & ~(width - 1);
+
+        isUnaligned = false;
+        for (int i = 0; i < 4; i++)
+        {
+            if (linesizes[i] % strideAlign[i] != 0)
+            {
+                isUnaligned = true;
+            }
+        }
+    } while (isUnaligned);
+
+    ptrdiff_t planeLinesizes[4];
+    size_t planeSizes[4];
+    for (int i = 0; i < 4; i++)
+    {
+        planeLinesizes[i] = linesizes[i];
+    }
+    if (av_image_fill_plane_sizes(planeSizes, format, height, planeLinesizes) < 0)
+    {
+        return 0;
+    }
+
+    // 所有分量依次放在一块内存里
+    size_t frameSize = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        offsets[i] = frameSize;
+        if (planeSizes[i] != 0)
+        {
+            frameSize += alignPlaneSize(planeSizes[i] + FRAME_PLANE_PADDING);
+        }
+    }
+    return frameSize;
+}
+
+size_t FrameAllocator::alignPlaneSize(size_t size)
+{
+    return (size + FRAME_PLANE_ALIGN - 1) & ~static_cast<size_t>(FRAME_PLANE_ALIGN - 1);
+}
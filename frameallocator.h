@@ -0,0 +1,34 @@
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include <cstddef>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+// 每个分量的起始地址按64字节对齐，末尾留出解码器读写越界需要的填充
+#define FRAME_PLANE_ALIGN 64
+#define FRAME_PLANE_PADDING (16 + FRAME_PLANE_ALIGN)
+
+// 给解码器提供帧缓冲区的接口，通过AVCodecContext::get_buffer2接到解码器上
+// 解码器可能在多个线程里同时调用，实现必须是线程安全的
+class FrameAllocator
+{
+public:
+    virtual ~FrameAllocator() = default;
+
+    // frame的宽高和格式已经由解码器设置好，需要填好data、linesize和buf
+    // 返回false时解码器改用FFmpeg默认的分配方式
+    virtual bool allocateFrame(AVCodecContext *context, AVFrame *frame) = 0;
+
+protected:
+    // 按解码器的要求计算每个分量的行宽和在一块连续内存里的偏移，和FFmpeg默认的分配方式一致
+    // context为空时是解码器以外的帧(比如缩小后的帧)，行宽只按FRAME_PLANE_ALIGN对齐
+    // 返回整帧需要的大小，格式不支持时返回0
+    static size_t computeFrameLayout(AVCodecContext *context, const AVFrame *frame, int linesizes[4], size_t offsets[4]);
+    static size_t alignPlaneSize(size_t size);
+};
+
+#endif // FRAMEALLOCATOR_H
@@ -0,0 +1,208 @@
+#include "framepool.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#ifdef PLATFORM_LINUX
+#include <sys/mman.h>
+#elif PLATFORM_WINDOWS
+#include <malloc.h>
+#endif
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+FramePool::~FramePool()
+{
+    // 还被使用方引用的帧释放后内存才真正回收
+    for (auto &pool : m_pools)
+    {
+        av_buffer_pool_uninit(&pool.m_pPool);
+    }
+}
+
+void FramePool::setHugePages(bool isHugePages)
+{
+    m_isHugePages.store(isHugePages, std::memory_order_relaxed);
+}
+
+bool FramePool::allocateFrame(AVCodecContext *context, AVFrame *frame)
+{
+    // 硬件帧和带调色板的格式不是普通的分量，交给默认分配
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (descriptor == nullptr || (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) != 0)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Pool *pPool = findPool(context, frame);
+    if (pPool == nullptr)
+    {
+        return false;
+    }
+
+    AVBufferRef *buffer = av_buffer_pool_get(pPool->m_pPool);
+    if (buffer == nullptr)
+    {
+        std::cerr << "av_buffer_pool_get failed" << std::endl;
+        return false;
+    }
+
+    // 所有分量共用一个引用
+    frame->buf[0] = buffer;
+    for (int i = 0; i < 4; i++)
+    {
+        frame->data[i] = pPool->m_linesizes[i] != 0 ? buffer->data + pPool->m_offsets[i] : nullptr;
+        frame->linesize[i] = pPool->m_linesizes[i];
+    }
+    frame->extended_data = frame->data;
+
+    m_frameCount++;
+    return true;
+}
+
+FramePoolStats FramePool::stats() const
+{
+    FramePoolStats stats;
+    stats.m_frameCount = m_frameCount.load(std::memory_order_relaxed);
+    stats.m_blockCount = m_blockCount.load(std::memory_order_relaxed);
+    stats.m_hugePageBlocks = m_hugePageBlocks.load(std::memory_order_relaxed);
+    stats.m_poolCount = m_poolCount.load(std::memory_order_relaxed);
+    stats.m_allocatedBytes = m_allocatedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// 调用时已经持有锁
+FramePool::Pool *FramePool::findPool(AVCodecContext *context, const AVFrame *frame)
+{
+    m_useCounter++;
+    bool isCodecLayout = context != nullptr;
+    for (auto &pool : m_pools)
+    {
+        if (pool.m_width == frame->width && pool.m_height == frame->height && pool.m_format == frame->format && pool.m_isCodecLayout == isCodecLayout)
+        {
+            pool.m_lastUsed = m_useCounter;
+            return &pool;
+        }
+    }
+
+    Pool pool;
+    size_t frameSize = computeFrameLayout(context, frame, pool.m_linesizes, pool.m_offsets);
+    if (frameSize == 0)
+    {
+        return nullptr;
+    }
+
+    pool.m_pPool = av_buffer_pool_init2(frameSize, this, &FramePool::allocBlock, nullptr);
+    if (pool.m_pPool == nullptr)
+    {
+        std::cerr << "av_buffer_pool_init2 failed" << std::endl;
+        return nullptr;
+    }
+    pool.m_width = frame->width;
+    pool.m_height = frame->height;
+    pool.m_format = frame->format;
+    pool.m_isCodecLayout = isCodecLayout;
+    pool.m_lastUsed = m_useCounter;
+
+    // 分辨率来回切换时保留最近用过的几种，更早的回收
+    if (m_pools.size() >= FRAME_POOL_MAX_FORMATS)
+    {
+        auto oldest = m_pools.begin();
+        for (auto iter = m_pools.begin(); iter != m_pools.end(); ++iter)
+        {
+            if (iter->m_lastUsed < oldest->m_lastUsed)
+            {
+                oldest = iter;
+            }
+        }
+        av_buffer_pool_uninit(&oldest->m_pPool);
+        m_pools.erase(oldest);
+    }
+
+    m_pools.push_back(pool);
+    m_poolCount++;
+    return &m_pools.back();
+}
+
+// 池里没有空闲的块时由AVBufferPool调用，只在allocateFrame里发生
+AVBufferRef *FramePool::allocBlock(void *opaque, size_t size)
+{
+    FramePool *pFramePool = static_cast<FramePool *>(opaque);
+    pFramePool->m_blockCount++;
+    pFramePool->m_allocatedBytes += size;
+
+#ifdef PLATFORM_LINUX
+    if (pFramePool->m_isHugePages.load(std::memory_order_relaxed) && size >= FRAME_POOL_HUGE_PAGE_THRESHOLD)
+    {
+        size_t mapSize = (size + FRAME_POOL_HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(FRAME_POOL_HUGE_PAGE_SIZE - 1);
+        void *data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            // 没有预留大页，退回普通映射并建议内核使用透明大页
+            data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, mapSize, MADV_HUGEPAGE);
+            }
+        }
+
+        if (data != MAP_FAILED)
+        {
+            // opaque记录映射的大小，释放时用munmap
+            AVBufferRef *buffer = av_buffer_create(static_cast<uint8_t *>(data), size, &FramePool::freeBlock, reinterpret_cast<void *>(mapSize), 0);
+            if (buffer == nullptr)
+            {
+                munmap(data, mapSize);
+                return nullptr;
+            }
+            pFramePool->m_hugePageBlocks++;
+            return buffer;
+        }
+    }
+#endif
+
+    void *data = nullptr;
+#ifdef PLATFORM_WINDOWS
+    data = _aligned_malloc(size, FRAME_PLANE_ALIGN);
+#else
+    if (posix_memalign(&data, FRAME_PLANE_ALIGN, size) != 0)
+    {
+        data = nullptr;
+    }
+#endif
+    if (data == nullptr)
+    {
+        return nullptr;
+    }
+
+    AVBufferRef *buffer = av_buffer_create(static_cast<uint8_t *>(data), size, &FramePool::freeBlock, nullptr, 0);
+    if (buffer == nullptr)
+    {
+        freeBlock(nullptr, static_cast<uint8_t *>(data));
+    }
+    return buffer;
+}
+
+// opaque不为空时是大页映射的大小
+void FramePool::freeBlock(void *opaque, uint8_t *data)
+{
+#ifdef PLATFORM_LINUX
+    if (opaque != nullptr)
+    {
+        munmap(data, reinterpret_cast<size_t>(opaque));
+        return;
+    }
+#else
+    (void)opaque;
+#endif
+
+#ifdef PLATFORM_WINDOWS
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
@@ -0,0 +1,84 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include "frameallocator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/buffer.h>
+}
+
+// 同时保留的分辨率和格式的组合数，超过时回收最久没用的
+#define FRAME_POOL_MAX_FORMATS 4
+// 一帧超过这个大小时才考虑用大页，4K的yuv420p大约12MB
+#define FRAME_POOL_HUGE_PAGE_THRESHOLD (8 * 1024 * 1024)
+#define FRAME_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct FramePoolStats
+{
+    uint64_t m_frameCount = 0;     // 从池里分配的帧
+    uint64_t m_blockCount = 0;     // 实际申请内存的次数，稳定以后不再增加
+    uint64_t m_hugePageBlocks = 0; // 其中用了大页的
+    uint64_t m_poolCount = 0;      // 创建过的池的个数，分辨率或格式变化时增加
+    uint64_t m_allocatedBytes = 0; // 累计申请的内存，池不回收时就是帧池占用的内存
+};
+
+// 解码输出帧的内存池，按分辨率、像素格式和是否是解码器的帧分开，每种一个AVBufferPool
+// 一帧的所有分量放在一块连续的内存里，起始地址和每个分量都按64字节对齐
+// 帧的最后一个引用释放后内存回到池里，分辨率不变时不再申请像素数据的内存
+// 开启大页时，超过阈值的帧先尝试预留的大页(MAP_HUGETLB)，没有时退回透明大页，只在Linux上有效
+class FramePool : public FrameAllocator
+{
+public:
+    FramePool() = default;
+    ~FramePool() override;
+
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    void setHugePages(bool isHugePages);
+
+    bool allocateFrame(AVCodecContext *context, AVFrame *frame) override;
+
+    FramePoolStats stats() const;
+
+private:
+    struct Pool
+    {
+        int m_width = 0;
+        int m_height = 0;
+        int m_format = AV_PIX_FMT_NONE;
+        // 解码器的帧按avcodec_align_dimensions2加大了宽高，缩小后的帧没有
+        // 两种布局不能混用，否则解码器会写到不够大的块外面
+        bool m_isCodecLayout = false;
+        AVBufferPool *m_pPool = nullptr;
+        int m_linesizes[4] = {0};
+        size_t m_offsets[4] = {0};
+        uint64_t m_lastUsed = 0;
+    };
+
+    Pool *findPool(AVCodecContext *context, const AVFrame *frame);
+    static AVBufferRef *allocBlock(void *opaque, size_t size);
+    static void freeBlock(void *opaque, uint8_t *data);
+
+private:
+    std::atomic_bool m_isHugePages{false};
+
+    // 解码器的多个线程可能同时分配
+    std::mutex m_mutex;
+    std::vector<Pool> m_pools;
+    uint64_t m_useCounter = 0;
+
+    std::atomic<uint64_t> m_frameCount{0};
+    std::atomic<uint64_t> m_blockCount{0};
+    std::atomic<uint64_t> m_hugePageBlocks{0};
+    std::atomic<uint64_t> m_poolCount{0};
+    std::atomic<uint64_t> m_allocatedBytes{0};
+};
+
+#endif // FRAMEPOOL_H
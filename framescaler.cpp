@@ -0,0 +1,204 @@
+#include "framescaler.h"
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 中间缓冲区的行宽按16字节对齐
+#define SCALER_LINESIZE_ALIGN 16
+
+bool FrameScaler::isSupported(int format)
+{
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(format));
+    if (descriptor == nullptr || descriptor->nb_components != 3)
+    {
+        return false;
+    }
+
+    if ((descriptor->flags & AV_PIX_FMT_FLAG_PLANAR) == 0 || (descriptor->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) != 0)
+    {
+        return false;
+    }
+
+    // 每个分量单独一个平面，每个像素一个字节
+    for (int i = 0; i < 3; i++)
+    {
+        if (descriptor->comp[i].depth != 8 || descriptor->comp[i].step != 1 || descriptor->comp[i].plane != i)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FrameScaler::scale(const AVFrame *src, AVFrame *dst)
+{
+    if (src->format != dst->format || !isSupported(src->format))
+    {
+        return false;
+    }
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(src->format));
+    for (int plane = 0; plane < 3; plane++)
+    {
+        // 色度分量的宽高按格式缩小，奇数时向上取整
+        int shiftX = plane == 0 ? 0 : descriptor->log2_chroma_w;
+        int shiftY = plane == 0 ? 0 : descriptor->log2_chroma_h;
+        int srcWidth = AV_CEIL_RSHIFT(src->width, shiftX);
+        int srcHeight = AV_CEIL_RSHIFT(src->height, shiftY);
+        int dstWidth = AV_CEIL_RSHIFT(dst->width, shiftX);
+        int dstHeight = AV_CEIL_RSHIFT(dst->height, shiftY);
+
+        scalePlane(src->data[plane], src->linesize[plane], srcWidth, srcHeight, dst->data[plane], dst->linesize[plane], dstWidth, dstHeight);
+    }
+    return true;
+}
+
+void FrameScaler::scalePlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight)
+{
+    const uint8_t *current = src;
+    int currentLinesize = srcLinesize;
+    int currentWidth = srcWidth;
+    int currentHeight = srcHeight;
+    int bufferIndex = 0;
+
+    // 两个方向都还能减半时先减半，大部分的缩小在这一步完成
+    while (currentWidth >= dstWidth * 2 && currentHeight >= dstHeight * 2)
+    {
+        int halfWidth = currentWidth / 2;
+        int halfHeight = currentHeight / 2;
+        int halfLinesize = (halfWidth + SCALER_LINESIZE_ALIGN - 1) & ~(SCALER_LINESIZE_ALIGN - 1);
+
+        std::vector<uint8_t> &buffer = m_halveBuffers[bufferIndex];
+        size_t needSize = static_cast<size_t>(halfLinesize) * halfHeight;
+        if (buffer.size() < needSize)
+        {
+            buffer.resize(needSize);
+        }
+
+        halvePlane(current, currentLinesize, currentWidth, currentHeight, buffer.data(), halfLinesize);
+
+        current = buffer.data();
+        currentLinesize = halfLinesize;
+        currentWidth = halfWidth;
+        currentHeight = halfHeight;
+        bufferIndex ^= 1;
+    }
+
+    boxPlane(current, currentLinesize, currentWidth, currentHeight, dst, dstLinesize, dstWidth, dstHeight);
+}
+
+// 宽高各减半，每个输出像素是2x2个源像素的平均，源的宽高是奇数时丢掉最后一列或一行
+void FrameScaler::halvePlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize)
+{
+    int dstWidth = srcWidth / 2;
+    int dstHeight = srcHeight / 2;
+
+#ifdef __SSE2__
+    const __m128i lowByteMask = _mm_set1_epi16(0x00FF);
+    const __m128i rounding = _mm_set1_epi16(2);
+#endif
+
+    for (int y = 0; y < dstHeight; y++)
+    {
+        const uint8_t *row0 = src + static_cast<ptrdiff_t>(y) * 2 * srcLinesize;
+        const uint8_t *row1 = row0 + srcLinesize;
+        uint8_t *out = dst + static_cast<ptrdiff_t>(y) * dstLinesize;
+        int x = 0;
+
+#ifdef __SSE2__
+        // 一次读两行各32个源像素，输出16个像素
+        // 每个16位里的低字节是偶数列，高字节是奇数列，拆开后相加不会溢出
+        for (; x + 16 <= dstWidth; x += 16)
+        {
+            __m128i top0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 2));
+            __m128i top1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 2 + 16));
+            __m128i bottom0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 2));
+            __m128i bottom1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 2 + 16));
+
+            __m128i sum0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(top0, lowByteMask), _mm_srli_epi16(top0, 8)),
+                                         _mm_add_epi16(_mm_and_si128(bottom0, lowByteMask), _mm_srli_epi16(bottom0, 8)));
+            __m128i sum1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(top1, lowByteMask), _mm_srli_epi16(top1, 8)),
+                                         _mm_add_epi16(_mm_and_si128(bottom1, lowByteMask), _mm_srli_epi16(bottom1, 8)));
+
+            sum0 = _mm_srli_epi16(_mm_add_epi16(sum0, rounding), 2);
+            sum1 = _mm_srli_epi16(_mm_add_epi16(sum1, rounding), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(sum0, sum1));
+        }
+#endif
+
+        for (; x < dstWidth; x++)
+        {
+            out[x] = static_cast<uint8_t>((row0[x * 2] + row0[x * 2 + 1] + row1[x * 2] + row1[x * 2 + 1] + 2) >> 2);
+        }
+    }
+}
+
+// 计算一个方向上每个输出像素覆盖哪些源像素，以及每个源像素覆盖的比例(权重总和为256)
+static void buildTaps(int srcSize, int dstSize, std::vector<int> &starts, std::vector<int> &counts, std::vector<int> &weights)
+{
+    starts.resize(dstSize);
+    counts.resize(dstSize);
+    weights.clear();
+
+    // 坐标放大dstSize倍后都是整数，第i个输出像素覆盖[i * srcSize, (i + 1) * srcSize)
+    for (int i = 0; i < dstSize; i++)
+    {
+        int64_t begin = static_cast<int64_t>(i) * srcSize;
+        int64_t end = begin + srcSize;
+        int first = static_cast<int>(begin / dstSize);
+        int last = static_cast<int>((end - 1) / dstSize);
+
+        starts[i] = first;
+        counts[i] = last - first + 1;
+        int weightSum = 0;
+        for (int j = first; j <= last; j++)
+        {
+            int64_t overlapBegin = std::max(begin, static_cast<int64_t>(j) * dstSize);
+            int64_t overlapEnd = std::min(end, static_cast<int64_t>(j + 1) * dstSize);
+            int weight = static_cast<int>((overlapEnd - overlapBegin) * 256 / srcSize);
+            weights.push_back(weight);
+            weightSum += weight;
+        }
+        // 取整的误差加到第一个源像素上，保证总和是256
+        weights[weights.size() - counts[i]] += 256 - weightSum;
+    }
+}
+
+// 任意比例的缩小，每个输出像素是它覆盖的源像素按覆盖面积的加权平均
+void FrameScaler::boxPlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight)
+{
+    buildTaps(srcWidth, dstWidth, m_tapStartsX, m_tapCountsX, m_tapWeightsX);
+    buildTaps(srcHeight, dstHeight, m_tapStartsY, m_tapCountsY, m_tapWeightsY);
+
+    size_t weightIndexY = 0;
+    for (int y = 0; y < dstHeight; y++)
+    {
+        uint8_t *out = dst + static_cast<ptrdiff_t>(y) * dstLinesize;
+        size_t weightIndexX = 0;
+        for (int x = 0; x < dstWidth; x++)
+        {
+            int sum = 0;
+            for (int ty = 0; ty < m_tapCountsY[y]; ty++)
+            {
+                const uint8_t *row = src + static_cast<ptrdiff_t>(m_tapStartsY[y] + ty) * srcLinesize + m_tapStartsX[x];
+                int rowSum = 0;
+                for (int tx = 0; tx < m_tapCountsX[x]; tx++)
+                {
+                    rowSum += row[tx] * m_tapWeightsX[weightIndexX + tx];
+                }
+                sum += rowSum * m_tapWeightsY[weightIndexY + ty];
+            }
+            out[x] = static_cast<uint8_t>((sum + 32768) >> 16);
+            weightIndexX += m_tapCountsX[x];
+        }
+        weightIndexY += m_tapCountsY[y];
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef FRAMESCALER_H
+#define FRAMESCALER_H
+
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+// 缩略图用的缩小，按面积平均，只缩小不放大
+// 先用SSE2每次把宽高减半，剩下不到两倍的部分再按每个输出像素覆盖的源像素面积加权平均
+// 只支持8位的平面YUV格式(yuv420p、yuv422p、yuv444p等)
+class FrameScaler
+{
+public:
+    // 判断格式是否支持
+    static bool isSupported(int format);
+
+    // dst的宽高、格式和缓冲区由调用方准备好，格式要和src相同
+    bool scale(const AVFrame *src, AVFrame *dst);
+
+private:
+    static void halvePlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize);
+    void boxPlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight);
+    void scalePlane(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight);
+
+private:
+    // 逐级减半时交替使用的两个中间缓冲区，分辨率不变时不再重新分配
+    std::vector<uint8_t> m_halveBuffers[2];
+    // 最后一步缩小时每个输出像素的源像素范围和权重
+    std::vector<int> m_tapStartsX;
+    std::vector<int> m_tapCountsX;
+    std::vector<int> m_tapWeightsX;
+    std::vector<int> m_tapStartsY;
+    std::vector<int> m_tapCountsY;
+    std::vector<int> m_tapWeightsY;
+};
+
+#endif // FRAMESCALER_H
@@ -1,11 +1,65 @@
 #include "h264decoder.h"
 
-H264Decoder::H264Decoder()
+#include <algorithm>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+#ifdef PLATFORM_LINUX
+#include <time.h>
+#elif PLATFORM_WINDOWS
+#include <windows.h>
+#endif
+
+// 当前线程用掉的CPU时间，用来统计每一路解码的开销
+static int64_t threadCpuTimeUs()
+{
+#ifdef PLATFORM_LINUX
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+    {
+        return 0;
+    }
+    return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+#elif PLATFORM_WINDOWS
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+    // FILETIME的单位是100纳秒
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return static_cast<int64_t>((kernel.QuadPart + user.QuadPart) / 10);
+#else
+    return 0;
+#endif
+}
+
+H264Decoder::H264Decoder(const DecoderConfig &config)
+    : m_config(config)
 {
     initCodec();
 }
 
 H264Decoder::~H264Decoder()
+{
+    closeCodec();
+}
+
+bool H264Decoder::configure(const DecoderConfig &config)
+{
+    m_config = config;
+    closeCodec();
+    return initCodec();
+}
+
+void H264Decoder::closeCodec()
 {
     if (m_pCodecContext != nullptr)
     {
@@ -18,96 +72,531 @@ H264Decoder::~H264Decoder()
         av_frame_free(&m_pVideoFrame);
         m_pVideoFrame = nullptr;
     }
+
+    if (m_pTileFrame != nullptr)
+    {
+        av_frame_free(&m_pTileFrame);
+        m_pTileFrame = nullptr;
+    }
+
+    if (m_pPacket != nullptr)
+    {
+        av_packet_free(&m_pPacket);
+        m_pPacket = nullptr;
+    }
 }
 
-void H264Decoder::initCodec()
+bool H264Decoder::initCodec()
 {
     m_pCodec = avcodec_find_decoder(AV_CODEC_ID_H264);
     if (m_pCodec == nullptr)
     {
         std::cerr << "avcodec_find_decoder error" << std::endl;
+        return false;
     }
 
     m_pCodecContext = avcodec_alloc_context3(m_pCodec);
     if (m_pCodecContext == nullptr)
     {
         std::cerr << "avcode_alloc_context3 error" << std::endl;
+        return false;
     }
 
+    // 输出帧的缓冲区由分配器决定，没有分配器时从帧池里取
+    m_framePool.setHugePages(m_config.m_isHugePages);
+    m_pCodecContext->opaque = this;
+    m_pCodecContext->get_buffer2 = &H264Decoder::getBuffer;
+
+    // 线程参数必须在avcodec_open2之前设置
+    if (m_config.m_profile == DECODER_PROFILE_LOW_LATENCY)
+    {
+        // slice线程在同一帧内部并行，不会像frame线程那样缓存多帧
+        // 调用方要保证码流没有B帧，否则LOW_DELAY会让帧按解码顺序输出
+        m_pCodecContext->thread_type = FF_THREAD_SLICE;
+        m_pCodecContext->thread_count = m_config.m_threadCount;
+        m_pCodecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    else if (m_config.m_profile == DECODER_PROFILE_THROUGHPUT)
+    {
+        m_pCodecContext->thread_type = FF_THREAD_FRAME;
+        m_pCodecContext->thread_count = m_config.m_threadCount;
+    }
+    else if (m_config.m_threadCount != 0)
+    {
+        m_pCodecContext->thread_count = m_config.m_threadCount;
+    }
+
+    if (m_config.m_threadType != DECODER_THREAD_TYPE_AUTO)
+    {
+        m_pCodecContext->thread_type = m_config.m_threadType;
+    }
+
+    // 新打开的解码器从完整解码开始
+    resetLoadControl();
+    // tile模式在下一个包开始时重新设置到新的解码器上
+    m_loadStats.m_isTileMode = false;
+    m_isWaitingKeyFrame = false;
+    publishLoadStats();
+
     if (avcodec_open2(m_pCodecContext, m_pCodec, nullptr) < 0)
     {
         std::cerr << "avcodec_open2 error" << std::endl;
+        return false;
     }
 
+    // 打开后的thread_count和active_thread_type是实际生效的值
+    std::cout << "h264 decoder opened, threads " << m_pCodecContext->thread_count
+              << ", thread type " << m_pCodecContext->active_thread_type << std::endl;
+
     m_pVideoFrame = av_frame_alloc();
     if (m_pVideoFrame == nullptr)
     {
         std::cerr << "av_frame_alloc error" << std::endl;
+        return false;
+    }
+
+    m_pPacket = av_packet_alloc();
+    if (m_pPacket == nullptr)
+    {
+        std::cerr << "av_packet_alloc error" << std::endl;
+        return false;
+    }
+
+    m_pTileFrame = av_frame_alloc();
+    if (m_pTileFrame == nullptr)
+    {
+        std::cerr << "av_frame_alloc error" << std::endl;
+        return false;
     }
+
+    return true;
 }
 
-void H264Decoder::copyFrameData(uint8_t *src, uint8_t *dst, int linesize, int width, int height)
+int H264Decoder::getBuffer(AVCodecContext *context, AVFrame *frame, int flags)
 {
-    for (int i = 0; i < height; i++)
+    H264Decoder *pDecoder = static_cast<H264Decoder *>(context->opaque);
+    FrameAllocator *pAllocator = pDecoder->m_pFrameAllocator.load(std::memory_order_acquire);
+    if (pAllocator != nullptr && pAllocator->allocateFrame(context, frame))
     {
-        memcpy(dst, src, width);
+        return 0;
+    }
 
-        dst += width;
+    if (pDecoder->m_framePool.allocateFrame(context, frame))
+    {
+        return 0;
+    }
 
-        src += linesize;
+    return avcodec_default_get_buffer2(context, frame, flags);
+}
+
+void H264Decoder::setFrameAllocator(FrameAllocator *pAllocator)
+{
+    m_pFrameAllocator.store(pAllocator, std::memory_order_release);
+}
+
+FramePoolStats H264Decoder::framePoolStats() const
+{
+    return m_framePool.stats();
+}
+
+void H264Decoder::reset()
+{
+    if (m_pCodecContext != nullptr)
+    {
+        avcodec_flush_buffers(m_pCodecContext);
+    }
+}
+
+bool H264Decoder::isKeyFramePacket(const uint8_t *data, size_t length)
+{
+    // 找起始码00 00 01，后面一个字节的低5位是NAL类型，5表示IDR
+    for (size_t i = 0; i + 3 < length; i++)
+    {
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+        {
+            continue;
+        }
+
+        int nalType = data[i + 3] & 0x1F;
+        if (nalType == 5)
+        {
+            return true;
+        }
+        i += 2;
     }
+
+    return false;
 }
 
-int H264Decoder::decodeH264Packet(std::vector<uint8_t> &&buffer, size_t length, YUVFrameData *outFrame)
+int H264Decoder::decodeH264Packet(AVBufferRef *buffer, size_t length, int64_t pts, int64_t queueDelayUs, const decodedFrameCallback &callback)
 {
-    if (outFrame == nullptr)
+    if (buffer == nullptr)
     {
-        std::cerr << "Output frame is null" << std::endl;
+        std::cerr << "Input packet is null" << std::endl;
         return -1;
     }
 
-    AVPacket *pkg = av_packet_alloc();
-    if (pkg == nullptr)
+    if (m_pCodecContext == nullptr)
     {
-        std::cerr << "Failed to allocate packet" << std::endl;
+        av_buffer_unref(&buffer);
+        return -1;
     }
-    pkg->data = buffer.data();
-    pkg->size = length;
 
-    int ret = 0;
-    ret = avcodec_send_packet(m_pCodecContext, pkg);
-    av_packet_free(&pkg);
+    updateTileMode();
+
+    auto startTime = std::chrono::steady_clock::now();
+    int64_t startCpuTime = threadCpuTimeUs();
+    m_callbackTimeUs = 0;
+
+    // 带引用计数的packet，解码器只增加引用，不会再拷贝一份负载
+    m_pPacket->buf = buffer;
+    m_pPacket->data = buffer->data;
+    m_pPacket->size = static_cast<int>(length);
+    m_pPacket->pts = pts;
+    m_pPacket->dts = AV_NOPTS_VALUE;
+
+    int frameCount = 0;
+    int ret = avcodec_send_packet(m_pCodecContext, m_pPacket);
+    if (ret == AVERROR(EAGAIN))
+    {
+        // 解码器的输出还没取完，先取出来再送一次
+        frameCount = std::max(receiveFrames(callback), 0);
+        ret = avcodec_send_packet(m_pCodecContext, m_pPacket);
+    }
+    av_packet_unref(m_pPacket);
     if (ret != 0)
     {
         std::cerr << "Error sending packet to decoder: " << ret << std::endl;
         return -1;
     }
 
-    ret = avcodec_receive_frame(m_pCodecContext, m_pVideoFrame);
-    if (ret != 0)
+    int receivedCount = receiveFrames(callback);
+    m_loadStats.m_cpuTimeUs += threadCpuTimeUs() - startCpuTime;
+    if (receivedCount >= 0 && m_config.m_isLoadShedding)
+    {
+        // frame多线程时解码在FFmpeg的线程里，送包和取帧的耗时只有在线程都忙、需要等待时才变长
+        // 所以占用时间包括等待，能反映解码器整体是否跟得上
+        auto decodeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+        updateLoadLevel(decodeTime - m_callbackTimeUs, queueDelayUs);
+    }
+
+    publishLoadStats();
+    if (receivedCount < 0)
     {
-        std::cerr << "Error receiving frame from decoder: " << ret << std::endl;
         return -1;
     }
 
-    size_t lumaLength = m_pCodecContext->width * m_pCodecContext->height;
-    size_t chromaBLength = m_pCodecContext->width / 2 * m_pCodecContext->height / 2;
-    size_t chromaRLength = m_pCodecContext->width / 2 * m_pCodecContext->height / 2;
+    return frameCount + receivedCount;
+}
+
+void H264Decoder::setLoadLevelCallback(loadLevelCallback &&callback)
+{
+    m_loadLevelCallback = callback;
+}
+
+DecoderLoadStats H264Decoder::loadStats() const
+{
+    std::lock_guard<std::mutex> lock(m_publishedLoadStatsMutex);
+    return m_publishedLoadStats;
+}
+
+void H264Decoder::publishLoadStats()
+{
+    std::lock_guard<std::mutex> lock(m_publishedLoadStatsMutex);
+    m_publishedLoadStats = m_loadStats;
+}
 
-    outFrame->m_luma.m_dataBuffer.resize(lumaLength);
-    outFrame->m_chromaB.m_dataBuffer.resize(chromaBLength);
-    outFrame->m_chromaR.m_dataBuffer.resize(chromaRLength);
+void H264Decoder::resetLoadControl()
+{
+    m_loadController.reset(std::chrono::steady_clock::now());
+    copyLoadState();
+}
 
-    outFrame->m_luma.m_length = lumaLength;
-    outFrame->m_chromaB.m_length = chromaBLength;
-    outFrame->m_chromaR.m_length = chromaRLength;
+void H264Decoder::updateLoadLevel(int64_t busyUs, int64_t queueDelayUs)
+{
+    int level = m_loadStats.m_level;
+    bool isChanged = m_loadController.update(busyUs, queueDelayUs, frameIntervalUs(), std::chrono::steady_clock::now());
+    copyLoadState();
+    if (!isChanged)
+    {
+        return;
+    }
 
-    outFrame->m_width = m_pCodecContext->width;
-    outFrame->m_height = m_pCodecContext->height;
+    int newLevel = m_loadStats.m_level;
+    std::cout << "decode busy " << m_loadStats.m_busyRatio << ", queue delay " << m_loadStats.m_averageQueueDelayUs << "us, level " << level << " -> " << newLevel << std::endl;
+    m_loadStats.m_levelChanges++;
+    applyLoadLevel();
 
-    copyFrameData(m_pVideoFrame->data[0], outFrame->m_luma.m_dataBuffer.data(), m_pVideoFrame->linesize[0], m_pCodecContext->width, m_pCodecContext->height);
-    copyFrameData(m_pVideoFrame->data[1], outFrame->m_chromaB.m_dataBuffer.data(), m_pVideoFrame->linesize[1], m_pCodecContext->width / 2, m_pCodecContext->height / 2);
-    copyFrameData(m_pVideoFrame->data[2], outFrame->m_chromaR.m_dataBuffer.data(), m_pVideoFrame->linesize[2], m_pCodecContext->width / 2, m_pCodecContext->height / 2);
+    if (m_loadLevelCallback)
+    {
+        m_loadLevelCallback(newLevel);
+    }
+}
 
-    return 0;
+void H264Decoder::copyLoadState()
+{
+    const DecodeLoadState &state = m_loadController.state();
+    m_loadStats.m_level = state.m_level;
+    m_loadStats.m_busyRatio = state.m_busyRatio;
+    m_loadStats.m_averageQueueDelayUs = state.m_averageQueueDelayUs;
+    m_loadStats.m_frameIntervalUs = state.m_frameIntervalUs;
+    m_loadStats.m_recoverHoldMs = state.m_recoverHoldMs;
+}
+
+// 解码器在每一帧开始时读取这两个参数，打开之后也可以修改
+// tile模式和降级同时生效时取丢得更多的那个
+void H264Decoder::applyLoadLevel()
+{
+    int level = m_loadStats.m_level;
+    AVDiscard skipLoopFilter = level >= DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    AVDiscard skipFrame = AVDISCARD_DEFAULT;
+    if (level >= DECODE_LOAD_LEVEL_KEYFRAME_ONLY)
+    {
+        skipFrame = AVDISCARD_NONKEY;
+    }
+    else if (level >= DECODE_LOAD_LEVEL_SKIP_NONREF)
+    {
+        skipFrame = AVDISCARD_NONREF;
+    }
+
+    if (m_loadStats.m_isTileMode)
+    {
+        if (m_config.m_tileFrameStep == 0)
+        {
+            // 只解关键帧时没有帧参考它，缩小后也看不出去块滤波的差别
+            skipFrame = AVDISCARD_NONKEY;
+            skipLoopFilter = AVDISCARD_ALL;
+        }
+        else
+        {
+            skipFrame = std::max(skipFrame, AVDISCARD_NONREF);
+        }
+    }
+
+    // 只解关键帧时后面的P帧缺参考帧，无论是降级恢复还是退出tile模式，都要等下一个关键帧
+    if (m_pCodecContext->skip_frame >= AVDISCARD_NONKEY && skipFrame < AVDISCARD_NONKEY)
+    {
+        m_isWaitingKeyFrame = true;
+    }
+
+    m_pCodecContext->skip_loop_filter = skipLoopFilter;
+    m_pCodecContext->skip_frame = skipFrame;
+}
+
+void H264Decoder::setTileMode(bool isTileMode)
+{
+    m_isTileModeRequested.store(isTileMode, std::memory_order_release);
+}
+
+bool H264Decoder::isTileMode() const
+{
+    return m_isTileModeRequested.load(std::memory_order_acquire);
+}
+
+// 在解码线程里把请求的tile模式设置到解码器上
+void H264Decoder::updateTileMode()
+{
+    bool isTileMode = m_isTileModeRequested.load(std::memory_order_acquire);
+    if (isTileMode == m_loadStats.m_isTileMode)
+    {
+        return;
+    }
+
+    std::cout << "tile mode " << (isTileMode ? "on" : "off") << std::endl;
+    m_loadStats.m_isTileMode = isTileMode;
+    m_tileFrameCounter = 0;
+    applyLoadLevel();
+}
+
+bool H264Decoder::scaleToTile()
+{
+    int srcWidth = m_pVideoFrame->width;
+    int srcHeight = m_pVideoFrame->height;
+    if (srcWidth <= 0 || srcHeight <= 0 || !FrameScaler::isSupported(m_pVideoFrame->format))
+    {
+        return false;
+    }
+
+    // 保持宽高比放进tile里，宽高取偶数，色度分量正好是一半
+    int width = m_config.m_tileWidth;
+    int height = static_cast<int>(static_cast<int64_t>(srcHeight) * width / srcWidth);
+    if (height > m_config.m_tileHeight)
+    {
+        height = m_config.m_tileHeight;
+        width = static_cast<int>(static_cast<int64_t>(srcWidth) * height / srcHeight);
+    }
+    width &= ~1;
+    height &= ~1;
+
+    // 原图已经不比tile大时直接输出原图
+    if (width <= 0 || height <= 0 || width >= srcWidth || height >= srcHeight)
+    {
+        return false;
+    }
+
+    // 缩小后的帧也从帧池里取，使用方释放后回到池里
+    av_frame_unref(m_pTileFrame);
+    m_pTileFrame->width = width;
+    m_pTileFrame->height = height;
+    m_pTileFrame->format = m_pVideoFrame->format;
+    if (!m_framePool.allocateFrame(nullptr, m_pTileFrame))
+    {
+        return false;
+    }
+
+    if (!m_scaler.scale(m_pVideoFrame, m_pTileFrame))
+    {
+        av_frame_unref(m_pTileFrame);
+        return false;
+    }
+
+    av_frame_copy_props(m_pTileFrame, m_pVideoFrame);
+    return true;
+}
+
+int64_t H264Decoder::frameIntervalUs() const
+{
+    // SPS里带了时间信息时解码器会填好帧率，明显不合理的值不用
+    AVRational frameRate = m_pCodecContext->framerate;
+    if (frameRate.num > 0 && frameRate.den > 0)
+    {
+        int64_t intervalUs = 1000000LL * frameRate.den / frameRate.num;
+        if (intervalUs >= DECODE_LOAD_MIN_FRAME_INTERVAL_US)
+        {
+            return intervalUs;
+        }
+    }
+
+    int configuredRate = m_config.m_frameRate > 0 ? m_config.m_frameRate : DECODE_LOAD_DEFAULT_FRAME_RATE;
+    return 1000000LL / configuredRate;
+}
+
+int H264Decoder::flush(const decodedFrameCallback &callback)
+{
+    if (m_pCodecContext == nullptr)
+    {
+        return 0;
+    }
+
+    // 空包表示没有更多输入，解码器把缓存的帧全部输出
+    int ret = avcodec_send_packet(m_pCodecContext, nullptr);
+    int frameCount = 0;
+    if (ret == 0 || ret == AVERROR_EOF)
+    {
+        frameCount = receiveFrames(callback);
+    }
+
+    // 进入EOF状态后必须清一下才能继续送包
+    avcodec_flush_buffers(m_pCodecContext);
+    publishLoadStats();
+    return frameCount;
+}
+
+int H264Decoder::receiveFrames(const decodedFrameCallback &callback)
+{
+    int frameCount = 0;
+    while (true)
+    {
+        int ret = avcodec_receive_frame(m_pCodecContext, m_pVideoFrame);
+
+        // EAGAIN表示需要更多输入，EOF表示已经全部输出，都不是错误
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        {
+            break;
+        }
+
+        if (ret < 0)
+        {
+            std::cerr << "Error receiving frame from decoder: " << ret << std::endl;
+            return -1;
+        }
+
+        outputFrame(callback);
+        av_frame_unref(m_pVideoFrame);
+        frameCount++;
+    }
+
+    return frameCount;
+}
+
+void H264Decoder::outputFrame(const decodedFrameCallback &callback)
+{
+    if (!callback)
+    {
+        return;
+    }
+
+    if (m_isWaitingKeyFrame)
+    {
+        if ((m_pVideoFrame->flags & AV_FRAME_FLAG_KEY) == 0)
+        {
+            m_loadStats.m_skippedFrames++;
+            return;
+        }
+        m_isWaitingKeyFrame = false;
+    }
+
+    const AVFrame *pFrame = m_pVideoFrame;
+    if (m_loadStats.m_isTileMode)
+    {
+        // 每N帧只输出一帧，其余的解完就丢掉
+        if (m_config.m_tileFrameStep > 1 && m_tileFrameCounter++ % m_config.m_tileFrameStep != 0)
+        {
+            m_loadStats.m_skippedFrames++;
+            return;
+        }
+
+        if (scaleToTile())
+        {
+            pFrame = m_pTileFrame;
+            m_loadStats.m_scaledFrames++;
+        }
+    }
+
+    // 只引用解码器的帧，按原始行宽交给使用方，不拷贝像素数据
+    YUVFrameData outFrame;
+    outFrame.m_frame = VideoFrame(pFrame);
+    if (!outFrame.m_frame.isValid())
+    {
+        return;
+    }
+
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pFrame->format));
+    if (descriptor == nullptr)
+    {
+        return;
+    }
+
+    int width = pFrame->width;
+    int height = pFrame->height;
+    outFrame.m_width = width;
+    outFrame.m_height = height;
+    outFrame.pts = pFrame->best_effort_timestamp;
+    outFrame.m_format = pFrame->format;
+    outFrame.m_colorSpace = pFrame->colorspace;
+    outFrame.m_colorRange = pFrame->color_range;
+
+    // 色度分量按格式缩小，宽高是奇数时向上取整；半平面格式只有两个平面
+    int planeCount = std::min(av_pix_fmt_count_planes(static_cast<AVPixelFormat>(pFrame->format)), 3);
+    YUVChannel *channels[3] = {&outFrame.m_luma, &outFrame.m_chromaB, &outFrame.m_chromaR};
+    for (int plane = 0; plane < planeCount; plane++)
+    {
+        YUVChannel *channel = channels[plane];
+        channel->m_pData = outFrame.m_frame.data(plane);
+        channel->m_linesize = outFrame.m_frame.linesize(plane);
+        channel->m_width = plane == 0 ? width : AV_CEIL_RSHIFT(width, descriptor->log2_chroma_w);
+        channel->m_height = plane == 0 ? height : AV_CEIL_RSHIFT(height, descriptor->log2_chroma_h);
+    }
+
+    m_loadStats.m_outputFrames++;
+    // 回调的耗时不算在解码的开销里
+    auto callbackStartTime = std::chrono::steady_clock::now();
+    callback(&outFrame);
+    m_callbackTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - callbackStartTime).count();
+
+    // 使用方需要的话已经拿走了引用，这里不再占着池里的块
+    if (pFrame == m_pTileFrame)
+    {
+        av_frame_unref(m_pTileFrame);
+    }
 }
@@ -2,8 +2,16 @@
 #define H264DECODER_H
 
 #include "type.h"
+#include "frameallocator.h"
+#include "framepool.h"
+#include "framescaler.h"
+#include "decodeloadcontroller.h"
 
 #include <iostream>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 extern "C"
 {
@@ -11,22 +19,123 @@ extern "C"
 #include <libavformat/avformat.h>
 }
 
+// 每解出一帧回调一次，帧数据引用的是解码器输出的缓冲区，没有拷贝
+// 回调返回后释放，需要留到之后使用的话在回调里把它std::move走
+using decodedFrameCallback = std::function<void(YUVFrameData *yuvFrameData)>;
+// 降级的级别变化时回调，level是DECODE_LOAD_LEVEL_*，在解码线程里执行
+using loadLevelCallback = std::function<void(int level)>;
+
+// 码流和配置里都没有帧率时使用
+#define DECODE_LOAD_DEFAULT_FRAME_RATE 30
+// 码流里的帧率超过240时认为不可信
+#define DECODE_LOAD_MIN_FRAME_INTERVAL_US (1000000 / 240)
+
+struct DecoderLoadStats
+{
+    int m_level = DECODE_LOAD_LEVEL_NORMAL;
+    uint64_t m_levelChanges = 0;
+    double m_busyRatio = 0;             // 最近一个窗口里解码占用的时间比例，不包括输出回调
+    int64_t m_averageQueueDelayUs = 0;  // 最近一个窗口里包在送进解码器之前平均排队的时间
+    int64_t m_frameIntervalUs = 0;      // 当前使用的帧间隔
+    int64_t m_recoverHoldMs = 0;        // 现在恢复一级需要等待的时间
+    int64_t m_cpuTimeUs = 0;       // 解码线程累计的CPU时间，不包括FFmpeg内部的解码线程
+    uint64_t m_outputFrames = 0;   // 交给回调的帧
+    uint64_t m_skippedFrames = 0;  // tile模式下解出来但没有输出的帧
+    uint64_t m_scaledFrames = 0;   // tile模式下缩小后输出的帧
+    bool m_isTileMode = false;
+};
+
 class H264Decoder
 {
 public:
-    H264Decoder();
+    explicit H264Decoder(const DecoderConfig &config = DecoderConfig());
     ~H264Decoder();
 
-    int decodeH264Packet(std::vector<uint8_t> &&buffer, size_t length, YUVFrameData *outBuffer);
+    // 按新的线程配置重新打开解码器，线程参数只能在打开之前设置
+    // 不能和解码同时调用
+    bool configure(const DecoderConfig &config);
+
+    // buffer的引用交给解码器，无论成功与否调用方都不再持有
+    // 缓冲区末尾需要有AV_INPUT_BUFFER_PADDING_SIZE大小的补零填充
+    // 一个包可能解出零帧或多帧，每一帧都回调，返回解出的帧数，出错返回-1
+    // pts会原样带到解出的帧上(best_effort_timestamp)，不知道时传AV_NOPTS_VALUE
+    // queueDelayUs是包送进解码器之前排队的时间，解码跟不上时会越来越长，是降级的依据之一
+    int decodeH264Packet(AVBufferRef *buffer, size_t length, int64_t pts, int64_t queueDelayUs, const decodedFrameCallback &callback);
+
+    // 输出解码器里还缓存着的帧(比如B帧重排序队列)，之后解码器可以继续使用
+    // 流结束或者重新连接时调用，返回输出的帧数
+    int flush(const decodedFrameCallback &callback);
+
+    // 直接丢掉解码器内部缓存的帧和参考帧
+    void reset();
+
+    // 设置解码输出帧的分配器，比如直接分配在映射好的PBO里，传nullptr恢复默认的帧池
+    // 可以在解码过程中切换，已经分配出去的帧不受影响；分配器要比解码器里的帧活得久
+    void setFrameAllocator(FrameAllocator *pAllocator);
+
+    FramePoolStats framePoolStats() const;
+
+    // 需要在开始解码之前设置
+    // 从只解关键帧的级别恢复时，和退出tile模式一样等到下一个关键帧才开始输出
+    void setLoadLevelCallback(loadLevelCallback &&callback);
+    // 返回解码线程处理完上一个包时的快照，可以在任意线程调用
+    DecoderLoadStats loadStats() const;
+
+    // 切换tile模式，可以在任意线程调用，解码线程在下一个包开始时生效
+    // tile模式下只解关键帧(或者每N帧输出一帧)，输出缩小到m_tileWidth x m_tileHeight以内的帧
+    // 从只解关键帧的tile模式切回完整解码时，参考帧不完整，等到下一个关键帧才开始输出
+    void setTileMode(bool isTileMode);
+    bool isTileMode() const;
+
+    // 判断Annex B格式的数据里是否包含IDR帧
+    static bool isKeyFramePacket(const uint8_t *data, size_t length);
 
 private:
-    void initCodec();
-    void copyFrameData(uint8_t *src, uint8_t *dst, int linesize, int width, int height);
+    bool initCodec();
+    static int getBuffer(AVCodecContext *context, AVFrame *frame, int flags);
+    void closeCodec();
+    // 取出所有已经解好的帧，返回帧数，出错返回-1
+    int receiveFrames(const decodedFrameCallback &callback);
+    void outputFrame(const decodedFrameCallback &callback);
+    // 交给降级控制器评估，级别变化时设置到解码器上
+    void updateLoadLevel(int64_t busyUs, int64_t queueDelayUs);
+    void resetLoadControl();
+    void copyLoadState();
+    // 把m_loadStats复制一份给其他线程读
+    void publishLoadStats();
+    void applyLoadLevel();
+    int64_t frameIntervalUs() const;
+    void updateTileMode();
+    // 缩小到tile大小，结果在m_pTileFrame里
+    bool scaleToTile();
 
 private:
+    DecoderConfig m_config;
     const AVCodec *m_pCodec = nullptr;
     AVCodecContext *m_pCodecContext = nullptr;
     AVFrame *m_pVideoFrame = nullptr;
+    // 重复使用的packet，不再每次分配
+    AVPacket *m_pPacket = nullptr;
+    // get_buffer2可能在解码器内部的线程里调用
+    std::atomic<FrameAllocator *> m_pFrameAllocator{nullptr};
+    // 没有设置分配器或者分配器分配不了时用的帧池
+    FramePool m_framePool;
+
+    // 降级控制，只在解码线程里修改
+    loadLevelCallback m_loadLevelCallback;
+    DecodeLoadController m_loadController;
+    DecoderLoadStats m_loadStats;
+    mutable std::mutex m_publishedLoadStatsMutex;
+    DecoderLoadStats m_publishedLoadStats;
+    // 这个包里输出回调用掉的时间，从解码占用的时间里扣掉
+    int64_t m_callbackTimeUs = 0;
+
+    // tile模式，请求的状态可以在其他线程修改，生效的状态只在解码线程里修改
+    std::atomic_bool m_isTileModeRequested{false};
+    bool m_isWaitingKeyFrame = false;
+    uint64_t m_tileFrameCounter = 0;
+    AVFrame *m_pTileFrame = nullptr;
+    FrameScaler m_scaler;
 };
 
 #endif // H264DECODER_H
@@ -0,0 +1,245 @@
+#include "iouringreceiver.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_LIBURING
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// multishot recv的user_data标记
+#define IOURING_RECV_TAG 1
+
+IoUringReceiver::IoUringReceiver()
+{
+}
+
+IoUringReceiver::~IoUringReceiver()
+{
+    close();
+}
+
+#ifdef HAVE_LIBURING
+bool IoUringReceiver::init(int socketFD)
+{
+    close();
+    m_socketFD = socketFD;
+    m_hasReceivedData = false;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ret = io_uring_queue_init_params(IOURING_QUEUE_DEPTH, &m_ring, &params);
+    if (ret < 0)
+    {
+        std::cerr << "io_uring_queue_init failed: " << strerror(-ret) << std::endl;
+        return false;
+    }
+    m_isRingInitialized = true;
+
+    // 按页对齐分配，内核往里面写数据
+    m_pBufferMemory = static_cast<uint8_t *>(std::aligned_alloc(4096, IOURING_BUFFER_COUNT * IOURING_BUFFER_SIZE));
+    if (m_pBufferMemory == nullptr)
+    {
+        std::cerr << "io_uring buffer alloc failed" << std::endl;
+        close();
+        return false;
+    }
+
+    // 把buffer ring注册给内核，需要5.19以上的内核
+    int error = 0;
+    m_pBufferRing = io_uring_setup_buf_ring(&m_ring, IOURING_BUFFER_COUNT, IOURING_BUFFER_GROUP_ID, 0, &error);
+    if (m_pBufferRing == nullptr)
+    {
+        std::cerr << "io_uring_setup_buf_ring failed: " << strerror(-error) << std::endl;
+        close();
+        return false;
+    }
+
+    int mask = io_uring_buf_ring_mask(IOURING_BUFFER_COUNT);
+    for (int i = 0; i < IOURING_BUFFER_COUNT; i++)
+    {
+        io_uring_buf_ring_add(m_pBufferRing, m_pBufferMemory + i * IOURING_BUFFER_SIZE, IOURING_BUFFER_SIZE, i, mask, i);
+    }
+    io_uring_buf_ring_advance(m_pBufferRing, IOURING_BUFFER_COUNT);
+
+    // 完成事件通过eventfd通知事件循环
+    m_eventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFD < 0 || io_uring_register_eventfd(&m_ring, m_eventFD) < 0)
+    {
+        std::cerr << "io_uring_register_eventfd failed" << std::endl;
+        close();
+        return false;
+    }
+
+    if (!armReceive())
+    {
+        close();
+        return false;
+    }
+
+    std::cout << "io_uring receive backend enabled" << std::endl;
+    return true;
+}
+
+void IoUringReceiver::close()
+{
+    if (m_isRingInitialized)
+    {
+        if (m_pBufferRing != nullptr)
+        {
+            io_uring_free_buf_ring(&m_ring, m_pBufferRing, IOURING_BUFFER_COUNT, IOURING_BUFFER_GROUP_ID);
+            m_pBufferRing = nullptr;
+        }
+
+        // 退出时内核会取消还没完成的recv
+        io_uring_queue_exit(&m_ring);
+        m_isRingInitialized = false;
+    }
+
+    if (m_eventFD >= 0)
+    {
+        ::close(m_eventFD);
+        m_eventFD = -1;
+    }
+
+    if (m_pBufferMemory != nullptr)
+    {
+        std::free(m_pBufferMemory);
+        m_pBufferMemory = nullptr;
+    }
+
+    m_socketFD = -1;
+}
+
+int IoUringReceiver::processCompletions(const receivedDataCallback &callback)
+{
+    // 清掉eventfd的计数，非阻塞的eventfd已经被清掉时返回EAGAIN，不是错误
+    uint64_t value = 0;
+    if (read(m_eventFD, &value, sizeof(value)) < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        std::cerr << "read io_uring eventfd error: " << strerror(errno) << std::endl;
+    }
+
+    int result = IOURING_RESULT_OK;
+    bool needRearm = false;
+    int mask = io_uring_buf_ring_mask(IOURING_BUFFER_COUNT);
+
+    unsigned head;
+    unsigned count = 0;
+    struct io_uring_cqe *cqe;
+    io_uring_for_each_cqe(&m_ring, head, cqe)
+    {
+        count++;
+
+        if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+        {
+            m_hasReceivedData = true;
+
+            int bufferID = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            uint8_t *buffer = m_pBufferMemory + bufferID * IOURING_BUFFER_SIZE;
+            callback(buffer, cqe->res);
+
+            // 用完立刻还给内核
+            io_uring_buf_ring_add(m_pBufferRing, buffer, IOURING_BUFFER_SIZE, bufferID, mask, 0);
+            io_uring_buf_ring_advance(m_pBufferRing, 1);
+        }
+        else if (cqe->res == 0)
+        {
+            std::cerr << "connection close, io_uring receive error" << std::endl;
+            result = IOURING_RESULT_CLOSED;
+        }
+        else if (cqe->res == -ENOBUFS)
+        {
+            // 缓冲区暂时用完了，回调里已经归还，重新提交即可
+            needRearm = true;
+        }
+        else if (cqe->res < 0)
+        {
+            std::cerr << "io_uring receive error: " << strerror(-cqe->res) << std::endl;
+            if (!m_hasReceivedData && (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP))
+            {
+                result = IOURING_RESULT_UNSUPPORTED;
+            }
+            else
+            {
+                result = IOURING_RESULT_CLOSED;
+            }
+        }
+
+        // 没有MORE标记说明这次multishot已经结束
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            needRearm = true;
+        }
+    }
+    io_uring_cq_advance(&m_ring, count);
+
+    if (result == IOURING_RESULT_OK && needRearm && !armReceive())
+    {
+        result = IOURING_RESULT_CLOSED;
+    }
+
+    return result;
+}
+
+bool IoUringReceiver::armReceive()
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+    if (sqe == nullptr)
+    {
+        std::cerr << "io_uring_get_sqe failed" << std::endl;
+        return false;
+    }
+
+    // 不指定缓冲区，由内核从buffer ring里选，一次提交持续产生完成事件
+    io_uring_prep_recv_multishot(sqe, m_socketFD, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IOURING_BUFFER_GROUP_ID;
+    io_uring_sqe_set_data64(sqe, IOURING_RECV_TAG);
+
+    int ret = io_uring_submit(&m_ring);
+    if (ret < 0)
+    {
+        std::cerr << "io_uring_submit failed: " << strerror(-ret) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+#else
+bool IoUringReceiver::init(int socketFD)
+{
+    (void)socketFD;
+    std::cerr << "io_uring is not available in this build, fallback to recv" << std::endl;
+    return false;
+}
+
+void IoUringReceiver::close()
+{
+}
+
+int IoUringReceiver::processCompletions(const receivedDataCallback &callback)
+{
+    (void)callback;
+    return IOURING_RESULT_UNSUPPORTED;
+}
+
+bool IoUringReceiver::armReceive()
+{
+    return false;
+}
+#endif
+
+bool IoUringReceiver::isActive() const
+{
+    return m_eventFD >= 0;
+}
+
+int IoUringReceiver::eventFD() const
+{
+    return m_eventFD;
+}
@@ -0,0 +1,66 @@
+#ifndef IOURINGRECEIVER_H
+#define IOURINGRECEIVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// 提供给内核的接收缓冲区个数和每个的大小
+#define IOURING_BUFFER_COUNT 64
+#define IOURING_BUFFER_SIZE (64 * 1024)
+#define IOURING_BUFFER_GROUP_ID 1
+#define IOURING_QUEUE_DEPTH 8
+
+// 处理完成队列的结果
+#define IOURING_RESULT_OK 0
+#define IOURING_RESULT_CLOSED -1
+// 内核不支持multishot recv或buffer ring，需要退回普通recv
+#define IOURING_RESULT_UNSUPPORTED -2
+
+using receivedDataCallback = std::function<void(const uint8_t *data, size_t length)>;
+
+// 基于io_uring的接收后端，只在Linux且编译时找到liburing才可用
+// 用multishot recv加上注册到内核的buffer ring，内核直接把数据写进预先分配好的缓冲区
+// 完成时通过eventfd通知事件循环，读数据本身不再需要系统调用
+class IoUringReceiver
+{
+public:
+    IoUringReceiver();
+    ~IoUringReceiver();
+
+    // 初始化失败返回false，调用方应该使用普通recv
+    bool init(int socketFD);
+    void close();
+
+    bool isActive() const;
+    // 注册到事件循环里的描述符，可读表示有完成事件
+    int eventFD() const;
+
+    // 取出所有完成事件，收到的数据交给回调，返回IOURING_RESULT_*
+    int processCompletions(const receivedDataCallback &callback);
+
+private:
+    bool armReceive();
+
+private:
+    int m_socketFD = -1;
+    int m_eventFD = -1;
+
+#ifdef HAVE_LIBURING
+    struct io_uring m_ring;
+    struct io_uring_buf_ring *m_pBufferRing = nullptr;
+#endif
+    bool m_isRingInitialized = false;
+
+    // 所有提供给内核的缓冲区是一整块连续内存
+    uint8_t *m_pBufferMemory = nullptr;
+
+    // 还没收到过数据，这时候出错多半是内核不支持
+    bool m_hasReceivedData = false;
+};
+
+#endif // IOURINGRECEIVER_H
@@ -0,0 +1,232 @@
+#include "jitterbuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// 第一个包的扩展序号从这里开始，序号回绕到比它小也不会变成负数
+#define RTP_SEQUENCE_BASE (static_cast<uint64_t>(1) << 32)
+
+JitterBuffer::JitterBuffer(int latencyMs)
+    : m_latencyMs(latencyMs),
+    m_slots(JITTER_BUFFER_CAPACITY)
+{
+}
+
+void JitterBuffer::setLatency(int latencyMs)
+{
+    m_latencyMs = latencyMs;
+}
+
+bool JitterBuffer::insert(uint16_t sequence, uint32_t timestamp, bool marker, const uint8_t *payload, size_t length, Clock::time_point now)
+{
+    if (length > RTP_MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+    m_stats.m_received++;
+
+    uint64_t extendedSequence = 0;
+    if (!m_hasFirstPacket)
+    {
+        m_hasFirstPacket = true;
+        extendedSequence = RTP_SEQUENCE_BASE + sequence;
+        m_nextSequence = extendedSequence;
+        m_highestSequence = extendedSequence;
+    }
+    else
+    {
+        extendedSequence = extendSequence(sequence);
+    }
+
+    // 已经播放过的序号，重复包或者重传来得太晚
+    if (extendedSequence < m_nextSequence)
+    {
+        m_stats.m_duplicated++;
+        return false;
+    }
+
+    // 超出缓冲区范围，前面还没到的包不再等待
+    if (extendedSequence >= m_nextSequence + JITTER_BUFFER_CAPACITY)
+    {
+        uint64_t newNextSequence = extendedSequence - JITTER_BUFFER_CAPACITY + 1;
+        for (uint64_t i = m_nextSequence; i < newNextSequence; i++)
+        {
+            Slot &slot = m_slots[i % JITTER_BUFFER_CAPACITY];
+            if (slot.m_isUsed && slot.m_sequence == i)
+            {
+                slot.m_isUsed = false;
+            }
+            m_stats.m_lost++;
+        }
+        m_nextSequence = newNextSequence;
+        m_isAfterLoss = true;
+        m_missing.erase(m_missing.begin(), m_missing.lower_bound(m_nextSequence));
+    }
+
+    Slot &slot = m_slots[extendedSequence % JITTER_BUFFER_CAPACITY];
+    if (slot.m_isUsed && slot.m_sequence == extendedSequence)
+    {
+        m_stats.m_duplicated++;
+        return false;
+    }
+
+    if (extendedSequence > m_highestSequence)
+    {
+        // 中间跳过的序号记为缺失，之后请求重传
+        for (uint64_t i = std::max(m_highestSequence + 1, m_nextSequence); i < extendedSequence; i++)
+        {
+            NackState state;
+            state.m_detectedTime = now;
+            m_missing[i] = state;
+        }
+        m_highestSequence = extendedSequence;
+    }
+    else if (extendedSequence < m_highestSequence)
+    {
+        // 等于最大序号的只有第一个包，它不算乱序
+        m_stats.m_reordered++;
+        auto iter = m_missing.find(extendedSequence);
+        if (iter != m_missing.end())
+        {
+            if (iter->second.m_retries > 0)
+            {
+                m_stats.m_recovered++;
+            }
+            m_missing.erase(iter);
+        }
+    }
+
+    slot.m_isUsed = true;
+    slot.m_sequence = extendedSequence;
+    slot.m_timestamp = timestamp;
+    slot.m_marker = marker;
+    slot.m_arrivalTime = now;
+    slot.m_length = length;
+    memcpy(slot.m_data, payload, length);
+
+    return true;
+}
+
+bool JitterBuffer::pop(RtpPacket &packet, bool &isAfterLoss, Clock::time_point now)
+{
+    if (!m_hasFirstPacket)
+    {
+        return false;
+    }
+
+    while (m_nextSequence <= m_highestSequence)
+    {
+        Slot &slot = m_slots[m_nextSequence % JITTER_BUFFER_CAPACITY];
+        if (slot.m_isUsed && slot.m_sequence == m_nextSequence)
+        {
+            packet.m_sequence = slot.m_sequence;
+            packet.m_timestamp = slot.m_timestamp;
+            packet.m_marker = slot.m_marker;
+            packet.m_payload = slot.m_data;
+            packet.m_length = slot.m_length;
+            slot.m_isUsed = false;
+            m_nextSequence++;
+
+            isAfterLoss = m_isAfterLoss;
+            m_isAfterLoss = false;
+            return true;
+        }
+
+        // 出现空洞，找到后面第一个已经到达的包
+        uint64_t arrivedSequence = m_nextSequence + 1;
+        while (arrivedSequence <= m_highestSequence)
+        {
+            Slot &arrivedSlot = m_slots[arrivedSequence % JITTER_BUFFER_CAPACITY];
+            if (arrivedSlot.m_isUsed && arrivedSlot.m_sequence == arrivedSequence)
+            {
+                break;
+            }
+            arrivedSequence++;
+        }
+
+        // 它等待的时间还没超过延迟目标，继续等缺失的包
+        if (arrivedSequence <= m_highestSequence)
+        {
+            Slot &arrivedSlot = m_slots[arrivedSequence % JITTER_BUFFER_CAPACITY];
+            if (now - arrivedSlot.m_arrivalTime < std::chrono::milliseconds(m_latencyMs))
+            {
+                return false;
+            }
+        }
+
+        // 超时了，跳过空洞
+        m_stats.m_lost += arrivedSequence - m_nextSequence;
+        m_nextSequence = arrivedSequence;
+        m_isAfterLoss = true;
+        m_missing.erase(m_missing.begin(), m_missing.lower_bound(m_nextSequence));
+    }
+
+    return false;
+}
+
+void JitterBuffer::collectNacks(std::vector<uint16_t> &sequences, Clock::time_point now)
+{
+    for (auto iter = m_missing.begin(); iter != m_missing.end();)
+    {
+        // 已经跳过的不用再请求
+        if (iter->first < m_nextSequence)
+        {
+            iter = m_missing.erase(iter);
+            continue;
+        }
+
+        NackState &state = iter->second;
+        bool isExpired = now - state.m_detectedTime >= std::chrono::milliseconds(m_latencyMs);
+        bool isRetryDue = false;
+        if (state.m_retries == 0)
+        {
+            isRetryDue = now - state.m_detectedTime >= std::chrono::milliseconds(NACK_REORDER_DELAY_MS);
+        }
+        else
+        {
+            isRetryDue = now - state.m_lastSentTime >= std::chrono::milliseconds(NACK_RETRY_INTERVAL_MS);
+        }
+        if (!isExpired && isRetryDue && state.m_retries < NACK_MAX_RETRIES)
+        {
+            sequences.push_back(static_cast<uint16_t>(iter->first & 0xFFFF));
+            state.m_lastSentTime = now;
+            state.m_retries++;
+            m_stats.m_nackSent++;
+        }
+        ++iter;
+    }
+}
+
+void JitterBuffer::reset()
+{
+    for (auto &slot : m_slots)
+    {
+        slot.m_isUsed = false;
+    }
+
+    m_hasFirstPacket = false;
+    m_nextSequence = 0;
+    m_highestSequence = 0;
+    m_isAfterLoss = false;
+    m_missing.clear();
+}
+
+const JitterBufferStats &JitterBuffer::stats() const
+{
+    return m_stats;
+}
+
+// 把16位的序号扩展成不会回绕的64位序号，取离当前最大序号最近的那个
+uint64_t JitterBuffer::extendSequence(uint16_t sequence) const
+{
+    uint64_t candidate = (m_highestSequence & ~static_cast<uint64_t>(0xFFFF)) | sequence;
+    if (candidate + 0x8000 < m_highestSequence)
+    {
+        candidate += 0x10000;
+    }
+    else if (candidate > m_highestSequence + 0x8000)
+    {
+        candidate -= 0x10000;
+    }
+    return candidate;
+}
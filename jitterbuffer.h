@@ -0,0 +1,101 @@
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 缓冲区最多能放多少个包，序号超过这个范围的包会导致前面缺的包直接判定为丢失
+#define JITTER_BUFFER_CAPACITY 1024
+// 单个RTP负载的最大长度
+#define RTP_MAX_PAYLOAD_SIZE 2048
+// 同一个缺失的包最多请求重传几次，以及两次请求之间的间隔
+#define NACK_MAX_RETRIES 3
+#define NACK_RETRY_INTERVAL_MS 20
+// 轻微乱序的包通常很快就会到，缺失超过这个时间才第一次请求重传
+#define NACK_REORDER_DELAY_MS 5
+
+// 按序取出的一个RTP包，负载指向缓冲区内部，下一次insert之前有效
+struct RtpPacket
+{
+    uint64_t m_sequence = 0;
+    uint32_t m_timestamp = 0;
+    bool m_marker = false;
+    const uint8_t *m_payload = nullptr;
+    size_t m_length = 0;
+};
+
+struct JitterBufferStats
+{
+    uint64_t m_received = 0;
+    uint64_t m_duplicated = 0;  // 重复或者已经过了播放时间才到的包
+    uint64_t m_reordered = 0;   // 乱序到达的包
+    uint64_t m_lost = 0;        // 等到超时仍然没到，最终跳过的包
+    uint64_t m_nackSent = 0;    // 请求重传的次数
+    uint64_t m_recovered = 0;   // 请求重传后到达的包
+};
+
+// 按序号排序的抖动缓冲区
+// 包按序到达时立即输出，出现空洞时最多等待设定的延迟，期间对缺失的包请求重传
+// 包存放在预先分配好的固定槽位里，稳定运行时不分配内存
+class JitterBuffer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit JitterBuffer(int latencyMs = 50);
+
+    void setLatency(int latencyMs);
+
+    // 插入一个包，重复、过期或过大的包返回false
+    bool insert(uint16_t sequence, uint32_t timestamp, bool marker, const uint8_t *payload, size_t length, Clock::time_point now);
+
+    // 按序取出下一个包，isAfterLoss表示它前面有包被判定为丢失
+    bool pop(RtpPacket &packet, bool &isAfterLoss, Clock::time_point now);
+
+    // 取出现在需要请求重传的序号
+    void collectNacks(std::vector<uint16_t> &sequences, Clock::time_point now);
+
+    void reset();
+
+    const JitterBufferStats &stats() const;
+
+private:
+    struct Slot
+    {
+        bool m_isUsed = false;
+        uint64_t m_sequence = 0;
+        uint32_t m_timestamp = 0;
+        bool m_marker = false;
+        Clock::time_point m_arrivalTime;
+        size_t m_length = 0;
+        uint8_t m_data[RTP_MAX_PAYLOAD_SIZE];
+    };
+
+    struct NackState
+    {
+        Clock::time_point m_detectedTime;
+        Clock::time_point m_lastSentTime;
+        int m_retries = 0;
+    };
+
+    uint64_t extendSequence(uint16_t sequence) const;
+
+private:
+    int m_latencyMs = 50;
+    std::vector<Slot> m_slots;
+
+    bool m_hasFirstPacket = false;
+    uint64_t m_nextSequence = 0;     // 下一个要输出的序号
+    uint64_t m_highestSequence = 0;  // 收到过的最大序号
+    bool m_isAfterLoss = false;
+
+    // 缺失的包，按扩展序号排序
+    std::map<uint64_t, NackState> m_missing;
+
+    JitterBufferStats m_stats;
+};
+
+#endif // JITTERBUFFER_H
@@ -5,12 +5,12 @@ MainWindow::MainWindow(QWidget *parent)
     m_pVideoClient(std::make_unique<VideoClient>())
 {
     this->setFixedSize(640, 480);
-    // 这里设置的地址必须是服务端可用的IP地址,这样才能访问到特定主机的服务端
-    // 通过ip addr show在服务端主机上查看其可用IP
-    NetConnectInfo netConnectInfo("192.168.18.3", 30000);
 
-    m_pVideoClient->startSocketConnection(netConnectInfo);
+    // 控件要在回调之前创建，连接建立后解码线程随时可能回调
+    m_pOpenGLWidget = new OpenGLWidget(this);
+    this->setCentralWidget(m_pOpenGLWidget);
 
+    // 回调在解码线程里执行，RendVideo只把帧交给控件，绘制在GUI线程
     auto updateVideoCallbackFunction = [this] (YUVFrameData *yuvFrameData) {
         if (yuvFrameData == nullptr) {
             return;
@@ -19,8 +19,15 @@ MainWindow::MainWindow(QWidget *parent)
     };
     m_pVideoClient->setupUpdateVideoCallback(updateVideoCallbackFunction);
 
-    m_pOpenGLWidget = new OpenGLWidget(this);
-    this->setCentralWidget(m_pOpenGLWidget);
+    // 解码器直接把帧解到控件的PBO里
+    m_pVideoClient->setFrameAllocator(m_pOpenGLWidget->frameAllocator());
+
+    // 这里设置的地址必须是服务端可用的IP地址,这样才能访问到特定主机的服务端
+    // 通过ip addr show在服务端主机上查看其可用IP
+    NetConnectInfo netConnectInfo("192.168.18.3", 30000);
+
+    // 回调和分配器都设置好之后再开始连接
+    m_pVideoClient->startSocketConnection(netConnectInfo);
 }
 
 MainWindow::~MainWindow()
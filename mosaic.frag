@@ -0,0 +1,23 @@
+#version 330 core
+
+// 三个分量的纹理数组，每个窗口一层
+uniform sampler2DArray uni_textureY;
+uniform sampler2DArray uni_textureU;
+uniform sampler2DArray uni_textureV;
+
+in vec3 out_uv;
+// 这个窗口的YUV转RGB矩阵和偏移，和fragment.frag的uni_colorMatrix、uni_colorOffset相同
+flat in mat3 out_colorMatrix;
+flat in vec3 out_colorOffset;
+out vec4 frag_color;
+
+void main(void)
+{
+    vec3 yuv;
+    yuv.x = texture(uni_textureY, out_uv).r;
+    yuv.y = texture(uni_textureU, out_uv).r;
+    yuv.z = texture(uni_textureV, out_uv).r;
+
+    vec3 rgb = out_colorMatrix * yuv + out_colorOffset;
+    frag_color = vec4(rgb, 1);
+}
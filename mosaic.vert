@@ -0,0 +1,28 @@
+#version 330 core
+
+// 所有窗口共用的单位正方形
+layout(location = 0) in vec2 attr_position;
+// 每个窗口一个实例：在控件里的位置(x, y, 宽, 高)，0到1，y向下
+layout(location = 1) in vec4 attr_tileRect;
+// 帧在层里占的比例，以及纹理数组的层
+layout(location = 2) in vec3 attr_tileTexture;
+// 这个窗口的YUV转RGB矩阵的三列，w分量依次是R、G、B的偏移
+layout(location = 3) in vec4 attr_colorColumn0;
+layout(location = 4) in vec4 attr_colorColumn1;
+layout(location = 5) in vec4 attr_colorColumn2;
+
+out vec3 out_uv;
+// 整个窗口的值都一样，不需要插值
+flat out mat3 out_colorMatrix;
+flat out vec3 out_colorOffset;
+
+void main(void)
+{
+    vec2 position = attr_tileRect.xy + attr_position * attr_tileRect.zw;
+    // 转换到裁剪坐标，y向上
+    gl_Position = vec4(position.x * 2.0 - 1.0, 1.0 - position.y * 2.0, 0.0, 1.0);
+    // 帧的第一行在层的最上面，和位置的方向一致
+    out_uv = vec3(attr_position * attr_tileTexture.xy, attr_tileTexture.z);
+    out_colorMatrix = mat3(attr_colorColumn0.xyz, attr_colorColumn1.xyz, attr_colorColumn2.xyz);
+    out_colorOffset = vec3(attr_colorColumn0.w, attr_colorColumn1.w, attr_colorColumn2.w);
+}
@@ -0,0 +1,471 @@
+#include "mosaicwidget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// 着色器里顶点属性的位置
+#define MOSAIC_ATTR_POSITION 0
+#define MOSAIC_ATTR_TILE_RECT 1
+#define MOSAIC_ATTR_TILE_TEXTURE 2
+#define MOSAIC_ATTR_COLOR_MATRIX 3 // 占3、4、5三个位置，每个是矩阵的一列
+
+MosaicWidget::MosaicWidget(QWidget *parent)
+    : QOpenGLWidget{parent}
+{
+    for (int i = 0; i < MOSAIC_MAX_TILES; i++)
+    {
+        m_tiles.push_back(std::make_unique<Tile>());
+    }
+
+    // 纹理数组和实例化绘制需要3.3的核心模式
+    QSurfaceFormat surfaceFormat = format();
+    surfaceFormat.setVersion(3, 3);
+    surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+    setFormat(surfaceFormat);
+
+    YUVTextureFormat::fromPixelFormat(AV_PIX_FMT_YUV420P, m_textureFormat);
+}
+
+MosaicWidget::~MosaicWidget()
+{
+    makeCurrent();
+
+    for (auto &tile : m_tiles)
+    {
+        tile->m_frameBuffer.reset();
+    }
+
+    glDeleteTextures(3, m_textures);
+    glDeleteBuffers(1, &m_quadBuffer);
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteVertexArrays(1, &m_vertexArray);
+
+    doneCurrent();
+}
+
+void MosaicWidget::setTileCount(int tileCount)
+{
+    m_tileCount = std::max(0, std::min(tileCount, MOSAIC_MAX_TILES));
+    m_isInstancesDirty = true;
+    update();
+}
+
+void MosaicWidget::setMosaicLayout(int layout, int focusedTile)
+{
+    m_layout = layout;
+    m_focusedTile = focusedTile;
+    m_isInstancesDirty = true;
+    update();
+}
+
+void MosaicWidget::RendVideo(int tileIndex, YUVFrameData *yuvFrame)
+{
+    if (yuvFrame == nullptr || tileIndex < 0 || tileIndex >= MOSAIC_MAX_TILES)
+    {
+        return;
+    }
+
+    // 和OpenGLWidget一样只把帧放进这个窗口的三缓冲，不会等待GUI线程
+    Tile &tile = *m_tiles[tileIndex];
+    tile.m_frameBuffer.backBuffer() = std::move(*yuvFrame);
+    if (tile.m_frameBuffer.publish())
+    {
+        m_framesSuperseded++;
+    }
+    m_framesReceived++;
+    tile.m_frameBuffer.backBuffer() = YUVFrameData();
+
+    // 所有窗口共用一个重绘请求，多路流的帧只触发一次绘制
+    if (!m_isUpdatePending.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, [this]()
+                                  {
+            this->m_isUpdatePending.store(false);
+            this->update(); }, Qt::QueuedConnection);
+    }
+}
+
+MosaicStats MosaicWidget::renderStats() const
+{
+    MosaicStats stats;
+    stats.m_framesReceived = m_framesReceived.load(std::memory_order_relaxed);
+    stats.m_framesSuperseded = m_framesSuperseded.load(std::memory_order_relaxed);
+    stats.m_tileUploads = m_tileUploads.load(std::memory_order_relaxed);
+    stats.m_tilesUnchanged = m_tilesUnchanged.load(std::memory_order_relaxed);
+    stats.m_textureReallocations = m_textureReallocations.load(std::memory_order_relaxed);
+    stats.m_paintCount = m_paintCount.load(std::memory_order_relaxed);
+    stats.m_drawCalls = m_drawCalls.load(std::memory_order_relaxed);
+    stats.m_lastPaintUs = m_lastPaintUs.load(std::memory_order_relaxed);
+    stats.m_averagePaintUs = m_averagePaintUs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MosaicWidget::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    QOpenGLContext *glContext = context();
+    QSurfaceFormat surfaceFormat = glContext->format();
+    if (surfaceFormat.version() < qMakePair(3, 3))
+    {
+        qDebug() << "Mosaic needs OpenGL 3.3, got" << surfaceFormat.majorVersion() << surfaceFormat.minorVersion();
+        return;
+    }
+    m_hasTextureStorage = surfaceFormat.version() >= qMakePair(4, 2) || glContext->hasExtension("GL_ARB_texture_storage");
+
+    if (!initializeShaders())
+    {
+        return;
+    }
+    initializeBuffers();
+    m_isGLReady = true;
+}
+
+bool MosaicWidget::initializeShaders()
+{
+    m_pShaderProgram = new QOpenGLShaderProgram(this);
+    if (!m_pShaderProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/shaders/mosaic.vert"))
+    {
+        qDebug() << "VS Compile ERROR:" << m_pShaderProgram->log();
+        return false;
+    }
+
+    if (!m_pShaderProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/shaders/mosaic.frag"))
+    {
+        qDebug() << "FS Compile ERROR:" << m_pShaderProgram->log();
+        return false;
+    }
+
+    m_pShaderProgram->bindAttributeLocation("attr_position", MOSAIC_ATTR_POSITION);
+    m_pShaderProgram->bindAttributeLocation("attr_tileRect", MOSAIC_ATTR_TILE_RECT);
+    m_pShaderProgram->bindAttributeLocation("attr_tileTexture", MOSAIC_ATTR_TILE_TEXTURE);
+    m_pShaderProgram->bindAttributeLocation("attr_colorColumn0", MOSAIC_ATTR_COLOR_MATRIX);
+    m_pShaderProgram->bindAttributeLocation("attr_colorColumn1", MOSAIC_ATTR_COLOR_MATRIX + 1);
+    m_pShaderProgram->bindAttributeLocation("attr_colorColumn2", MOSAIC_ATTR_COLOR_MATRIX + 2);
+    if (!m_pShaderProgram->link())
+    {
+        qDebug() << "LINK ERROR:" << m_pShaderProgram->log();
+        return false;
+    }
+
+    // 采样器固定使用纹理单元0、1、2，只需要设置一次
+    m_pShaderProgram->bind();
+    m_pShaderProgram->setUniformValue(m_pShaderProgram->uniformLocation("uni_textureY"), 0);
+    m_pShaderProgram->setUniformValue(m_pShaderProgram->uniformLocation("uni_textureU"), 1);
+    m_pShaderProgram->setUniformValue(m_pShaderProgram->uniformLocation("uni_textureV"), 2);
+    m_pShaderProgram->release();
+    return true;
+}
+
+void MosaicWidget::initializeBuffers()
+{
+    // 单位正方形，所有窗口共用，按三角形带的顺序排列
+    static const float quadVertices[] = {
+        0, 0,
+        0, 1,
+        1, 0,
+        1, 1};
+
+    glGenVertexArrays(1, &m_vertexArray);
+    glBindVertexArray(m_vertexArray);
+
+    glGenBuffers(1, &m_quadBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(MOSAIC_ATTR_POSITION);
+    glVertexAttribPointer(MOSAIC_ATTR_POSITION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+    // 实例数据只在布局或者帧的大小变化时更新
+    glGenBuffers(1, &m_instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(TileInstance) * MOSAIC_MAX_TILES, nullptr, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(MOSAIC_ATTR_TILE_RECT);
+    glVertexAttribPointer(MOSAIC_ATTR_TILE_RECT, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_x)));
+    glVertexAttribDivisor(MOSAIC_ATTR_TILE_RECT, 1);
+    glEnableVertexAttribArray(MOSAIC_ATTR_TILE_TEXTURE);
+    glVertexAttribPointer(MOSAIC_ATTR_TILE_TEXTURE, 3, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_uScale)));
+    glVertexAttribDivisor(MOSAIC_ATTR_TILE_TEXTURE, 1);
+    for (int i = 0; i < 3; i++)
+    {
+        glEnableVertexAttribArray(MOSAIC_ATTR_COLOR_MATRIX + i);
+        glVertexAttribPointer(MOSAIC_ATTR_COLOR_MATRIX + i, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_colorColumns) + sizeof(float) * 4 * i));
+        glVertexAttribDivisor(MOSAIC_ATTR_COLOR_MATRIX + i, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MosaicWidget::allocateTextures(int layerWidth, int layerHeight, int layerCount)
+{
+    glDeleteTextures(3, m_textures);
+    glGenTextures(3, m_textures);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // 色度分量按yuv420p取一半，向上取整
+        int width = i == 0 ? layerWidth : (layerWidth + 1) / 2;
+        int height = i == 0 ? layerHeight : (layerHeight + 1) / 2;
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        if (m_hasTextureStorage)
+        {
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8, width, height, layerCount);
+        }
+        else
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, width, height, layerCount, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    m_layerWidth = layerWidth;
+    m_layerHeight = layerHeight;
+    m_layerCount = layerCount;
+    m_textureReallocations++;
+
+    // 新的纹理里没有数据，所有窗口重新上传
+    for (auto &tile : m_tiles)
+    {
+        tile->m_uploadedGeneration = 0;
+    }
+}
+
+// 找出行宽和起始地址都满足的最大对齐
+static GLint unpackAlignment(const YUVChannel &channel)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(channel.m_pData);
+    for (GLint alignment = 8; alignment > 1; alignment /= 2)
+    {
+        if (channel.m_linesize % alignment == 0 && address % alignment == 0)
+        {
+            return alignment;
+        }
+    }
+    return 1;
+}
+
+// 三个分量分别更新到纹理数组的第layer层的左上角
+void MosaicWidget::uploadTile(int layer, const YUVFrameData &frame)
+{
+    const YUVChannel *channels[3] = {&frame.m_luma, &frame.m_chromaB, &frame.m_chromaR};
+    for (int i = 0; i < 3; i++)
+    {
+        const YUVChannel &channel = *channels[i];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment(channel));
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, channel.m_linesize);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, channel.m_width, channel.m_height, 1, GL_RED, GL_UNSIGNED_BYTE, channel.m_pData);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool MosaicWidget::updateColorMatrix(Tile &tile, const YUVFrameData &frame)
+{
+    if (frame.m_colorSpace == tile.m_colorSpace && frame.m_colorRange == tile.m_colorRange)
+    {
+        return false;
+    }
+
+    // 和OpenGLWidget一样由YUVTextureFormat计算，同一路流在两种控件里颜色一致
+    YUVTextureFormat::colorMatrix(frame.m_colorSpace, frame.m_colorRange, frame.m_height, m_textureFormat, tile.m_colorMatrix, tile.m_colorOffset);
+    tile.m_colorSpace = frame.m_colorSpace;
+    tile.m_colorRange = frame.m_colorRange;
+    return true;
+}
+
+// 所有窗口共用一组纹理数组，只能是同一种格式，其他格式的流要用OpenGLWidget显示
+bool MosaicWidget::isTileFrame(const YUVFrameData &frame)
+{
+    return frame.m_frame.isValid() && frame.m_format == AV_PIX_FMT_YUV420P && frame.m_width > 0 && frame.m_height > 0;
+}
+
+void MosaicWidget::tileRect(int index, float rect[4]) const
+{
+    if (m_layout == MOSAIC_LAYOUT_FOCUS && m_tileCount > 1)
+    {
+        // 分成cells x cells的格子，放大的窗口占左上角(cells-1) x (cells-1)个格子
+        // 右边一列和下边一行一共2 * cells - 1个格子放其余的窗口
+        int focusedTile = m_focusedTile >= 0 && m_focusedTile < m_tileCount ? m_focusedTile : 0;
+        int cells = std::max(2, (m_tileCount + 1) / 2);
+        float cellSize = 1.0f / cells;
+        if (index == focusedTile)
+        {
+            rect[0] = 0;
+            rect[1] = 0;
+            rect[2] = cellSize * (cells - 1);
+            rect[3] = cellSize * (cells - 1);
+            return;
+        }
+
+        int slot = index < focusedTile ? index : index - 1;
+        int column = slot < cells ? cells - 1 : slot - cells;
+        int row = slot < cells ? slot : cells - 1;
+        rect[0] = cellSize * column;
+        rect[1] = cellSize * row;
+        rect[2] = cellSize;
+        rect[3] = cellSize;
+        return;
+    }
+
+    // 网格的列数取窗口个数的平方根向上取整
+    int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(m_tileCount)))));
+    int rows = std::max(1, (m_tileCount + columns - 1) / columns);
+    rect[0] = static_cast<float>(index % columns) / columns;
+    rect[1] = static_cast<float>(index / columns) / rows;
+    rect[2] = 1.0f / columns;
+    rect[3] = 1.0f / rows;
+}
+
+// 只为已经有帧的窗口生成实例，还没有帧的窗口保持黑色
+void MosaicWidget::updateInstances()
+{
+    TileInstance instances[MOSAIC_MAX_TILES];
+    int instanceCount = 0;
+    for (int i = 0; i < m_tileCount; i++)
+    {
+        const Tile &tile = *m_tiles[i];
+        if (tile.m_width == 0 || tile.m_height == 0)
+        {
+            continue;
+        }
+
+        float rect[4];
+        tileRect(i, rect);
+        TileInstance &instance = instances[instanceCount++];
+        instance.m_x = rect[0];
+        instance.m_y = rect[1];
+        instance.m_width = rect[2];
+        instance.m_height = rect[3];
+        instance.m_uScale = static_cast<float>(tile.m_width) / m_layerWidth;
+        instance.m_vScale = static_cast<float>(tile.m_height) / m_layerHeight;
+        instance.m_layer = static_cast<float>(i);
+        for (int column = 0; column < 3; column++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                instance.m_colorColumns[column][row] = tile.m_colorMatrix[column * 3 + row];
+            }
+            instance.m_colorColumns[column][3] = tile.m_colorOffset[column];
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TileInstance) * instanceCount, instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_instanceCount = instanceCount;
+    m_isInstancesDirty = false;
+}
+
+void MosaicWidget::paintGL()
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!m_isGLReady)
+    {
+        return;
+    }
+
+    // 取每个窗口最新的一帧，找出需要的层大小
+    int layerWidth = m_layerWidth;
+    int layerHeight = m_layerHeight;
+    for (int i = 0; i < m_tileCount; i++)
+    {
+        Tile &tile = *m_tiles[i];
+        if (tile.m_frameBuffer.update())
+        {
+            tile.m_frameGeneration++;
+        }
+
+        const YUVFrameData &frame = tile.m_frameBuffer.frontBuffer();
+        if (isTileFrame(frame))
+        {
+            layerWidth = std::max(layerWidth, frame.m_width);
+            layerHeight = std::max(layerHeight, frame.m_height);
+        }
+    }
+
+    // 层只会变大，帧变小时继续用原来的层，避免来回重新分配
+    // 还没有任何窗口收到帧时不知道层的大小，0大小的纹理会报GL_INVALID_VALUE，等第一帧到了再分配
+    bool hasLayerSize = layerWidth > 0 && layerHeight > 0;
+    if (hasLayerSize && (layerWidth != m_layerWidth || layerHeight != m_layerHeight || m_tileCount > m_layerCount))
+    {
+        allocateTextures(layerWidth, layerHeight, std::max(m_tileCount, m_layerCount));
+        m_isInstancesDirty = true;
+    }
+
+    // 只上传有新帧的窗口
+    for (int i = 0; i < m_tileCount; i++)
+    {
+        Tile &tile = *m_tiles[i];
+        const YUVFrameData &frame = tile.m_frameBuffer.frontBuffer();
+        if (!isTileFrame(frame) || tile.m_frameGeneration == tile.m_uploadedGeneration)
+        {
+            m_tilesUnchanged++;
+            continue;
+        }
+
+        uploadTile(i, frame);
+        tile.m_uploadedGeneration = tile.m_frameGeneration;
+        m_tileUploads++;
+        if (frame.m_width != tile.m_width || frame.m_height != tile.m_height)
+        {
+            tile.m_width = frame.m_width;
+            tile.m_height = frame.m_height;
+            m_isInstancesDirty = true;
+        }
+        if (updateColorMatrix(tile, frame))
+        {
+            m_isInstancesDirty = true;
+        }
+    }
+
+    if (m_isInstancesDirty)
+    {
+        updateInstances();
+    }
+
+    if (m_instanceCount > 0)
+    {
+        m_pShaderProgram->bind();
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+        }
+
+        // 所有窗口一次画完
+        glBindVertexArray(m_vertexArray);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_instanceCount);
+        glBindVertexArray(0);
+        m_drawCalls++;
+
+        m_pShaderProgram->release();
+    }
+
+    // 只统计CPU上提交命令的时间，GPU执行是异步的
+    int64_t paintUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    int64_t averagePaintUs = m_averagePaintUs.load(std::memory_order_relaxed);
+    averagePaintUs = averagePaintUs == 0 ? paintUs : averagePaintUs + (paintUs - averagePaintUs) / 8;
+    m_averagePaintUs.store(averagePaintUs, std::memory_order_relaxed);
+    m_lastPaintUs.store(paintUs, std::memory_order_relaxed);
+    m_paintCount++;
+}
+
+void MosaicWidget::resizeGL(int w, int h)
+{
+    // 窗口的位置是相对控件的比例，大小变化时不需要重新生成实例
+    glViewport(0, 0, w, h);
+}
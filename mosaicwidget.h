@@ -0,0 +1,140 @@
+#ifndef MOSAICWIDGET_H
+#define MOSAICWIDGET_H
+
+#include <QOpenGLWidget>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLExtraFunctions>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "type.h"
+#include "triplebuffer.h"
+#include "yuvtextureformat.h"
+
+// 画面墙最多显示的流，也是纹理数组的最大层数
+#define MOSAIC_MAX_TILES 64
+
+#define MOSAIC_LAYOUT_GRID 0  // 所有窗口一样大，排成网格
+#define MOSAIC_LAYOUT_FOCUS 1 // 放大的窗口在左上角，其余的小窗口排在右边一列和下边一行
+
+struct MosaicStats
+{
+    uint64_t m_framesReceived = 0;       // RendVideo收到的帧
+    uint64_t m_framesSuperseded = 0;     // 还没显示就被更新的帧替换掉的帧
+    uint64_t m_tileUploads = 0;          // 上传到纹理数组的窗口帧
+    uint64_t m_tilesUnchanged = 0;       // 绘制时没有新的帧，跳过上传的窗口
+    uint64_t m_textureReallocations = 0; // 窗口个数或者帧的大小变化时重新分配纹理数组的次数
+    uint64_t m_paintCount = 0;
+    uint64_t m_drawCalls = 0;
+    int64_t m_lastPaintUs = 0;    // 最近一次paintGL在CPU上的耗时
+    int64_t m_averagePaintUs = 0; // 指数平均，新的样本占1/8
+};
+
+// 多路流的画面墙，所有窗口的Y、U、V分别放在三个纹理数组里，每路流占一层
+// 每次绘制只上传有新帧的窗口，所有窗口用一次实例化绘制画出来
+// 纹理数组每层的大小是显示过的最大的帧，小一些的帧只占用层的左上角，用每个窗口自己的纹理坐标缩放
+// 放大的窗口是完整分辨率时所有层都按它分配，64路1080p大约需要200MB显存，小窗口都用H264Decoder的tile模式时只有几MB
+// 需要OpenGL 3.3，和MultiStreamClient::setTileLayout配合使用，只显示8位的yuv420p
+class MosaicWidget : public QOpenGLWidget, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+public:
+    MosaicWidget(QWidget *parent = nullptr);
+    ~MosaicWidget();
+
+    // 以下两个在GUI线程调用
+    // 窗口的个数，超过MOSAIC_MAX_TILES时按MOSAIC_MAX_TILES
+    void setTileCount(int tileCount);
+    // layout是MOSAIC_LAYOUT_*，focusedTile只在MOSAIC_LAYOUT_FOCUS时使用
+    void setMosaicLayout(int layout, int focusedTile = 0);
+
+    // 把一路流的帧交给第tileIndex个窗口，帧会被移走留到绘制时使用
+    // 在这路流的解码线程里调用，同一个窗口同一时间只能有一个线程调用，不同的窗口可以同时调用
+    void RendVideo(int tileIndex, YUVFrameData *frame);
+
+    // 可以在其他线程读取
+    MosaicStats renderStats() const;
+
+private:
+    struct Tile
+    {
+        // 解码线程和GUI线程之间传递帧，GUI线程总是显示最新的一帧
+        TripleBuffer<YUVFrameData> m_frameBuffer;
+        // 以下只在GUI线程访问
+        uint64_t m_frameGeneration = 0;
+        uint64_t m_uploadedGeneration = 0;
+        // 层里现在的帧的宽高，用来计算纹理坐标的缩放
+        int m_width = 0;
+        int m_height = 0;
+        // 每路流的色彩空间和范围可能不同，按帧上标的值算好转换矩阵，-1表示还没有算过
+        int m_colorSpace = -1;
+        int m_colorRange = -1;
+        float m_colorMatrix[9] = {0};
+        float m_colorOffset[3] = {0};
+    };
+
+    // 每个窗口一个实例，顶点着色器按它把单位正方形放到窗口的位置
+    struct TileInstance
+    {
+        float m_x, m_y, m_width, m_height; // 在控件里的位置，0到1，y向下
+        float m_uScale, m_vScale;          // 帧在层里占的比例
+        float m_layer;
+        // YUV转RGB矩阵的三列，w分量依次是R、G、B的偏移，和OpenGLWidget用的是同一个矩阵
+        float m_colorColumns[3][4];
+    };
+
+    bool initializeShaders();
+    void initializeBuffers();
+    // 窗口个数或者最大的帧变化时重新创建纹理数组，之后所有窗口都要重新上传
+    void allocateTextures(int layerWidth, int layerHeight, int layerCount);
+    void uploadTile(int layer, const YUVFrameData &frame);
+    // 帧的色彩空间或范围变了时重新计算这个窗口的转换矩阵，返回是否变化
+    bool updateColorMatrix(Tile &tile, const YUVFrameData &frame);
+    void updateInstances();
+    static bool isTileFrame(const YUVFrameData &frame);
+    // 窗口在控件里的位置，0到1
+    void tileRect(int index, float rect[4]) const;
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+    void resizeGL(int w, int h) override;
+
+private:
+    // 一次创建MOSAIC_MAX_TILES个，解码线程访问时不会被重新分配
+    std::vector<std::unique_ptr<Tile>> m_tiles;
+    int m_tileCount = 0;
+    int m_layout = MOSAIC_LAYOUT_GRID;
+    int m_focusedTile = 0;
+    // 布局、窗口个数或者某个窗口的帧大小变了，需要重新生成实例数据
+    bool m_isInstancesDirty = true;
+    int m_instanceCount = 0;
+
+    QOpenGLShaderProgram *m_pShaderProgram = nullptr;
+    // 只显示yuv420p，纹理格式是固定的
+    YUVTextureFormat m_textureFormat;
+    bool m_isGLReady = false;
+    bool m_hasTextureStorage = false;
+    GLuint m_textures[3] = {0, 0, 0};
+    int m_layerWidth = 0;
+    int m_layerHeight = 0;
+    int m_layerCount = 0;
+    GLuint m_vertexArray = 0;
+    GLuint m_quadBuffer = 0;
+    GLuint m_instanceBuffer = 0;
+
+    std::atomic_bool m_isUpdatePending{false};
+    std::atomic<uint64_t> m_framesReceived{0};
+    std::atomic<uint64_t> m_framesSuperseded{0};
+    std::atomic<uint64_t> m_tileUploads{0};
+    std::atomic<uint64_t> m_tilesUnchanged{0};
+    std::atomic<uint64_t> m_textureReallocations{0};
+    std::atomic<uint64_t> m_paintCount{0};
+    std::atomic<uint64_t> m_drawCalls{0};
+    std::atomic<int64_t> m_lastPaintUs{0};
+    std::atomic<int64_t> m_averagePaintUs{0};
+};
+
+#endif // MOSAICWIDGET_H
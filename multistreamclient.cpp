@@ -0,0 +1,119 @@
+#include "multistreamclient.h"
+
+MultiStreamClient::MultiStreamClient(size_t decodeThreadCount)
+    : m_decodePool(decodeThreadCount)
+{
+    m_ioThread = std::thread([this]()
+                             { this->m_eventLoop.run(); });
+}
+
+MultiStreamClient::~MultiStreamClient()
+{
+    // 先停掉所有流，再退出事件循环
+    stopAllStreams();
+
+    m_eventLoop.quit();
+    if (m_ioThread.joinable())
+    {
+        m_ioThread.join();
+    }
+}
+
+int MultiStreamClient::addStream(const NetConnectInfo &netConnectInfo, updateVideoCallback &&callback)
+{
+    auto client = std::make_unique<VideoClient>(&m_eventLoop, &m_decodePool);
+    // 回调要在开始连接前设置，连接后随时可能有数据
+    client->setupUpdateVideoCallback(std::move(callback));
+    {
+        // 新的流不会是放大的那一路
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        client->setTileMode(m_isTileLayout);
+    }
+    client->startSocketConnection(netConnectInfo);
+
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    int streamID = m_nextStreamID++;
+    m_streams[streamID] = std::move(client);
+    return streamID;
+}
+
+void MultiStreamClient::removeStream(int streamID)
+{
+    std::unique_ptr<VideoClient> client;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        auto iter = m_streams.find(streamID);
+        if (iter == m_streams.end())
+        {
+            return;
+        }
+        client = std::move(iter->second);
+        m_streams.erase(iter);
+    }
+
+    // 在锁外停止，停止时要等事件循环和解码线程
+    client->stopSocketConnection();
+}
+
+void MultiStreamClient::stopAllStreams()
+{
+    std::map<int, std::unique_ptr<VideoClient>> streams;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        streams.swap(m_streams);
+    }
+
+    for (auto &item : streams)
+    {
+        item.second->stopSocketConnection();
+    }
+}
+
+void MultiStreamClient::setTileLayout(bool isTileLayout, int focusedStreamID)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_isTileLayout = isTileLayout;
+    for (auto &item : m_streams)
+    {
+        item.second->setTileMode(isTileLayout && item.first != focusedStreamID);
+    }
+}
+
+size_t MultiStreamClient::streamCount()
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    return m_streams.size();
+}
+
+ClientStats MultiStreamClient::streamStats(int streamID)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    auto iter = m_streams.find(streamID);
+    if (iter == m_streams.end())
+    {
+        return ClientStats();
+    }
+    return iter->second->clientStats();
+}
+
+DecoderLoadStats MultiStreamClient::streamDecoderStats(int streamID)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    auto iter = m_streams.find(streamID);
+    if (iter == m_streams.end())
+    {
+        return DecoderLoadStats();
+    }
+    return iter->second->decoderLoadStats();
+}
+
+FramePoolStats MultiStreamClient::streamFramePoolStats(int streamID)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    auto iter = m_streams.find(streamID);
+    if (iter == m_streams.end())
+    {
+        return FramePoolStats();
+    }
+    return iter->second->framePoolStats();
+}
@@ -0,0 +1,50 @@
+#ifndef MULTISTREAMCLIENT_H
+#define MULTISTREAMCLIENT_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "type.h"
+#include "eventloop.h"
+#include "decodeworkerpool.h"
+#include "videoclient.h"
+
+// 多路视频流客户端
+// 所有连接共用一个事件循环线程收数据，解码分摊到固定大小的线程池里
+// 线程数不再随流的数量线性增长
+class MultiStreamClient
+{
+public:
+    // decodeThreadCount为0时使用CPU核数
+    explicit MultiStreamClient(size_t decodeThreadCount = 0);
+    ~MultiStreamClient();
+
+    // 添加一路流并开始连接，回调在解码线程里执行，返回流ID
+    int addStream(const NetConnectInfo &netConnectInfo, updateVideoCallback &&callback);
+    void removeStream(int streamID);
+    void stopAllStreams();
+
+    // 画面墙布局，isTileLayout为true时除了focusedStreamID以外的流都只解关键帧并缩小输出
+    // focusedStreamID为0表示没有放大的流，之后添加的流也按当前的布局解码
+    void setTileLayout(bool isTileLayout, int focusedStreamID = 0);
+
+    size_t streamCount();
+    ClientStats streamStats(int streamID);
+    // 每一路的解码CPU时间和帧池内存，用来衡量每个小窗口的开销
+    DecoderLoadStats streamDecoderStats(int streamID);
+    FramePoolStats streamFramePoolStats(int streamID);
+
+private:
+    EventLoop m_eventLoop;
+    std::thread m_ioThread;
+    DecodeWorkerPool m_decodePool;
+
+    std::mutex m_streamMutex;
+    std::map<int, std::unique_ptr<VideoClient>> m_streams;
+    int m_nextStreamID = 1;
+    bool m_isTileLayout = false;
+};
+
+#endif // MULTISTREAMCLIENT_H
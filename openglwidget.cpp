@@ -1,19 +1,44 @@
 #include "openglwidget.h"
 
+#include <chrono>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+// 着色器里顶点属性的位置
+#define VIDEO_ATTR_POSITION 0
+#define VIDEO_ATTR_UV 1
+
 OpenGLWidget::OpenGLWidget(QWidget *parent)
     : QOpenGLWidget{parent}
 {
+    // 顶点数据放在VBO里，用3.3的核心模式，不再使用固定管线和客户端顶点数组
+    QSurfaceFormat surfaceFormat = format();
+    surfaceFormat.setVersion(3, 3);
+    surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+    setFormat(surfaceFormat);
 }
 
 OpenGLWidget::~OpenGLWidget()
 {
-    if (m_pBufYuv420p != nullptr)
+    makeCurrent();
+
+    // 先释放还引用着PBO的帧，槽位全部回收后才能取消映射
+    for (auto &pendingUpload : m_pendingUploads)
     {
-        free(m_pBufYuv420p);
-        m_pBufYuv420p = nullptr;
+        glDeleteSync(pendingUpload.m_fence);
     }
+    m_pendingUploads.clear();
+    m_frameBuffer.reset();
+    m_frameAllocator.destroy(this);
 
     glDeleteTextures(3, m_textures);
+    glDeleteBuffers(1, &m_vertexBuffer);
+    glDeleteVertexArrays(1, &m_vertexArray);
+
+    doneCurrent();
 }
 
 void OpenGLWidget::RendVideo(YUVFrameData *yuvFrame)
@@ -24,137 +49,334 @@ void OpenGLWidget::RendVideo(YUVFrameData *yuvFrame)
         return;
     }
 
-    // 传入数据宽度与当前宽高不匹配则释放缓冲区并在后续重新分配缓冲区
-    if (m_videoHeight != (int)yuvFrame->m_height || m_videoWidth != (int)yuvFrame->m_width)
+    // 在解码线程里调用，只把帧放进三缓冲，不会等待GUI线程
+    // 直接持有解码器的帧，按原始行宽上传，不再拷贝
+    m_frameBuffer.backBuffer() = std::move(*yuvFrame);
+    if (m_frameBuffer.publish())
+    {
+        // 上一帧还没来得及显示就被这一帧替换了
+        m_framesSuperseded++;
+    }
+    m_framesReceived++;
+    // 换回来的是已经显示过或者被替换掉的旧帧，马上释放，缓冲区尽早回到解码器
+    m_frameBuffer.backBuffer() = YUVFrameData();
+
+    // 排队到GUI线程重绘，还有没执行的请求时不再重复排队，多帧只触发一次绘制
+    if (!m_isUpdatePending.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, [this]()
+                                  {
+            this->m_isUpdatePending.store(false);
+            this->update(); }, Qt::QueuedConnection);
+    }
+}
+
+FrameAllocator *OpenGLWidget::frameAllocator()
+{
+    return &m_frameAllocator;
+}
+
+RenderStats OpenGLWidget::renderStats() const
+{
+    RenderStats stats;
+    stats.m_uploadCount = m_uploadCount.load(std::memory_order_relaxed);
+    stats.m_uploadsAvoided = m_uploadsAvoided.load(std::memory_order_relaxed);
+    stats.m_framesReceived = m_framesReceived.load(std::memory_order_relaxed);
+    stats.m_framesSuperseded = m_framesSuperseded.load(std::memory_order_relaxed);
+    stats.m_unsupportedFrames = m_unsupportedFrames.load(std::memory_order_relaxed);
+    stats.m_paintCount = m_paintCount.load(std::memory_order_relaxed);
+    stats.m_drawCalls = m_drawCalls.load(std::memory_order_relaxed);
+    stats.m_lastPaintUs = m_lastPaintUs.load(std::memory_order_relaxed);
+    stats.m_averagePaintUs = m_averagePaintUs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+PboAllocatorStats OpenGLWidget::frameAllocatorStats() const
+{
+    return m_frameAllocator.stats();
+}
+
+// 找出行宽和起始地址都满足的最大对齐，行宽本身是对齐的倍数时GL算出的行间距正好等于linesize
+static GLint unpackAlignment(const YUVChannel &channel)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(channel.m_pData);
+    for (GLint alignment = 8; alignment > 1; alignment /= 2)
+    {
+        if (channel.m_linesize % alignment == 0 && address % alignment == 0)
+        {
+            return alignment;
+        }
+    }
+    return 1;
+}
+
+bool OpenGLWidget::allocateTextures(const YUVFrameData &frame)
+{
+    YUVTextureFormat textureFormat;
+    if (!YUVTextureFormat::fromPixelFormat(frame.m_format, textureFormat))
+    {
+        // 同一种格式只提示一次
+        if (frame.m_format != m_rejectedPixelFormat)
+        {
+            const char *formatName = av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame.m_format));
+            qDebug() << "Unsupported pixel format:" << (formatName != nullptr ? formatName : "unknown");
+        }
+        m_rejectedWidth = frame.m_width;
+        m_rejectedHeight = frame.m_height;
+        m_rejectedPixelFormat = frame.m_format;
+        return false;
+    }
+
+    // 不可变的纹理存储不能改变大小，重新创建纹理
+    glDeleteTextures(3, m_textures);
+    glGenTextures(3, m_textures);
+
+    const YUVChannel *channels[3] = {&frame.m_luma, &frame.m_chromaB, &frame.m_chromaR};
+    for (int i = 0; i < textureFormat.m_planeCount; i++)
     {
-        if (m_pBufYuv420p != nullptr)
+        const YUVPlaneFormat &planeFormat = textureFormat.m_planes[i];
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        // 纹理参数只在创建时设置一次
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // 单通道数据存储在红色通道，由着色器取.r，双通道的UV在.rg
+        if (m_hasTextureStorage)
         {
-            free(m_pBufYuv420p);
-            m_pBufYuv420p = nullptr;
+            glTexStorage2D(GL_TEXTURE_2D, 1, planeFormat.m_internalFormat, channels[i]->m_width, channels[i]->m_height);
         }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, planeFormat.m_internalFormat, channels[i]->m_width, channels[i]->m_height, 0, planeFormat.m_uploadFormat, planeFormat.m_dataType, nullptr);
+        }
+    }
+
+    m_textureWidth = frame.m_width;
+    m_textureHeight = frame.m_height;
+    m_texturePixelFormat = frame.m_format;
+    m_textureFormat = textureFormat;
+    // 位深可能变了，矩阵要重新计算
+    m_colorSpace = -1;
+    return true;
+}
+
+void OpenGLWidget::updateColorMatrix(const YUVFrameData &frame)
+{
+    if (frame.m_colorSpace == m_colorSpace && frame.m_colorRange == m_colorRange)
+    {
+        return;
     }
 
-    // 根据传入数据设置宽高
-    m_videoWidth = yuvFrame->m_width;
-    m_videoHeight = yuvFrame->m_height;
+    YUVTextureFormat::colorMatrix(frame.m_colorSpace, frame.m_colorRange, frame.m_height, m_textureFormat, m_colorMatrix, m_colorOffset);
+    m_colorSpace = frame.m_colorSpace;
+    m_colorRange = frame.m_colorRange;
+    m_isColorMatrixDirty = true;
+}
+
+// 按分量自己的行宽上传一个分量，行尾的填充由GL_UNPACK_ROW_LENGTH跳过
+// 只更新已有存储里的数据，不重新分配
+void OpenGLWidget::uploadChannel(const YUVChannel &channel, const YUVPlaneFormat &planeFormat, const void *pixels)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment(channel));
+    // 行长度按纹素计算，linesize除以每个纹素的字节数
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, channel.m_linesize / planeFormat.m_bytesPerPixel);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, channel.m_width, channel.m_height, planeFormat.m_uploadFormat, planeFormat.m_dataType, pixels);
+    // 恢复默认值
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// 把当前帧的每个平面原样更新到纹理里
+void OpenGLWidget::uploadFrame(const YUVFrameData &frame)
+{
+    // 帧在PBO里时纹理从PBO更新，传给GL的是偏移，由DMA异步拷贝
+    bool isFromPbo = m_frameAllocator.offsetOf(frame.m_luma.m_pData) >= 0;
+    if (isFromPbo)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_frameAllocator.buffer());
+    }
 
-    // 根据传入数据获取yuv每个分量的数据长度
-    m_yFrameLength = yuvFrame->m_luma.m_length;
-    m_uFrameLength = yuvFrame->m_chromaB.m_length;
-    m_vFrameLength = yuvFrame->m_chromaR.m_length;
+    // 色度分量的宽高由解码器按格式和向上取整给出，奇数宽高也不会错位
+    const YUVChannel *channels[3] = {&frame.m_luma, &frame.m_chromaB, &frame.m_chromaR};
+    for (int i = 0; i < m_textureFormat.m_planeCount; i++)
+    {
+        const void *pixels = channels[i]->m_pData;
+        if (isFromPbo)
+        {
+            pixels = reinterpret_cast<const void *>(m_frameAllocator.offsetOf(channels[i]->m_pData));
+        }
 
-    // 计算存当前一帧数据的长度，由yuv每个分量的数据长度相加得出
-    int nLen = m_yFrameLength + m_uFrameLength + m_vFrameLength;
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        uploadChannel(*channels[i], m_textureFormat.m_planes[i], pixels);
+    }
 
-    // 根据数据长度分配内存，每个数据大小是一字节
-    if (m_pBufYuv420p == nullptr)
+    if (isFromPbo)
     {
-        m_pBufYuv420p = (unsigned char *)malloc(nLen);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        // GPU读完之前留着帧的引用，槽位不会被解码器重新使用
+        PendingUpload pendingUpload;
+        pendingUpload.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pendingUpload.m_frame = frame.m_frame.ref();
+        m_pendingUploads.push_back(std::move(pendingUpload));
     }
+}
 
-    /*
-     * 拷贝的目标位置是m_pBufYuv420p的起始位置
-     * 拷贝的源数据位置是结构体yuvFrame的luma的dataBuffer的位置
-     * 大小是y分量的数据长度
-     */
-    memcpy(m_pBufYuv420p, yuvFrame->m_luma.m_dataBuffer.data(), m_yFrameLength);
-    memcpy(m_pBufYuv420p + m_yFrameLength, yuvFrame->m_chromaB.m_dataBuffer.data(), m_uFrameLength);
-    memcpy(m_pBufYuv420p + m_yFrameLength + m_uFrameLength, yuvFrame->m_chromaR.m_dataBuffer.data(), m_vFrameLength);
+void OpenGLWidget::releaseFinishedUploads()
+{
+    // fence按提交顺序触发，遇到第一个没完成的就可以停下
+    while (!m_pendingUploads.empty())
+    {
+        GLenum result = glClientWaitSync(m_pendingUploads.front().m_fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
 
-    update();
+        glDeleteSync(m_pendingUploads.front().m_fence);
+        m_pendingUploads.pop_front();
+    }
 }
 
 void OpenGLWidget::initializeGL()
 {
     initializeOpenGLFunctions();
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glClearDepth(1.0f);
-
+    // 只画一个铺满的矩形，不需要深度测试
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     glGenTextures(3, m_textures);
 
+    // glTexStorage2D需要GL 4.2或者ARB_texture_storage
+    QOpenGLContext *glContext = context();
+    QSurfaceFormat surfaceFormat = glContext->format();
+    if (surfaceFormat.version() < qMakePair(3, 3))
+    {
+        qDebug() << "Video renderer needs OpenGL 3.3, got" << surfaceFormat.majorVersion() << surfaceFormat.minorVersion();
+    }
+    m_hasTextureStorage = surfaceFormat.version() >= qMakePair(4, 2) || glContext->hasExtension("GL_ARB_texture_storage");
+    qDebug() << "Texture storage:" << (m_hasTextureStorage ? "immutable" : "glTexImage2D fallback");
+
+    // 不支持持久映射时分配器不启用，帧从普通内存上传
+    m_frameAllocator.initialize(context(), this);
+
     initializeGLSLShaders();
+    initializeVertexBuffer();
+}
+
+// 铺满控件的矩形放在VBO里，顶点格式记录在VAO里，之后每次绘制只需要绑定VAO
+void OpenGLWidget::initializeVertexBuffer()
+{
+    // 位置直接是裁剪坐标，帧的第一行在上面
+    static const Vertex quadVertices[] = {
+        {-1, 1, 0, 0, 0},
+        {-1, -1, 0, 0, 1},
+        {1, 1, 0, 1, 0},
+        {1, -1, 0, 1, 1}};
+
+    glGenVertexArrays(1, &m_vertexArray);
+    glBindVertexArray(m_vertexArray);
+
+    glGenBuffers(1, &m_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(VIDEO_ATTR_POSITION);
+    glVertexAttribPointer(VIDEO_ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, x)));
+    glEnableVertexAttribArray(VIDEO_ATTR_UV);
+    glVertexAttribPointer(VIDEO_ATTR_UV, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, u)));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void OpenGLWidget::paintGL()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+    auto startTime = std::chrono::steady_clock::now();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // 取最新写完的一帧，中间被替换掉的帧不会显示
+    if (m_frameBuffer.update())
+    {
+        m_frameGeneration++;
+    }
+    const YUVFrameData &frame = m_frameBuffer.frontBuffer();
+    if (!frame.m_frame.isValid())
+    {
+        return;
+    }
 
-    static Vertex triangleVert[] = {
-        {-1, 1, 1, 0, 0},
-        {-1, -1, 1, 0, 1},
-        {1, 1, 1, 1, 0},
-        {1, -1, 1, 1, 1}};
+    // 分辨率或者像素格式变了才重新分配纹理存储，之后每帧只更新数据
+    // 已经知道不支持的格式和大小不再尝试，等帧的格式或大小变了再试
+    bool isRejected = frame.m_width == m_rejectedWidth && frame.m_height == m_rejectedHeight && frame.m_format == m_rejectedPixelFormat;
+    if (frame.m_width != m_textureWidth || frame.m_height != m_textureHeight || frame.m_format != m_texturePixelFormat)
+    {
+        if (isRejected || !allocateTextures(frame))
+        {
+            // 不做CPU上的转换，不支持的格式不显示
+            if (m_frameGeneration != m_uploadedGeneration)
+            {
+                m_unsupportedFrames++;
+                m_uploadedGeneration = m_frameGeneration;
+            }
+            return;
+        }
+        m_uploadedGeneration = 0;
+    }
+    updateColorMatrix(frame);
 
-    QMatrix4x4 matrix;
-    // 设置正交变换，也就是视角，使绘制内容铺满视角
-    matrix.ortho(-1, 1, -1, 1, 0.1, 1000);
-    // 将绘制内容向z的负方向移动
-    matrix.translate(0, 0, -3);
+    // 没有新的帧时纹理里已经是当前帧(窗口重绘、改变大小)，不用再上传
+    releaseFinishedUploads();
+    if (m_frameGeneration != m_uploadedGeneration)
+    {
+        uploadFrame(frame);
+        m_uploadedGeneration = m_frameGeneration;
+        m_uploadCount++;
+    }
+    else
+    {
+        m_uploadsAvoided++;
+    }
 
     // 将此着色器程序绑定到当前上下文环境
-    m_pShaderProgram->bind();
-
-    // 将矩阵传入
-    m_pShaderProgram->setUniformValue("uni_mat", matrix);
-
-    // 传入顶点和uv坐标
-    m_pShaderProgram->enableAttributeArray("attr_position");
-    m_pShaderProgram->enableAttributeArray("attr_uv");
-    m_pShaderProgram->setAttributeArray("attr_position", GL_FLOAT, triangleVert, 3, sizeof(Vertex));
-    m_pShaderProgram->setAttributeArray("attr_uv", GL_FLOAT, &triangleVert[0].u, 2, sizeof(Vertex));
-
-    // Y分量纹理的纹理采样器的纹理单元为0
-    m_pShaderProgram->setUniformValue("uni_textureY", 0);
-    // 激活纹理单元0
-    glActiveTexture(GL_TEXTURE0);
-    // 绑定当前纹理
-    glBindTexture(GL_TEXTURE_2D, m_textures[0]);
-    // 设定默认像素对齐为1
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    // GL_LUMINANCE表明传入的数据格式为单通道亮度（传YUV某个分量时使用这个）
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_videoWidth, m_videoHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, m_pBufYuv420p);
-    // 恢复默认像素对齐为4
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    // 设置纹理参数
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    m_pShaderProgram->setUniformValue("uni_textureU", 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_textures[1]);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_videoWidth / 2, m_videoHeight / 2, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, (char *)(m_pBufYuv420p + m_yFrameLength));
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    m_pShaderProgram->setUniformValue("uni_textureV", 2);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_textures[2]);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_videoWidth / 2, m_videoHeight / 2, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, (char *)(m_pBufYuv420p + m_yFrameLength + m_uFrameLength));
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    int shaderVariant = m_textureFormat.m_shaderVariant;
+    QOpenGLShaderProgram *pShaderProgram = m_pShaderPrograms[shaderVariant];
+    pShaderProgram->bind();
 
-    // 绘制
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    // uniform是着色器程序的状态，只有矩阵变了或者换了着色器时才需要重新设置
+    if (m_isColorMatrixDirty || shaderVariant != m_colorMatrixVariant)
+    {
+        const ShaderUniforms &uniforms = m_shaderUniforms[shaderVariant];
+        glUniformMatrix3fv(uniforms.m_colorMatrix, 1, GL_FALSE, m_colorMatrix);
+        glUniform3f(uniforms.m_colorOffset, m_colorOffset[0], m_colorOffset[1], m_colorOffset[2]);
+        m_isColorMatrixDirty = false;
+        m_colorMatrixVariant = shaderVariant;
+    }
 
-    m_pShaderProgram->disableAttributeArray("attr_position");
-    m_pShaderProgram->disableAttributeArray("attr_uv");
+    // 每个平面的纹理依次绑定到纹理单元0、1、2，半平面格式只有两个
+    for (int i = 0; i < m_textureFormat.m_planeCount; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+    }
 
-    m_pShaderProgram->release();
+    // 绘制
+    glBindVertexArray(m_vertexArray);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    m_drawCalls++;
+
+    pShaderProgram->release();
+
+    // 只统计CPU上提交命令的时间，GPU执行是异步的
+    int64_t paintUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    int64_t averagePaintUs = m_averagePaintUs.load(std::memory_order_relaxed);
+    averagePaintUs = averagePaintUs == 0 ? paintUs : averagePaintUs + (paintUs - averagePaintUs) / 8;
+    m_averagePaintUs.store(averagePaintUs, std::memory_order_relaxed);
+    m_lastPaintUs.store(paintUs, std::memory_order_relaxed);
+    m_paintCount++;
 }
 
 void OpenGLWidget::resizeGL(int w, int h)
@@ -163,6 +385,34 @@ void OpenGLWidget::resizeGL(int w, int h)
 }
 
 void OpenGLWidget::initializeGLSLShaders()
+{
+    // 顶点着色器相同，片段着色器按平面的布局各一个
+    m_pShaderPrograms[YUV_SHADER_PLANAR] = createShaderProgram(":/shaders/fragment.frag");
+    m_pShaderPrograms[YUV_SHADER_SEMI_PLANAR] = createShaderProgram(":/shaders/fragment_semiplanar.frag");
+
+    // 采样器固定使用纹理单元0、1、2，只设置一次；其他uniform的位置也只查一次
+    for (int i = 0; i < YUV_SHADER_VARIANT_COUNT; i++)
+    {
+        QOpenGLShaderProgram *pShaderProgram = m_pShaderPrograms[i];
+        pShaderProgram->bind();
+        if (i == YUV_SHADER_SEMI_PLANAR)
+        {
+            pShaderProgram->setUniformValue(pShaderProgram->uniformLocation("uni_textureY"), 0);
+            pShaderProgram->setUniformValue(pShaderProgram->uniformLocation("uni_textureUV"), 1);
+        }
+        else
+        {
+            pShaderProgram->setUniformValue(pShaderProgram->uniformLocation("uni_textureY"), 0);
+            pShaderProgram->setUniformValue(pShaderProgram->uniformLocation("uni_textureU"), 1);
+            pShaderProgram->setUniformValue(pShaderProgram->uniformLocation("uni_textureV"), 2);
+        }
+        m_shaderUniforms[i].m_colorMatrix = pShaderProgram->uniformLocation("uni_colorMatrix");
+        m_shaderUniforms[i].m_colorOffset = pShaderProgram->uniformLocation("uni_colorOffset");
+        pShaderProgram->release();
+    }
+}
+
+QOpenGLShaderProgram *OpenGLWidget::createShaderProgram(const QString &fragmentPath)
 {
     // 初始化顶点着色器
     QOpenGLShader *vertexShader = new QOpenGLShader(QOpenGLShader::Vertex, this);
@@ -174,21 +424,21 @@ void OpenGLWidget::initializeGLSLShaders()
 
     // 初始化片段着色器
     QOpenGLShader *fragmentShader = new QOpenGLShader(QOpenGLShader::Fragment, this);
-    bool bCompileFS = fragmentShader->compileSourceFile(":/shaders/fragment.frag");
+    bool bCompileFS = fragmentShader->compileSourceFile(fragmentPath);
     if (bCompileFS == false)
     {
         qDebug() << "FS Compile ERROR:" << fragmentShader->log();
     }
 
     // 初始化shader程序并链接
-    m_pShaderProgram = new QOpenGLShaderProgram(this);
-    m_pShaderProgram->addShader(vertexShader);
-    m_pShaderProgram->addShader(fragmentShader);
-    bool linkStatus = m_pShaderProgram->link();
+    QOpenGLShaderProgram *pShaderProgram = new QOpenGLShaderProgram(this);
+    pShaderProgram->addShader(vertexShader);
+    pShaderProgram->addShader(fragmentShader);
+    bool linkStatus = pShaderProgram->link();
 
     if (linkStatus == false)
     {
-        qDebug() << "LINK ERROR:" << m_pShaderProgram->log();
+        qDebug() << "LINK ERROR:" << pShaderProgram->log();
     }
 
     if (vertexShader != nullptr)
@@ -202,6 +452,8 @@ void OpenGLWidget::initializeGLSLShaders()
         delete fragmentShader;
         fragmentShader = nullptr;
     }
+
+    return pShaderProgram;
 }
 
 // 没有用到这段代码，单纯用来比对用rgb图片与yuv某个分量初始化纹理的区别
@@ -3,10 +3,16 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLShaderProgram>
-#include <QMatrix4x4>
-#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
 
 #include "type.h"
+#include "pboframeallocator.h"
+#include "triplebuffer.h"
+#include "yuvtextureformat.h"
 
 struct Vertex
 {
@@ -14,18 +20,50 @@ struct Vertex
     float u, v;
 };
 
-class OpenGLWidget : public QOpenGLWidget, protected QOpenGLFunctions
+struct RenderStats
+{
+    uint64_t m_uploadCount = 0;    // 有新的帧，实际上传纹理的绘制次数
+    uint64_t m_uploadsAvoided = 0; // 没有新的帧，跳过上传的绘制次数
+    uint64_t m_framesReceived = 0;   // RendVideo收到的帧
+    uint64_t m_framesSuperseded = 0; // 还没显示就被更新的帧替换掉的帧
+    uint64_t m_unsupportedFrames = 0; // 像素格式不能直接上传、没有显示的帧
+    uint64_t m_paintCount = 0;
+    uint64_t m_drawCalls = 0;
+    int64_t m_lastPaintUs = 0;    // 最近一次paintGL在CPU上的耗时
+    int64_t m_averagePaintUs = 0; // 指数平均，新的样本占1/8
+};
+
+class OpenGLWidget : public QOpenGLWidget, protected QOpenGLExtraFunctions
 {
     Q_OBJECT
 public:
     OpenGLWidget(QWidget *parent = nullptr);
     ~OpenGLWidget();
 
-    // 根据传过来的YUV数据执行渲染
+    // 根据传过来的YUV数据执行渲染，帧会被移走留到绘制时使用
+    // 在解码线程里调用，同一时间只能有一个线程调用
     void RendVideo(YUVFrameData *frame);
 
+    // 交给解码器的帧分配器，GL初始化之后解码器直接把帧解到PBO里，之前和不支持时用默认分配
+    // 分配器属于这个控件，解码器要在控件销毁之前停止
+    FrameAllocator *frameAllocator();
+    PboAllocatorStats frameAllocatorStats() const;
+    // 可以在其他线程读取
+    RenderStats renderStats() const;
+
 private:
     void initializeGLSLShaders();
+    QOpenGLShaderProgram *createShaderProgram(const QString &fragmentPath);
+    void initializeVertexBuffer();
+    // 分辨率或者像素格式变化时按格式重新创建每个平面的纹理，格式不支持时返回false
+    bool allocateTextures(const YUVFrameData &frame);
+    // 色彩空间或者范围变化时重新计算转换矩阵
+    void updateColorMatrix(const YUVFrameData &frame);
+    void uploadFrame(const YUVFrameData &frame);
+    // pixels是数据的地址，从PBO上传时是在PBO里的偏移
+    void uploadChannel(const YUVChannel &channel, const YUVPlaneFormat &planeFormat, const void *pixels);
+    // 释放GPU已经读完的PBO帧
+    void releaseFinishedUploads();
     GLuint createImageTextures(QString &pathString);
 
 protected:
@@ -34,19 +72,65 @@ protected:
     void resizeGL(int w, int h) override;
 
 private:
-    QOpenGLShaderProgram *m_pShaderProgram = nullptr;
+    // 每种平面布局一个着色器，按帧的像素格式选择
+    QOpenGLShaderProgram *m_pShaderPrograms[YUV_SHADER_VARIANT_COUNT] = {nullptr, nullptr};
+    // 链接后查好的uniform位置，绘制时不再按名字查找
+    struct ShaderUniforms
+    {
+        GLint m_colorMatrix = -1;
+        GLint m_colorOffset = -1;
+    };
+    ShaderUniforms m_shaderUniforms[YUV_SHADER_VARIANT_COUNT];
+    // 铺满控件的矩形，在initializeGL里创建一次
+    GLuint m_vertexArray = 0;
+    GLuint m_vertexBuffer = 0;
     GLuint m_textures[3];
+    // 当前纹理存储对应的视频宽高和像素格式，和新的帧不一样时才重新分配
+    int m_textureWidth = 0;
+    int m_textureHeight = 0;
+    int m_texturePixelFormat = AV_PIX_FMT_NONE;
+    YUVTextureFormat m_textureFormat;
+    // 上一次不能分配纹理的帧，同样的帧不再重复尝试
+    int m_rejectedWidth = 0;
+    int m_rejectedHeight = 0;
+    int m_rejectedPixelFormat = AV_PIX_FMT_NONE;
+    // 支持glTexStorage2D时用不可变的存储，否则退回到glTexImage2D
+    bool m_hasTextureStorage = false;
+    // 当前转换矩阵对应的色彩空间和范围
+    int m_colorSpace = -1;
+    int m_colorRange = -1;
+    float m_colorMatrix[9] = {0};
+    float m_colorOffset[3] = {0};
+    // 矩阵变了还没有设置到着色器上，或者上次设置的是另一个着色器
+    bool m_isColorMatrixDirty = true;
+    int m_colorMatrixVariant = -1;
+    std::atomic<uint64_t> m_unsupportedFrames{0};
+    std::atomic<uint64_t> m_paintCount{0};
+    std::atomic<uint64_t> m_drawCalls{0};
+    std::atomic<int64_t> m_lastPaintUs{0};
+    std::atomic<int64_t> m_averagePaintUs{0};
 
-    // YUV每个分量的数据长度
-    int m_yFrameLength = 0;
-    int m_uFrameLength = 0;
-    int m_vFrameLength = 0;
-
-    int m_videoWidth = 0;
-    int m_videoHeight = 0;
+    // 解码线程和GUI线程之间传递帧，GUI线程总是显示最新的一帧
+    TripleBuffer<YUVFrameData> m_frameBuffer;
+    // 已经排队了还没执行的重绘请求
+    std::atomic_bool m_isUpdatePending{false};
+    std::atomic<uint64_t> m_framesReceived{0};
+    std::atomic<uint64_t> m_framesSuperseded{0};
+    // 每换到一个新的帧加1，和已经上传的代数相同时纹理里已经是当前帧
+    uint64_t m_frameGeneration = 0;
+    uint64_t m_uploadedGeneration = 0;
+    std::atomic<uint64_t> m_uploadCount{0};
+    std::atomic<uint64_t> m_uploadsAvoided{0};
 
-    // 数据缓冲区
-    unsigned char *m_pBufYuv420p = nullptr;
+    // 解码器直接写入的PBO环
+    PboFrameAllocator m_frameAllocator;
+    // 已经从PBO发起上传的帧，fence触发之前GPU可能还在读，不能让槽位被回收
+    struct PendingUpload
+    {
+        GLsync m_fence = nullptr;
+        VideoFrame m_frame;
+    };
+    std::deque<PendingUpload> m_pendingUploads;
 
     bool m_glewInitSuccessfully = false;
 };
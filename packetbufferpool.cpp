@@ -0,0 +1,85 @@
+#include "packetbufferpool.h"
+
+#include <cstring>
+#include <iostream>
+
+PacketBufferPool::PacketBufferPool(size_t maxMessageLength)
+    : m_maxMessageLength(maxMessageLength)
+{
+}
+
+PacketBufferPool::~PacketBufferPool()
+{
+    // 还被解码器引用的缓冲区会在释放后再真正回收
+    for (auto &pool : m_pools)
+    {
+        if (pool != nullptr)
+        {
+            av_buffer_pool_uninit(&pool);
+        }
+    }
+}
+
+void PacketBufferPool::setMaxMessageLength(size_t maxMessageLength)
+{
+    m_maxMessageLength = maxMessageLength;
+}
+
+size_t PacketBufferPool::maxMessageLength() const
+{
+    return m_maxMessageLength;
+}
+
+AVBufferRef *PacketBufferPool::acquire(size_t length)
+{
+    // 长度来自网络，不能信任，超过上限直接拒绝，避免分配几个G的内存
+    if (length > m_maxMessageLength)
+    {
+        std::cerr << "message length " << length << " exceeds limit " << m_maxMessageLength << std::endl;
+        m_stats.m_rejectCount++;
+        return nullptr;
+    }
+
+    // 找到能放下负载和填充的最小档位
+    size_t needLength = length + AV_INPUT_BUFFER_PADDING_SIZE;
+    size_t level = 0;
+    while ((static_cast<size_t>(1) << (level + PACKET_POOL_MIN_BUFFER_SHIFT)) < needLength)
+    {
+        level++;
+    }
+
+    if (level >= m_pools.size())
+    {
+        m_pools.resize(level + 1, nullptr);
+    }
+
+    if (m_pools[level] == nullptr)
+    {
+        size_t bufferSize = static_cast<size_t>(1) << (level + PACKET_POOL_MIN_BUFFER_SHIFT);
+        m_pools[level] = av_buffer_pool_init(bufferSize, av_buffer_alloc);
+        if (m_pools[level] == nullptr)
+        {
+            std::cerr << "av_buffer_pool_init failed" << std::endl;
+            return nullptr;
+        }
+        m_stats.m_poolCount++;
+    }
+
+    AVBufferRef *buffer = av_buffer_pool_get(m_pools[level]);
+    if (buffer == nullptr)
+    {
+        std::cerr << "av_buffer_pool_get failed" << std::endl;
+        return nullptr;
+    }
+
+    // 填充部分补零，负载部分由调用方写入
+    memset(buffer->data + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    m_stats.m_acquireCount++;
+
+    return buffer;
+}
+
+const PacketPoolStats &PacketBufferPool::stats() const
+{
+    return m_stats;
+}
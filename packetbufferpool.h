@@ -0,0 +1,51 @@
+#ifndef PACKETBUFFERPOOL_H
+#define PACKETBUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+}
+
+#include "type.h"
+
+// 最小的一档缓冲区大小，小于它的消息都用这一档
+#define PACKET_POOL_MIN_BUFFER_SHIFT 12
+
+struct PacketPoolStats
+{
+    uint64_t m_acquireCount = 0;
+    uint64_t m_rejectCount = 0;   // 超过最大消息长度被拒绝的次数
+    uint64_t m_poolCount = 0;     // 已经创建的档位数
+};
+
+// 接收负载用的缓冲区池，按2的幂分档，每档一个AVBufferPool
+// 缓冲区带引用计数，直接交给解码器使用，解码器释放后回到池里重复使用
+// 末尾留有AV_INPUT_BUFFER_PADDING_SIZE大小的补零填充，满足解码器的要求
+class PacketBufferPool
+{
+public:
+    explicit PacketBufferPool(size_t maxMessageLength = DEFAULT_MAX_MESSAGE_SIZE);
+    ~PacketBufferPool();
+
+    void setMaxMessageLength(size_t maxMessageLength);
+    size_t maxMessageLength() const;
+
+    // 取一个能放下length字节的缓冲区，超过最大消息长度返回nullptr
+    AVBufferRef *acquire(size_t length);
+
+    const PacketPoolStats &stats() const;
+
+private:
+    size_t m_maxMessageLength = DEFAULT_MAX_MESSAGE_SIZE;
+    // 下标是档位，对应大小为(1 << (下标 + PACKET_POOL_MIN_BUFFER_SHIFT))
+    std::vector<AVBufferPool *> m_pools;
+
+    PacketPoolStats m_stats;
+};
+
+#endif // PACKETBUFFERPOOL_H
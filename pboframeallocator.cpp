@@ -0,0 +1,212 @@
+#include "pboframeallocator.h"
+#include "yuvtextureformat.h"
+
+#include <iostream>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+// 解码器会读回参考帧做运动补偿和去块滤波，映射必须可读，没有GL_MAP_READ_BIT时读映射的内存是未定义的
+#define PBO_MAP_FLAGS (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+// GL_CLIENT_STORAGE_BIT提示驱动放在有缓存的系统内存里，写合并的内存读起来非常慢
+#define PBO_STORAGE_FLAGS (PBO_MAP_FLAGS | GL_CLIENT_STORAGE_BIT)
+
+// glBufferStorage不在QOpenGLExtraFunctions里，需要自己取函数地址
+using BufferStorageFunction = void(QOPENGLF_APIENTRYP)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+bool PboFrameAllocator::initialize(QOpenGLContext *context, QOpenGLExtraFunctions *gl)
+{
+    if (m_pMapped != nullptr)
+    {
+        return true;
+    }
+
+    bool hasBufferStorage = false;
+    if (context->isOpenGLES())
+    {
+        hasBufferStorage = context->hasExtension("GL_EXT_buffer_storage");
+    }
+    else
+    {
+        hasBufferStorage = context->format().version() >= qMakePair(4, 4) || context->hasExtension("GL_ARB_buffer_storage");
+    }
+
+    BufferStorageFunction bufferStorage = reinterpret_cast<BufferStorageFunction>(context->getProcAddress("glBufferStorage"));
+    if (bufferStorage == nullptr)
+    {
+        bufferStorage = reinterpret_cast<BufferStorageFunction>(context->getProcAddress("glBufferStorageEXT"));
+    }
+
+    if (!hasBufferStorage || bufferStorage == nullptr)
+    {
+        std::cerr << "persistent buffer mapping is not supported, decoded frames use default buffers" << std::endl;
+        return false;
+    }
+
+    // 按最大分辨率估算一个槽位的大小，解码器还会把宽高对齐到宏块并多留两行
+    size_t lumaLinesize = alignPlaneSize(PBO_RING_MAX_WIDTH + FRAME_PLANE_ALIGN);
+    size_t lumaHeight = ((PBO_RING_MAX_HEIGHT + 31) & ~31) + 2;
+    size_t lumaSize = alignPlaneSize(lumaLinesize * lumaHeight + FRAME_PLANE_PADDING);
+    size_t chromaSize = alignPlaneSize(lumaLinesize / 2 * ((lumaHeight + 1) / 2) + FRAME_PLANE_PADDING);
+    m_slotSize = lumaSize + chromaSize * 2;
+    m_bufferSize = m_slotSize * PBO_RING_SLOT_COUNT + FRAME_PLANE_ALIGN;
+
+    gl->glGenBuffers(1, &m_buffer);
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    bufferStorage(GL_PIXEL_UNPACK_BUFFER, m_bufferSize, nullptr, PBO_STORAGE_FLAGS);
+    m_pMapped = static_cast<uint8_t *>(gl->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_bufferSize, PBO_MAP_FLAGS));
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (m_pMapped == nullptr)
+    {
+        std::cerr << "glMapBufferRange error: " << gl->glGetError() << std::endl;
+        gl->glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        return false;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(m_pMapped);
+    m_pSlotBase = m_pMapped + (FRAME_PLANE_ALIGN - address % FRAME_PLANE_ALIGN) % FRAME_PLANE_ALIGN;
+
+    {
+        std::lock_guard<std::mutex> lock(m_slotMutex);
+        m_freeSlots.clear();
+        for (int i = PBO_RING_SLOT_COUNT - 1; i >= 0; i--)
+        {
+            m_freeSlots.push_back(i);
+        }
+    }
+
+    m_isReady.store(true, std::memory_order_release);
+    std::cout << "pbo frame ring: " << PBO_RING_SLOT_COUNT << " slots of " << m_slotSize << " bytes, persistently mapped" << std::endl;
+    return true;
+}
+
+void PboFrameAllocator::destroy(QOpenGLExtraFunctions *gl)
+{
+    m_isReady.store(false, std::memory_order_release);
+    if (m_pMapped == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_slotMutex);
+        if (m_freeSlots.size() != PBO_RING_SLOT_COUNT)
+        {
+            // 还有帧指向映射的内存，不能释放，宁可泄漏
+            std::cerr << "pbo frame ring still has " << PBO_RING_SLOT_COUNT - m_freeSlots.size() << " frames in use" << std::endl;
+            return;
+        }
+        m_freeSlots.clear();
+    }
+
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    gl->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl->glDeleteBuffers(1, &m_buffer);
+
+    m_buffer = 0;
+    m_pMapped = nullptr;
+    m_pSlotBase = nullptr;
+}
+
+GLuint PboFrameAllocator::buffer() const
+{
+    return m_buffer;
+}
+
+ptrdiff_t PboFrameAllocator::offsetOf(const uint8_t *data) const
+{
+    if (m_pMapped == nullptr || data < m_pMapped || data >= m_pMapped + m_bufferSize)
+    {
+        return -1;
+    }
+    return data - m_pMapped;
+}
+
+bool PboFrameAllocator::allocateFrame(AVCodecContext *context, AVFrame *frame)
+{
+    // 只接受渲染器能直接上传成纹理的格式
+    YUVTextureFormat textureFormat;
+    if (!m_isReady.load(std::memory_order_acquire) || !YUVTextureFormat::fromPixelFormat(frame->format, textureFormat))
+    {
+        m_fallbackFrames++;
+        return false;
+    }
+
+    int linesizes[4] = {0};
+    size_t offsets[4] = {0};
+    size_t frameSize = computeFrameLayout(context, frame, linesizes, offsets);
+    if (frameSize == 0 || frameSize > m_slotSize)
+    {
+        m_fallbackFrames++;
+        return false;
+    }
+
+    int slot = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_slotMutex);
+        if (!m_freeSlots.empty())
+        {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+    }
+    if (slot < 0)
+    {
+        m_noFreeSlot++;
+        m_fallbackFrames++;
+        return false;
+    }
+
+    uint8_t *pSlot = m_pSlotBase + slot * m_slotSize;
+    AVBufferRef *buffer = av_buffer_create(pSlot, m_slotSize, &PboFrameAllocator::releaseSlot, this, 0);
+    if (buffer == nullptr)
+    {
+        releaseSlot(this, pSlot);
+        m_fallbackFrames++;
+        return false;
+    }
+
+    // 所有平面放在同一个缓冲区里，共用一个引用，半平面格式只有两个平面
+    frame->buf[0] = buffer;
+    for (int i = 0; i < 4; i++)
+    {
+        frame->data[i] = linesizes[i] != 0 ? pSlot + offsets[i] : nullptr;
+        frame->linesize[i] = linesizes[i];
+    }
+    frame->extended_data = frame->data;
+
+    m_pboFrames++;
+    return true;
+}
+
+PboAllocatorStats PboFrameAllocator::stats() const
+{
+    PboAllocatorStats stats;
+    stats.m_isPersistent = m_isReady.load(std::memory_order_relaxed);
+    stats.m_pboFrames = m_pboFrames.load(std::memory_order_relaxed);
+    stats.m_fallbackFrames = m_fallbackFrames.load(std::memory_order_relaxed);
+    stats.m_noFreeSlot = m_noFreeSlot.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// 帧的最后一个引用释放时调用，可能在任意线程
+void PboFrameAllocator::releaseSlot(void *opaque, uint8_t *data)
+{
+    PboFrameAllocator *pAllocator = static_cast<PboFrameAllocator *>(opaque);
+    int slot = static_cast<int>((data - pAllocator->m_pSlotBase) / pAllocator->m_slotSize);
+
+    std::lock_guard<std::mutex> lock(pAllocator->m_slotMutex);
+    pAllocator->m_freeSlots.push_back(slot);
+}
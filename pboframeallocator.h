@@ -0,0 +1,76 @@
+#ifndef PBOFRAMEALLOCATOR_H
+#define PBOFRAMEALLOCATOR_H
+
+#include "frameallocator.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 环里的槽位数，要能同时放下解码器的参考帧、帧线程正在解的帧、等待显示和GPU还在读的帧
+#define PBO_RING_SLOT_COUNT 16
+// 每个槽位按这个分辨率分配，更大的帧退回默认分配
+#define PBO_RING_MAX_WIDTH 1920
+#define PBO_RING_MAX_HEIGHT 1088
+
+struct PboAllocatorStats
+{
+    bool m_isPersistent = false;   // 是否启用了持久映射的PBO
+    uint64_t m_pboFrames = 0;      // 直接解码到PBO里的帧
+    uint64_t m_fallbackFrames = 0; // 退回默认分配的帧
+    uint64_t m_noFreeSlot = 0;     // 其中因为没有空闲槽位退回的
+};
+
+// 一个持久映射的PBO切成固定大小的槽位，解码器通过get_buffer2直接把帧解到映射的内存里
+// 纹理从PBO更新，只有一次DMA，没有CPU拷贝
+// 解码器要读参考帧，映射是可读写的，并且请求放在有缓存的系统内存里(GL_CLIENT_STORAGE_BIT)
+// 槽位在帧的最后一个引用释放时回收，GPU读完之前使用方要留着帧的引用(用fence判断)
+// 不支持持久映射(GL 4.4、ARB_buffer_storage或者EXT_buffer_storage)时不启用，所有帧都用默认分配，走普通的纹理上传
+class PboFrameAllocator : public FrameAllocator
+{
+public:
+    PboFrameAllocator() = default;
+
+    PboFrameAllocator(const PboFrameAllocator &) = delete;
+    PboFrameAllocator &operator=(const PboFrameAllocator &) = delete;
+
+    // 在GL线程里调用，context必须是当前的，不支持持久映射时返回false
+    bool initialize(QOpenGLContext *context, QOpenGLExtraFunctions *gl);
+    // 在GL线程里调用，解码器要已经停止，使用槽位的帧都要已经释放
+    void destroy(QOpenGLExtraFunctions *gl);
+
+    GLuint buffer() const;
+    // data在PBO里时返回它在PBO里的偏移，不在时返回-1
+    ptrdiff_t offsetOf(const uint8_t *data) const;
+
+    bool allocateFrame(AVCodecContext *context, AVFrame *frame) override;
+
+    PboAllocatorStats stats() const;
+
+private:
+    static void releaseSlot(void *opaque, uint8_t *data);
+
+private:
+    GLuint m_buffer = 0;
+    uint8_t *m_pMapped = nullptr;
+    size_t m_bufferSize = 0;
+    // 按64字节对齐后的第一个槽位
+    uint8_t *m_pSlotBase = nullptr;
+    size_t m_slotSize = 0;
+    std::atomic_bool m_isReady{false};
+
+    // 空闲槽位，解码线程取，释放帧的线程还
+    std::mutex m_slotMutex;
+    std::vector<int> m_freeSlots;
+
+    std::atomic<uint64_t> m_pboFrames{0};
+    std::atomic<uint64_t> m_fallbackFrames{0};
+    std::atomic<uint64_t> m_noFreeSlot{0};
+};
+
+#endif // PBOFRAMEALLOCATOR_H
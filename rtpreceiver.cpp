@@ -0,0 +1,314 @@
+#include "rtpreceiver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+// H.264的NAL类型(RFC 6184)
+#define H264_NAL_STAP_A 24
+#define H264_NAL_FU_A 28
+
+static const uint8_t H264_START_CODE[4] = {0, 0, 0, 1};
+
+static uint16_t readUint16(const uint8_t *data)
+{
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static uint32_t readUint32(const uint8_t *data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+static void writeUint16(std::vector<uint8_t> &packet, uint16_t value)
+{
+    packet.push_back(static_cast<uint8_t>(value >> 8));
+    packet.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+static void writeUint32(std::vector<uint8_t> &packet, uint32_t value)
+{
+    writeUint16(packet, static_cast<uint16_t>(value >> 16));
+    writeUint16(packet, static_cast<uint16_t>(value & 0xFFFF));
+}
+
+RtpReceiver::RtpReceiver(PacketBufferPool *pPacketPool)
+    : m_pPacketPool(pPacketPool)
+{
+    std::random_device randomDevice;
+    m_localSSRC = randomDevice();
+}
+
+void RtpReceiver::setLatency(int latencyMs)
+{
+    m_jitterBuffer.setLatency(latencyMs);
+}
+
+void RtpReceiver::pushDatagram(const uint8_t *data, size_t length, JitterBuffer::Clock::time_point now)
+{
+    // 版本号必须是2
+    if (length < RTP_HEADER_SIZE || (data[0] >> 6) != 2)
+    {
+        m_stats.m_invalidPackets++;
+        return;
+    }
+
+    // 同一端口上的RTCP包(类型200到206)不是媒体数据
+    uint8_t packetType = data[1];
+    if (packetType >= 200 && packetType <= 206)
+    {
+        return;
+    }
+
+    bool hasPadding = (data[0] & 0x20) != 0;
+    bool hasExtension = (data[0] & 0x10) != 0;
+    int csrcCount = data[0] & 0x0F;
+    bool marker = (data[1] & 0x80) != 0;
+    uint16_t sequence = readUint16(data + 2);
+    uint32_t timestamp = readUint32(data + 4);
+    uint32_t ssrc = readUint32(data + 8);
+
+    size_t payloadOffset = RTP_HEADER_SIZE + csrcCount * 4;
+    if (hasExtension)
+    {
+        if (payloadOffset + 4 > length)
+        {
+            m_stats.m_invalidPackets++;
+            return;
+        }
+        payloadOffset += 4 + readUint16(data + payloadOffset + 2) * 4;
+    }
+
+    size_t payloadEnd = length;
+    if (hasPadding)
+    {
+        payloadEnd -= std::min<size_t>(data[length - 1], length);
+    }
+
+    if (payloadOffset >= payloadEnd)
+    {
+        m_stats.m_invalidPackets++;
+        return;
+    }
+
+    m_remoteSSRC = ssrc;
+    m_jitterBuffer.insert(sequence, timestamp, marker, data + payloadOffset, payloadEnd - payloadOffset, now);
+}
+
+void RtpReceiver::process(JitterBuffer::Clock::time_point now, const accessUnitCallback &callback)
+{
+    RtpPacket packet;
+    bool isAfterLoss = false;
+    while (m_jitterBuffer.pop(packet, isAfterLoss, now))
+    {
+        // 丢包可能发生在正在组装的帧里，这一帧不能再用
+        if (isAfterLoss)
+        {
+            if (m_hasAccessUnit)
+            {
+                m_isAccessUnitBroken = true;
+            }
+            m_isPendingLoss = true;
+        }
+
+        depacketize(packet, callback);
+    }
+}
+
+size_t RtpReceiver::buildNackPacket(std::vector<uint8_t> &packet, JitterBuffer::Clock::time_point now)
+{
+    m_nackSequences.clear();
+    m_jitterBuffer.collectNacks(m_nackSequences, now);
+    if (m_nackSequences.empty())
+    {
+        return 0;
+    }
+
+    // RTCP头部：V=2, FMT=1, PT=205，长度稍后填
+    packet.clear();
+    packet.push_back(0x80 | RTCP_FMT_GENERIC_NACK);
+    packet.push_back(RTCP_PT_RTPFB);
+    writeUint16(packet, 0);
+    writeUint32(packet, m_localSSRC);
+    writeUint32(packet, m_remoteSSRC);
+
+    // 每一项是一个序号PID加上后面16个序号的位图BLP
+    size_t i = 0;
+    while (i < m_nackSequences.size())
+    {
+        uint16_t pid = m_nackSequences[i];
+        uint16_t blp = 0;
+        size_t j = i + 1;
+        while (j < m_nackSequences.size())
+        {
+            uint16_t diff = static_cast<uint16_t>(m_nackSequences[j] - pid);
+            if (diff == 0 || diff > 16)
+            {
+                break;
+            }
+            blp |= static_cast<uint16_t>(1 << (diff - 1));
+            j++;
+        }
+
+        writeUint16(packet, pid);
+        writeUint16(packet, blp);
+        i = j;
+    }
+
+    // 长度字段是以32位为单位的长度减1
+    uint16_t lengthField = static_cast<uint16_t>(packet.size() / 4 - 1);
+    packet[2] = static_cast<uint8_t>(lengthField >> 8);
+    packet[3] = static_cast<uint8_t>(lengthField & 0xFF);
+
+    return packet.size();
+}
+
+void RtpReceiver::reset()
+{
+    m_jitterBuffer.reset();
+    m_accessUnitLength = 0;
+    m_hasAccessUnit = false;
+    m_isAccessUnitBroken = false;
+    m_isInFragment = false;
+    m_isPendingLoss = false;
+}
+
+const JitterBufferStats &RtpReceiver::jitterStats() const
+{
+    return m_jitterBuffer.stats();
+}
+
+const RtpReceiverStats &RtpReceiver::stats() const
+{
+    return m_stats;
+}
+
+void RtpReceiver::depacketize(const RtpPacket &packet, const accessUnitCallback &callback)
+{
+    // 时间戳变了说明新的一帧开始了，上一帧没有收到marker也要结束
+    if (m_hasAccessUnit && packet.m_timestamp != m_accessUnitTimestamp)
+    {
+        flushAccessUnit(callback);
+    }
+
+    if (!m_hasAccessUnit)
+    {
+        m_hasAccessUnit = true;
+        m_accessUnitTimestamp = packet.m_timestamp;
+    }
+
+    const uint8_t *payload = packet.m_payload;
+    size_t length = packet.m_length;
+    int nalType = payload[0] & 0x1F;
+
+    if (nalType >= 1 && nalType < H264_NAL_STAP_A)
+    {
+        // 单个NAL单元
+        appendNal(payload, length);
+    }
+    else if (nalType == H264_NAL_STAP_A)
+    {
+        // 一个包里聚合了多个NAL单元，每个前面有2字节长度
+        size_t offset = 1;
+        while (offset + 2 <= length)
+        {
+            size_t nalLength = readUint16(payload + offset);
+            offset += 2;
+            if (offset + nalLength > length)
+            {
+                m_isAccessUnitBroken = true;
+                break;
+            }
+            appendNal(payload + offset, nalLength);
+            offset += nalLength;
+        }
+    }
+    else if (nalType == H264_NAL_FU_A && length > 2)
+    {
+        // 一个NAL单元被分成多个包
+        uint8_t fuHeader = payload[1];
+        bool isStart = (fuHeader & 0x80) != 0;
+        bool isEnd = (fuHeader & 0x40) != 0;
+
+        if (isStart)
+        {
+            // 用FU indicator的F/NRI和FU header的类型还原NAL头
+            uint8_t nalHeader = (payload[0] & 0xE0) | (fuHeader & 0x1F);
+            appendNal(&nalHeader, 1);
+            m_isInFragment = true;
+        }
+        else if (!m_isInFragment)
+        {
+            // 分片的开头丢了
+            m_isAccessUnitBroken = true;
+        }
+
+        if (m_isInFragment)
+        {
+            size_t needLength = m_accessUnitLength + length - 2;
+            if (m_accessUnit.size() < needLength)
+            {
+                m_accessUnit.resize(needLength * 2);
+            }
+            memcpy(m_accessUnit.data() + m_accessUnitLength, payload + 2, length - 2);
+            m_accessUnitLength = needLength;
+        }
+
+        if (isEnd)
+        {
+            m_isInFragment = false;
+        }
+    }
+    else
+    {
+        m_stats.m_invalidPackets++;
+    }
+
+    // marker表示这是一帧的最后一个包
+    if (packet.m_marker)
+    {
+        flushAccessUnit(callback);
+    }
+}
+
+// 加上起始码追加到正在组装的帧里
+void RtpReceiver::appendNal(const uint8_t *data, size_t length)
+{
+    size_t needLength = m_accessUnitLength + sizeof(H264_START_CODE) + length;
+    if (m_accessUnit.size() < needLength)
+    {
+        m_accessUnit.resize(needLength * 2);
+    }
+
+    memcpy(m_accessUnit.data() + m_accessUnitLength, H264_START_CODE, sizeof(H264_START_CODE));
+    memcpy(m_accessUnit.data() + m_accessUnitLength + sizeof(H264_START_CODE), data, length);
+    m_accessUnitLength = needLength;
+}
+
+void RtpReceiver::flushAccessUnit(const accessUnitCallback &callback)
+{
+    if (m_hasAccessUnit)
+    {
+        if (m_isAccessUnitBroken || m_isInFragment || m_accessUnitLength == 0)
+        {
+            m_stats.m_brokenAccessUnits++;
+            m_isPendingLoss = true;
+        }
+        else
+        {
+            AVBufferRef *buffer = m_pPacketPool->acquire(m_accessUnitLength);
+            if (buffer != nullptr)
+            {
+                memcpy(buffer->data, m_accessUnit.data(), m_accessUnitLength);
+                m_stats.m_accessUnits++;
+                callback(buffer, m_accessUnitLength, m_isPendingLoss);
+                m_isPendingLoss = false;
+            }
+        }
+    }
+
+    m_hasAccessUnit = false;
+    m_accessUnitLength = 0;
+    m_isAccessUnitBroken = false;
+    m_isInFragment = false;
+}
@@ -0,0 +1,78 @@
+#ifndef RTPRECEIVER_H
+#define RTPRECEIVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "jitterbuffer.h"
+#include "packetbufferpool.h"
+
+// RTP固定头部长度
+#define RTP_HEADER_SIZE 12
+// RTCP反馈包类型(RFC 4585)，FMT为1表示Generic NACK
+#define RTCP_PT_RTPFB 205
+#define RTCP_FMT_GENERIC_NACK 1
+
+// 输出一个完整的帧(Annex B格式)，isAfterLoss表示前面有数据丢失，需要等待IDR
+using accessUnitCallback = std::function<void(AVBufferRef *buffer, size_t length, bool isAfterLoss)>;
+
+struct RtpReceiverStats
+{
+    uint64_t m_invalidPackets = 0;
+    uint64_t m_accessUnits = 0;
+    uint64_t m_brokenAccessUnits = 0; // 因为丢包不完整而丢弃的帧
+};
+
+// RTP/H.264接收端
+// 负责解析RTP头、经过抖动缓冲区排序、按RFC 6184把单NAL/STAP-A/FU-A包还原成完整的帧
+// 以及生成请求重传的RTCP NACK包
+class RtpReceiver
+{
+public:
+    explicit RtpReceiver(PacketBufferPool *pPacketPool);
+
+    void setLatency(int latencyMs);
+
+    // 处理收到的一个UDP数据报
+    void pushDatagram(const uint8_t *data, size_t length, JitterBuffer::Clock::time_point now);
+
+    // 从抖动缓冲区里取出已经可以输出的包，组装成帧后回调
+    void process(JitterBuffer::Clock::time_point now, const accessUnitCallback &callback);
+
+    // 生成NACK包写入packet，不需要请求重传时返回0
+    size_t buildNackPacket(std::vector<uint8_t> &packet, JitterBuffer::Clock::time_point now);
+
+    void reset();
+
+    const JitterBufferStats &jitterStats() const;
+    const RtpReceiverStats &stats() const;
+
+private:
+    void depacketize(const RtpPacket &packet, const accessUnitCallback &callback);
+    void appendNal(const uint8_t *data, size_t length);
+    void flushAccessUnit(const accessUnitCallback &callback);
+
+private:
+    JitterBuffer m_jitterBuffer;
+    PacketBufferPool *m_pPacketPool = nullptr;
+
+    // 正在组装的帧，容量只增不减，稳定后不再分配
+    std::vector<uint8_t> m_accessUnit;
+    size_t m_accessUnitLength = 0;
+    uint32_t m_accessUnitTimestamp = 0;
+    bool m_hasAccessUnit = false;
+    bool m_isAccessUnitBroken = false;
+    bool m_isInFragment = false;
+    // 有帧因为丢包被丢弃，下一个输出的帧需要带上丢包标记
+    bool m_isPendingLoss = false;
+
+    uint32_t m_localSSRC = 0;
+    uint32_t m_remoteSSRC = 0;
+    std::vector<uint16_t> m_nackSequences;
+
+    RtpReceiverStats m_stats;
+};
+
+#endif // RTPRECEIVER_H
@@ -0,0 +1,124 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 避免生产者和消费者的位置落在同一个缓存行里互相干扰
+#define SPSC_CACHE_LINE_SIZE 64
+
+// 有界的无锁队列，一个线程入队，一个线程出队
+// 每个槽位带一个序号(Vyukov的做法)，用序号判断槽位是空的还是满的，不需要读对方的位置
+// 出队用CAS推进位置，这样队列满时生产者也可以自己取出最老的元素丢掉，和消费者同时出队也是安全的
+template <typename T>
+class SpscQueue
+{
+public:
+    // 容量向上取整到2的幂
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t roundedCapacity = 2;
+        while (roundedCapacity < capacity)
+        {
+            roundedCapacity <<= 1;
+        }
+
+        m_mask = roundedCapacity - 1;
+        m_cells = std::vector<Cell>(roundedCapacity);
+        for (size_t i = 0; i < roundedCapacity; i++)
+        {
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // 只能在生产者线程调用，队列满时返回false
+    bool tryPush(T &&value)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell &cell = m_cells[pos & m_mask];
+        size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+
+        // 槽位的序号等于入队位置说明已经被取走，可以写入；否则是上一圈的数据还没取
+        if (static_cast<intptr_t>(sequence - pos) < 0)
+        {
+            return false;
+        }
+
+        cell.m_data = std::move(value);
+        cell.m_sequence.store(pos + 1, std::memory_order_release);
+        m_enqueuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 消费者线程调用，队列满时生产者线程也可以调用，队列为空时返回false
+    bool tryPop(T &value)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = m_cells[pos & m_mask];
+            size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.m_data);
+                    // 序号推进一圈，表示这个槽位可以给下一圈入队使用
+                    cell.m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                // 被另一个线程抢先取走了，重新读位置
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool isEmpty() const
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        const Cell &cell = m_cells[pos & m_mask];
+        return cell.m_sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // 近似的元素个数，只用于统计
+    size_t size() const
+    {
+        size_t enqueuePos = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeuePos = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueuePos >= dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> m_sequence{0};
+        T m_data{};
+    };
+
+private:
+    std::vector<Cell> m_cells;
+    size_t m_mask = 0;
+
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> m_enqueuePos{0};
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> m_dequeuePos{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,397 @@
+#include "streamreassembler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 消息头标识，包括结尾的'\0'，两个版本的前4个字节相同
+static const char STREAM_HEADER_MAGIC[6] = {'A', 'L', 'I', 'V', 'E', '\0'};
+static const char STREAM_HEADER_MAGIC_V2[6] = {'A', 'L', 'I', 'V', '2', '\0'};
+
+StreamReassembler::StreamReassembler(size_t capacity)
+{
+    grow(capacity);
+}
+
+uint8_t *StreamReassembler::writePointer()
+{
+    return m_buffer.data() + m_writePos;
+}
+
+size_t StreamReassembler::writableLength()
+{
+    // 数据都处理完了，直接回到开头，不需要搬移
+    if (m_readPos == m_writePos)
+    {
+        m_readPos = 0;
+        m_writePos = 0;
+    }
+
+    // 当前消息至少还需要多少空间
+    size_t needLength = m_pendingFrameLength != 0 ? m_pendingFrameLength : STREAM_HEADER_V2_SIZE;
+    if (needLength > m_capacity)
+    {
+        // 留出余量，大消息后面跟着的小消息不用每次都搬移
+        grow(needLength * 2);
+    }
+
+    // 尾部剩余空间放不下当前消息就把未读的数据搬到开头
+    if (m_capacity - m_readPos < needLength || m_writePos == m_capacity)
+    {
+        compact();
+    }
+
+    return m_capacity - m_writePos;
+}
+
+void StreamReassembler::commitWrite(size_t length)
+{
+    m_writePos += length;
+
+    m_readCount++;
+    m_bytesReceived += length;
+}
+
+bool StreamReassembler::nextMessage(StreamMessage &message)
+{
+    // 先丢掉未知类型消息还没收完的负载
+    if (m_skipRemaining > 0)
+    {
+        size_t skipLength = std::min(m_skipRemaining, m_writePos - m_readPos);
+        m_readPos += skipLength;
+        m_skipRemaining -= skipLength;
+        if (m_skipRemaining > 0)
+        {
+            return false;
+        }
+    }
+
+    while (m_writePos - m_readPos >= sizeof(NetMessageHeader))
+    {
+        const uint8_t *frameData = m_buffer.data() + m_readPos;
+
+        // 缓冲区里的消息头不一定对齐，拷贝出来再用
+        memcpy(&message.m_header, frameData, sizeof(NetMessageHeader));
+
+        // 消息头不可信，说明流已经错位了，往后找下一个合法的消息头
+        if (!isValidHeader(message.m_header))
+        {
+            if (!resync())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        // v2消息头后面的扩展字段还没收完
+        size_t headerLength = headerVersion(frameData) == PROTOCOL_VERSION_2 ? STREAM_HEADER_V2_SIZE : STREAM_HEADER_V1_SIZE;
+        if (m_writePos - m_readPos < headerLength)
+        {
+            return false;
+        }
+
+        if (m_isResyncing)
+        {
+            finishResync();
+        }
+
+        // 未知类型的消息按声明的长度整个跳过，不需要等它收完
+        if (!isKnownMessageType(message.m_header))
+        {
+            size_t frameLength = headerLength + message.m_header.m_length;
+            size_t skipLength = std::min(frameLength, m_writePos - m_readPos);
+            m_readPos += skipLength;
+            m_skipRemaining = frameLength - skipLength;
+            m_pendingFrameLength = 0;
+            m_unknownMessages++;
+            m_bytesSkipped += frameLength;
+            if (m_skipRemaining > 0)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        m_pendingHeaderLength = headerLength;
+        m_pendingFrameLength = headerLength + message.m_header.m_length;
+        if (m_writePos - m_readPos < m_pendingFrameLength)
+        {
+            return false;
+        }
+
+        parseHeader(frameData, message);
+        message.m_payload = frameData + headerLength;
+
+        m_readPos += m_pendingFrameLength;
+        m_pendingFrameLength = 0;
+        m_messageCount++;
+        return true;
+    }
+
+    return false;
+}
+
+bool StreamReassembler::pendingPayload(StreamMessage &message, size_t &bufferedLength) const
+{
+    if (m_pendingFrameLength == 0)
+    {
+        return false;
+    }
+
+    parseHeader(m_buffer.data() + m_readPos, message);
+    message.m_payload = nullptr;
+    bufferedLength = m_writePos - m_readPos - m_pendingHeaderLength;
+    return true;
+}
+
+size_t StreamReassembler::takePendingPayload(uint8_t *dst)
+{
+    size_t bufferedLength = m_writePos - m_readPos - m_pendingHeaderLength;
+    memcpy(dst, m_buffer.data() + m_readPos + m_pendingHeaderLength, bufferedLength);
+
+    m_readPos = m_writePos;
+    m_pendingFrameLength = 0;
+    m_messageCount++;
+    return bufferedLength;
+}
+
+void StreamReassembler::setMaxMessageLength(size_t maxMessageLength)
+{
+    m_maxMessageLength = maxMessageLength;
+}
+
+bool StreamReassembler::takeDiscontinuity()
+{
+    bool isDiscontinuity = m_isDiscontinuity;
+    m_isDiscontinuity = false;
+    return isDiscontinuity;
+}
+
+void StreamReassembler::reset()
+{
+    m_readPos = 0;
+    m_writePos = 0;
+    m_pendingFrameLength = 0;
+    m_pendingHeaderLength = 0;
+    m_skipRemaining = 0;
+    m_isResyncing = false;
+    m_isDiscontinuity = false;
+}
+
+ReassemblerStats StreamReassembler::stats() const
+{
+    ReassemblerStats stats;
+    stats.m_readCount = m_readCount.load(std::memory_order_relaxed);
+    stats.m_bytesReceived = m_bytesReceived.load(std::memory_order_relaxed);
+    stats.m_messageCount = m_messageCount.load(std::memory_order_relaxed);
+    stats.m_invalidHeaders = m_invalidHeaders.load(std::memory_order_relaxed);
+    stats.m_oversizedHeaders = m_oversizedHeaders.load(std::memory_order_relaxed);
+    stats.m_compactCount = m_compactCount.load(std::memory_order_relaxed);
+    stats.m_compactBytes = m_compactBytes.load(std::memory_order_relaxed);
+    stats.m_growCount = m_growCount.load(std::memory_order_relaxed);
+    stats.m_unknownMessages = m_unknownMessages.load(std::memory_order_relaxed);
+    stats.m_resyncCount = m_resyncCount.load(std::memory_order_relaxed);
+    stats.m_bytesSkipped = m_bytesSkipped.load(std::memory_order_relaxed);
+    stats.m_lastResyncMicros = m_lastResyncMicros.load(std::memory_order_relaxed);
+    stats.m_maxResyncMicros = m_maxResyncMicros.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool StreamReassembler::isValidHeader(const NetMessageHeader &header)
+{
+    // 标识包括结尾的'\0'一共6个字节都要匹配
+    if (headerVersion(reinterpret_cast<const uint8_t *>(header.m_headerID)) == 0)
+    {
+        m_invalidHeaders++;
+        return false;
+    }
+
+    if (header.m_length > m_maxMessageLength)
+    {
+        m_oversizedHeaders++;
+        return false;
+    }
+
+    // 找同步点时要求类型也合法，减少把负载里的字节误认为消息头的可能
+    if (m_isResyncing && !isKnownMessageType(header))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// 根据标识判断消息头的版本，不是合法的标识返回0
+int StreamReassembler::headerVersion(const uint8_t *data)
+{
+    if (memcmp(data, STREAM_HEADER_MAGIC, sizeof(STREAM_HEADER_MAGIC)) == 0)
+    {
+        return PROTOCOL_VERSION_1;
+    }
+
+    if (memcmp(data, STREAM_HEADER_MAGIC_V2, sizeof(STREAM_HEADER_MAGIC_V2)) == 0)
+    {
+        return PROTOCOL_VERSION_2;
+    }
+
+    return 0;
+}
+
+// 从缓冲区里拷贝出消息头，调用前已经确认整个消息头都在缓冲区里
+void StreamReassembler::parseHeader(const uint8_t *frameData, StreamMessage &message) const
+{
+    memcpy(&message.m_header, frameData, sizeof(NetMessageHeader));
+    message.m_length = message.m_header.m_length;
+    message.m_version = headerVersion(frameData);
+    if (message.m_version == PROTOCOL_VERSION_2)
+    {
+        memcpy(&message.m_extension, frameData + sizeof(NetMessageHeader), sizeof(NetMessageHeaderExt));
+    }
+    else
+    {
+        message.m_extension = NetMessageHeaderExt();
+    }
+}
+
+bool StreamReassembler::isKnownMessageType(const NetMessageHeader &header) const
+{
+    if (header.m_msgType == MSGHEADER_TYPE_KEEPALIVE)
+    {
+        return true;
+    }
+
+    return header.m_msgType == MSGHEADER_TYPE_STREAM && (header.m_subType == MSGHEADER_STREAM_VIDEO || header.m_subType == MSGHEADER_STREAM_AUDIO);
+}
+
+bool StreamReassembler::resync()
+{
+    if (!m_isResyncing)
+    {
+        m_isResyncing = true;
+        m_resyncStartTime = std::chrono::steady_clock::now();
+        m_resyncCount++;
+    }
+    m_pendingFrameLength = 0;
+
+    // 从下一个字节开始找标识
+    size_t searchPos = m_readPos + 1;
+    size_t searchLength = m_writePos - searchPos;
+    size_t offset = findHeaderMagic(m_buffer.data() + searchPos, searchLength);
+    if (offset < searchLength)
+    {
+        m_bytesSkipped += searchPos + offset - m_readPos;
+        m_readPos = searchPos + offset;
+        return true;
+    }
+
+    // 没找到，末尾不足一个标识长度的字节可能是下一个标识的开头，先留着
+    size_t keepLength = std::min(searchLength, sizeof(STREAM_HEADER_MAGIC) - 1);
+    size_t newReadPos = m_writePos - keepLength;
+    m_bytesSkipped += newReadPos - m_readPos;
+    m_readPos = newReadPos;
+    return false;
+}
+
+void StreamReassembler::finishResync()
+{
+    m_isResyncing = false;
+    m_isDiscontinuity = true;
+
+    auto resyncTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_resyncStartTime).count();
+    m_lastResyncMicros.store(resyncTime, std::memory_order_relaxed);
+    if (static_cast<uint64_t>(resyncTime) > m_maxResyncMicros.load(std::memory_order_relaxed))
+    {
+        m_maxResyncMicros.store(resyncTime, std::memory_order_relaxed);
+    }
+}
+
+// 在data里找完整的消息头标识(任意版本)，返回偏移，找不到返回length
+size_t StreamReassembler::findHeaderMagic(const uint8_t *data, size_t length)
+{
+    const size_t magicLength = sizeof(STREAM_HEADER_MAGIC);
+    if (length < magicLength)
+    {
+        return length;
+    }
+    size_t lastPos = length - magicLength;
+    size_t pos = 0;
+
+#ifdef __SSE2__
+    // 一次比较16个位置的前三个字节，三个都匹配的位置再完整比较
+    const __m128i firstChar = _mm_set1_epi8(STREAM_HEADER_MAGIC[0]);
+    const __m128i secondChar = _mm_set1_epi8(STREAM_HEADER_MAGIC[1]);
+    const __m128i thirdChar = _mm_set1_epi8(STREAM_HEADER_MAGIC[2]);
+    while (pos + 16 + 2 <= length && pos + 15 <= lastPos)
+    {
+        __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 1));
+        __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 2));
+        __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(block0, firstChar), _mm_cmpeq_epi8(block1, secondChar)), _mm_cmpeq_epi8(block2, thirdChar));
+
+        int mask = _mm_movemask_epi8(match);
+        while (mask != 0)
+        {
+            int bit = __builtin_ctz(mask);
+            if (headerVersion(data + pos + bit) != 0)
+            {
+                return pos + bit;
+            }
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#endif
+
+    // 剩下的部分用memchr找首字节，glibc的memchr本身也是向量化的
+    while (pos <= lastPos)
+    {
+        const void *found = memchr(data + pos, STREAM_HEADER_MAGIC[0], lastPos - pos + 1);
+        if (found == nullptr)
+        {
+            break;
+        }
+
+        pos = static_cast<const uint8_t *>(found) - data;
+        if (headerVersion(data + pos) != 0)
+        {
+            return pos;
+        }
+        pos++;
+    }
+
+    return length;
+}
+
+void StreamReassembler::compact()
+{
+    size_t unreadLength = m_writePos - m_readPos;
+    if (m_readPos == 0)
+    {
+        return;
+    }
+
+    // 剩下的通常只有半个消息，搬移量很小
+    memmove(m_buffer.data(), m_buffer.data() + m_readPos, unreadLength);
+    m_readPos = 0;
+    m_writePos = unreadLength;
+
+    m_compactCount++;
+    m_compactBytes += unreadLength;
+}
+
+void StreamReassembler::grow(size_t capacity)
+{
+    // 先搬到开头再扩容，避免拷贝已经读过的数据
+    if (!m_buffer.empty())
+    {
+        compact();
+        m_growCount++;
+    }
+
+    m_capacity = capacity;
+    // 末尾留出填充，新增的部分是补零的
+    m_buffer.resize(m_capacity + STREAM_BUFFER_PADDING, 0);
+}
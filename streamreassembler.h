@@ -0,0 +1,130 @@
+#ifndef STREAMREASSEMBLER_H
+#define STREAMREASSEMBLER_H
+
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "type.h"
+
+// 接收缓冲区默认大小，一次recv尽量多读，高码率下一次系统调用能收好几个消息
+#define STREAM_BUFFER_DEFAULT_CAPACITY (256 * 1024)
+// 缓冲区末尾额外留出的空间，解码器读取负载时可能会越界读一小段
+#define STREAM_BUFFER_PADDING 64
+// 两个版本消息头的长度
+#define STREAM_HEADER_V1_SIZE sizeof(NetMessageHeader)
+#define STREAM_HEADER_V2_SIZE (sizeof(NetMessageHeader) + sizeof(NetMessageHeaderExt))
+
+// 从缓冲区里解析出来的一个完整消息，负载是指向缓冲区内部的视图，不拷贝
+struct StreamMessage
+{
+    NetMessageHeader m_header;
+    int m_version = PROTOCOL_VERSION_1;
+    NetMessageHeaderExt m_extension = {}; // 只有v2的消息有效
+    const uint8_t *m_payload = nullptr;
+    size_t m_length = 0;
+};
+
+// 接收统计，用来对比每个消息平均需要几次recv
+struct ReassemblerStats
+{
+    uint64_t m_readCount = 0;     // 往缓冲区写入的次数(即recv调用次数)
+    uint64_t m_bytesReceived = 0;
+    uint64_t m_messageCount = 0;
+    uint64_t m_invalidHeaders = 0;
+    uint64_t m_oversizedHeaders = 0; // 长度超过上限的消息头
+    uint64_t m_compactCount = 0;  // 把未读完的数据搬到缓冲区开头的次数
+    uint64_t m_compactBytes = 0;
+    uint64_t m_growCount = 0;     // 缓冲区扩容次数，稳定运行时应该不再增长
+
+    uint64_t m_unknownMessages = 0;  // 按长度跳过的未知类型消息
+    uint64_t m_resyncCount = 0;      // 流错位后重新同步的次数
+    uint64_t m_bytesSkipped = 0;     // 重新同步和跳过未知消息丢掉的字节数
+    uint64_t m_lastResyncMicros = 0; // 最近一次从发现错位到找到合法消息头的耗时
+    uint64_t m_maxResyncMicros = 0;
+};
+
+// 按NetMessageHeader分帧的接收环形缓冲区
+// 读写位置在缓冲区里向后推进，尾部放不下当前消息时把剩下的半个消息搬回开头
+// 这样每个消息在缓冲区里都是连续的，可以直接把指针交给解码器
+// 遇到不可信的消息头时进入重新同步，向后搜索下一个合法的消息头，而不是一直错位下去
+class StreamReassembler
+{
+public:
+    explicit StreamReassembler(size_t capacity = STREAM_BUFFER_DEFAULT_CAPACITY);
+
+    // 返回可以写入的位置和长度，调用后之前取出的消息视图失效
+    uint8_t *writePointer();
+    size_t writableLength();
+    void commitWrite(size_t length);
+
+    // 取出下一个完整的消息，数据不够时返回false
+    bool nextMessage(StreamMessage &message);
+
+    // 消息头已经解析出来但负载还没收完时返回true，bufferedLength是缓冲区里已有的负载长度
+    // message里只填消息头和长度，负载指针为空
+    bool pendingPayload(StreamMessage &message, size_t &bufferedLength) const;
+    // 把缓冲区里这个消息已有的负载拷贝出去并从缓冲区里移除，剩下的负载由调用方直接读到自己的缓冲区
+    size_t takePendingPayload(uint8_t *dst);
+
+    // 消息头里的长度超过上限时当作无效消息头，缓冲区不会为它扩容
+    void setMaxMessageLength(size_t maxMessageLength);
+
+    // 重新同步后取出的第一个消息前面有数据丢失，返回true后标记清除
+    bool takeDiscontinuity();
+
+    // 丢弃缓冲区中所有数据，重新连接时调用
+    void reset();
+
+    // 计数器是原子的，可以在其他线程读取
+    ReassemblerStats stats() const;
+
+private:
+    bool isValidHeader(const NetMessageHeader &header);
+    static int headerVersion(const uint8_t *data);
+    void parseHeader(const uint8_t *frameData, StreamMessage &message) const;
+    bool isKnownMessageType(const NetMessageHeader &header) const;
+    // 跳到下一个可能的消息头，缓冲区里找不到时返回false
+    bool resync();
+    void finishResync();
+    static size_t findHeaderMagic(const uint8_t *data, size_t length);
+
+    void compact();
+    void grow(size_t capacity);
+
+private:
+    std::vector<uint8_t> m_buffer;
+    size_t m_capacity = 0;
+    size_t m_readPos = 0;
+    size_t m_writePos = 0;
+
+    // 已经解析出消息头的消息的总长度(消息头+负载)，0表示还没解析
+    size_t m_pendingFrameLength = 0;
+    size_t m_pendingHeaderLength = 0;
+    size_t m_maxMessageLength = DEFAULT_MAX_MESSAGE_SIZE;
+    // 未知类型消息还需要丢掉的字节数
+    size_t m_skipRemaining = 0;
+
+    bool m_isResyncing = false;
+    bool m_isDiscontinuity = false;
+    std::chrono::steady_clock::time_point m_resyncStartTime;
+
+    // 只在接收线程里写，其他线程通过stats读取
+    std::atomic<uint64_t> m_readCount{0};
+    std::atomic<uint64_t> m_bytesReceived{0};
+    std::atomic<uint64_t> m_messageCount{0};
+    std::atomic<uint64_t> m_invalidHeaders{0};
+    std::atomic<uint64_t> m_oversizedHeaders{0};
+    std::atomic<uint64_t> m_compactCount{0};
+    std::atomic<uint64_t> m_compactBytes{0};
+    std::atomic<uint64_t> m_growCount{0};
+    std::atomic<uint64_t> m_unknownMessages{0};
+    std::atomic<uint64_t> m_resyncCount{0};
+    std::atomic<uint64_t> m_bytesSkipped{0};
+    std::atomic<uint64_t> m_lastResyncMicros{0};
+    std::atomic<uint64_t> m_maxResyncMicros{0};
+};
+
+#endif // STREAMREASSEMBLER_H
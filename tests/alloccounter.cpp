@@ -0,0 +1,123 @@
+#include "alloccounter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+static std::atomic<uint64_t> s_count{0};
+static std::atomic<uint64_t> s_bytes{0};
+static std::atomic<uint64_t> s_largest{0};
+
+#if defined(PLATFORM_LINUX) && defined(__GLIBC__)
+
+static void recordAlloc(size_t size)
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    s_bytes.fetch_add(size, std::memory_order_relaxed);
+    uint64_t largest = s_largest.load(std::memory_order_relaxed);
+    while (size > largest && !s_largest.compare_exchange_weak(largest, size, std::memory_order_relaxed))
+    {
+    }
+}
+
+// glibc导出了这几个真正的实现，可执行文件里定义的malloc会替换掉所有动态库里对malloc的调用
+// free不需要替换，只统计申请
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    void *pointer = __libc_malloc(size);
+    if (pointer != nullptr)
+    {
+        recordAlloc(size);
+    }
+    return pointer;
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    void *pointer = __libc_calloc(count, size);
+    if (pointer != nullptr)
+    {
+        recordAlloc(count * size);
+    }
+    return pointer;
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+    void *newPointer = __libc_realloc(pointer, size);
+    if (newPointer != nullptr)
+    {
+        recordAlloc(size);
+    }
+    return newPointer;
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    void *pointer = __libc_memalign(alignment, size);
+    if (pointer != nullptr)
+    {
+        recordAlloc(size);
+    }
+    return pointer;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    void *result = memalign(alignment, size);
+    if (result == nullptr)
+    {
+        return ENOMEM;
+    }
+    *pointer = result;
+    return 0;
+}
+}
+
+bool isAllocCounterSupported()
+{
+    return true;
+}
+
+#else
+
+bool isAllocCounterSupported()
+{
+    return false;
+}
+
+#endif
+
+void resetAllocCounts()
+{
+    s_count.store(0, std::memory_order_relaxed);
+    s_bytes.store(0, std::memory_order_relaxed);
+    s_largest.store(0, std::memory_order_relaxed);
+}
+
+AllocCounts allocCounts()
+{
+    AllocCounts counts;
+    counts.m_count = s_count.load(std::memory_order_relaxed);
+    counts.m_bytes = s_bytes.load(std::memory_order_relaxed);
+    counts.m_largest = s_largest.load(std::memory_order_relaxed);
+    return counts;
+}
@@ -0,0 +1,21 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+// 统计整个进程实际的堆内存申请，包括FFmpeg内部的av_malloc和operator new
+// 在glibc上替换malloc系列函数实现，其他平台不支持，测试应该跳过相关的检查
+
+#include <cstdint>
+
+struct AllocCounts
+{
+    uint64_t m_count = 0;   // 成功申请的次数，realloc也算一次
+    uint64_t m_bytes = 0;   // 累计申请的字节数
+    uint64_t m_largest = 0; // 最大的一次申请
+};
+
+bool isAllocCounterSupported();
+// 清零，之后的allocCounts()只包含清零以后的申请
+void resetAllocCounts();
+AllocCounts allocCounts();
+
+#endif // ALLOCCOUNTER_H
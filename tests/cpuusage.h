@@ -0,0 +1,47 @@
+#ifndef CPUUSAGE_H
+#define CPUUSAGE_H
+
+// 性能测试里统计CPU时间和上下文切换，只在Linux上使用
+// 客户端和代替服务端的发送在同一个进程里，客户端的CPU时间 = 进程的 - 发送线程自己的
+
+#ifdef PLATFORM_LINUX
+
+#include <cstdint>
+
+#include <sys/resource.h>
+#include <time.h>
+
+struct CpuUsage
+{
+    double m_processSeconds = 0; // 进程所有线程的用户态加内核态时间
+    double m_threadSeconds = 0;  // 调用线程自己的CPU时间
+    int64_t m_contextSwitches = 0; // 进程所有线程主动和被动的上下文切换次数
+};
+
+inline CpuUsage cpuUsage()
+{
+    CpuUsage usage;
+    struct rusage processUsage;
+    if (getrusage(RUSAGE_SELF, &processUsage) == 0)
+    {
+        usage.m_processSeconds = processUsage.ru_utime.tv_sec + processUsage.ru_utime.tv_usec / 1e6 + processUsage.ru_stime.tv_sec + processUsage.ru_stime.tv_usec / 1e6;
+        usage.m_contextSwitches = processUsage.ru_nvcsw + processUsage.ru_nivcsw;
+    }
+
+    struct timespec threadTime;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &threadTime) == 0)
+    {
+        usage.m_threadSeconds = threadTime.tv_sec + threadTime.tv_nsec / 1e9;
+    }
+    return usage;
+}
+
+// 两次采样之间除了调用线程以外的CPU时间
+inline double otherThreadsCpuSeconds(const CpuUsage &start, const CpuUsage &end)
+{
+    return (end.m_processSeconds - start.m_processSeconds) - (end.m_threadSeconds - start.m_threadSeconds);
+}
+
+#endif // PLATFORM_LINUX
+
+#endif // CPUUSAGE_H
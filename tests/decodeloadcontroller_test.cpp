@@ -0,0 +1,178 @@
+// DecodeLoadController的状态转换测试，时间由测试传入，不需要真的解码也不需要等待
+// 全部通过返回0，否则返回1
+
+#include "../decodeloadcontroller.h"
+#include "testcommon.h"
+
+#include <cstdint>
+
+using Clock = DecodeLoadController::Clock;
+
+// 25帧每秒，每个包间隔10毫秒送进来，一个窗口正好50个包
+#define FRAME_INTERVAL_US 40000
+#define PACKET_INTERVAL_MS 10
+// 超过DECODE_LOAD_MAX_LAG_FRAMES个帧间隔的排队时间
+#define LAGGING_QUEUE_DELAY_US (FRAME_INTERVAL_US * (DECODE_LOAD_MAX_LAG_FRAMES + 1))
+
+// 从nowMs解码到untilMs，每个包的占用时间按busyRatio算，返回级别变化的次数
+static int run(DecodeLoadController &controller, int64_t &nowMs, int64_t untilMs, double busyRatio, int64_t queueDelayUs)
+{
+    int changes = 0;
+    while (nowMs < untilMs)
+    {
+        nowMs += PACKET_INTERVAL_MS;
+        int64_t busyUs = static_cast<int64_t>(busyRatio * PACKET_INTERVAL_MS * 1000);
+        if (controller.update(busyUs, queueDelayUs, FRAME_INTERVAL_US, Clock::time_point() + std::chrono::milliseconds(nowMs)))
+        {
+            changes++;
+        }
+    }
+    return changes;
+}
+
+// 一直过载时每隔DECODE_LOAD_ESCALATE_HOLD_MS降一级，降到只解关键帧为止
+static void testEscalateWhenBusy()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    // 第一个窗口结束时还没到降级的等待时间
+    CHECK(run(controller, nowMs, DECODE_LOAD_WINDOW_MS, 0.95, 0) == 0);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+    CHECK(controller.state().m_busyRatio > DECODE_LOAD_HIGH_RATIO);
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.95, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+
+    // 降级后半个等待时间内不再降级
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS + DECODE_LOAD_WINDOW_MS, 0.95, 0) == 0);
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS * 2, 0.95, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_NONREF);
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS * 3, 0.95, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_KEYFRAME_ONLY);
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS * 10, 0.95, 0) == 0);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_KEYFRAME_ONLY);
+}
+
+// 占用比例不高但包在队列里越积越多，也要降级
+static void testEscalateWhenLagging()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+    CHECK(controller.state().m_averageQueueDelayUs == LAGGING_QUEUE_DELAY_US);
+    CHECK(controller.state().m_frameIntervalUs == FRAME_INTERVAL_US);
+}
+
+// 只在估计上一级也有余量时才恢复，而且至少等DECODE_LOAD_RECOVER_HOLD_MS
+static void testRecoverOnlyWithHeadroom()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    // 占用比例0.95时降级，降级后是0.3，两级开销的比值按3.17估计
+    // 恢复后估计还是0.95，所以一直不恢复
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.95, 0) == 1);
+    int64_t changeMs = nowMs;
+    CHECK(run(controller, nowMs, changeMs + DECODE_LOAD_RECOVER_HOLD_MS * 3, 0.3, 0) == 0);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+
+    // 画面变简单以后估计恢复后是0.32，满足条件时马上恢复
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_WINDOW_MS, 0.1, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+}
+
+// 因为排队降级，降级前占用比例不高，等够恢复时间后恢复，之前不恢复
+static void testRecoverAfterHold()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    int64_t changeMs = nowMs;
+    CHECK(run(controller, nowMs, changeMs + DECODE_LOAD_RECOVER_HOLD_MS - DECODE_LOAD_WINDOW_MS, 0.2, 0) == 0);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+    CHECK(run(controller, nowMs, changeMs + DECODE_LOAD_RECOVER_HOLD_MS, 0.2, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+}
+
+// 队列里还有积压时不恢复，积压消化掉以后再恢复
+static void testNoRecoverWhileQueued()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_RECOVER_HOLD_MS * 2, 0.2, FRAME_INTERVAL_US) == 0);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_WINDOW_MS, 0.2, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+}
+
+// 恢复后一个恢复等待时间之内又降级，下次恢复的等待时间加倍；恢复后稳定下来再回到默认值
+static void testRecoverHoldDoubling()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_RECOVER_HOLD_MS, 0.2, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+    CHECK(controller.state().m_recoverHoldMs == DECODE_LOAD_RECOVER_HOLD_MS);
+
+    // 恢复得太早，又开始排队
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER);
+    CHECK(controller.state().m_recoverHoldMs == DECODE_LOAD_RECOVER_HOLD_MS * 2);
+
+    // 按加倍后的等待时间恢复
+    int64_t changeMs = nowMs;
+    CHECK(run(controller, nowMs, changeMs + DECODE_LOAD_RECOVER_HOLD_MS * 2 - DECODE_LOAD_WINDOW_MS, 0.2, 0) == 0);
+    CHECK(run(controller, nowMs, changeMs + DECODE_LOAD_RECOVER_HOLD_MS * 2, 0.2, 0) == 1);
+    CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+
+    // 恢复后稳定了一个等待时间
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_RECOVER_HOLD_MS * 2, 0.2, 0) == 0);
+    CHECK(controller.state().m_recoverHoldMs == DECODE_LOAD_RECOVER_HOLD_MS);
+}
+
+// 每次恢复后马上又降级，等待时间一直加倍到上限为止
+static void testRecoverHoldLimit()
+{
+    DecodeLoadController controller;
+    controller.reset(Clock::time_point());
+    int64_t nowMs = 0;
+
+    CHECK(run(controller, nowMs, DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+    CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_RECOVER_HOLD_MS, 0.2, 0) == 1);
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK(run(controller, nowMs, nowMs + DECODE_LOAD_ESCALATE_HOLD_MS, 0.3, LAGGING_QUEUE_DELAY_US) == 1);
+        CHECK(run(controller, nowMs, nowMs + controller.state().m_recoverHoldMs, 0.2, 0) == 1);
+        CHECK(controller.state().m_level == DECODE_LOAD_LEVEL_NORMAL);
+    }
+    CHECK(controller.state().m_recoverHoldMs == DECODE_LOAD_MAX_RECOVER_HOLD_MS);
+}
+
+int main()
+{
+    testEscalateWhenBusy();
+    testEscalateWhenLagging();
+    testRecoverOnlyWithHeadroom();
+    testRecoverAfterHold();
+    testNoRecoverWhileQueued();
+    testRecoverHoldDoubling();
+    testRecoverHoldLimit();
+
+    return testResult();
+}
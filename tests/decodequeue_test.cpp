@@ -0,0 +1,276 @@
+// DecodeQueue三种满队列策略的测试，解码线程比网络线程慢时
+// 阻塞策略不丢包，丢最老的策略保留最新的包，丢到IDR的策略丢包以后第一个收到的一定是关键帧
+// 每个包的缓冲区释放时计数，检查不管是被取走还是被丢掉，所有缓冲区最后都释放了
+// 全部通过返回0，否则返回1
+
+#include "../decodequeue.h"
+#include "testcommon.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define TEST_QUEUE_CAPACITY 4
+#define TEST_PACKET_COUNT 400
+#define TEST_GOP_SIZE 10
+#define TEST_PACKET_SIZE 64
+// 解码线程处理一个包的时间，比网络线程送包慢
+#define TEST_DECODE_DELAY_US 200
+
+static std::atomic<int> s_createdBuffers{0};
+static std::atomic<int> s_freedBuffers{0};
+
+static void freeBuffer(void *opaque, uint8_t *data)
+{
+    (void)opaque;
+    delete[] data;
+    s_freedBuffers++;
+}
+
+// m_pts记录包的序号
+static DecodeQueueItem makeItem(int64_t sequence, bool isKeyFrame)
+{
+    DecodeQueueItem item;
+    item.m_pBuffer = av_buffer_create(new uint8_t[TEST_PACKET_SIZE], TEST_PACKET_SIZE, freeBuffer, nullptr, 0);
+    item.m_length = TEST_PACKET_SIZE;
+    item.m_pts = sequence;
+    item.m_isKeyFrame = isKeyFrame;
+    s_createdBuffers++;
+    return item;
+}
+
+static bool isAllFreed()
+{
+    return s_createdBuffers == s_freedBuffers;
+}
+
+// 在另一个线程里慢慢取出所有包，直到队列关闭
+static std::thread startConsumer(DecodeQueue &queue, std::vector<DecodeQueueItem> &received)
+{
+    return std::thread([&queue, &received]() {
+        DecodeQueueItem item;
+        while (queue.pop(item))
+        {
+            av_buffer_unref(&item.m_pBuffer);
+            received.push_back(item);
+            std::this_thread::sleep_for(std::chrono::microseconds(TEST_DECODE_DELAY_US));
+        }
+    });
+}
+
+// 等解码线程把队列取空再关闭，否则关闭时还在队列里的包也会算作丢掉
+static void waitDrained(DecodeQueue &queue)
+{
+    while (queue.depth() != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+// 单线程：队列满时丢掉最老的，保留最新的几个
+static void testDropOldestFull()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_DROP_OLDEST);
+
+    for (int i = 0; i < TEST_QUEUE_CAPACITY; i++)
+    {
+        CHECK(queue.push(makeItem(i, i == 0)) == DECODE_QUEUE_PUSHED);
+    }
+    for (int i = TEST_QUEUE_CAPACITY; i < TEST_QUEUE_CAPACITY + 6; i++)
+    {
+        CHECK(queue.push(makeItem(i, false)) == DECODE_QUEUE_DROPPED);
+    }
+    CHECK(queue.depth() == TEST_QUEUE_CAPACITY);
+    CHECK(queue.stats().m_dropped == 6);
+
+    DecodeQueueItem item;
+    for (int i = 6; i < TEST_QUEUE_CAPACITY + 6; i++)
+    {
+        CHECK(queue.pop(item));
+        CHECK(item.m_pts == i);
+        av_buffer_unref(&item.m_pBuffer);
+    }
+    CHECK(queue.depth() == 0);
+    queue.close();
+    CHECK(isAllFreed());
+}
+
+// 单线程：队列满时普通帧把队列清空，IDR清空队列后留下来
+static void testDropToIdrFull()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_DROP_TO_IDR);
+
+    for (int i = 0; i < TEST_QUEUE_CAPACITY; i++)
+    {
+        CHECK(queue.push(makeItem(i, i == 0)) == DECODE_QUEUE_PUSHED);
+    }
+    CHECK(queue.push(makeItem(TEST_QUEUE_CAPACITY, false)) == DECODE_QUEUE_FLUSHED);
+    CHECK(queue.depth() == 0);
+    CHECK(queue.stats().m_dropped == TEST_QUEUE_CAPACITY + 1);
+
+    for (int i = 0; i < TEST_QUEUE_CAPACITY; i++)
+    {
+        CHECK(queue.push(makeItem(10 + i, false)) == DECODE_QUEUE_PUSHED);
+    }
+    CHECK(queue.push(makeItem(20, true)) == DECODE_QUEUE_DROPPED);
+    CHECK(queue.depth() == 1);
+
+    DecodeQueueItem item;
+    CHECK(queue.pop(item));
+    CHECK(item.m_pts == 20 && item.m_isKeyFrame);
+    av_buffer_unref(&item.m_pBuffer);
+    queue.close();
+    CHECK(isAllFreed());
+}
+
+// 关闭以后push失败并释放包，pop返回false
+static void testClosed()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_BLOCK);
+    CHECK(queue.push(makeItem(0, true)) == DECODE_QUEUE_PUSHED);
+    queue.close();
+
+    CHECK(queue.push(makeItem(1, false)) == DECODE_QUEUE_CLOSED);
+    DecodeQueueItem item;
+    CHECK(!queue.pop(item));
+    queue.clear();
+    CHECK(isAllFreed());
+}
+
+// 阻塞策略：网络线程等解码线程，一个包都不丢，顺序不变
+static void testBlockSlowConsumer()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_BLOCK);
+    std::vector<DecodeQueueItem> received;
+    std::thread consumer = startConsumer(queue, received);
+
+    bool isAllPushed = true;
+    for (int i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        isAllPushed = queue.push(makeItem(i, i % TEST_GOP_SIZE == 0)) == DECODE_QUEUE_PUSHED && isAllPushed;
+    }
+    waitDrained(queue);
+    queue.close();
+    consumer.join();
+
+    CHECK(isAllPushed);
+    CHECK(received.size() == TEST_PACKET_COUNT);
+    bool isOrdered = true;
+    for (size_t i = 0; i < received.size(); i++)
+    {
+        isOrdered = isOrdered && received[i].m_pts == static_cast<int64_t>(i);
+    }
+    CHECK(isOrdered);
+
+    DecodeQueueStats stats = queue.stats();
+    CHECK(stats.m_dropped == 0);
+    CHECK(stats.m_overflowCount > 0);
+    CHECK(stats.m_producerWaitUs > 0);
+    CHECK(stats.m_maxDepth <= TEST_QUEUE_CAPACITY);
+    CHECK(isAllFreed());
+    std::printf("block: %zu received, producer waited %llu us\n", received.size(), static_cast<unsigned long long>(stats.m_producerWaitUs));
+}
+
+// 丢最老的策略：网络线程从不等待，收到的包按顺序，收到的加上丢掉的等于送进去的
+static void testDropOldestSlowConsumer()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_DROP_OLDEST);
+    std::vector<DecodeQueueItem> received;
+    std::thread consumer = startConsumer(queue, received);
+
+    for (int i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        queue.push(makeItem(i, i % TEST_GOP_SIZE == 0));
+        std::this_thread::sleep_for(std::chrono::microseconds(TEST_DECODE_DELAY_US / 4));
+    }
+    waitDrained(queue);
+    queue.close();
+    consumer.join();
+
+    DecodeQueueStats stats = queue.stats();
+    bool isOrdered = true;
+    for (size_t i = 1; i < received.size(); i++)
+    {
+        isOrdered = isOrdered && received[i].m_pts > received[i - 1].m_pts;
+    }
+    CHECK(isOrdered);
+    CHECK(received.size() + stats.m_dropped == TEST_PACKET_COUNT);
+    CHECK(stats.m_dropped > 0);
+    CHECK(stats.m_producerWaitUs == 0);
+    // 最后一个包一定留下来
+    CHECK(!received.empty() && received.back().m_pts == TEST_PACKET_COUNT - 1);
+    CHECK(isAllFreed());
+    std::printf("drop oldest: %zu received, %llu dropped\n", received.size(), static_cast<unsigned long long>(stats.m_dropped));
+}
+
+// 丢到IDR的策略：网络线程像VideoClient一样，FLUSHED以后一直丢到下一个关键帧
+// 解码线程收到的包在序号不连续的地方，后一个一定是关键帧
+static void testDropToIdrSlowConsumer()
+{
+    DecodeQueue queue;
+    queue.open(TEST_QUEUE_CAPACITY, DECODE_QUEUE_POLICY_DROP_TO_IDR);
+    std::vector<DecodeQueueItem> received;
+    std::thread consumer = startConsumer(queue, received);
+
+    bool isWaitingKeyFrame = false;
+    int flushedCount = 0;
+    int skippedCount = 0;
+    for (int i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        bool isKeyFrame = i % TEST_GOP_SIZE == 0;
+        if (isWaitingKeyFrame && !isKeyFrame)
+        {
+            skippedCount++;
+            continue;
+        }
+        isWaitingKeyFrame = false;
+
+        if (queue.push(makeItem(i, isKeyFrame)) == DECODE_QUEUE_FLUSHED)
+        {
+            isWaitingKeyFrame = true;
+            flushedCount++;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(TEST_DECODE_DELAY_US / 4));
+    }
+    waitDrained(queue);
+    queue.close();
+    consumer.join();
+
+    DecodeQueueStats stats = queue.stats();
+    CHECK(flushedCount > 0);
+    CHECK(!received.empty() && received[0].m_isKeyFrame);
+    bool isGapAtKeyFrame = true;
+    for (size_t i = 1; i < received.size(); i++)
+    {
+        if (received[i].m_pts != received[i - 1].m_pts + 1)
+        {
+            isGapAtKeyFrame = isGapAtKeyFrame && received[i].m_isKeyFrame;
+        }
+    }
+    CHECK(isGapAtKeyFrame);
+    CHECK(received.size() + stats.m_dropped + skippedCount == TEST_PACKET_COUNT);
+    CHECK(isAllFreed());
+    std::printf("drop to IDR: %zu received, %llu dropped in the queue, %d skipped waiting for a key frame, %d flushes\n", received.size(),
+                static_cast<unsigned long long>(stats.m_dropped), skippedCount, flushedCount);
+}
+
+int main()
+{
+    testDropOldestFull();
+    testDropToIdrFull();
+    testClosed();
+    testBlockSlowConsumer();
+    testDropOldestSlowConsumer();
+    testDropToIdrSlowConsumer();
+
+    return testResult();
+}
@@ -0,0 +1,223 @@
+// H264Decoder三种解码配置的性能测试：默认(单线程)、低延迟(slice多线程)、高吞吐(frame多线程)
+// 先用FFmpeg里的H.264编码器生成1080p和4K的测试码流，再分别用三种配置解码
+// 打印每秒解出的帧数，以及每帧从送进解码器到输出的延迟
+// 检查每种配置都解出了所有帧，并且分辨率正确
+// 使用的FFmpeg没有H.264编码器(比如没有编译libx264)时跳过
+
+#include "../h264decoder.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+#define BENCH_GOP_SIZE 30
+#define BENCH_FRAME_RATE 30
+#define BENCH_BIT_RATE_PER_PIXEL 4
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult
+{
+    int m_frames = 0;
+    bool m_isSizeOk = true;
+    double m_fps = 0;
+    std::vector<int64_t> m_latenciesUs;
+};
+
+// 画面每帧平移的渐变，加上一块移动的方块，让编码器产生正常大小的P帧
+static void fillFrame(AVFrame *frame, int index)
+{
+    int blockX = index * 8 % frame->width;
+    for (int y = 0; y < frame->height; y++)
+    {
+        uint8_t *row = frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0];
+        for (int x = 0; x < frame->width; x++)
+        {
+            bool isBlock = x >= blockX && x < blockX + frame->width / 8 && y > frame->height / 3 && y < frame->height / 2;
+            row[x] = isBlock ? 235 : static_cast<uint8_t>((x + y + index * 4) & 0xFF);
+        }
+    }
+    for (int plane = 1; plane < 3; plane++)
+    {
+        for (int y = 0; y < frame->height / 2; y++)
+        {
+            uint8_t *row = frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane];
+            memset(row, 128 + (plane == 1 ? index % 16 : -(index % 16)), frame->width / 2);
+        }
+    }
+}
+
+static bool receivePackets(AVCodecContext *context, AVPacket *packet, std::vector<std::vector<uint8_t>> &packets)
+{
+    while (true)
+    {
+        int ret = avcodec_receive_packet(context, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        {
+            return true;
+        }
+        if (ret < 0)
+        {
+            return false;
+        }
+        packets.emplace_back(packet->data, packet->data + packet->size);
+        av_packet_unref(packet);
+    }
+}
+
+// 编码成Annex B格式的包，每个包一帧，没有编码器时返回空
+static std::vector<std::vector<uint8_t>> encodeStream(int width, int height, int frameCount)
+{
+    std::vector<std::vector<uint8_t>> packets;
+    const AVCodec *pCodec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (pCodec == nullptr)
+    {
+        return packets;
+    }
+
+    AVCodecContext *context = avcodec_alloc_context3(pCodec);
+    context->width = width;
+    context->height = height;
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+    context->time_base = AVRational{1, BENCH_FRAME_RATE};
+    context->framerate = AVRational{BENCH_FRAME_RATE, 1};
+    context->gop_size = BENCH_GOP_SIZE;
+    context->bit_rate = static_cast<int64_t>(width) * height * BENCH_BIT_RATE_PER_PIXEL;
+    // 只是生成测试数据，编码越快越好；不是libx264时这个选项不存在，设置失败也没关系
+    av_opt_set(context->priv_data, "preset", "ultrafast", 0);
+
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    bool isOk = avcodec_open2(context, pCodec, nullptr) == 0;
+    if (isOk)
+    {
+        frame->width = width;
+        frame->height = height;
+        frame->format = AV_PIX_FMT_YUV420P;
+        isOk = av_frame_get_buffer(frame, 0) == 0;
+    }
+
+    for (int i = 0; isOk && i < frameCount; i++)
+    {
+        // 编码器可能还引用着上一帧的缓冲区
+        isOk = av_frame_make_writable(frame) == 0;
+        if (!isOk)
+        {
+            break;
+        }
+        fillFrame(frame, i);
+        frame->pts = i;
+        isOk = avcodec_send_frame(context, frame) == 0 && receivePackets(context, packet, packets);
+    }
+    if (isOk)
+    {
+        avcodec_send_frame(context, nullptr);
+        isOk = receivePackets(context, packet, packets);
+    }
+    if (!isOk)
+    {
+        packets.clear();
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&context);
+    return packets;
+}
+
+static BenchResult runBench(const std::vector<std::vector<uint8_t>> &packets, int width, int height, int profile)
+{
+    BenchResult result;
+    DecoderConfig config;
+    config.m_profile = profile;
+    // 测的是解码本身，不能因为跟不上而降级丢帧
+    config.m_isLoadShedding = false;
+    H264Decoder decoder(config);
+
+    // 每个包按序号作为pts送进去，解出的帧带着同一个pts，用来算这一帧的延迟
+    std::vector<Clock::time_point> sendTimes(packets.size());
+    auto callback = [&result, &sendTimes, width, height](YUVFrameData *yuvFrameData) {
+        result.m_frames++;
+        result.m_isSizeOk = result.m_isSizeOk && yuvFrameData->m_width == width && yuvFrameData->m_height == height;
+        if (yuvFrameData->pts >= 0 && static_cast<size_t>(yuvFrameData->pts) < sendTimes.size())
+        {
+            auto latency = Clock::now() - sendTimes[yuvFrameData->pts];
+            result.m_latenciesUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        }
+    };
+
+    auto startTime = Clock::now();
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        AVBufferRef *buffer = av_buffer_alloc(packets[i].size() + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(buffer->data, packets[i].data(), packets[i].size());
+        memset(buffer->data + packets[i].size(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        sendTimes[i] = Clock::now();
+        decoder.decodeH264Packet(buffer, packets[i].size(), static_cast<int64_t>(i), 0, callback);
+    }
+    decoder.flush(callback);
+    result.m_fps = result.m_frames / std::chrono::duration<double>(Clock::now() - startTime).count();
+
+    std::sort(result.m_latenciesUs.begin(), result.m_latenciesUs.end());
+    return result;
+}
+
+static double percentileMs(const std::vector<int64_t> &sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * percentile));
+    return sorted[index] / 1000.0;
+}
+
+static bool runResolution(const char *name, int width, int height, int frameCount)
+{
+    std::vector<std::vector<uint8_t>> packets = encodeStream(width, height, frameCount);
+    if (packets.empty())
+    {
+        return false;
+    }
+
+    const struct
+    {
+        const char *m_name;
+        int m_profile;
+    } profiles[] = {
+        {"default", DECODER_PROFILE_DEFAULT},
+        {"low latency", DECODER_PROFILE_LOW_LATENCY},
+        {"throughput", DECODER_PROFILE_THROUGHPUT},
+    };
+    for (const auto &profile : profiles)
+    {
+        BenchResult result = runBench(packets, width, height, profile.m_profile);
+        std::printf("%-5s %-11s %7.1f fps  latency p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n", name, profile.m_name, result.m_fps,
+                    percentileMs(result.m_latenciesUs, 0.5), percentileMs(result.m_latenciesUs, 0.99), percentileMs(result.m_latenciesUs, 1.0));
+        CHECK(result.m_frames == frameCount);
+        CHECK(result.m_isSizeOk);
+    }
+    return true;
+}
+
+int main()
+{
+    if (!runResolution("1080p", 1920, 1080, 90))
+    {
+        std::printf("skipped: this FFmpeg build has no usable H.264 encoder to generate the test streams\n");
+        return 0;
+    }
+    runResolution("4K", 3840, 2160, 30);
+
+    return testResult();
+}
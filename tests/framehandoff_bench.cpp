@@ -0,0 +1,173 @@
+// 解码器把帧交给使用方的开销对比，1080p和4K的yuv420p
+// 原来：每帧新建三个vector，逐行拷贝解码器的帧，渲染端再整块拷贝进上传缓冲区，一帧的数据拷贝两次
+// 现在：VideoFrame只引用解码器的帧，渲染端按行宽去掉行尾填充拷贝进上传缓冲区，一帧只拷贝一次
+// 打印每帧拷贝的字节数和耗时，检查引用的是同一块内存、源帧释放后引用仍然有效，两种方式得到的上传数据相同
+
+#include "../videoframe.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define BENCH_TOTAL_PIXELS (100LL * 1920 * 1080)
+
+// 原来type.h里的YUVChannel，每个分量自己持有一份紧凑存放的数据
+struct CopiedChannel
+{
+    std::vector<uint8_t> m_dataBuffer;
+    size_t m_length = 0;
+};
+
+struct CopiedFrame
+{
+    CopiedChannel m_channels[3];
+};
+
+struct BenchResult
+{
+    double m_frameUs = 0;
+    size_t m_bytesCopied = 0;
+};
+
+static AVFrame *allocFrame(int width, int height)
+{
+    AVFrame *frame = av_frame_alloc();
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if (av_frame_get_buffer(frame, 0) < 0)
+    {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    for (int plane = 0; plane < 3; plane++)
+    {
+        int planeHeight = plane == 0 ? height : height / 2;
+        for (int y = 0; y < planeHeight; y++)
+        {
+            memset(frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane], (y + plane * 50) & 0xFF, frame->linesize[plane]);
+        }
+    }
+    return frame;
+}
+
+static int planeWidth(const AVFrame *frame, int plane)
+{
+    return plane == 0 ? frame->width : frame->width / 2;
+}
+
+static int planeHeight(const AVFrame *frame, int plane)
+{
+    return plane == 0 ? frame->height : frame->height / 2;
+}
+
+// 按行拷贝，去掉行尾的对齐填充
+static size_t copyRows(const uint8_t *src, int linesize, int width, int height, uint8_t *dst)
+{
+    for (int y = 0; y < height; y++)
+    {
+        memcpy(dst + static_cast<size_t>(y) * width, src + static_cast<ptrdiff_t>(y) * linesize, width);
+    }
+    return static_cast<size_t>(width) * height;
+}
+
+// 原来的H264Decoder::copyFrameData加上OpenGLWidget::RendVideo里的memcpy
+static size_t handOffByCopy(const AVFrame *frame, std::vector<uint8_t> &uploadBuffer)
+{
+    size_t bytesCopied = 0;
+    CopiedFrame copiedFrame;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        CopiedChannel &channel = copiedFrame.m_channels[plane];
+        channel.m_length = static_cast<size_t>(planeWidth(frame, plane)) * planeHeight(frame, plane);
+        channel.m_dataBuffer.resize(channel.m_length);
+        bytesCopied += copyRows(frame->data[plane], frame->linesize[plane], planeWidth(frame, plane), planeHeight(frame, plane), channel.m_dataBuffer.data());
+    }
+
+    size_t offset = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        const CopiedChannel &channel = copiedFrame.m_channels[plane];
+        memcpy(uploadBuffer.data() + offset, channel.m_dataBuffer.data(), channel.m_length);
+        offset += channel.m_length;
+        bytesCopied += channel.m_length;
+    }
+    return bytesCopied;
+}
+
+// 现在的H264Decoder交出VideoFrame，渲染端从解码器的帧里直接按行拷贝
+static size_t handOffByReference(const AVFrame *frame, std::vector<uint8_t> &uploadBuffer)
+{
+    VideoFrame videoFrame(frame);
+    size_t bytesCopied = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        bytesCopied += copyRows(videoFrame.data(plane), videoFrame.linesize(plane), planeWidth(frame, plane), planeHeight(frame, plane),
+                                uploadBuffer.data() + bytesCopied);
+    }
+    return bytesCopied;
+}
+
+template <typename HandOff>
+static BenchResult measure(const AVFrame *frame, std::vector<uint8_t> &uploadBuffer, HandOff handOff)
+{
+    BenchResult result;
+    int frameCount = static_cast<int>(BENCH_TOTAL_PIXELS / (static_cast<int64_t>(frame->width) * frame->height));
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < frameCount; i++)
+    {
+        result.m_bytesCopied = handOff(frame, uploadBuffer);
+    }
+    result.m_frameUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+    return result;
+}
+
+// 引用的是解码器的那块内存；源帧释放以后，句柄仍然持有数据
+static void checkReference(AVFrame *frame)
+{
+    VideoFrame videoFrame(frame);
+    CHECK(videoFrame.isValid());
+    CHECK(videoFrame.data(0) == frame->data[0]);
+    CHECK(videoFrame.linesize(1) == frame->linesize[1]);
+
+    AVFrame *source = av_frame_clone(frame);
+    VideoFrame kept(source);
+    av_frame_free(&source);
+    CHECK(kept.isValid() && kept.data(2)[0] == frame->data[2][0]);
+}
+
+static void runBench(const char *name, int width, int height)
+{
+    AVFrame *frame = allocFrame(width, height);
+    CHECK(frame != nullptr);
+    if (frame == nullptr)
+    {
+        return;
+    }
+    checkReference(frame);
+
+    size_t frameBytes = static_cast<size_t>(width) * height * 3 / 2;
+    std::vector<uint8_t> copiedUpload(frameBytes);
+    std::vector<uint8_t> referencedUpload(frameBytes);
+    BenchResult copyResult = measure(frame, copiedUpload, handOffByCopy);
+    BenchResult referenceResult = measure(frame, referencedUpload, handOffByReference);
+    CHECK(copiedUpload == referencedUpload);
+    CHECK(copyResult.m_bytesCopied == 2 * frameBytes);
+    CHECK(referenceResult.m_bytesCopied == frameBytes);
+
+    std::printf("%-5s copy      %9zu bytes copied/frame  %8.1f us/frame\n", name, copyResult.m_bytesCopied, copyResult.m_frameUs);
+    std::printf("%-5s reference %9zu bytes copied/frame  %8.1f us/frame\n", name, referenceResult.m_bytesCopied, referenceResult.m_frameUs);
+    av_frame_free(&frame);
+}
+
+int main()
+{
+    runBench("1080p", 1920, 1080);
+    runBench("4K", 3840, 2160);
+
+    return testResult();
+}
@@ -0,0 +1,192 @@
+// FramePool的稳定状态测试，预热以后按解码的节奏反复分配和释放帧，不应该再申请内存
+// 除了FramePool自己的计数，还统计进程里实际的堆内存申请，FFmpeg内部的申请也算在内
+// 全部通过返回0，否则返回1
+
+#include "../framepool.h"
+#include "alloccounter.h"
+#include "testcommon.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+// 同时被引用的帧数，参考帧加上解码后排队等待显示的帧
+#define FRAMES_IN_FLIGHT 8
+#define STEADY_FRAME_COUNT 1000
+// 稳定以后每一帧只允许申请一个AVBufferRef这样的小对象，不能有帧数据大小的申请
+#define MAX_STEADY_ALLOC_SIZE 1024
+
+static AVCodecContext *createContext(int width, int height)
+{
+    AVCodecContext *context = avcodec_alloc_context3(nullptr);
+    if (context == nullptr)
+    {
+        return nullptr;
+    }
+    context->codec_type = AVMEDIA_TYPE_VIDEO;
+    context->codec_id = AV_CODEC_ID_H264;
+    context->width = width;
+    context->height = height;
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+    return context;
+}
+
+// 和解码器的get_buffer2一样，宽高和格式已经设置好再交给分配器
+static bool allocate(FramePool &framePool, AVCodecContext *context, AVFrame *frame, int width, int height)
+{
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if (!framePool.allocateFrame(context, frame))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (reinterpret_cast<uintptr_t>(frame->data[i]) % FRAME_PLANE_ALIGN != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 解码器输出一帧的同时释放最老的一帧，每隔几帧再缩小出一帧tile
+static void decodeFrames(FramePool &framePool, AVCodecContext *context, std::vector<AVFrame *> &frames, AVFrame *pTileFrame, int count, int &next)
+{
+    for (int i = 0; i < count; i++)
+    {
+        AVFrame *pFrame = frames[next];
+        next = (next + 1) % FRAMES_IN_FLIGHT;
+
+        av_frame_unref(pFrame);
+        CHECK(allocate(framePool, context, pFrame, context->width, context->height));
+
+        if (i % 4 == 0)
+        {
+            CHECK(allocate(framePool, nullptr, pTileFrame, 320, 180));
+            av_frame_unref(pTileFrame);
+        }
+    }
+}
+
+// 稳定以后实际的堆内存申请：每帧最多一个池里取块时的引用，没有大块的申请
+static void checkSteadyAllocs(const AllocCounts &counts, uint64_t frameCount)
+{
+    if (!isAllocCounterSupported())
+    {
+        return;
+    }
+
+    std::printf("steady state: %llu allocations, %llu bytes, largest %llu bytes for %llu frames\n",
+                static_cast<unsigned long long>(counts.m_count), static_cast<unsigned long long>(counts.m_bytes),
+                static_cast<unsigned long long>(counts.m_largest), static_cast<unsigned long long>(frameCount));
+    CHECK(counts.m_count <= frameCount);
+    CHECK(counts.m_largest <= MAX_STEADY_ALLOC_SIZE);
+}
+
+static void releaseFrames(std::vector<AVFrame *> &frames)
+{
+    for (AVFrame *&pFrame : frames)
+    {
+        av_frame_free(&pFrame);
+    }
+    frames.clear();
+}
+
+// 分辨率不变时，预热以后既不申请新的块也不创建新的池
+static void testSteadyState()
+{
+    FramePool framePool;
+    AVCodecContext *context = createContext(1920, 1080);
+    CHECK(context != nullptr);
+    if (context == nullptr)
+    {
+        return;
+    }
+
+    std::vector<AVFrame *> frames;
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+    {
+        frames.push_back(av_frame_alloc());
+    }
+    AVFrame *pTileFrame = av_frame_alloc();
+
+    int next = 0;
+    decodeFrames(framePool, context, frames, pTileFrame, FRAMES_IN_FLIGHT * 2, next);
+    FramePoolStats warmStats = framePool.stats();
+    CHECK(warmStats.m_poolCount == 2);
+    // 解码的帧最多同时被引用FRAMES_IN_FLIGHT个，释放后马上被下一帧复用，tile帧只需要一块
+    CHECK(warmStats.m_blockCount <= FRAMES_IN_FLIGHT + 2);
+
+    resetAllocCounts();
+    decodeFrames(framePool, context, frames, pTileFrame, STEADY_FRAME_COUNT, next);
+    AllocCounts steadyAllocs = allocCounts();
+    FramePoolStats steadyStats = framePool.stats();
+    CHECK(steadyStats.m_blockCount == warmStats.m_blockCount);
+    CHECK(steadyStats.m_allocatedBytes == warmStats.m_allocatedBytes);
+    CHECK(steadyStats.m_poolCount == warmStats.m_poolCount);
+    CHECK(steadyStats.m_frameCount - warmStats.m_frameCount == STEADY_FRAME_COUNT + STEADY_FRAME_COUNT / 4);
+    checkSteadyAllocs(steadyAllocs, steadyStats.m_frameCount - warmStats.m_frameCount);
+
+    av_frame_free(&pTileFrame);
+    releaseFrames(frames);
+    avcodec_free_context(&context);
+}
+
+// 两种分辨率来回切换，池的数量没有超过上限时两边的块都会保留下来
+static void testResolutionSwitch()
+{
+    FramePool framePool;
+    AVCodecContext *pHighContext = createContext(1920, 1080);
+    AVCodecContext *pLowContext = createContext(1280, 720);
+    CHECK(pHighContext != nullptr && pLowContext != nullptr);
+    if (pHighContext == nullptr || pLowContext == nullptr)
+    {
+        avcodec_free_context(&pHighContext);
+        avcodec_free_context(&pLowContext);
+        return;
+    }
+
+    std::vector<AVFrame *> frames;
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+    {
+        frames.push_back(av_frame_alloc());
+    }
+    AVFrame *pTileFrame = av_frame_alloc();
+
+    int next = 0;
+    decodeFrames(framePool, pHighContext, frames, pTileFrame, FRAMES_IN_FLIGHT * 2, next);
+    decodeFrames(framePool, pLowContext, frames, pTileFrame, FRAMES_IN_FLIGHT * 2, next);
+    FramePoolStats warmStats = framePool.stats();
+
+    resetAllocCounts();
+    for (int i = 0; i < 20; i++)
+    {
+        decodeFrames(framePool, i % 2 == 0 ? pHighContext : pLowContext, frames, pTileFrame, FRAMES_IN_FLIGHT * 2, next);
+    }
+    AllocCounts steadyAllocs = allocCounts();
+    FramePoolStats steadyStats = framePool.stats();
+    CHECK(steadyStats.m_blockCount == warmStats.m_blockCount);
+    CHECK(steadyStats.m_poolCount == warmStats.m_poolCount);
+    checkSteadyAllocs(steadyAllocs, steadyStats.m_frameCount - warmStats.m_frameCount);
+
+    av_frame_free(&pTileFrame);
+    releaseFrames(frames);
+    avcodec_free_context(&pHighContext);
+    avcodec_free_context(&pLowContext);
+}
+
+int main()
+{
+    testSteadyState();
+    testResolutionSwitch();
+
+    return testResult();
+}
@@ -0,0 +1,138 @@
+// FrameScaler的性能测试：720p、1080p、4K的yuv420p帧缩小到画面墙小窗口的320x180
+// 打印每帧的缩小时间、按每秒一个关键帧计算的每个小窗口的CPU占用，以及小窗口一帧和原图一帧的内存
+// 检查纯色的图缩小后颜色不变，并且按面积平均以后整幅图的平均亮度基本不变
+
+#include "../framescaler.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+}
+
+#define BENCH_TILE_WIDTH 320
+#define BENCH_TILE_HEIGHT 180
+// 每种分辨率一共缩小这么多像素，分辨率越高帧数越少
+#define BENCH_TOTAL_PIXELS (200LL * 1920 * 1080)
+// tile模式默认只解关键帧，按每秒一个关键帧估算每个小窗口的CPU
+#define BENCH_KEY_FRAMES_PER_SECOND 1
+
+static AVFrame *allocFrame(int width, int height)
+{
+    AVFrame *frame = av_frame_alloc();
+    frame->width = width;
+    frame->height = height;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if (av_frame_get_buffer(frame, 0) < 0)
+    {
+        av_frame_free(&frame);
+    }
+    return frame;
+}
+
+// 亮度是斜向的渐变，两个色度分量是常数
+static void fillFrame(AVFrame *frame)
+{
+    for (int y = 0; y < frame->height; y++)
+    {
+        uint8_t *row = frame->data[0] + static_cast<ptrdiff_t>(y) * frame->linesize[0];
+        for (int x = 0; x < frame->width; x++)
+        {
+            row[x] = static_cast<uint8_t>((x * 7 + y * 3) & 0xFF);
+        }
+    }
+    for (int plane = 1; plane < 3; plane++)
+    {
+        for (int y = 0; y < (frame->height + 1) / 2; y++)
+        {
+            uint8_t *row = frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane];
+            for (int x = 0; x < (frame->width + 1) / 2; x++)
+            {
+                row[x] = plane == 1 ? 90 : 200;
+            }
+        }
+    }
+}
+
+static double planeMean(const uint8_t *data, int linesize, int width, int height)
+{
+    double sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            sum += data[static_cast<ptrdiff_t>(y) * linesize + x];
+        }
+    }
+    return sum / (static_cast<double>(width) * height);
+}
+
+static bool isPlaneConstant(const uint8_t *data, int linesize, int width, int height, uint8_t value)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (data[static_cast<ptrdiff_t>(y) * linesize + x] != value)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void runBench(const char *name, int width, int height)
+{
+    AVFrame *src = allocFrame(width, height);
+    AVFrame *dst = allocFrame(BENCH_TILE_WIDTH, BENCH_TILE_HEIGHT);
+    CHECK(src != nullptr && dst != nullptr);
+    if (src == nullptr || dst == nullptr)
+    {
+        av_frame_free(&src);
+        av_frame_free(&dst);
+        return;
+    }
+    fillFrame(src);
+
+    FrameScaler scaler;
+    CHECK(scaler.scale(src, dst));
+
+    // 第一次缩小时分配中间缓冲区和权重表，不计时
+    int frameCount = static_cast<int>(BENCH_TOTAL_PIXELS / (static_cast<int64_t>(width) * height));
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < frameCount; i++)
+    {
+        scaler.scale(src, dst);
+    }
+    double frameUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+
+    double srcMean = planeMean(src->data[0], src->linesize[0], width, height);
+    double dstMean = planeMean(dst->data[0], dst->linesize[0], BENCH_TILE_WIDTH, BENCH_TILE_HEIGHT);
+    CHECK(std::fabs(srcMean - dstMean) < 1.0);
+    CHECK(isPlaneConstant(dst->data[1], dst->linesize[1], BENCH_TILE_WIDTH / 2, BENCH_TILE_HEIGHT / 2, 90));
+    CHECK(isPlaneConstant(dst->data[2], dst->linesize[2], BENCH_TILE_WIDTH / 2, BENCH_TILE_HEIGHT / 2, 200));
+
+    int srcBytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, 1);
+    int tileBytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, BENCH_TILE_WIDTH, BENCH_TILE_HEIGHT, 1);
+    std::printf("%-6s -> %dx%d  %8.1f us/frame  %6.3f%% of a core per tile at %d key frame/s  tile frame %d bytes, source frame %d bytes  (luma mean %.2f -> %.2f)\n",
+                name, BENCH_TILE_WIDTH, BENCH_TILE_HEIGHT, frameUs, frameUs * BENCH_KEY_FRAMES_PER_SECOND / 1e4, BENCH_KEY_FRAMES_PER_SECOND,
+                tileBytes, srcBytes, srcMean, dstMean);
+
+    av_frame_free(&src);
+    av_frame_free(&dst);
+}
+
+int main()
+{
+    runBench("720p", 1280, 720);
+    runBench("1080p", 1920, 1080);
+    runBench("4K", 3840, 2160);
+
+    return testResult();
+}
@@ -0,0 +1,192 @@
+// JitterBuffer的测试：乱序、丢包超时跳过、16位序号回绕、重传请求的时机
+// 序号扩展是私有的，通过insert和pop的结果检查；时间由测试传入
+// 全部通过返回0，否则返回1
+
+#include "../jitterbuffer.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using Clock = JitterBuffer::Clock;
+
+#define TEST_LATENCY_MS 100
+
+static Clock::time_point at(int64_t ms)
+{
+    return Clock::time_point() + std::chrono::milliseconds(ms);
+}
+
+// 负载的第一个字节是序号的低8位，用来确认取出来的是哪个包
+static bool insert(JitterBuffer &jitterBuffer, uint16_t sequence, int64_t ms)
+{
+    uint8_t payload[4] = {static_cast<uint8_t>(sequence & 0xFF), 0x11, 0x22, 0x33};
+    return jitterBuffer.insert(sequence, sequence * 3000u, false, payload, sizeof(payload), at(ms));
+}
+
+// 取出现在能取的所有包，返回它们的16位序号
+static std::vector<uint16_t> popAll(JitterBuffer &jitterBuffer, int64_t ms, std::vector<bool> *pLossFlags = nullptr)
+{
+    std::vector<uint16_t> sequences;
+    RtpPacket packet;
+    bool isAfterLoss = false;
+    while (jitterBuffer.pop(packet, isAfterLoss, at(ms)))
+    {
+        uint16_t sequence = static_cast<uint16_t>(packet.m_sequence & 0xFFFF);
+        sequences.push_back(sequence);
+        CHECK(packet.m_length == 4 && packet.m_payload[0] == (sequence & 0xFF));
+        if (pLossFlags != nullptr)
+        {
+            pLossFlags->push_back(isAfterLoss);
+        }
+    }
+    return sequences;
+}
+
+// 轻微乱序的包到了以后按序输出，不算丢包
+static void testReorder()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    CHECK(insert(jitterBuffer, 1, 0));
+    CHECK(insert(jitterBuffer, 3, 1));
+    CHECK((popAll(jitterBuffer, 1) == std::vector<uint16_t>{1}));
+
+    CHECK(insert(jitterBuffer, 2, 2));
+    CHECK(insert(jitterBuffer, 5, 3));
+    CHECK(insert(jitterBuffer, 4, 4));
+    std::vector<bool> lossFlags;
+    CHECK((popAll(jitterBuffer, 4, &lossFlags) == std::vector<uint16_t>{2, 3, 4, 5}));
+    CHECK((lossFlags == std::vector<bool>{false, false, false, false}));
+
+    // 重复的包和已经输出过的包都不再接收
+    CHECK(!insert(jitterBuffer, 5, 5));
+    CHECK(!insert(jitterBuffer, 2, 5));
+
+    const JitterBufferStats &stats = jitterBuffer.stats();
+    CHECK(stats.m_reordered == 2);
+    CHECK(stats.m_duplicated == 2);
+    CHECK(stats.m_lost == 0);
+}
+
+// 空洞后面的包等待超过延迟目标后跳过空洞，第一个输出的包带丢包标记
+static void testLossTimeout()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    CHECK(insert(jitterBuffer, 10, 0));
+    CHECK(insert(jitterBuffer, 13, 10));
+    CHECK(insert(jitterBuffer, 14, 11));
+    CHECK((popAll(jitterBuffer, 11) == std::vector<uint16_t>{10}));
+
+    // 13到达后还没等够延迟
+    CHECK(popAll(jitterBuffer, 10 + TEST_LATENCY_MS - 1).empty());
+
+    std::vector<bool> lossFlags;
+    CHECK((popAll(jitterBuffer, 10 + TEST_LATENCY_MS, &lossFlags) == std::vector<uint16_t>{13, 14}));
+    CHECK((lossFlags == std::vector<bool>{true, false}));
+    CHECK(jitterBuffer.stats().m_lost == 2);
+
+    // 跳过以后才到的包是过期的
+    CHECK(!insert(jitterBuffer, 11, 10 + TEST_LATENCY_MS + 1));
+    CHECK(jitterBuffer.stats().m_duplicated == 1);
+}
+
+// 序号从65535回绕到0，按序到达时连续输出，不会被当成很老的包或者很大的空洞
+static void testWraparound()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    std::vector<uint16_t> expected;
+    uint16_t sequence = 65530;
+    for (int i = 0; i < 12; i++)
+    {
+        CHECK(insert(jitterBuffer, sequence, i));
+        expected.push_back(sequence);
+        sequence++;
+    }
+
+    std::vector<bool> lossFlags;
+    CHECK(popAll(jitterBuffer, 12, &lossFlags) == expected);
+    CHECK(lossFlags == std::vector<bool>(expected.size(), false));
+    CHECK(jitterBuffer.stats().m_lost == 0);
+
+    // 回绕以后再来一个回绕前的序号是重复包
+    CHECK(!insert(jitterBuffer, 65535, 13));
+    CHECK(jitterBuffer.stats().m_duplicated == 1);
+}
+
+// 回绕的地方乱序，回绕后的包先到
+static void testWraparoundReorder()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    CHECK(insert(jitterBuffer, 65534, 0));
+    CHECK(insert(jitterBuffer, 0, 1));
+    CHECK(insert(jitterBuffer, 65535, 2));
+    CHECK(insert(jitterBuffer, 1, 3));
+
+    CHECK((popAll(jitterBuffer, 3) == std::vector<uint16_t>{65534, 65535, 0, 1}));
+    CHECK(jitterBuffer.stats().m_reordered == 1);
+    CHECK(jitterBuffer.stats().m_lost == 0);
+}
+
+// 缺失的包等NACK_REORDER_DELAY_MS后第一次请求，之后每NACK_RETRY_INTERVAL_MS一次，最多NACK_MAX_RETRIES次
+static void testNackTiming()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    CHECK(insert(jitterBuffer, 100, 0));
+    CHECK(insert(jitterBuffer, 102, 0));
+
+    std::vector<uint16_t> nacks;
+    jitterBuffer.collectNacks(nacks, at(NACK_REORDER_DELAY_MS - 1));
+    CHECK(nacks.empty());
+
+    int64_t ms = NACK_REORDER_DELAY_MS;
+    jitterBuffer.collectNacks(nacks, at(ms));
+    CHECK((nacks == std::vector<uint16_t>{101}));
+
+    nacks.clear();
+    jitterBuffer.collectNacks(nacks, at(ms + NACK_RETRY_INTERVAL_MS - 1));
+    CHECK(nacks.empty());
+
+    for (int retry = 1; retry < NACK_MAX_RETRIES; retry++)
+    {
+        ms += NACK_RETRY_INTERVAL_MS;
+        nacks.clear();
+        jitterBuffer.collectNacks(nacks, at(ms));
+        CHECK((nacks == std::vector<uint16_t>{101}));
+    }
+
+    nacks.clear();
+    jitterBuffer.collectNacks(nacks, at(ms + NACK_RETRY_INTERVAL_MS));
+    CHECK(nacks.empty());
+    CHECK(jitterBuffer.stats().m_nackSent == NACK_MAX_RETRIES);
+
+    // 重传的包在超时前到达，算作恢复，不算丢包
+    CHECK(insert(jitterBuffer, 101, ms + NACK_RETRY_INTERVAL_MS));
+    CHECK((popAll(jitterBuffer, ms + NACK_RETRY_INTERVAL_MS) == std::vector<uint16_t>{100, 101, 102}));
+    CHECK(jitterBuffer.stats().m_recovered == 1);
+    CHECK(jitterBuffer.stats().m_lost == 0);
+}
+
+// 超过延迟目标的缺失包已经没用了，不再请求
+static void testNackExpired()
+{
+    JitterBuffer jitterBuffer(TEST_LATENCY_MS);
+    CHECK(insert(jitterBuffer, 1, 0));
+    CHECK(insert(jitterBuffer, 3, 0));
+
+    std::vector<uint16_t> nacks;
+    jitterBuffer.collectNacks(nacks, at(TEST_LATENCY_MS));
+    CHECK(nacks.empty());
+}
+
+int main()
+{
+    testReorder();
+    testLossTimeout();
+    testWraparound();
+    testWraparoundReorder();
+    testNackTiming();
+    testNackExpired();
+
+    return testResult();
+}
@@ -0,0 +1,546 @@
+// 画面墙的性能测试：16路和64路320x180的yuv420p流画到1920x1080的帧缓冲里，排成网格
+// 原来：每路流一个OpenGLWidget，每个窗口三个纹理，各自设置视口和颜色矩阵，每个窗口一次绘制
+// 现在：MosaicWidget的方式，所有窗口放在三个纹理数组里，每路流一层，一次实例化绘制画完
+// 两种方式都只上传有新帧的窗口，每次绘制有一半的窗口收到新帧，着色器读取客户端用的同一份文件
+// 打印每次绘制在CPU上提交命令的时间、加上glFinish的时间和绘制次数，检查两种方式画出来的画面相同
+// 原来的方式在一个上下文里按窗口切换视口来模拟，没有算上多个控件各自的上下文切换和合成
+// 用EGL创建离屏上下文，没有可用的OpenGL 3.3时跳过
+
+#include "offscreengl.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define BENCH_FRAMEBUFFER_WIDTH 1920
+#define BENCH_FRAMEBUFFER_HEIGHT 1080
+#define BENCH_TILE_WIDTH 320
+#define BENCH_TILE_HEIGHT 180
+#define BENCH_PAINT_COUNT 60
+// 每路流轮流用这么多帧不同的内容
+#define BENCH_SOURCE_FRAME_COUNT 8
+// 解码器输出的行宽按这个对齐，每行至少留出BENCH_ROW_PADDING字节的填充
+#define BENCH_LINESIZE_ALIGN 64
+#define BENCH_ROW_PADDING 32
+// 两种方式画出来的颜色允许的差别，纹理坐标的插值方式不同，可能有一级的舍入差别
+#define BENCH_MAX_PIXEL_DIFF 2
+
+// 和MosaicWidget的MOSAIC_ATTR_*一致
+#define MOSAIC_ATTR_POSITION 0
+#define MOSAIC_ATTR_TILE_RECT 1
+#define MOSAIC_ATTR_TILE_TEXTURE 2
+#define MOSAIC_ATTR_COLOR_MATRIX 3
+// 和OpenGLWidget的VIDEO_ATTR_*一致
+#define VIDEO_ATTR_POSITION 0
+#define VIDEO_ATTR_UV 1
+
+// 解码器输出的一帧，每个平面按自己的行宽存放
+struct TileFrame
+{
+    int m_widths[3] = {0, 0, 0};
+    int m_heights[3] = {0, 0, 0};
+    int m_linesizes[3] = {0, 0, 0};
+    std::vector<uint8_t> m_planes[3];
+};
+
+static TileFrame makeFrame(int seed)
+{
+    TileFrame frame;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        frame.m_widths[plane] = plane == 0 ? BENCH_TILE_WIDTH : BENCH_TILE_WIDTH / 2;
+        frame.m_heights[plane] = plane == 0 ? BENCH_TILE_HEIGHT : BENCH_TILE_HEIGHT / 2;
+        frame.m_linesizes[plane] = (frame.m_widths[plane] + BENCH_ROW_PADDING + BENCH_LINESIZE_ALIGN - 1) / BENCH_LINESIZE_ALIGN * BENCH_LINESIZE_ALIGN;
+        frame.m_planes[plane].resize(static_cast<size_t>(frame.m_linesizes[plane]) * frame.m_heights[plane]);
+        for (int y = 0; y < frame.m_heights[plane]; y++)
+        {
+            for (int x = 0; x < frame.m_linesizes[plane]; x++)
+            {
+                // 亮度是斜向的渐变，色度是每帧不同的常量附近，转成RGB以后大部分不会被截到0
+                int value = plane == 0 ? 40 + (x + y + seed * 17) % 180 : 96 + (seed * 29 + plane * 13 + x / 16) % 64;
+                frame.m_planes[plane][static_cast<size_t>(y) * frame.m_linesizes[plane] + x] = static_cast<uint8_t>(value);
+            }
+        }
+    }
+    return frame;
+}
+
+// 8位有限范围的YUV转RGB矩阵，按列存放，和YUVTextureFormat::colorMatrix算出来的一样
+static void colorMatrix(double kr, double kb, float matrix[9], float offset[3])
+{
+    double kg = 1.0 - kr - kb;
+    const double scales[3] = {255.0 / 219.0, 255.0 / 224.0, 255.0 / 224.0};
+    const double offsets[3] = {16.0 / 255.0, 128.0 / 255.0, 128.0 / 255.0};
+    const double coefficients[3][3] = {
+        {1.0, 0.0, 2.0 * (1.0 - kr)},
+        {1.0, -2.0 * kb * (1.0 - kb) / kg, -2.0 * kr * (1.0 - kr) / kg},
+        {1.0, 2.0 * (1.0 - kb), 0.0}};
+
+    for (int row = 0; row < 3; row++)
+    {
+        double rowOffset = 0.0;
+        for (int column = 0; column < 3; column++)
+        {
+            double coefficient = coefficients[row][column] * scales[column];
+            matrix[column * 3 + row] = static_cast<float>(coefficient);
+            rowOffset -= coefficient * offsets[column];
+        }
+        offset[row] = static_cast<float>(rowOffset);
+    }
+}
+
+// 每次绘制时每个窗口要显示的帧，以及这一帧是不是新的
+struct Scene
+{
+    int m_tileCount = 0;
+    std::vector<const TileFrame *> m_frames;
+    std::vector<bool> m_isNew;
+    // 偶数窗口是BT.601，奇数窗口是BT.709，每个窗口要用自己的矩阵
+    std::vector<float> m_colorMatrices;
+    std::vector<float> m_colorOffsets;
+};
+
+static Scene makeScene(int tileCount)
+{
+    Scene scene;
+    scene.m_tileCount = tileCount;
+    scene.m_frames.assign(tileCount, nullptr);
+    scene.m_isNew.assign(tileCount, false);
+    scene.m_colorMatrices.resize(tileCount * 9);
+    scene.m_colorOffsets.resize(tileCount * 3);
+    for (int i = 0; i < tileCount; i++)
+    {
+        bool isBt709 = i % 2 != 0;
+        colorMatrix(isBt709 ? 0.2126 : 0.299, isBt709 ? 0.0722 : 0.114, &scene.m_colorMatrices[i * 9], &scene.m_colorOffsets[i * 3]);
+    }
+    return scene;
+}
+
+// 第一次绘制时所有窗口都有新帧，之后每次有一半的窗口收到新帧，比如25fps的流在50Hz的刷新率下显示
+static void advanceScene(Scene &scene, const std::vector<TileFrame> &sourceFrames, int paint)
+{
+    for (int i = 0; i < scene.m_tileCount; i++)
+    {
+        scene.m_isNew[i] = paint == 0 || (paint + i) % 2 == 0;
+        if (scene.m_isNew[i])
+        {
+            scene.m_frames[i] = &sourceFrames[(paint + i * 3) % sourceFrames.size()];
+        }
+    }
+}
+
+// 和MosaicWidget::tileRect的网格布局一样，0到1，y向下
+static void tileRect(int index, int tileCount, float rect[4])
+{
+    int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(tileCount)))));
+    int rows = std::max(1, (tileCount + columns - 1) / columns);
+    rect[0] = static_cast<float>(index % columns) / columns;
+    rect[1] = static_cast<float>(index / columns) / rows;
+    rect[2] = 1.0f / columns;
+    rect[3] = 1.0f / rows;
+}
+
+static void setSamplers(GLuint program, const char *names[3])
+{
+    glUseProgram(program);
+    for (int i = 0; i < 3; i++)
+    {
+        glUniform1i(glGetUniformLocation(program, names[i]), i);
+    }
+    glUseProgram(0);
+}
+
+// 原来的方式：每个窗口一个OpenGLWidget，各自的三个纹理、视口和颜色矩阵，各画一次
+class PerTileRenderer
+{
+public:
+    bool initialize(int tileCount)
+    {
+        m_tileCount = tileCount;
+        m_program = OffscreenGL::linkProgram(OffscreenGL::readShaderFile("vertex.vert"), OffscreenGL::readShaderFile("fragment.frag"));
+        if (m_program == 0)
+        {
+            return false;
+        }
+        const char *samplers[3] = {"uni_textureY", "uni_textureU", "uni_textureV"};
+        setSamplers(m_program, samplers);
+        m_colorMatrixLocation = glGetUniformLocation(m_program, "uni_colorMatrix");
+        m_colorOffsetLocation = glGetUniformLocation(m_program, "uni_colorOffset");
+
+        // 和OpenGLWidget::initializeVertexBuffer一样，铺满视口的矩形
+        static const float quadVertices[] = {
+            -1, 1, 0, 0, 0,
+            -1, -1, 0, 0, 1,
+            1, 1, 0, 1, 0,
+            1, -1, 0, 1, 1};
+        glGenVertexArrays(1, &m_vertexArray);
+        glBindVertexArray(m_vertexArray);
+        glGenBuffers(1, &m_vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(VIDEO_ATTR_POSITION);
+        glVertexAttribPointer(VIDEO_ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), nullptr);
+        glEnableVertexAttribArray(VIDEO_ATTR_UV);
+        glVertexAttribPointer(VIDEO_ATTR_UV, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<const void *>(3 * sizeof(float)));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_textures.resize(tileCount * 3);
+        glGenTextures(tileCount * 3, m_textures.data());
+        for (int i = 0; i < tileCount * 3; i++)
+        {
+            int plane = i % 3;
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, plane == 0 ? BENCH_TILE_WIDTH : BENCH_TILE_WIDTH / 2, plane == 0 ? BENCH_TILE_HEIGHT : BENCH_TILE_HEIGHT / 2);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return true;
+    }
+
+    void destroy()
+    {
+        glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteVertexArrays(1, &m_vertexArray);
+        glDeleteProgram(m_program);
+    }
+
+    void paint(const Scene &scene)
+    {
+        glViewport(0, 0, BENCH_FRAMEBUFFER_WIDTH, BENCH_FRAMEBUFFER_HEIGHT);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUseProgram(m_program);
+        glBindVertexArray(m_vertexArray);
+        for (int i = 0; i < m_tileCount; i++)
+        {
+            const TileFrame &frame = *scene.m_frames[i];
+            for (int plane = 0; plane < 3; plane++)
+            {
+                glActiveTexture(GL_TEXTURE0 + plane);
+                glBindTexture(GL_TEXTURE_2D, m_textures[i * 3 + plane]);
+                if (scene.m_isNew[i])
+                {
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+                    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.m_linesizes[plane]);
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.m_widths[plane], frame.m_heights[plane], GL_RED, GL_UNSIGNED_BYTE, frame.m_planes[plane].data());
+                    m_uploads += plane == 0 ? 1 : 0;
+                }
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            // 每个控件的视口是自己的窗口，GL的视口原点在左下角
+            float rect[4];
+            tileRect(i, m_tileCount, rect);
+            int x = static_cast<int>(std::lround(rect[0] * BENCH_FRAMEBUFFER_WIDTH));
+            int width = static_cast<int>(std::lround(rect[2] * BENCH_FRAMEBUFFER_WIDTH));
+            int height = static_cast<int>(std::lround(rect[3] * BENCH_FRAMEBUFFER_HEIGHT));
+            int y = BENCH_FRAMEBUFFER_HEIGHT - static_cast<int>(std::lround(rect[1] * BENCH_FRAMEBUFFER_HEIGHT)) - height;
+            glViewport(x, y, width, height);
+
+            glUniformMatrix3fv(m_colorMatrixLocation, 1, GL_FALSE, &scene.m_colorMatrices[i * 9]);
+            glUniform3fv(m_colorOffsetLocation, 1, &scene.m_colorOffsets[i * 3]);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            m_drawCalls++;
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+        glViewport(0, 0, BENCH_FRAMEBUFFER_WIDTH, BENCH_FRAMEBUFFER_HEIGHT);
+    }
+
+    uint64_t m_drawCalls = 0;
+    uint64_t m_uploads = 0;
+
+private:
+    int m_tileCount = 0;
+    GLuint m_program = 0;
+    GLint m_colorMatrixLocation = -1;
+    GLint m_colorOffsetLocation = -1;
+    GLuint m_vertexArray = 0;
+    GLuint m_vertexBuffer = 0;
+    std::vector<GLuint> m_textures;
+};
+
+// 现在的方式：和MosaicWidget一样，三个纹理数组每路流一层，实例数据里有每个窗口的位置和颜色矩阵
+class InstancedRenderer
+{
+public:
+    // 和MosaicWidget::TileInstance相同
+    struct TileInstance
+    {
+        float m_x, m_y, m_width, m_height;
+        float m_uScale, m_vScale;
+        float m_layer;
+        float m_colorColumns[3][4];
+    };
+
+    bool initialize(const Scene &scene)
+    {
+        m_tileCount = scene.m_tileCount;
+        m_program = OffscreenGL::linkProgram(OffscreenGL::readShaderFile("mosaic.vert"), OffscreenGL::readShaderFile("mosaic.frag"));
+        if (m_program == 0)
+        {
+            return false;
+        }
+        const char *samplers[3] = {"uni_textureY", "uni_textureU", "uni_textureV"};
+        setSamplers(m_program, samplers);
+
+        // 和MosaicWidget::initializeBuffers一样
+        static const float quadVertices[] = {
+            0, 0,
+            0, 1,
+            1, 0,
+            1, 1};
+        glGenVertexArrays(1, &m_vertexArray);
+        glBindVertexArray(m_vertexArray);
+        glGenBuffers(1, &m_quadBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_quadBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(MOSAIC_ATTR_POSITION);
+        glVertexAttribPointer(MOSAIC_ATTR_POSITION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+        glGenBuffers(1, &m_instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+        glEnableVertexAttribArray(MOSAIC_ATTR_TILE_RECT);
+        glVertexAttribPointer(MOSAIC_ATTR_TILE_RECT, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_x)));
+        glVertexAttribDivisor(MOSAIC_ATTR_TILE_RECT, 1);
+        glEnableVertexAttribArray(MOSAIC_ATTR_TILE_TEXTURE);
+        glVertexAttribPointer(MOSAIC_ATTR_TILE_TEXTURE, 3, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_uScale)));
+        glVertexAttribDivisor(MOSAIC_ATTR_TILE_TEXTURE, 1);
+        for (int i = 0; i < 3; i++)
+        {
+            glEnableVertexAttribArray(MOSAIC_ATTR_COLOR_MATRIX + i);
+            glVertexAttribPointer(MOSAIC_ATTR_COLOR_MATRIX + i, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<const void *>(offsetof(TileInstance, m_colorColumns) + sizeof(float) * 4 * i));
+            glVertexAttribDivisor(MOSAIC_ATTR_COLOR_MATRIX + i, 1);
+        }
+
+        // 窗口的位置和颜色矩阵不变，实例数据只生成一次，和MosaicWidget::updateInstances一样
+        std::vector<TileInstance> instances(m_tileCount);
+        for (int i = 0; i < m_tileCount; i++)
+        {
+            float rect[4];
+            tileRect(i, m_tileCount, rect);
+            TileInstance &instance = instances[i];
+            instance.m_x = rect[0];
+            instance.m_y = rect[1];
+            instance.m_width = rect[2];
+            instance.m_height = rect[3];
+            instance.m_uScale = 1.0f;
+            instance.m_vScale = 1.0f;
+            instance.m_layer = static_cast<float>(i);
+            for (int column = 0; column < 3; column++)
+            {
+                for (int row = 0; row < 3; row++)
+                {
+                    instance.m_colorColumns[column][row] = scene.m_colorMatrices[i * 9 + column * 3 + row];
+                }
+                instance.m_colorColumns[column][3] = scene.m_colorOffsets[i * 3 + column];
+            }
+        }
+        glBufferData(GL_ARRAY_BUFFER, sizeof(TileInstance) * m_tileCount, instances.data(), GL_DYNAMIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // 和MosaicWidget::allocateTextures一样，层的大小就是窗口帧的大小
+        glGenTextures(3, m_textures);
+        for (int i = 0; i < 3; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8, i == 0 ? BENCH_TILE_WIDTH : BENCH_TILE_WIDTH / 2, i == 0 ? BENCH_TILE_HEIGHT : BENCH_TILE_HEIGHT / 2, m_tileCount);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return true;
+    }
+
+    void destroy()
+    {
+        glDeleteTextures(3, m_textures);
+        glDeleteBuffers(1, &m_quadBuffer);
+        glDeleteBuffers(1, &m_instanceBuffer);
+        glDeleteVertexArrays(1, &m_vertexArray);
+        glDeleteProgram(m_program);
+    }
+
+    void paint(const Scene &scene)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // MosaicWidget::uploadTile，只上传有新帧的窗口
+        for (int i = 0; i < m_tileCount; i++)
+        {
+            if (!scene.m_isNew[i])
+            {
+                continue;
+            }
+            const TileFrame &frame = *scene.m_frames[i];
+            for (int plane = 0; plane < 3; plane++)
+            {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[plane]);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.m_linesizes[plane]);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, frame.m_widths[plane], frame.m_heights[plane], 1, GL_RED, GL_UNSIGNED_BYTE, frame.m_planes[plane].data());
+            }
+            m_uploads++;
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glUseProgram(m_program);
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+        }
+        glBindVertexArray(m_vertexArray);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_tileCount);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        m_drawCalls++;
+    }
+
+    uint64_t m_drawCalls = 0;
+    uint64_t m_uploads = 0;
+
+private:
+    int m_tileCount = 0;
+    GLuint m_program = 0;
+    GLuint m_vertexArray = 0;
+    GLuint m_quadBuffer = 0;
+    GLuint m_instanceBuffer = 0;
+    GLuint m_textures[3] = {0, 0, 0};
+};
+
+struct PaintResult
+{
+    double m_submitUs = 0; // paint里CPU提交命令的时间
+    double m_frameUs = 0;  // 加上glFinish等GL画完
+    double m_drawCalls = 0;
+    double m_uploads = 0;
+    std::vector<uint8_t> m_pixels;
+};
+
+// 第一次绘制上传所有窗口，不计时，之后每次绘制后glFinish，最后读回画面
+template <typename Renderer>
+static PaintResult measure(OffscreenGL &gl, Renderer &renderer, Scene &scene, const std::vector<TileFrame> &sourceFrames)
+{
+    advanceScene(scene, sourceFrames, 0);
+    renderer.paint(scene);
+    glFinish();
+    renderer.m_drawCalls = 0;
+    renderer.m_uploads = 0;
+
+    std::chrono::steady_clock::duration submitTime{0};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int paint = 1; paint <= BENCH_PAINT_COUNT; paint++)
+    {
+        advanceScene(scene, sourceFrames, paint);
+        auto paintStartTime = std::chrono::steady_clock::now();
+        renderer.paint(scene);
+        submitTime += std::chrono::steady_clock::now() - paintStartTime;
+        glFinish();
+    }
+
+    PaintResult result;
+    result.m_frameUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / BENCH_PAINT_COUNT;
+    result.m_submitUs = std::chrono::duration<double, std::micro>(submitTime).count() / BENCH_PAINT_COUNT;
+    result.m_drawCalls = static_cast<double>(renderer.m_drawCalls) / BENCH_PAINT_COUNT;
+    result.m_uploads = static_cast<double>(renderer.m_uploads) / BENCH_PAINT_COUNT;
+    result.m_pixels = gl.readFramebuffer();
+    return result;
+}
+
+// 两种方式画出来的画面逐像素比较，另外检查画面大部分不是黑的，排除两边都没画出东西的情况
+static void checkSameImage(const std::vector<uint8_t> &perTile, const std::vector<uint8_t> &instanced)
+{
+    CHECK(perTile.size() == instanced.size());
+    if (perTile.size() != instanced.size())
+    {
+        return;
+    }
+
+    int maxDiff = 0;
+    size_t litPixels = 0;
+    for (size_t i = 0; i < perTile.size(); i += 4)
+    {
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            maxDiff = std::max(maxDiff, std::abs(perTile[i + channel] - instanced[i + channel]));
+        }
+        litPixels += perTile[i] + perTile[i + 1] + perTile[i + 2] > 0 ? 1 : 0;
+    }
+    CHECK(maxDiff <= BENCH_MAX_PIXEL_DIFF);
+    CHECK(litPixels > perTile.size() / 4 * 9 / 10);
+}
+
+static void runBench(OffscreenGL &gl, int tileCount, const std::vector<TileFrame> &sourceFrames)
+{
+    Scene scene = makeScene(tileCount);
+    PaintResult perTileResult;
+    PerTileRenderer perTileRenderer;
+    if (perTileRenderer.initialize(tileCount))
+    {
+        perTileResult = measure(gl, perTileRenderer, scene, sourceFrames);
+    }
+    perTileRenderer.destroy();
+
+    scene = makeScene(tileCount);
+    PaintResult instancedResult;
+    InstancedRenderer instancedRenderer;
+    if (instancedRenderer.initialize(scene))
+    {
+        instancedResult = measure(gl, instancedRenderer, scene, sourceFrames);
+    }
+    instancedRenderer.destroy();
+
+    CHECK(glGetError() == GL_NO_ERROR);
+    checkSameImage(perTileResult.m_pixels, instancedResult.m_pixels);
+    CHECK(perTileResult.m_drawCalls == tileCount);
+    CHECK(instancedResult.m_drawCalls == 1);
+    CHECK(perTileResult.m_uploads == instancedResult.m_uploads && instancedResult.m_uploads == tileCount / 2);
+
+    std::printf("%2d tiles  per tile   CPU %7.1f us  frame %8.1f us  %5.1f draws  %5.1f tile uploads per paint\n", tileCount,
+                perTileResult.m_submitUs, perTileResult.m_frameUs, perTileResult.m_drawCalls, perTileResult.m_uploads);
+    std::printf("%2d tiles  instanced  CPU %7.1f us  frame %8.1f us  %5.1f draws  %5.1f tile uploads per paint\n", tileCount,
+                instancedResult.m_submitUs, instancedResult.m_frameUs, instancedResult.m_drawCalls, instancedResult.m_uploads);
+}
+
+int main()
+{
+    OffscreenGL gl;
+    if (!gl.create(3, 3))
+    {
+        std::printf("skipped: no offscreen OpenGL 3.3 context\n");
+        return 0;
+    }
+    std::printf("renderer: %s\n", gl.renderer());
+    if (!gl.createFramebuffer(BENCH_FRAMEBUFFER_WIDTH, BENCH_FRAMEBUFFER_HEIGHT))
+    {
+        return 1;
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    std::vector<TileFrame> sourceFrames;
+    for (int i = 0; i < BENCH_SOURCE_FRAME_COUNT; i++)
+    {
+        sourceFrames.push_back(makeFrame(i));
+    }
+
+    runBench(gl, 16, sourceFrames);
+    runBench(gl, 64, sourceFrames);
+
+    return testResult();
+}
@@ -0,0 +1,194 @@
+// 多路流的性能测试：4、16、64路流，每路按25fps收视频消息
+// 对比所有流共用一个事件循环线程的MultiStreamClient和每路一个VideoClient(各自的收数据线程和解码线程)
+// 打印客户端的线程数、每路流占用的CPU、每秒上下文切换次数，以及从服务端生成消息到客户端收完的延迟
+// 消息不标记IDR，客户端在送进解码器之前丢掉，测到的是接收路径，不包括解码
+// 检查每一路都收到了所有消息
+
+#include "../multistreamclient.h"
+#include "cpuusage.h"
+#include "standinserver.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+
+#include <dirent.h>
+
+#define BENCH_FRAME_COUNT 40
+#define BENCH_FRAME_INTERVAL_MS 40
+#define BENCH_PAYLOAD_SIZE (8 * 1024)
+#define BENCH_DECODE_THREADS 2
+#define BENCH_TIMEOUT_MS 30000
+// 测试自己的线程：主线程和代替服务端接受连接的线程
+#define BENCH_OWN_THREADS 2
+
+struct BenchResult
+{
+    int m_threads = 0;
+    double m_cpuPerStreamPercent = 0;
+    double m_switchesPerSecond = 0;
+    double m_meanLatencyUs = 0;
+    double m_maxLatencyUs = 0;
+    bool m_isAllReceived = true;
+};
+
+using StatsGetter = std::function<ClientStats(int index)>;
+
+static int threadCount()
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == nullptr)
+    {
+        return 0;
+    }
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+        {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static bool waitReceived(int streamCount, const StatsGetter &statsOf, uint64_t count)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCH_TIMEOUT_MS);
+    for (int i = 0; i < streamCount; i++)
+    {
+        while (statsOf(i).m_videoPackets < count)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return true;
+}
+
+// 所有流都连上以后按固定帧率给每个连接发消息
+static BenchResult measure(StandInServer &server, int streamCount, const StatsGetter &statsOf)
+{
+    BenchResult result;
+    result.m_isAllReceived = server.waitAccepted(streamCount, BENCH_TIMEOUT_MS);
+    result.m_threads = threadCount() - BENCH_OWN_THREADS;
+
+    CpuUsage startUsage = cpuUsage();
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_FRAME_COUNT; i++)
+    {
+        std::vector<uint8_t> message = StandInServer::makeVideoMessage(i, BENCH_PAYLOAD_SIZE);
+        server.broadcast(message.data(), message.size());
+        std::this_thread::sleep_until(startTime + std::chrono::milliseconds((i + 1) * BENCH_FRAME_INTERVAL_MS));
+    }
+    result.m_isAllReceived = waitReceived(streamCount, statsOf, BENCH_FRAME_COUNT) && result.m_isAllReceived;
+    CpuUsage endUsage = cpuUsage();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    result.m_cpuPerStreamPercent = otherThreadsCpuSeconds(startUsage, endUsage) / seconds / streamCount * 100;
+    result.m_switchesPerSecond = (endUsage.m_contextSwitches - startUsage.m_contextSwitches) / seconds;
+
+    // 每一路的最大延迟，服务端依次发给每个连接，后面的连接还包括发给前面连接的时间
+    double totalLatencyUs = 0;
+    for (int i = 0; i < streamCount; i++)
+    {
+        ClientStats stats = statsOf(i);
+        result.m_isAllReceived = result.m_isAllReceived && stats.m_videoPackets == BENCH_FRAME_COUNT && stats.m_lostMessages == 0;
+        totalLatencyUs += stats.m_maxCaptureLatencyUs;
+        result.m_maxLatencyUs = std::max(result.m_maxLatencyUs, static_cast<double>(stats.m_maxCaptureLatencyUs));
+    }
+    result.m_meanLatencyUs = totalLatencyUs / streamCount;
+    return result;
+}
+
+static BenchResult runShared(int streamCount)
+{
+    StandInServer server;
+    if (!server.start())
+    {
+        return BenchResult();
+    }
+
+    MultiStreamClient client(BENCH_DECODE_THREADS);
+    std::vector<int> streamIDs;
+    for (int i = 0; i < streamCount; i++)
+    {
+        streamIDs.push_back(client.addStream(NetConnectInfo("127.0.0.1", server.port()), [](YUVFrameData *) {}));
+    }
+
+    BenchResult result = measure(server, streamCount, [&client, &streamIDs](int index) { return client.streamStats(streamIDs[index]); });
+    client.stopAllStreams();
+    return result;
+}
+
+static BenchResult runSeparate(int streamCount)
+{
+    StandInServer server;
+    if (!server.start())
+    {
+        return BenchResult();
+    }
+
+    std::vector<std::unique_ptr<VideoClient>> clients;
+    for (int i = 0; i < streamCount; i++)
+    {
+        clients.push_back(std::make_unique<VideoClient>());
+        clients.back()->startSocketConnection(NetConnectInfo("127.0.0.1", server.port()));
+    }
+
+    BenchResult result = measure(server, streamCount, [&clients](int index) { return clients[index]->clientStats(); });
+    for (auto &client : clients)
+    {
+        client->stopSocketConnection();
+    }
+    return result;
+}
+
+static void printResult(const char *name, int streamCount, const BenchResult &result)
+{
+    std::printf("%-8s %2d streams  %3d threads  CPU %6.3f%% of a core per stream  %8.0f switches/s  latency mean %7.0f us  max %7.0f us\n",
+                name, streamCount, result.m_threads, result.m_cpuPerStreamPercent, result.m_switchesPerSecond, result.m_meanLatencyUs,
+                result.m_maxLatencyUs);
+}
+
+int main()
+{
+    const int streamCounts[] = {4, 16, 64};
+    for (int streamCount : streamCounts)
+    {
+        BenchResult shared = runShared(streamCount);
+        BenchResult separate = runSeparate(streamCount);
+        printResult("shared", streamCount, shared);
+        printResult("separate", streamCount, separate);
+
+        CHECK(shared.m_isAllReceived);
+        CHECK(separate.m_isAllReceived);
+        // 共用的事件循环和解码线程池，线程数不随流的数量增长
+        CHECK(shared.m_threads == 1 + BENCH_DECODE_THREADS);
+        CHECK(separate.m_threads >= streamCount);
+    }
+
+    return testResult();
+}
+
+#else
+
+int main()
+{
+    std::printf("skipped: the stand-in server is only implemented for Linux\n");
+    return 0;
+}
+
+#endif
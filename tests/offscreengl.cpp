@@ -0,0 +1,190 @@
+#include "offscreengl.h"
+
+#include <EGL/eglext.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+OffscreenGL::OffscreenGL()
+{
+}
+
+OffscreenGL::~OffscreenGL()
+{
+    destroy();
+}
+
+bool OffscreenGL::create(int majorVersion, int minorVersion, bool isCoreProfile)
+{
+    destroy();
+
+    // surfaceless平台不需要X11或Wayland，不支持这个扩展时退回默认的显示
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr)
+    {
+        m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (m_display == EGL_NO_DISPLAY)
+    {
+        m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint eglMajor = 0;
+    EGLint eglMinor = 0;
+    if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, &eglMajor, &eglMinor))
+    {
+        std::fprintf(stderr, "eglInitialize failed: 0x%x\n", eglGetError());
+        m_display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::fprintf(stderr, "eglBindAPI failed: 0x%x\n", eglGetError());
+        destroy();
+        return false;
+    }
+
+    // 不画到窗口上，不需要选择EGLConfig(EGL_KHR_no_config_context)，也不需要surface(EGL_KHR_surfaceless_context)
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, isCoreProfile ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE};
+    m_context = eglCreateContext(m_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (m_context == EGL_NO_CONTEXT || !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+    {
+        std::fprintf(stderr, "cannot create an OpenGL %d.%d context: 0x%x\n", majorVersion, minorVersion, eglGetError());
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenGL::destroy()
+{
+    if (m_display == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    if (m_context != EGL_NO_CONTEXT && m_framebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_colorBuffer);
+        m_framebuffer = 0;
+        m_colorBuffer = 0;
+    }
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(m_display, m_context);
+        m_context = EGL_NO_CONTEXT;
+    }
+    eglTerminate(m_display);
+    m_display = EGL_NO_DISPLAY;
+}
+
+const char *OffscreenGL::renderer() const
+{
+    const GLubyte *renderer = m_context != EGL_NO_CONTEXT ? glGetString(GL_RENDERER) : nullptr;
+    return renderer != nullptr ? reinterpret_cast<const char *>(renderer) : "none";
+}
+
+bool OffscreenGL::createFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &m_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::fprintf(stderr, "framebuffer is incomplete: 0x%x\n", status);
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+std::vector<uint8_t> OffscreenGL::readFramebuffer() const
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(m_width) * m_height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+static GLuint compileShader(GLenum type, const std::string &source)
+{
+    GLuint shader = glCreateShader(type);
+    const char *pSource = source.c_str();
+    glShaderSource(shader, 1, &pSource, nullptr);
+    glCompileShader(shader);
+
+    GLint isCompiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if (!isCompiled)
+    {
+        char log[1024] = {0};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::fprintf(stderr, "%s compile error: %s\n", type == GL_VERTEX_SHADER ? "VS" : "FS", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint OffscreenGL::linkProgram(const std::string &vertexSource, const std::string &fragmentSource)
+{
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (!isLinked)
+    {
+        char log[1024] = {0};
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::fprintf(stderr, "link error: %s\n", log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+std::string OffscreenGL::readShaderFile(const char *fileName)
+{
+    // SHADER_SOURCE_DIR由tests/CMakeLists.txt定义成仓库的根目录
+    std::ifstream file(std::string(SHADER_SOURCE_DIR) + "/" + fileName);
+    if (!file)
+    {
+        std::fprintf(stderr, "cannot read shader %s\n", fileName);
+        return std::string();
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+    return source.str();
+}
@@ -0,0 +1,53 @@
+#ifndef OFFSCREENGL_H
+#define OFFSCREENGL_H
+
+// 渲染相关的性能测试用的离屏OpenGL上下文，不需要窗口和Qt
+// 用EGL的surfaceless平台创建，没有显卡的机器上可以用Mesa的llvmpipe
+// 没有默认的帧缓冲，需要画东西的测试自己创建FBO
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <EGL/egl.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class OffscreenGL
+{
+public:
+    OffscreenGL();
+    ~OffscreenGL();
+
+    OffscreenGL(const OffscreenGL &) = delete;
+    OffscreenGL &operator=(const OffscreenGL &) = delete;
+
+    // 创建上下文并设为当前线程的上下文，isCoreProfile为false时创建兼容profile
+    bool create(int majorVersion, int minorVersion, bool isCoreProfile = true);
+    void destroy();
+
+    // 比如"llvmpipe (LLVM 15.0.6, 256 bits)"
+    const char *renderer() const;
+
+    // 创建width x height的RGBA8帧缓冲并绑定，视口设为整个帧缓冲
+    bool createFramebuffer(int width, int height);
+    // 读回整个帧缓冲，每个像素4个字节，第一行是画面最下面的一行
+    std::vector<uint8_t> readFramebuffer() const;
+
+    // 编译并链接着色器程序，失败时打印日志并返回0
+    static GLuint linkProgram(const std::string &vertexSource, const std::string &fragmentSource);
+    // 读取仓库根目录下的着色器文件，和客户端用的是同一份，读不到时返回空字符串
+    static std::string readShaderFile(const char *fileName);
+
+private:
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLContext m_context = EGL_NO_CONTEXT;
+    GLuint m_framebuffer = 0;
+    GLuint m_colorBuffer = 0;
+    int m_width = 0;
+    int m_height = 0;
+};
+
+#endif // OFFSCREENGL_H
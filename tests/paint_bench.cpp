@@ -0,0 +1,482 @@
+// OpenGLWidget::paintGL的性能测试：1080p的yuv420p帧画到640x360的帧缓冲里
+// 原来：兼容profile，每次绘制glLoadIdentity、重新计算正交矩阵、按名字查找每个uniform和顶点属性，
+// 顶点从客户端内存的数组里读，每次重新设置顶点属性
+// 现在：3.3 core profile，矩形放在VBO里，顶点格式记录在VAO里，uniform的位置只查找一次，颜色矩阵变了才设置
+// 分别测只重绘(没有新帧，不上传)和每次都有新帧两种情况，打印每次绘制在CPU上提交命令的时间、
+// 按名字查找的次数和绘制次数，检查两种方式画出来的画面相同
+// 原来的着色器已经改成了core profile的写法，这里内嵌改动前的版本
+// 用EGL创建离屏上下文，没有兼容profile或者3.3 core profile时跳过
+
+#include "offscreengl.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define BENCH_VIEWPORT_WIDTH 640
+#define BENCH_VIEWPORT_HEIGHT 360
+#define BENCH_FRAME_WIDTH 1920
+#define BENCH_FRAME_HEIGHT 1080
+#define BENCH_REPAINT_COUNT 400
+#define BENCH_NEW_FRAME_PAINT_COUNT 60
+#define BENCH_LINESIZE_ALIGN 64
+#define BENCH_ROW_PADDING 32
+// 两种方式的顶点经过不同的变换，允许的舍入差别
+#define BENCH_MAX_PIXEL_DIFF 1
+
+// 和OpenGLWidget的VIDEO_ATTR_*一致
+#define VIDEO_ATTR_POSITION 0
+#define VIDEO_ATTR_UV 1
+
+// 改动前的vertex.vert和fragment.frag
+static const char *s_legacyVertexSource = R"(
+attribute vec4 attr_position;
+attribute vec2 attr_uv;
+uniform mat4 uni_mat;
+varying vec2 out_uv;
+
+void main(void)
+{
+    out_uv = attr_uv;
+    gl_Position = uni_mat * attr_position;
+}
+)";
+
+static const char *s_legacyFragmentSource = R"(
+uniform sampler2D uni_textureY;
+uniform sampler2D uni_textureU;
+uniform sampler2D uni_textureV;
+uniform mat3 uni_colorMatrix;
+uniform vec3 uni_colorOffset;
+varying vec2 out_uv;
+
+void main(void)
+{
+    vec3 yuv;
+    yuv.x = texture2D(uni_textureY, out_uv).r;
+    yuv.y = texture2D(uni_textureU, out_uv).r;
+    yuv.z = texture2D(uni_textureV, out_uv).r;
+
+    vec3 rgb = uni_colorMatrix * yuv + uni_colorOffset;
+    gl_FragColor = vec4(rgb, 1);
+}
+)";
+
+// 和OpenGLWidget::Vertex相同
+struct Vertex
+{
+    float x, y, z;
+    float u, v;
+};
+
+// 解码器输出的一帧，每个平面按自己的行宽存放
+struct SourceFrame
+{
+    int m_widths[3] = {0, 0, 0};
+    int m_heights[3] = {0, 0, 0};
+    int m_linesizes[3] = {0, 0, 0};
+    std::vector<uint8_t> m_planes[3];
+};
+
+static SourceFrame makeFrame(int seed)
+{
+    SourceFrame frame;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        frame.m_widths[plane] = plane == 0 ? BENCH_FRAME_WIDTH : BENCH_FRAME_WIDTH / 2;
+        frame.m_heights[plane] = plane == 0 ? BENCH_FRAME_HEIGHT : BENCH_FRAME_HEIGHT / 2;
+        frame.m_linesizes[plane] = (frame.m_widths[plane] + BENCH_ROW_PADDING + BENCH_LINESIZE_ALIGN - 1) / BENCH_LINESIZE_ALIGN * BENCH_LINESIZE_ALIGN;
+        frame.m_planes[plane].resize(static_cast<size_t>(frame.m_linesizes[plane]) * frame.m_heights[plane]);
+        for (int y = 0; y < frame.m_heights[plane]; y++)
+        {
+            for (int x = 0; x < frame.m_linesizes[plane]; x++)
+            {
+                int value = plane == 0 ? 40 + (x / 4 + y / 4 + seed * 17) % 180 : 96 + (seed * 29 + plane * 13 + x / 32) % 64;
+                frame.m_planes[plane][static_cast<size_t>(y) * frame.m_linesizes[plane] + x] = static_cast<uint8_t>(value);
+            }
+        }
+    }
+    return frame;
+}
+
+// BT.709有限范围，按列存放，和YUVTextureFormat::colorMatrix对1080p的帧算出来的一样
+static void colorMatrix(float matrix[9], float offset[3])
+{
+    const double kr = 0.2126;
+    const double kb = 0.0722;
+    double kg = 1.0 - kr - kb;
+    const double scales[3] = {255.0 / 219.0, 255.0 / 224.0, 255.0 / 224.0};
+    const double offsets[3] = {16.0 / 255.0, 128.0 / 255.0, 128.0 / 255.0};
+    const double coefficients[3][3] = {
+        {1.0, 0.0, 2.0 * (1.0 - kr)},
+        {1.0, -2.0 * kb * (1.0 - kb) / kg, -2.0 * kr * (1.0 - kr) / kg},
+        {1.0, 2.0 * (1.0 - kb), 0.0}};
+
+    for (int row = 0; row < 3; row++)
+    {
+        double rowOffset = 0.0;
+        for (int column = 0; column < 3; column++)
+        {
+            double coefficient = coefficients[row][column] * scales[column];
+            matrix[column * 3 + row] = static_cast<float>(coefficient);
+            rowOffset -= coefficient * offsets[column];
+        }
+        offset[row] = static_cast<float>(rowOffset);
+    }
+}
+
+// OpenGLWidget::allocateTextures，两种方式都一样，只在分辨率变化时调用
+static void allocateTextures(GLuint textures[3], const SourceFrame &frame)
+{
+    glGenTextures(3, textures);
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, frame.m_widths[plane], frame.m_heights[plane]);
+    }
+}
+
+// OpenGLWidget::uploadFrame，两种方式都一样
+static void uploadFrame(const GLuint textures[3], const SourceFrame &frame)
+{
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glActiveTexture(GL_TEXTURE0 + plane);
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.m_linesizes[plane]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.m_widths[plane], frame.m_heights[plane], GL_RED, GL_UNSIGNED_BYTE, frame.m_planes[plane].data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+}
+
+// 改动前的paintGL，QOpenGLShaderProgram按名字设置uniform和顶点属性时每次都调用glGetUniformLocation或glGetAttribLocation
+class LegacyPainter
+{
+public:
+    bool initialize(const SourceFrame &frame)
+    {
+        m_program = OffscreenGL::linkProgram(s_legacyVertexSource, s_legacyFragmentSource);
+        if (m_program == 0)
+        {
+            return false;
+        }
+        allocateTextures(m_textures, frame);
+        colorMatrix(m_colorMatrix, m_colorOffset);
+        return true;
+    }
+
+    void destroy()
+    {
+        glDeleteTextures(3, m_textures);
+        glDeleteProgram(m_program);
+    }
+
+    void paint(const SourceFrame &frame, bool isNewFrame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glLoadIdentity();
+
+        // 顶点数组放在客户端内存里，每次绘制重新设置
+        static Vertex triangleVert[] = {
+            {-1, 1, 1, 0, 0},
+            {-1, -1, 1, 0, 1},
+            {1, 1, 1, 1, 0},
+            {1, -1, 1, 1, 1}};
+
+        // QMatrix4x4::ortho(-1, 1, -1, 1, 0.1, 1000)再translate(0, 0, -3)，每次绘制重新计算
+        float matrix[16];
+        orthoTranslate(-1, 1, -1, 1, 0.1f, 1000, -3, matrix);
+
+        glUseProgram(m_program);
+        glUniformMatrix4fv(uniformLocation("uni_mat"), 1, GL_FALSE, matrix);
+
+        glEnableVertexAttribArray(attributeLocation("attr_position"));
+        glEnableVertexAttribArray(attributeLocation("attr_uv"));
+        glVertexAttribPointer(attributeLocation("attr_position"), 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), triangleVert);
+        glVertexAttribPointer(attributeLocation("attr_uv"), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), &triangleVert[0].u);
+
+        if (isNewFrame)
+        {
+            uploadFrame(m_textures, frame);
+        }
+
+        glUniform1i(uniformLocation("uni_textureY"), 0);
+        glUniform1i(uniformLocation("uni_textureU"), 1);
+        glUniform1i(uniformLocation("uni_textureV"), 2);
+        glUniformMatrix3fv(uniformLocation("uni_colorMatrix"), 1, GL_FALSE, m_colorMatrix);
+        glUniform3f(uniformLocation("uni_colorOffset"), m_colorOffset[0], m_colorOffset[1], m_colorOffset[2]);
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        }
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        m_drawCalls++;
+
+        glDisableVertexAttribArray(attributeLocation("attr_position"));
+        glDisableVertexAttribArray(attributeLocation("attr_uv"));
+        glUseProgram(0);
+    }
+
+    uint64_t m_drawCalls = 0;
+    uint64_t m_nameLookups = 0;
+
+private:
+    GLint uniformLocation(const char *name)
+    {
+        m_nameLookups++;
+        return glGetUniformLocation(m_program, name);
+    }
+
+    GLuint attributeLocation(const char *name)
+    {
+        m_nameLookups++;
+        return static_cast<GLuint>(glGetAttribLocation(m_program, name));
+    }
+
+    // 按列存放的正交投影矩阵乘以沿z平移的矩阵
+    static void orthoTranslate(float left, float right, float bottom, float top, float nearPlane, float farPlane, float z, float matrix[16])
+    {
+        std::fill(matrix, matrix + 16, 0.0f);
+        matrix[0] = 2.0f / (right - left);
+        matrix[5] = 2.0f / (top - bottom);
+        matrix[10] = -2.0f / (farPlane - nearPlane);
+        matrix[12] = -(right + left) / (right - left);
+        matrix[13] = -(top + bottom) / (top - bottom);
+        matrix[14] = -(farPlane + nearPlane) / (farPlane - nearPlane) + matrix[10] * z;
+        matrix[15] = 1.0f;
+    }
+
+    GLuint m_program = 0;
+    GLuint m_textures[3] = {0, 0, 0};
+    float m_colorMatrix[9] = {0};
+    float m_colorOffset[3] = {0};
+};
+
+// 现在的paintGL：读取客户端的vertex.vert和fragment.frag，uniform的位置在初始化时查找
+class CorePainter
+{
+public:
+    bool initialize(const SourceFrame &frame)
+    {
+        m_program = OffscreenGL::linkProgram(OffscreenGL::readShaderFile("vertex.vert"), OffscreenGL::readShaderFile("fragment.frag"));
+        if (m_program == 0)
+        {
+            return false;
+        }
+
+        // OpenGLWidget::initializeGLSLShaders，采样器只设置一次，其余uniform记下位置
+        glUseProgram(m_program);
+        glUniform1i(glGetUniformLocation(m_program, "uni_textureY"), 0);
+        glUniform1i(glGetUniformLocation(m_program, "uni_textureU"), 1);
+        glUniform1i(glGetUniformLocation(m_program, "uni_textureV"), 2);
+        glUseProgram(0);
+        m_colorMatrixLocation = glGetUniformLocation(m_program, "uni_colorMatrix");
+        m_colorOffsetLocation = glGetUniformLocation(m_program, "uni_colorOffset");
+
+        // OpenGLWidget::initializeVertexBuffer，位置直接是裁剪坐标
+        static const Vertex quadVertices[] = {
+            {-1, 1, 0, 0, 0},
+            {-1, -1, 0, 0, 1},
+            {1, 1, 0, 1, 0},
+            {1, -1, 0, 1, 1}};
+        glGenVertexArrays(1, &m_vertexArray);
+        glBindVertexArray(m_vertexArray);
+        glGenBuffers(1, &m_vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(VIDEO_ATTR_POSITION);
+        glVertexAttribPointer(VIDEO_ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, x)));
+        glEnableVertexAttribArray(VIDEO_ATTR_UV);
+        glVertexAttribPointer(VIDEO_ATTR_UV, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, u)));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        allocateTextures(m_textures, frame);
+        colorMatrix(m_colorMatrix, m_colorOffset);
+        return true;
+    }
+
+    void destroy()
+    {
+        glDeleteTextures(3, m_textures);
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteVertexArrays(1, &m_vertexArray);
+        glDeleteProgram(m_program);
+    }
+
+    void paint(const SourceFrame &frame, bool isNewFrame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (isNewFrame)
+        {
+            uploadFrame(m_textures, frame);
+        }
+
+        glUseProgram(m_program);
+        if (m_isColorMatrixDirty)
+        {
+            glUniformMatrix3fv(m_colorMatrixLocation, 1, GL_FALSE, m_colorMatrix);
+            glUniform3f(m_colorOffsetLocation, m_colorOffset[0], m_colorOffset[1], m_colorOffset[2]);
+            m_isColorMatrixDirty = false;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        }
+
+        glBindVertexArray(m_vertexArray);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindVertexArray(0);
+        m_drawCalls++;
+
+        glUseProgram(0);
+    }
+
+    uint64_t m_drawCalls = 0;
+    uint64_t m_nameLookups = 0;
+
+private:
+    GLuint m_program = 0;
+    GLint m_colorMatrixLocation = -1;
+    GLint m_colorOffsetLocation = -1;
+    GLuint m_vertexArray = 0;
+    GLuint m_vertexBuffer = 0;
+    GLuint m_textures[3] = {0, 0, 0};
+    float m_colorMatrix[9] = {0};
+    float m_colorOffset[3] = {0};
+    bool m_isColorMatrixDirty = true;
+};
+
+struct PaintResult
+{
+    double m_repaintUs = 0;   // 没有新帧时一次绘制在CPU上的时间
+    double m_newFrameUs = 0;  // 有新帧时一次绘制在CPU上的时间，包括上传
+    double m_nameLookups = 0; // 每次绘制按名字查找uniform和顶点属性的次数
+    double m_drawCalls = 0;
+    bool m_isReady = false;
+    std::vector<uint8_t> m_pixels;
+};
+
+// 每次绘制后glFinish，不计入绘制的时间，GPU上的执行不会堆到下一次绘制里
+template <typename Painter>
+static double measurePaints(Painter &painter, const std::vector<SourceFrame> &frames, int paintCount, bool isNewFrame)
+{
+    std::chrono::steady_clock::duration paintTime{0};
+    for (int i = 0; i < paintCount; i++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        painter.paint(frames[i % frames.size()], isNewFrame);
+        paintTime += std::chrono::steady_clock::now() - startTime;
+        glFinish();
+    }
+    return std::chrono::duration<double, std::micro>(paintTime).count() / paintCount;
+}
+
+// 先画一次上传第一帧，然后测只重绘和每次都有新帧，最后再画一次最后那帧读回画面
+template <typename Painter>
+static PaintResult measure(OffscreenGL &gl, const std::vector<SourceFrame> &frames)
+{
+    PaintResult result;
+    if (!gl.createFramebuffer(BENCH_VIEWPORT_WIDTH, BENCH_VIEWPORT_HEIGHT))
+    {
+        return result;
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    Painter painter;
+    if (!painter.initialize(frames[0]))
+    {
+        painter.destroy();
+        return result;
+    }
+    painter.paint(frames[0], true);
+    glFinish();
+    painter.m_drawCalls = 0;
+    painter.m_nameLookups = 0;
+
+    result.m_repaintUs = measurePaints(painter, frames, BENCH_REPAINT_COUNT, false);
+    result.m_nameLookups = static_cast<double>(painter.m_nameLookups) / BENCH_REPAINT_COUNT;
+    result.m_drawCalls = static_cast<double>(painter.m_drawCalls) / BENCH_REPAINT_COUNT;
+    result.m_newFrameUs = measurePaints(painter, frames, BENCH_NEW_FRAME_PAINT_COUNT, true);
+
+    painter.paint(frames.back(), true);
+    glFinish();
+    result.m_pixels = gl.readFramebuffer();
+    result.m_isReady = glGetError() == GL_NO_ERROR;
+    painter.destroy();
+    return result;
+}
+
+int main()
+{
+    std::vector<SourceFrame> frames;
+    for (int i = 0; i < 3; i++)
+    {
+        frames.push_back(makeFrame(i));
+    }
+
+    // glLoadIdentity和客户端内存的顶点数组只有兼容profile里有
+    OffscreenGL gl;
+    if (!gl.create(2, 1, false))
+    {
+        std::printf("skipped: no offscreen OpenGL compatibility profile context\n");
+        return 0;
+    }
+    std::printf("renderer: %s\n", gl.renderer());
+    PaintResult legacyResult = measure<LegacyPainter>(gl, frames);
+
+    if (!gl.create(3, 3))
+    {
+        std::printf("skipped: no offscreen OpenGL 3.3 context\n");
+        return 0;
+    }
+    PaintResult coreResult = measure<CorePainter>(gl, frames);
+    gl.destroy();
+
+    CHECK(legacyResult.m_isReady);
+    CHECK(coreResult.m_isReady);
+    CHECK(legacyResult.m_nameLookups == 12);
+    CHECK(coreResult.m_nameLookups == 0);
+    CHECK(legacyResult.m_drawCalls == 1 && coreResult.m_drawCalls == 1);
+
+    // 两种方式画出来的画面逐像素比较，另外检查画面不是黑的
+    CHECK(legacyResult.m_pixels.size() == coreResult.m_pixels.size());
+    if (legacyResult.m_pixels.size() == coreResult.m_pixels.size())
+    {
+        int maxDiff = 0;
+        size_t litPixels = 0;
+        for (size_t i = 0; i < coreResult.m_pixels.size(); i += 4)
+        {
+            for (size_t channel = 0; channel < 3; channel++)
+            {
+                maxDiff = std::max(maxDiff, std::abs(legacyResult.m_pixels[i + channel] - coreResult.m_pixels[i + channel]));
+            }
+            litPixels += coreResult.m_pixels[i] + coreResult.m_pixels[i + 1] + coreResult.m_pixels[i + 2] > 0 ? 1 : 0;
+        }
+        CHECK(maxDiff <= BENCH_MAX_PIXEL_DIFF);
+        CHECK(litPixels > coreResult.m_pixels.size() / 4 * 9 / 10);
+    }
+
+    std::printf("legacy  repaint %7.1f us  new frame %8.1f us  %4.1f name lookups  %3.1f draws per paint\n", legacyResult.m_repaintUs,
+                legacyResult.m_newFrameUs, legacyResult.m_nameLookups, legacyResult.m_drawCalls);
+    std::printf("core    repaint %7.1f us  new frame %8.1f us  %4.1f name lookups  %3.1f draws per paint\n", coreResult.m_repaintUs,
+                coreResult.m_newFrameUs, coreResult.m_nameLookups, coreResult.m_drawCalls);
+
+    return testResult();
+}
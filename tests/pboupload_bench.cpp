@@ -0,0 +1,407 @@
+// PBO上传的性能测试：1080p的yuv420p帧，和OpenGLWidget::uploadFrame一样每帧更新Y、U、V三个纹理
+// 原来：解码器把帧写进普通内存，glTexSubImage2D在GL线程上从客户端内存拷贝
+// 现在：一个持久映射的PBO切成槽位，解码器直接写进映射的内存，纹理从PBO偏移更新，每次上传插一个fence，
+// fence触发以后槽位才还给解码器，槽位不够或者帧比槽位大时退回普通内存，和PboFrameAllocator一样
+// 解码器写帧的时间和GL线程提交上传的时间分开统计，最后glFinish算总时间；4K比槽位大，全部退回普通内存
+// 检查每种方式上传后纹理里的数据和源数据相同，并且连续上传超过一圈槽位时每一帧都对
+// 用EGL创建离屏上下文，没有可用的OpenGL 3.3时跳过，不支持glBufferStorage时只测普通内存
+
+#include "offscreengl.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#define BENCH_FRAME_COUNT 120
+// 源数据轮流用几帧不同的内容，槽位用错时读回的纹理对不上
+#define BENCH_SOURCE_FRAME_COUNT 3
+// 解码器输出的行宽按这个对齐，每行至少留出BENCH_ROW_PADDING字节的填充
+#define BENCH_LINESIZE_ALIGN 64
+#define BENCH_ROW_PADDING 32
+// 和PboFrameAllocator的PBO_RING_SLOT_COUNT、PBO_RING_MAX_WIDTH、PBO_RING_MAX_HEIGHT相同
+#define BENCH_SLOT_COUNT 16
+#define BENCH_SLOT_MAX_WIDTH 1920
+#define BENCH_SLOT_MAX_HEIGHT 1088
+// 解码器留着最近几帧做参考帧，它们的槽位在GPU读完以后也不能回收，这样连续的帧会轮流用到不同的槽位
+#define BENCH_REFERENCE_FRAMES 4
+// 和PboFrameAllocator的映射方式相同
+#define BENCH_MAP_FLAGS (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+#define BENCH_STORAGE_FLAGS (BENCH_MAP_FLAGS | GL_CLIENT_STORAGE_BIT)
+
+// 解码器输出的一帧，三个平面按各自的行宽连续存放，平面的起始位置按BENCH_LINESIZE_ALIGN对齐
+struct SourceFrame
+{
+    int m_widths[3] = {0, 0, 0};
+    int m_heights[3] = {0, 0, 0};
+    int m_linesizes[3] = {0, 0, 0};
+    size_t m_offsets[3] = {0, 0, 0};
+    std::vector<uint8_t> m_data;
+};
+
+static size_t alignSize(size_t size)
+{
+    return (size + BENCH_LINESIZE_ALIGN - 1) / BENCH_LINESIZE_ALIGN * BENCH_LINESIZE_ALIGN;
+}
+
+static SourceFrame makeFrame(int width, int height, int seed)
+{
+    SourceFrame frame;
+    size_t size = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        frame.m_widths[plane] = plane == 0 ? width : width / 2;
+        frame.m_heights[plane] = plane == 0 ? height : height / 2;
+        frame.m_linesizes[plane] = static_cast<int>(alignSize(frame.m_widths[plane] + BENCH_ROW_PADDING));
+        frame.m_offsets[plane] = size;
+        size += alignSize(static_cast<size_t>(frame.m_linesizes[plane]) * frame.m_heights[plane]);
+    }
+
+    frame.m_data.resize(size);
+    for (size_t i = 0; i < frame.m_data.size(); i++)
+    {
+        frame.m_data[i] = static_cast<uint8_t>((i * 13 + seed * 71) & 0xFF);
+    }
+    return frame;
+}
+
+// GPU还在读的槽位，fence触发以后还给解码器
+struct PendingUpload
+{
+    GLsync m_fence = nullptr;
+    int m_slot = -1;
+};
+
+// 持久映射的PBO，isPersistent为false时不创建，所有帧都在普通内存里
+// 槽位的引用计数代替帧的AVBufferRef：解码器的参考帧一个，GPU还在读一个，都释放以后回到空闲列表
+struct PboRing
+{
+    GLuint m_buffer = 0;
+    uint8_t *m_pMapped = nullptr;
+    size_t m_slotSize = 0;
+    std::vector<int> m_freeSlots;
+    std::vector<int> m_slotRefs;
+    std::deque<PendingUpload> m_pendingUploads;
+};
+
+static void releaseSlot(PboRing &ring, int slot)
+{
+    if (--ring.m_slotRefs[slot] == 0)
+    {
+        ring.m_freeSlots.push_back(slot);
+    }
+}
+
+static bool createRing(PboRing &ring, bool isPersistent)
+{
+    SourceFrame maxFrame = makeFrame(BENCH_SLOT_MAX_WIDTH, BENCH_SLOT_MAX_HEIGHT, 0);
+    ring.m_slotSize = maxFrame.m_data.size();
+    if (!isPersistent)
+    {
+        return true;
+    }
+
+    glGenBuffers(1, &ring.m_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.m_buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ring.m_slotSize * BENCH_SLOT_COUNT, nullptr, BENCH_STORAGE_FLAGS);
+    ring.m_pMapped = static_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ring.m_slotSize * BENCH_SLOT_COUNT, BENCH_MAP_FLAGS));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (ring.m_pMapped == nullptr)
+    {
+        std::printf("glMapBufferRange error: %u\n", glGetError());
+        return false;
+    }
+
+    for (int i = BENCH_SLOT_COUNT - 1; i >= 0; i--)
+    {
+        ring.m_freeSlots.push_back(i);
+    }
+    ring.m_slotRefs.assign(BENCH_SLOT_COUNT, 0);
+    return true;
+}
+
+static void destroyRing(PboRing &ring)
+{
+    for (PendingUpload &pendingUpload : ring.m_pendingUploads)
+    {
+        glDeleteSync(pendingUpload.m_fence);
+    }
+    ring.m_pendingUploads.clear();
+    if (ring.m_buffer != 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.m_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &ring.m_buffer);
+        ring.m_buffer = 0;
+    }
+    ring.m_pMapped = nullptr;
+}
+
+// OpenGLWidget::releaseFinishedUploads，fence按提交顺序触发，遇到第一个没完成的就停下
+static void releaseFinishedUploads(PboRing &ring)
+{
+    while (!ring.m_pendingUploads.empty())
+    {
+        GLenum result = glClientWaitSync(ring.m_pendingUploads.front().m_fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+
+        glDeleteSync(ring.m_pendingUploads.front().m_fence);
+        releaseSlot(ring, ring.m_pendingUploads.front().m_slot);
+        ring.m_pendingUploads.pop_front();
+    }
+}
+
+static void allocateStorage(const GLuint textures[3], const SourceFrame &frame)
+{
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, frame.m_widths[plane], frame.m_heights[plane]);
+    }
+}
+
+// OpenGLWidget::uploadFrame，帧在PBO里时传给glTexSubImage2D的是相对PBO起点的偏移
+static void uploadFrame(const GLuint textures[3], const SourceFrame &frame, const uint8_t *pData, PboRing &ring, int slot)
+{
+    if (slot >= 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.m_buffer);
+    }
+
+    for (int plane = 0; plane < 3; plane++)
+    {
+        const void *pixels = pData + frame.m_offsets[plane];
+        if (slot >= 0)
+        {
+            pixels = reinterpret_cast<const void *>(pData + frame.m_offsets[plane] - ring.m_pMapped);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.m_linesizes[plane]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.m_widths[plane], frame.m_heights[plane], GL_RED, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    if (slot >= 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        PendingUpload pendingUpload;
+        pendingUpload.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pendingUpload.m_slot = slot;
+        ring.m_pendingUploads.push_back(pendingUpload);
+        ring.m_slotRefs[slot]++;
+    }
+}
+
+// 读回纹理，和源数据逐行比较
+static bool isTextureEqual(const GLuint textures[3], const SourceFrame &frame)
+{
+    bool isEqual = true;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int plane = 0; plane < 3; plane++)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(frame.m_widths[plane]) * frame.m_heights[plane]);
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        for (int y = 0; isEqual && y < frame.m_heights[plane]; y++)
+        {
+            isEqual = memcmp(pixels.data() + static_cast<size_t>(y) * frame.m_widths[plane],
+                             frame.m_data.data() + frame.m_offsets[plane] + static_cast<size_t>(y) * frame.m_linesizes[plane], frame.m_widths[plane]) == 0;
+        }
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return isEqual;
+}
+
+struct UploadResult
+{
+    double m_decodeWriteUs = 0; // 解码器把一帧写进槽位或者普通内存
+    double m_submitUs = 0;      // GL线程回收槽位、提交上传和fence
+    double m_totalUs = 0;       // 包括最后glFinish，平均到每帧
+    int m_pboFrames = 0;
+    int m_fallbackFrames = 0;
+    int m_noFreeSlot = 0;
+    bool m_isEachFrameEqual = true;
+};
+
+// 单线程模拟解码线程和GL线程交替：回收GPU读完的槽位，解码器取一个槽位写帧，GL线程上传
+// isVerifyEachFrame为true时每帧上传后读回比较，这时的时间没有意义
+static UploadResult measure(const std::vector<SourceFrame> &frames, bool isPersistent, int frameCount, bool isVerifyEachFrame)
+{
+    UploadResult result;
+    PboRing ring;
+    if (!createRing(ring, isPersistent))
+    {
+        result.m_isEachFrameEqual = false;
+        return result;
+    }
+
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    allocateStorage(textures, frames[0]);
+    std::vector<uint8_t> fallbackBuffer(frames[0].m_data.size());
+    std::deque<int> referenceSlots;
+
+    std::chrono::steady_clock::duration decodeWriteTime{0};
+    std::chrono::steady_clock::duration submitTime{0};
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < frameCount; i++)
+    {
+        const SourceFrame &frame = frames[i % frames.size()];
+
+        auto submitStartTime = std::chrono::steady_clock::now();
+        releaseFinishedUploads(ring);
+        submitTime += std::chrono::steady_clock::now() - submitStartTime;
+
+        // PboFrameAllocator::allocateFrame，帧比槽位大或者没有空闲槽位时退回普通内存
+        auto decodeStartTime = std::chrono::steady_clock::now();
+        int slot = -1;
+        if (isPersistent && frame.m_data.size() <= ring.m_slotSize)
+        {
+            if (!ring.m_freeSlots.empty())
+            {
+                slot = ring.m_freeSlots.back();
+                ring.m_freeSlots.pop_back();
+                ring.m_slotRefs[slot] = 1;
+            }
+            else
+            {
+                result.m_noFreeSlot++;
+            }
+        }
+        uint8_t *pData = slot >= 0 ? ring.m_pMapped + slot * ring.m_slotSize : fallbackBuffer.data();
+        memcpy(pData, frame.m_data.data(), frame.m_data.size());
+        decodeWriteTime += std::chrono::steady_clock::now() - decodeStartTime;
+
+        submitStartTime = std::chrono::steady_clock::now();
+        uploadFrame(textures, frame, pData, ring, slot);
+        submitTime += std::chrono::steady_clock::now() - submitStartTime;
+
+        if (slot >= 0)
+        {
+            // 新的参考帧进来，最老的一个不再被参考
+            referenceSlots.push_back(slot);
+            if (referenceSlots.size() > BENCH_REFERENCE_FRAMES)
+            {
+                releaseSlot(ring, referenceSlots.front());
+                referenceSlots.pop_front();
+            }
+            result.m_pboFrames++;
+        }
+        else
+        {
+            result.m_fallbackFrames++;
+        }
+        if (isVerifyEachFrame)
+        {
+            result.m_isEachFrameEqual = isTextureEqual(textures, frame) && result.m_isEachFrameEqual;
+        }
+    }
+    glFinish();
+    double totalUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+
+    // glFinish以后所有fence都触发了，解码器也放掉参考帧，槽位全部回收
+    releaseFinishedUploads(ring);
+    for (int slot : referenceSlots)
+    {
+        releaseSlot(ring, slot);
+    }
+    CHECK(ring.m_pendingUploads.empty());
+    CHECK(!isPersistent || ring.m_freeSlots.size() == BENCH_SLOT_COUNT);
+    CHECK(isTextureEqual(textures, frames[(frameCount - 1) % frames.size()]));
+
+    result.m_decodeWriteUs = std::chrono::duration<double, std::micro>(decodeWriteTime).count() / frameCount;
+    result.m_submitUs = std::chrono::duration<double, std::micro>(submitTime).count() / frameCount;
+    result.m_totalUs = totalUs / frameCount;
+
+    glDeleteTextures(3, textures);
+    destroyRing(ring);
+    return result;
+}
+
+static void printResult(const char *name, const char *mode, const UploadResult &result)
+{
+    std::printf("%-5s %-18s decoder write %7.1f us  GL submit %7.1f us  total %7.1f us/frame  pbo %d  fallback %d  no free slot %d\n", name, mode,
+                result.m_decodeWriteUs, result.m_submitUs, result.m_totalUs, result.m_pboFrames, result.m_fallbackFrames, result.m_noFreeSlot);
+}
+
+static void runBench(const char *name, int width, int height, bool hasBufferStorage)
+{
+    std::vector<SourceFrame> frames;
+    for (int i = 0; i < BENCH_SOURCE_FRAME_COUNT; i++)
+    {
+        frames.push_back(makeFrame(width, height, i));
+    }
+    bool isFitInSlot = frames[0].m_data.size() <= makeFrame(BENCH_SLOT_MAX_WIDTH, BENCH_SLOT_MAX_HEIGHT, 0).m_data.size();
+
+    UploadResult clientResult = measure(frames, false, BENCH_FRAME_COUNT, false);
+    printResult(name, "client memory", clientResult);
+    CHECK(clientResult.m_fallbackFrames == BENCH_FRAME_COUNT);
+    if (!hasBufferStorage)
+    {
+        return;
+    }
+
+    // 先转两圈多的槽位，每帧读回比较，确认偏移和槽位回收是对的
+    UploadResult verifyResult = measure(frames, true, BENCH_SLOT_COUNT * 2 + 1, true);
+    CHECK(verifyResult.m_isEachFrameEqual);
+
+    UploadResult pboResult = measure(frames, true, BENCH_FRAME_COUNT, false);
+    printResult(name, "persistent pbo", pboResult);
+    if (isFitInSlot)
+    {
+        CHECK(verifyResult.m_pboFrames == BENCH_SLOT_COUNT * 2 + 1);
+        CHECK(pboResult.m_pboFrames + pboResult.m_noFreeSlot == BENCH_FRAME_COUNT);
+    }
+    else
+    {
+        CHECK(pboResult.m_fallbackFrames == BENCH_FRAME_COUNT);
+    }
+    CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main()
+{
+    OffscreenGL gl;
+    if (!gl.create(3, 3))
+    {
+        std::printf("skipped: no offscreen OpenGL 3.3 context\n");
+        return 0;
+    }
+    std::printf("renderer: %s\n", gl.renderer());
+
+    // 和PboFrameAllocator::create一样，4.4以上或者有GL_ARB_buffer_storage才能持久映射
+    GLint majorVersion = 0;
+    GLint minorVersion = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+    bool hasBufferStorage = majorVersion > 4 || (majorVersion == 4 && minorVersion >= 4);
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; !hasBufferStorage && i < extensionCount; i++)
+    {
+        hasBufferStorage = strcmp(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_buffer_storage") == 0;
+    }
+    if (!hasBufferStorage)
+    {
+        std::printf("persistent buffer mapping is not supported, only client memory uploads are measured\n");
+    }
+
+    runBench("1080p", 1920, 1080, hasBufferStorage);
+    runBench("4K", 3840, 2160, hasBufferStorage);
+
+    return testResult();
+}
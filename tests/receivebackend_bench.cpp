@@ -0,0 +1,122 @@
+// 接收后端的性能对比：本机代替服务端连续发送视频消息，客户端分别用recv和io_uring接收
+// 打印每秒收到的消息数、吞吐量，以及客户端每个消息用的CPU时间
+// 检查每个消息都收到并且没有丢失；编译时没有liburing时只测recv
+// 单核机器上发送和接收抢同一个CPU，消息速率只能和同一台机器上的其他结果比较
+
+#include "../videoclient.h"
+#include "cpuusage.h"
+#include "standinserver.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+
+#define BENCH_MESSAGE_COUNT 20000
+#define BENCH_PAYLOAD_SIZE (16 * 1024)
+#define BENCH_TIMEOUT_MS 30000
+
+struct BenchResult
+{
+    uint64_t m_received = 0;
+    uint64_t m_lost = 0;
+    double m_seconds = 0;
+    double m_clientCpuSeconds = 0;
+};
+
+static bool waitReceived(VideoClient &client, uint64_t count)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCH_TIMEOUT_MS);
+    while (client.clientStats().m_videoPackets < count)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+static BenchResult runBench(int receiveBackend)
+{
+    BenchResult result;
+    StandInServer server;
+    if (!server.start())
+    {
+        return result;
+    }
+
+    NetConnectInfo netConnectInfo("127.0.0.1", server.port());
+    netConnectInfo.m_receiveBackend = receiveBackend;
+    VideoClient client;
+    client.startSocketConnection(netConnectInfo);
+    if (!server.waitAccepted(1, BENCH_TIMEOUT_MS))
+    {
+        return result;
+    }
+
+    CpuUsage startUsage = cpuUsage();
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        std::vector<uint8_t> message = StandInServer::makeVideoMessage(i, BENCH_PAYLOAD_SIZE);
+        server.broadcast(message.data(), message.size());
+    }
+    waitReceived(client, BENCH_MESSAGE_COUNT);
+    result.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    // 等待期间主线程一直在让出CPU，这部分时间也算在主线程上，不会算到客户端头上
+    result.m_clientCpuSeconds = otherThreadsCpuSeconds(startUsage, cpuUsage());
+
+    ClientStats stats = client.clientStats();
+    result.m_received = stats.m_videoPackets;
+    result.m_lost = stats.m_lostMessages;
+    client.stopSocketConnection();
+    return result;
+}
+
+static void printResult(const char *name, const BenchResult &result)
+{
+    double messages = result.m_received > 0 ? static_cast<double>(result.m_received) : 1;
+    std::printf("%-8s %10.0f msg/s  %8.1f MB/s  client CPU %6.2f us/msg  %5.1f%% of a core\n", name, messages / result.m_seconds,
+                messages * BENCH_PAYLOAD_SIZE / result.m_seconds / (1024 * 1024), result.m_clientCpuSeconds * 1e6 / messages,
+                result.m_clientCpuSeconds / result.m_seconds * 100);
+}
+
+static void checkResult(const BenchResult &result)
+{
+    CHECK(result.m_received == BENCH_MESSAGE_COUNT);
+    CHECK(result.m_lost == 0);
+}
+
+int main()
+{
+    BenchResult recvResult = runBench(RECEIVE_BACKEND_RECV);
+    printResult("recv", recvResult);
+    checkResult(recvResult);
+
+#ifdef HAVE_LIBURING
+    // 内核不支持时客户端会退回recv并打印提示，这一行测到的就是recv
+    BenchResult uringResult = runBench(RECEIVE_BACKEND_IO_URING);
+    printResult("io_uring", uringResult);
+    checkResult(uringResult);
+#else
+    std::printf("io_uring: skipped, built without liburing\n");
+#endif
+
+    return testResult();
+}
+
+#else
+
+int main()
+{
+    std::printf("skipped: the stand-in server is only implemented for Linux\n");
+    return 0;
+}
+
+#endif
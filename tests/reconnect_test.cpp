@@ -0,0 +1,98 @@
+// 断线重连的测试：本机起一个代替服务端的监听，客户端连上以后关掉它
+// 检查客户端每次重连前等待的时间在指数退避的范围内，逐次变长并且带随机抖动，监听恢复后客户端能重新连上
+// 全部通过返回0，否则返回1
+
+#include "../videoclient.h"
+#include "standinserver.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+
+// 记录这么多次重连的等待时间，最大等待时间依次是200, 400, 800, 1600毫秒
+#define TEST_RECONNECT_SAMPLES 4
+#define TEST_TIMEOUT_MS 10000
+
+static ClientStats waitReconnect(VideoClient &client, uint64_t reconnectCount)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEST_TIMEOUT_MS);
+    ClientStats stats = client.clientStats();
+    while (stats.m_reconnectCount <= reconnectCount && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stats = client.clientStats();
+    }
+    return stats;
+}
+
+// 第i次重连等待的时间在[最大值/2, 最大值]之间，最大值从RECONNECT_BASE_DELAY_MS开始每次翻倍
+static void testReconnectBackoff()
+{
+    StandInServer server;
+    CHECK(server.start());
+
+    VideoClient client;
+    client.startSocketConnection(NetConnectInfo("127.0.0.1", server.port()));
+    CHECK(server.waitAccepted(1, TEST_TIMEOUT_MS));
+
+    // 服务端下线，连接断开以后监听也不在了，之后每次重连都被拒绝
+    server.stop();
+    std::vector<int64_t> delays;
+    uint64_t reconnectCount = client.clientStats().m_reconnectCount;
+    for (int i = 0; i < TEST_RECONNECT_SAMPLES; i++)
+    {
+        ClientStats stats = waitReconnect(client, reconnectCount);
+        if (stats.m_reconnectCount != reconnectCount + 1)
+        {
+            break;
+        }
+        reconnectCount = stats.m_reconnectCount;
+        delays.push_back(stats.m_lastReconnectDelayMs);
+    }
+    CHECK(delays.size() == TEST_RECONNECT_SAMPLES);
+
+    bool isInRange = true;
+    bool isAllAtMax = true;
+    int64_t maxDelayMs = RECONNECT_BASE_DELAY_MS;
+    for (size_t i = 0; i < delays.size(); i++)
+    {
+        isInRange = isInRange && delays[i] >= maxDelayMs / 2 && delays[i] <= maxDelayMs;
+        isAllAtMax = isAllAtMax && delays[i] == maxDelayMs;
+        std::printf("reconnect %zu: waited %lld ms, range [%lld, %lld]\n", i + 1, static_cast<long long>(delays[i]),
+                    static_cast<long long>(maxDelayMs / 2), static_cast<long long>(maxDelayMs));
+        maxDelayMs = std::min<int64_t>(maxDelayMs * 2, RECONNECT_MAX_DELAY_MS);
+    }
+    CHECK(isInRange);
+    CHECK(!isAllAtMax);
+    CHECK(!delays.empty() && delays.back() > delays.front());
+
+    // 服务端在原来的端口上恢复，客户端下一次重连成功
+    CHECK(server.start(server.port()));
+    CHECK(server.waitAccepted(2, TEST_TIMEOUT_MS));
+    ClientStats stats = client.clientStats();
+    CHECK(stats.m_disconnectCount == 1);
+    client.stopSocketConnection();
+}
+
+int main()
+{
+    testReconnectBackoff();
+
+    return testResult();
+}
+
+#else
+
+int main()
+{
+    std::printf("skipped: the stand-in server is only implemented for Linux\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,258 @@
+// RtpReceiver的测试：NACK包里PID/BLP的打包、FU-A分片的还原、分片开头丢失时整帧丢弃并标记丢包
+// 直接构造RTP数据报送进去，时间由测试传入
+// 全部通过返回0，否则返回1
+
+#include "../rtpreceiver.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using Clock = JitterBuffer::Clock;
+
+#define TEST_LATENCY_MS 50
+#define TEST_SSRC 0x12345678u
+#define TEST_PAYLOAD_TYPE 96
+
+// 输出的一帧
+struct AccessUnit
+{
+    std::vector<uint8_t> m_data;
+    bool m_isAfterLoss = false;
+};
+
+static Clock::time_point at(int64_t ms)
+{
+    return Clock::time_point() + std::chrono::milliseconds(ms);
+}
+
+static std::vector<uint8_t> makeRtp(uint16_t sequence, uint32_t timestamp, bool marker, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> packet = {
+        0x80,
+        static_cast<uint8_t>((marker ? 0x80 : 0) | TEST_PAYLOAD_TYPE),
+        static_cast<uint8_t>(sequence >> 8),
+        static_cast<uint8_t>(sequence & 0xFF),
+        static_cast<uint8_t>(timestamp >> 24),
+        static_cast<uint8_t>(timestamp >> 16),
+        static_cast<uint8_t>(timestamp >> 8),
+        static_cast<uint8_t>(timestamp & 0xFF),
+        static_cast<uint8_t>(TEST_SSRC >> 24),
+        static_cast<uint8_t>(TEST_SSRC >> 16),
+        static_cast<uint8_t>(TEST_SSRC >> 8),
+        static_cast<uint8_t>(TEST_SSRC & 0xFF),
+    };
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    return packet;
+}
+
+static void push(RtpReceiver &receiver, uint16_t sequence, uint32_t timestamp, bool marker, const std::vector<uint8_t> &payload, int64_t ms)
+{
+    std::vector<uint8_t> packet = makeRtp(sequence, timestamp, marker, payload);
+    receiver.pushDatagram(packet.data(), packet.size(), at(ms));
+}
+
+// FU-A分片：FU indicator保留NAL头的F/NRI，类型28；FU header是起始/结束标记加NAL类型
+static std::vector<uint8_t> makeFragment(uint8_t nalHeader, bool isStart, bool isEnd, const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> payload = {
+        static_cast<uint8_t>((nalHeader & 0xE0) | 28),
+        static_cast<uint8_t>((isStart ? 0x80 : 0) | (isEnd ? 0x40 : 0) | (nalHeader & 0x1F)),
+    };
+    payload.insert(payload.end(), data.begin(), data.end());
+    return payload;
+}
+
+static std::vector<AccessUnit> process(RtpReceiver &receiver, int64_t ms)
+{
+    std::vector<AccessUnit> accessUnits;
+    receiver.process(at(ms), [&accessUnits](AVBufferRef *buffer, size_t length, bool isAfterLoss) {
+        AccessUnit accessUnit;
+        accessUnit.m_data.assign(buffer->data, buffer->data + length);
+        accessUnit.m_isAfterLoss = isAfterLoss;
+        accessUnits.push_back(accessUnit);
+        av_buffer_unref(&buffer);
+    });
+    return accessUnits;
+}
+
+static uint16_t readUint16(const std::vector<uint8_t> &data, size_t offset)
+{
+    return static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+}
+
+static uint32_t readUint32(const std::vector<uint8_t> &data, size_t offset)
+{
+    return (static_cast<uint32_t>(readUint16(data, offset)) << 16) | readUint16(data, offset + 2);
+}
+
+// 按序号发一串单NAL包，每个包一帧，跳过skipped里的序号
+static void pushSingleNals(RtpReceiver &receiver, uint16_t first, int count, const std::vector<uint16_t> &skipped, int64_t ms)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t sequence = static_cast<uint16_t>(first + i);
+        bool isSkipped = false;
+        for (uint16_t skippedSequence : skipped)
+        {
+            isSkipped = isSkipped || skippedSequence == sequence;
+        }
+        if (!isSkipped)
+        {
+            push(receiver, sequence, sequence * 3000u, true, {0x41, static_cast<uint8_t>(sequence & 0xFF)}, ms);
+        }
+    }
+}
+
+// 缺失的序号10, 11, 13, 26, 27, 100：10后面16个以内的11, 13, 26放进第一个BLP，27和100各自一项
+static void testNackPacking()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+    receiver.setLatency(1000);
+    pushSingleNals(receiver, 9, 93, {10, 11, 13, 26, 27, 100}, 0);
+
+    std::vector<uint8_t> packet;
+    CHECK(receiver.buildNackPacket(packet, at(0)) == 0);
+    CHECK(receiver.buildNackPacket(packet, at(NACK_REORDER_DELAY_MS)) == 24);
+    if (packet.size() != 24)
+    {
+        return;
+    }
+
+    // RTCP头：V=2, FMT=1, PT=205，长度是32位字数减1
+    CHECK(packet[0] == (0x80 | RTCP_FMT_GENERIC_NACK));
+    CHECK(packet[1] == RTCP_PT_RTPFB);
+    CHECK(readUint16(packet, 2) == 5);
+    CHECK(readUint32(packet, 8) == TEST_SSRC);
+
+    CHECK(readUint16(packet, 12) == 10);
+    CHECK(readUint16(packet, 14) == ((1 << 0) | (1 << 2) | (1 << 15)));
+    CHECK(readUint16(packet, 16) == 27);
+    CHECK(readUint16(packet, 18) == 0);
+    CHECK(readUint16(packet, 20) == 100);
+    CHECK(readUint16(packet, 22) == 0);
+
+    // 重传间隔之内不再请求
+    CHECK(receiver.buildNackPacket(packet, at(NACK_REORDER_DELAY_MS + 1)) == 0);
+}
+
+// 缺失的包跨过序号回绕，PID是回绕前的序号，回绕后的序号在BLP里
+static void testNackPackingWraparound()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+    receiver.setLatency(1000);
+    pushSingleNals(receiver, 65533, 6, {65535, 0, 1}, 0);
+
+    std::vector<uint8_t> packet;
+    CHECK(receiver.buildNackPacket(packet, at(NACK_REORDER_DELAY_MS)) == 16);
+    if (packet.size() == 16)
+    {
+        CHECK(readUint16(packet, 2) == 3);
+        CHECK(readUint16(packet, 12) == 65535);
+        CHECK(readUint16(packet, 14) == 0x0003);
+    }
+}
+
+// 一个NAL分成三片，还原成带起始码的一个NAL
+static void testFragmentReassembly()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+    receiver.setLatency(TEST_LATENCY_MS);
+
+    uint8_t nalHeader = 0x65;
+    push(receiver, 1, 3000, false, makeFragment(nalHeader, true, false, {1, 2, 3}), 0);
+    push(receiver, 2, 3000, false, makeFragment(nalHeader, false, false, {4, 5}), 0);
+    push(receiver, 3, 3000, true, makeFragment(nalHeader, false, true, {6}), 0);
+
+    std::vector<AccessUnit> accessUnits = process(receiver, 0);
+    CHECK(accessUnits.size() == 1);
+    if (accessUnits.size() == 1)
+    {
+        CHECK((accessUnits[0].m_data == std::vector<uint8_t>{0, 0, 0, 1, nalHeader, 1, 2, 3, 4, 5, 6}));
+        CHECK(!accessUnits[0].m_isAfterLoss);
+    }
+    CHECK(receiver.stats().m_accessUnits == 1);
+    CHECK(receiver.stats().m_brokenAccessUnits == 0);
+}
+
+// 分片的开头丢了：抖动缓冲区超时跳过以后，剩下的分片组成的帧丢弃，下一帧带丢包标记
+static void testFragmentLostStart()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+    receiver.setLatency(TEST_LATENCY_MS);
+
+    uint8_t nalHeader = 0x65;
+    push(receiver, 1, 3000, true, {0x41, 0xAA}, 0);
+    // 序号2是丢掉的起始分片
+    push(receiver, 3, 6000, false, makeFragment(nalHeader, false, false, {4, 5}), 1);
+    push(receiver, 4, 6000, true, makeFragment(nalHeader, false, true, {6}), 1);
+    push(receiver, 5, 9000, true, {0x41, 0xBB}, 2);
+
+    std::vector<AccessUnit> accessUnits = process(receiver, 2);
+    CHECK(accessUnits.size() == 1);
+
+    // 等到超时，跳过序号2
+    accessUnits = process(receiver, 1 + TEST_LATENCY_MS);
+    CHECK(accessUnits.size() == 1);
+    if (accessUnits.size() == 1)
+    {
+        CHECK((accessUnits[0].m_data == std::vector<uint8_t>{0, 0, 0, 1, 0x41, 0xBB}));
+        CHECK(accessUnits[0].m_isAfterLoss);
+    }
+    CHECK(receiver.stats().m_accessUnits == 2);
+    CHECK(receiver.stats().m_brokenAccessUnits == 1);
+    CHECK(receiver.jitterStats().m_lost == 1);
+}
+
+// 流从分片的中间开始，抖动缓冲区不知道前面有包，由FU-A的起始标记发现
+static void testFragmentStreamStartsMidNal()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+    receiver.setLatency(TEST_LATENCY_MS);
+
+    uint8_t nalHeader = 0x65;
+    push(receiver, 7, 3000, false, makeFragment(nalHeader, false, false, {4, 5}), 0);
+    push(receiver, 8, 3000, true, makeFragment(nalHeader, false, true, {6}), 0);
+    push(receiver, 9, 6000, true, {0x41, 0xCC}, 0);
+
+    std::vector<AccessUnit> accessUnits = process(receiver, 0);
+    CHECK(accessUnits.size() == 1);
+    if (accessUnits.size() == 1)
+    {
+        CHECK((accessUnits[0].m_data == std::vector<uint8_t>{0, 0, 0, 1, 0x41, 0xCC}));
+        CHECK(accessUnits[0].m_isAfterLoss);
+    }
+    CHECK(receiver.stats().m_brokenAccessUnits == 1);
+}
+
+// 不是RTP版本2，或者短于RTP头的数据报
+static void testInvalidDatagram()
+{
+    PacketBufferPool packetPool;
+    RtpReceiver receiver(&packetPool);
+
+    std::vector<uint8_t> packet = makeRtp(1, 3000, true, {0x41, 0x01});
+    packet[0] = 0x40;
+    receiver.pushDatagram(packet.data(), packet.size(), at(0));
+    receiver.pushDatagram(packet.data(), RTP_HEADER_SIZE - 1, at(0));
+    CHECK(receiver.stats().m_invalidPackets == 2);
+    CHECK(process(receiver, 0).empty());
+}
+
+int main()
+{
+    testNackPacking();
+    testNackPackingWraparound();
+    testFragmentReassembly();
+    testFragmentLostStart();
+    testFragmentStreamStartsMidNal();
+    testInvalidDatagram();
+
+    return testResult();
+}
@@ -0,0 +1,190 @@
+// 套接字参数的性能测试：本机代替服务端给客户端发视频消息，每组参数分别测吞吐量和延迟
+// 吞吐量是连续发送大消息时每秒收到的数据量；延迟是一次只发一个小消息，从发出到客户端收完的时间
+// 打印连接后读回来的实际参数，检查每个消息都收到，并且设置的参数确实生效
+// 消息不标记IDR，客户端在送进解码器之前丢掉，测到的只有接收路径
+
+#include "../videoclient.h"
+#include "standinserver.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+
+#define BENCH_THROUGHPUT_MESSAGES 10000
+#define BENCH_THROUGHPUT_PAYLOAD_SIZE (16 * 1024)
+#define BENCH_LATENCY_MESSAGES 2000
+#define BENCH_LATENCY_PAYLOAD_SIZE 256
+#define BENCH_LARGE_BUFFER_SIZE (4 * 1024 * 1024)
+#define BENCH_BUSY_POLL_US 50
+#define BENCH_TIMEOUT_MS 30000
+
+struct BenchResult
+{
+    SocketOptions m_options;
+    bool m_isConnected = false;
+    uint64_t m_received = 0;
+    double m_megabytesPerSecond = 0;
+    std::vector<int64_t> m_latenciesNs;
+};
+
+static bool waitReceived(VideoClient &client, uint64_t count)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCH_TIMEOUT_MS);
+    while (client.clientStats().m_videoPackets < count)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// 连接完成时客户端会读回实际参数，在这之前读到的都是0
+static bool waitConnected(VideoClient &client)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCH_TIMEOUT_MS);
+    while (client.socketOptions().m_receiveBufferSize <= 0)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static BenchResult runBench(const NetConnectInfo &options)
+{
+    BenchResult result;
+    StandInServer server;
+    if (!server.start())
+    {
+        return result;
+    }
+
+    NetConnectInfo netConnectInfo = options;
+    netConnectInfo.m_serverIP = "127.0.0.1";
+    netConnectInfo.m_port = server.port();
+    VideoClient client;
+    client.startSocketConnection(netConnectInfo);
+    result.m_isConnected = server.waitAccepted(1, BENCH_TIMEOUT_MS) && waitConnected(client);
+    if (!result.m_isConnected)
+    {
+        return result;
+    }
+    result.m_options = client.socketOptions();
+
+    uint32_t sequence = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_THROUGHPUT_MESSAGES; i++)
+    {
+        std::vector<uint8_t> message = StandInServer::makeVideoMessage(sequence++, BENCH_THROUGHPUT_PAYLOAD_SIZE);
+        server.broadcast(message.data(), message.size());
+    }
+    waitReceived(client, sequence);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.m_megabytesPerSecond = static_cast<double>(BENCH_THROUGHPUT_MESSAGES) * BENCH_THROUGHPUT_PAYLOAD_SIZE / seconds / (1024 * 1024);
+
+    for (int i = 0; i < BENCH_LATENCY_MESSAGES; i++)
+    {
+        std::vector<uint8_t> message = StandInServer::makeVideoMessage(sequence++, BENCH_LATENCY_PAYLOAD_SIZE);
+        auto sendTime = std::chrono::steady_clock::now();
+        server.broadcast(message.data(), message.size());
+        if (!waitReceived(client, sequence))
+        {
+            break;
+        }
+        result.m_latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sendTime).count());
+    }
+    std::sort(result.m_latenciesNs.begin(), result.m_latenciesNs.end());
+
+    ClientStats stats = client.clientStats();
+    result.m_received = stats.m_videoPackets;
+    CHECK(stats.m_lostMessages == 0);
+    client.stopSocketConnection();
+    return result;
+}
+
+static double percentileUs(const std::vector<int64_t> &sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * percentile));
+    return sorted[index] / 1000.0;
+}
+
+static void printResult(const char *name, const BenchResult &result)
+{
+    const SocketOptions &options = result.m_options;
+    std::printf("%-10s rcvbuf %8d sndbuf %8d nodelay %d quickack %d busy poll %3d us  %8.1f MB/s  latency p50 %7.1f us  p99 %7.1f us\n", name,
+                options.m_receiveBufferSize, options.m_sendBufferSize, options.m_isNoDelay, options.m_isQuickAck, options.m_busyPollMicros,
+                result.m_megabytesPerSecond, percentileUs(result.m_latenciesNs, 0.5), percentileUs(result.m_latenciesNs, 0.99));
+}
+
+static void checkResult(const BenchResult &result)
+{
+    CHECK(result.m_isConnected);
+    CHECK(result.m_received == BENCH_THROUGHPUT_MESSAGES + BENCH_LATENCY_MESSAGES);
+    CHECK(result.m_latenciesNs.size() == BENCH_LATENCY_MESSAGES);
+}
+
+int main()
+{
+    NetConnectInfo defaults;
+    BenchResult defaultResult = runBench(defaults);
+    printResult("default", defaultResult);
+    checkResult(defaultResult);
+    CHECK(defaultResult.m_options.m_isNoDelay);
+
+    NetConnectInfo largeBuffers;
+    largeBuffers.m_receiveBufferSize = BENCH_LARGE_BUFFER_SIZE;
+    largeBuffers.m_sendBufferSize = BENCH_LARGE_BUFFER_SIZE;
+    BenchResult largeBufferResult = runBench(largeBuffers);
+    printResult("buffers", largeBufferResult);
+    checkResult(largeBufferResult);
+    // 内核按net.core.rmem_max截断，但不会比默认值小
+    CHECK(largeBufferResult.m_options.m_receiveBufferSize >= defaultResult.m_options.m_receiveBufferSize);
+
+    NetConnectInfo noDelayOff;
+    noDelayOff.m_isNoDelay = false;
+    BenchResult noDelayOffResult = runBench(noDelayOff);
+    printResult("nagle", noDelayOffResult);
+    checkResult(noDelayOffResult);
+    CHECK(!noDelayOffResult.m_options.m_isNoDelay);
+
+    NetConnectInfo quickAck;
+    quickAck.m_isQuickAck = true;
+    BenchResult quickAckResult = runBench(quickAck);
+    printResult("quickack", quickAckResult);
+    checkResult(quickAckResult);
+
+    // 没有CAP_NET_ADMIN时设置失败，读回来是0，客户端照常工作
+    NetConnectInfo busyPoll;
+    busyPoll.m_busyPollMicros = BENCH_BUSY_POLL_US;
+    BenchResult busyPollResult = runBench(busyPoll);
+    printResult("busy poll", busyPollResult);
+    checkResult(busyPollResult);
+
+    return testResult();
+}
+
+#else
+
+int main()
+{
+    std::printf("skipped: the stand-in server is only implemented for Linux\n");
+    return 0;
+}
+
+#endif
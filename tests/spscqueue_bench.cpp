@@ -0,0 +1,236 @@
+// SpscQueue的性能测试：两个线程之间的吞吐量和往返延迟，和互斥锁保护的队列对比
+// 同时检查并发时元素不丢、不重复、按顺序，以及队列满时生产者和消费者同时出队，每个元素只被取走一次
+// 队列空或满时让出CPU而不是空转，单核的机器上也能跑完
+
+#include "../spscqueue.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define BENCH_ITEM_COUNT 200000
+#define BENCH_QUEUE_CAPACITY 256
+#define BENCH_ROUND_TRIP_COUNT 20000
+// 测试生产者自己丢掉最老元素时用小队列，让队列经常是满的
+#define BENCH_DROP_QUEUE_CAPACITY 8
+
+// 对比用的队列，接口和SpscQueue一样，每次入队出队都加锁
+class MutexQueue
+{
+public:
+    explicit MutexQueue(size_t capacity) : m_capacity(capacity)
+    {
+    }
+
+    bool tryPush(uint64_t &&value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.size() >= m_capacity)
+        {
+            return false;
+        }
+        m_items.push_back(value);
+        return true;
+    }
+
+    bool tryPop(uint64_t &value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty())
+        {
+            return false;
+        }
+        value = m_items.front();
+        m_items.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<uint64_t> m_items;
+    size_t m_capacity = 0;
+};
+
+template <typename Queue>
+static void pushWait(Queue &queue, uint64_t value)
+{
+    while (!queue.tryPush(std::move(value)))
+    {
+        std::this_thread::yield();
+    }
+}
+
+template <typename Queue>
+static uint64_t popWait(Queue &queue)
+{
+    uint64_t value = 0;
+    while (!queue.tryPop(value))
+    {
+        std::this_thread::yield();
+    }
+    return value;
+}
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 生产者连续入队，消费者检查顺序，返回每秒传递的元素个数
+template <typename Queue>
+static double measureThroughput(Queue &queue)
+{
+    bool isOrdered = true;
+    auto startTime = std::chrono::steady_clock::now();
+    std::thread consumer([&queue, &isOrdered]() {
+        for (uint64_t i = 0; i < BENCH_ITEM_COUNT; i++)
+        {
+            if (popWait(queue) != i)
+            {
+                isOrdered = false;
+            }
+        }
+    });
+
+    for (uint64_t i = 0; i < BENCH_ITEM_COUNT; i++)
+    {
+        pushWait(queue, i);
+    }
+    consumer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    CHECK(isOrdered);
+    return BENCH_ITEM_COUNT / seconds;
+}
+
+// 一个元素从主线程经过request队列到回声线程，再经过response队列回来的时间，排好序返回
+template <typename Queue>
+static std::vector<int64_t> measureRoundTrips(Queue &request, Queue &response)
+{
+    std::thread echo([&request, &response]() {
+        for (int i = 0; i < BENCH_ROUND_TRIP_COUNT; i++)
+        {
+            pushWait(response, popWait(request));
+        }
+    });
+
+    std::vector<int64_t> roundTrips;
+    roundTrips.reserve(BENCH_ROUND_TRIP_COUNT);
+    for (int i = 0; i < BENCH_ROUND_TRIP_COUNT; i++)
+    {
+        int64_t startNs = nowNs();
+        pushWait(request, static_cast<uint64_t>(startNs));
+        uint64_t value = popWait(response);
+        roundTrips.push_back(nowNs() - startNs);
+        CHECK(value == static_cast<uint64_t>(startNs));
+    }
+    echo.join();
+
+    std::sort(roundTrips.begin(), roundTrips.end());
+    return roundTrips;
+}
+
+static double percentileUs(const std::vector<int64_t> &sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * percentile));
+    return sorted[index] / 1000.0;
+}
+
+template <typename Queue>
+static void runBench(const char *name)
+{
+    Queue throughputQueue(BENCH_QUEUE_CAPACITY);
+    double itemsPerSecond = measureThroughput(throughputQueue);
+
+    Queue request(BENCH_QUEUE_CAPACITY);
+    Queue response(BENCH_QUEUE_CAPACITY);
+    std::vector<int64_t> roundTrips = measureRoundTrips(request, response);
+
+    std::printf("%-6s %8.2f M items/s  round trip p50 %7.2f us  p99 %8.2f us  max %9.2f us\n", name, itemsPerSecond / 1e6,
+                percentileUs(roundTrips, 0.5), percentileUs(roundTrips, 0.99), percentileUs(roundTrips, 1.0));
+}
+
+// 和DecodeQueue的DROP_OLDEST一样，队列满时生产者自己取出最老的元素丢掉，消费者同时在出队
+static void testProducerDrop()
+{
+    SpscQueue<uint64_t> queue(BENCH_DROP_QUEUE_CAPACITY);
+    std::atomic_bool isDone{false};
+    std::vector<uint64_t> consumed;
+    consumed.reserve(BENCH_ITEM_COUNT);
+
+    std::thread consumer([&queue, &isDone, &consumed]() {
+        uint64_t value = 0;
+        while (true)
+        {
+            if (queue.tryPop(value))
+            {
+                consumed.push_back(value);
+                continue;
+            }
+            if (isDone)
+            {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<uint64_t> dropped;
+    for (uint64_t i = 0; i < BENCH_ITEM_COUNT; i++)
+    {
+        uint64_t value = i;
+        uint64_t oldest = 0;
+        while (!queue.tryPush(std::move(value)))
+        {
+            if (queue.tryPop(oldest))
+            {
+                dropped.push_back(oldest);
+            }
+        }
+        // 时不时让出CPU，单核上消费者也有机会和生产者交替出队
+        if (i % 16 == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    isDone = true;
+    consumer.join();
+
+    // 两边取走的合起来正好是每个元素一次，各自都是递增的
+    CHECK(consumed.size() + dropped.size() == BENCH_ITEM_COUNT);
+    CHECK(std::is_sorted(consumed.begin(), consumed.end()));
+    CHECK(std::is_sorted(dropped.begin(), dropped.end()));
+    std::vector<uint64_t> all = consumed;
+    all.insert(all.end(), dropped.begin(), dropped.end());
+    std::sort(all.begin(), all.end());
+    bool isExactlyOnce = all.size() == BENCH_ITEM_COUNT;
+    for (size_t i = 0; isExactlyOnce && i < all.size(); i++)
+    {
+        isExactlyOnce = all[i] == i;
+    }
+    CHECK(isExactlyOnce);
+    std::printf("producer drop: %zu consumed, %zu dropped by the producer\n", consumed.size(), dropped.size());
+}
+
+int main()
+{
+    SpscQueue<uint64_t> roundedQueue(100);
+    CHECK(roundedQueue.capacity() == 128);
+
+    runBench<SpscQueue<uint64_t>>("spsc");
+    runBench<MutexQueue>("mutex");
+    testProducerDrop();
+
+    return testResult();
+}
@@ -0,0 +1,191 @@
+#include "standinserver.h"
+
+#ifdef PLATFORM_LINUX
+
+#include "../type.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 接受连接的线程每隔这么久检查一次是否要退出
+#define STANDIN_POLL_INTERVAL_MS 10
+
+StandInServer::StandInServer()
+{
+}
+
+StandInServer::~StandInServer()
+{
+    stop();
+}
+
+bool StandInServer::start(uint16_t port)
+{
+    stop();
+
+    if (port == 0)
+    {
+        port = m_port;
+    }
+
+    m_listenFD = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenFD < 0)
+    {
+        std::perror("socket");
+        return false;
+    }
+
+    // 重启时刚关闭的连接还在TIME_WAIT，需要允许重用地址才能在原来的端口上监听
+    int reuse = 1;
+    setsockopt(m_listenFD, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(m_listenFD, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 || listen(m_listenFD, 16) != 0)
+    {
+        std::perror("bind/listen");
+        close(m_listenFD);
+        m_listenFD = -1;
+        return false;
+    }
+
+    socklen_t addressLength = sizeof(address);
+    getsockname(m_listenFD, reinterpret_cast<struct sockaddr *>(&address), &addressLength);
+    m_port = ntohs(address.sin_port);
+
+    m_isRunning = true;
+    m_acceptThread = std::thread([this]()
+                                 { this->runAccept(); });
+    return true;
+}
+
+void StandInServer::stop()
+{
+    m_isRunning = false;
+    if (m_acceptThread.joinable())
+    {
+        m_acceptThread.join();
+    }
+
+    if (m_listenFD >= 0)
+    {
+        close(m_listenFD);
+        m_listenFD = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int fd : m_clientFDs)
+    {
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+    }
+    m_clientFDs.clear();
+}
+
+uint16_t StandInServer::port() const
+{
+    return m_port;
+}
+
+int StandInServer::acceptedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_acceptedCount;
+}
+
+bool StandInServer::waitAccepted(int count, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_acceptedCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, count]()
+                                        { return m_acceptedCount >= count; });
+}
+
+int StandInServer::broadcast(const uint8_t *data, size_t length)
+{
+    std::vector<int> clientFDs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clientFDs = m_clientFDs;
+    }
+
+    int sentCount = 0;
+    for (int fd : clientFDs)
+    {
+        size_t pos = 0;
+        while (pos < length)
+        {
+            ssize_t ret = send(fd, data + pos, length - pos, MSG_NOSIGNAL);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ret <= 0)
+            {
+                break;
+            }
+            pos += ret;
+        }
+        if (pos == length)
+        {
+            sentCount++;
+        }
+    }
+    return sentCount;
+}
+
+std::vector<uint8_t> StandInServer::makeVideoMessage(uint32_t sequence, size_t payloadLength)
+{
+    NetMessageHeader header("ALIV2", MSGHEADER_TYPE_STREAM, MSGHEADER_STREAM_VIDEO, payloadLength);
+    NetMessageHeaderExt extension;
+    extension.m_sequence = sequence;
+    extension.m_captureTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    extension.m_flags = 0;
+    extension.m_checksum = 0;
+
+    // 负载是一个普通P帧的NAL头加填充，v1的关键帧扫描也不会把它当成IDR
+    std::vector<uint8_t> message(sizeof(header) + sizeof(extension) + payloadLength, 0x41);
+    memcpy(message.data(), &header, sizeof(header));
+    memcpy(message.data() + sizeof(header), &extension, sizeof(extension));
+    return message;
+}
+
+void StandInServer::runAccept()
+{
+    while (m_isRunning)
+    {
+        struct pollfd pollFD = {m_listenFD, POLLIN, 0};
+        if (poll(&pollFD, 1, STANDIN_POLL_INTERVAL_MS) <= 0)
+        {
+            continue;
+        }
+
+        int clientFD = accept(m_listenFD, nullptr, nullptr);
+        if (clientFD < 0)
+        {
+            continue;
+        }
+
+        // 服务端自己不合并小包，测到的延迟只反映客户端的设置
+        int noDelay = 1;
+        setsockopt(clientFD, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clientFDs.push_back(clientFD);
+        m_acceptedCount++;
+        m_acceptedCondition.notify_all();
+    }
+}
+
+#endif // PLATFORM_LINUX
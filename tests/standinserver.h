@@ -0,0 +1,62 @@
+#ifndef STANDINSERVER_H
+#define STANDINSERVER_H
+
+// 测试用的本机TCP服务端，代替真正的视频服务端，只在Linux上使用
+// 可以随时关掉再在同一个端口上重新监听，用来模拟服务端重启；也可以给所有连接发送视频消息，用来做接收路径的性能测试
+
+#ifdef PLATFORM_LINUX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class StandInServer
+{
+public:
+    StandInServer();
+    ~StandInServer();
+
+    StandInServer(const StandInServer &) = delete;
+    StandInServer &operator=(const StandInServer &) = delete;
+
+    // 监听127.0.0.1，port为0时由系统分配，停止后再次start()不传端口时沿用上一次的端口
+    bool start(uint16_t port = 0);
+    // 关闭监听套接字和所有已经接受的连接，客户端会收到连接断开
+    void stop();
+
+    uint16_t port() const;
+    // 累计接受的连接数，stop()不清零
+    int acceptedCount() const;
+    // 等待累计接受的连接数达到count，超时返回false
+    bool waitAccepted(int count, int timeoutMs);
+
+    // 把一段数据依次发给所有已经接受的连接，每个连接都发完才返回，出错的连接跳过
+    // 返回发完的连接数，不能和stop()同时调用
+    int broadcast(const uint8_t *data, size_t length);
+
+    // 生成一个v2视频消息，采集时间是现在，不标记IDR
+    // 客户端连上以后在等IDR，收到的消息都在送进解码器之前丢掉，测到的只有接收路径
+    static std::vector<uint8_t> makeVideoMessage(uint32_t sequence, size_t payloadLength);
+
+private:
+    void runAccept();
+
+private:
+    int m_listenFD = -1;
+    uint16_t m_port = 0;
+    std::thread m_acceptThread;
+    std::atomic_bool m_isRunning{false};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_acceptedCondition;
+    std::vector<int> m_clientFDs;
+    int m_acceptedCount = 0;
+};
+
+#endif // PLATFORM_LINUX
+
+#endif // STANDINSERVER_H
@@ -0,0 +1,246 @@
+// 接收路径的性能对比：原来每个消息先recv消息头再recv负载，每次都新分配两个vector
+// 现在用StreamReassembler一次recv尽量多的数据，在环形缓冲区里原地分帧
+// 两边收同样的字节流，打印每个消息的recv次数、堆内存申请次数和吞吐量
+// 检查两边收到的消息一致，并且分帧器预热以后不再申请内存
+
+#include "../streamreassembler.h"
+#include "alloccounter.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#define BENCH_MESSAGE_COUNT 20000
+// 每隔这么多个消息有一个关键帧大小的消息，其他是普通帧大小
+#define BENCH_KEY_FRAME_INTERVAL 30
+#define BENCH_KEY_FRAME_SIZE (120 * 1024)
+#define BENCH_FRAME_MIN_SIZE 2000
+#define BENCH_FRAME_MAX_SIZE 18000
+// 缓冲区的扩容只发生在前面几个消息，之后开始统计内存申请
+#define BENCH_WARMUP_MESSAGES 100
+#define BENCH_SEND_CHUNK (64 * 1024)
+
+struct BenchResult
+{
+    uint64_t m_messageCount = 0;
+    uint64_t m_recvCalls = 0;
+    uint64_t m_steadyAllocs = 0;
+    uint64_t m_bytes = 0;
+    double m_seconds = 0;
+    bool m_isPayloadOk = true;
+};
+
+#ifdef PLATFORM_LINUX
+
+// 生成整个字节流，第i个消息的负载都是字节i & 0xff
+static std::vector<uint8_t> makeStream(std::vector<size_t> &lengths)
+{
+    std::vector<uint8_t> stream;
+    uint32_t seed = 12345;
+    for (int i = 0; i < BENCH_MESSAGE_COUNT; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        size_t length = i % BENCH_KEY_FRAME_INTERVAL == 0 ? BENCH_KEY_FRAME_SIZE : BENCH_FRAME_MIN_SIZE + (seed >> 8) % (BENCH_FRAME_MAX_SIZE - BENCH_FRAME_MIN_SIZE);
+        lengths.push_back(length);
+
+        NetMessageHeader header("ALIVE", MSGHEADER_TYPE_STREAM, MSGHEADER_STREAM_VIDEO, length);
+        size_t offset = stream.size();
+        stream.resize(offset + sizeof(header) + length, static_cast<uint8_t>(i & 0xff));
+        memcpy(stream.data() + offset, &header, sizeof(header));
+    }
+    return stream;
+}
+
+// 服务端，按固定大小分块写完整个字节流后关闭写端
+static void writeStream(int fd, const std::vector<uint8_t> &stream)
+{
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        ssize_t ret = send(fd, stream.data() + pos, std::min<size_t>(BENCH_SEND_CHUNK, stream.size() - pos), MSG_NOSIGNAL);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::perror("send");
+            break;
+        }
+        pos += ret;
+    }
+    shutdown(fd, SHUT_WR);
+}
+
+static bool checkPayload(const uint8_t *payload, size_t length, size_t index, const std::vector<size_t> &lengths)
+{
+    uint8_t fill = static_cast<uint8_t>(index & 0xff);
+    return index < lengths.size() && length == lengths[index] && payload[0] == fill && payload[length - 1] == fill;
+}
+
+// 原来的接收方式，一直收到length字节为止
+static bool receiveAll(int fd, uint8_t *data, size_t length, uint64_t &recvCalls)
+{
+    size_t receiveLength = 0;
+    while (receiveLength < length)
+    {
+        ssize_t ret = recv(fd, data + receiveLength, length - receiveLength, 0);
+        recvCalls++;
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            return false;
+        }
+        receiveLength += ret;
+    }
+    return true;
+}
+
+static void receiveOld(int fd, const std::vector<size_t> &lengths, BenchResult &result)
+{
+    while (true)
+    {
+        if (result.m_messageCount == BENCH_WARMUP_MESSAGES)
+        {
+            resetAllocCounts();
+        }
+
+        std::vector<uint8_t> buffer(sizeof(NetMessageHeader));
+        if (!receiveAll(fd, buffer.data(), buffer.size(), result.m_recvCalls))
+        {
+            break;
+        }
+        NetMessageHeader header;
+        memcpy(&header, buffer.data(), sizeof(header));
+
+        std::vector<uint8_t> streamBuffer(header.m_length);
+        if (!receiveAll(fd, streamBuffer.data(), header.m_length, result.m_recvCalls))
+        {
+            break;
+        }
+        result.m_isPayloadOk = result.m_isPayloadOk && checkPayload(streamBuffer.data(), header.m_length, result.m_messageCount, lengths);
+        result.m_bytes += sizeof(header) + header.m_length;
+        result.m_messageCount++;
+    }
+    result.m_steadyAllocs = allocCounts().m_count;
+}
+
+static void receiveReassembler(int fd, const std::vector<size_t> &lengths, BenchResult &result)
+{
+    StreamReassembler reassembler;
+    while (true)
+    {
+        ssize_t ret = recv(fd, reassembler.writePointer(), reassembler.writableLength(), 0);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        reassembler.commitWrite(ret);
+
+        StreamMessage message;
+        while (reassembler.nextMessage(message))
+        {
+            result.m_isPayloadOk = result.m_isPayloadOk && checkPayload(message.m_payload, message.m_length, result.m_messageCount, lengths);
+            result.m_bytes += sizeof(NetMessageHeader) + message.m_length;
+            result.m_messageCount++;
+            if (result.m_messageCount == BENCH_WARMUP_MESSAGES)
+            {
+                resetAllocCounts();
+            }
+        }
+    }
+    result.m_recvCalls = reassembler.stats().m_readCount;
+    result.m_steadyAllocs = allocCounts().m_count;
+}
+
+static BenchResult runBench(bool isReassembler, const std::vector<uint8_t> &stream, const std::vector<size_t> &lengths)
+{
+    BenchResult result;
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        std::perror("socketpair");
+        result.m_isPayloadOk = false;
+        return result;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::thread writer(writeStream, fds[0], std::cref(stream));
+    if (isReassembler)
+    {
+        receiveReassembler(fds[1], lengths, result);
+    }
+    else
+    {
+        receiveOld(fds[1], lengths, result);
+    }
+    writer.join();
+    result.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    close(fds[0]);
+    close(fds[1]);
+    return result;
+}
+
+static void printResult(const char *name, const BenchResult &result)
+{
+    double messages = result.m_messageCount > 0 ? static_cast<double>(result.m_messageCount) : 1;
+    double steadyMessages = result.m_messageCount > BENCH_WARMUP_MESSAGES ? static_cast<double>(result.m_messageCount - BENCH_WARMUP_MESSAGES) : 1;
+    std::printf("%-12s %6.2f recv/msg  %6.2f alloc/msg  %10.0f msg/s  %8.1f MB/s\n", name, result.m_recvCalls / messages,
+                isAllocCounterSupported() ? result.m_steadyAllocs / steadyMessages : -1.0, messages / result.m_seconds,
+                result.m_bytes / result.m_seconds / (1024 * 1024));
+}
+
+int main()
+{
+    std::vector<size_t> lengths;
+    std::vector<uint8_t> stream = makeStream(lengths);
+
+    BenchResult oldResult = runBench(false, stream, lengths);
+    BenchResult newResult = runBench(true, stream, lengths);
+    printResult("recv+vector", oldResult);
+    printResult("reassembler", newResult);
+
+    CHECK(oldResult.m_messageCount == BENCH_MESSAGE_COUNT);
+    CHECK(oldResult.m_isPayloadOk);
+    CHECK(newResult.m_messageCount == BENCH_MESSAGE_COUNT);
+    CHECK(newResult.m_isPayloadOk);
+    // 原来每个消息至少两次recv，分帧器一次recv可以收到多个消息
+    CHECK(oldResult.m_recvCalls >= 2 * oldResult.m_messageCount);
+    CHECK(newResult.m_recvCalls < oldResult.m_recvCalls);
+    if (isAllocCounterSupported())
+    {
+        CHECK(oldResult.m_steadyAllocs >= 2 * (oldResult.m_messageCount - BENCH_WARMUP_MESSAGES));
+        CHECK(newResult.m_steadyAllocs == 0);
+    }
+
+    return testResult();
+}
+
+#else
+
+int main()
+{
+    std::printf("skipped: the benchmark feeds the receive path through a Unix socketpair\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,200 @@
+// StreamReassembler的重新同步测试，不依赖Qt和网络，直接把构造好的字节流写进缓冲区
+// 全部通过返回0，否则返回1
+
+#include "../streamreassembler.h"
+#include "testcommon.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// 构造一个完整的v1消息，负载是重复的fill字节
+static std::vector<uint8_t> makeMessageV1(uint16_t subType, size_t length, uint8_t fill)
+{
+    NetMessageHeader header("ALIVE", MSGHEADER_TYPE_STREAM, subType, length);
+    std::vector<uint8_t> data(sizeof(header) + length, fill);
+    memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+static std::vector<uint8_t> makeMessageV2(uint32_t sequence, size_t length, uint8_t fill)
+{
+    NetMessageHeader header("ALIV2", MSGHEADER_TYPE_STREAM, MSGHEADER_STREAM_VIDEO, length);
+    NetMessageHeaderExt extension = {};
+    extension.m_sequence = sequence;
+    extension.m_flags = MSGHEADER_FLAG_IDR;
+    std::vector<uint8_t> data(sizeof(header) + sizeof(extension) + length, fill);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), &extension, sizeof(extension));
+    return data;
+}
+
+static void append(std::vector<uint8_t> &stream, const std::vector<uint8_t> &data)
+{
+    stream.insert(stream.end(), data.begin(), data.end());
+}
+
+// 按chunkSize分多次写入，模拟每次recv只收到一部分，边写边取出所有完整的消息
+static std::vector<StreamMessage> feed(StreamReassembler &reassembler, const std::vector<uint8_t> &stream, size_t chunkSize,
+                                       std::vector<bool> *pDiscontinuities = nullptr, std::vector<std::vector<uint8_t>> *pPayloads = nullptr)
+{
+    std::vector<StreamMessage> messages;
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        size_t length = std::min({chunkSize, stream.size() - pos, reassembler.writableLength()});
+        memcpy(reassembler.writePointer(), stream.data() + pos, length);
+        reassembler.commitWrite(length);
+        pos += length;
+
+        StreamMessage message;
+        while (reassembler.nextMessage(message))
+        {
+            messages.push_back(message);
+            if (pDiscontinuities != nullptr)
+            {
+                pDiscontinuities->push_back(reassembler.takeDiscontinuity());
+            }
+            // 负载视图在下一次写入后失效，需要的话先拷贝出来
+            if (pPayloads != nullptr)
+            {
+                pPayloads->emplace_back(message.m_payload, message.m_payload + message.m_length);
+            }
+        }
+    }
+    return messages;
+}
+
+// 消息前面的垃圾字节里夹着标识的前缀，逐字节写入和一次写入都要找到后面的消息
+static void testLeadingGarbage()
+{
+    std::vector<uint8_t> garbage = {0x00, 0xff, 'A', 'L', 'I', 0x12, 'A', 'L', 'I', 'V', 'E', 0x01, 0x7f};
+    for (size_t chunkSize : {size_t(1), size_t(3), size_t(4096)})
+    {
+        std::vector<uint8_t> stream = garbage;
+        append(stream, makeMessageV1(MSGHEADER_STREAM_VIDEO, 100, 0x11));
+
+        StreamReassembler reassembler(1024);
+        std::vector<bool> discontinuities;
+        std::vector<StreamMessage> messages = feed(reassembler, stream, chunkSize, &discontinuities);
+
+        CHECK(messages.size() == 1);
+        CHECK(discontinuities.size() == 1 && discontinuities[0]);
+        if (!messages.empty())
+        {
+            CHECK(messages[0].m_version == PROTOCOL_VERSION_1);
+            CHECK(messages[0].m_length == 100);
+        }
+
+        ReassemblerStats stats = reassembler.stats();
+        CHECK(stats.m_resyncCount == 1);
+        CHECK(stats.m_bytesSkipped == garbage.size());
+        CHECK(stats.m_messageCount == 1);
+    }
+}
+
+// 两个正常消息之间插入垃圾，前一个消息不受影响，后一个消息标记为不连续
+static void testGarbageBetweenMessages()
+{
+    std::vector<uint8_t> stream = makeMessageV2(1, 64, 0x21);
+    for (int i = 0; i < 300; i++)
+    {
+        stream.push_back(static_cast<uint8_t>(i * 37));
+    }
+    append(stream, makeMessageV2(2, 64, 0x22));
+    append(stream, makeMessageV2(3, 64, 0x23));
+
+    StreamReassembler reassembler(256);
+    std::vector<bool> discontinuities;
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<StreamMessage> messages = feed(reassembler, stream, 50, &discontinuities, &payloads);
+
+    CHECK(messages.size() == 3);
+    if (messages.size() == 3)
+    {
+        CHECK(messages[0].m_extension.m_sequence == 1);
+        CHECK(messages[1].m_extension.m_sequence == 2);
+        CHECK(messages[2].m_extension.m_sequence == 3);
+        CHECK(!discontinuities[0]);
+        CHECK(discontinuities[1]);
+        CHECK(!discontinuities[2]);
+        CHECK(payloads[1] == std::vector<uint8_t>(64, 0x22));
+    }
+    CHECK(reassembler.stats().m_resyncCount == 1);
+}
+
+// 消息头只发了一半就接上了下一个消息，拼出来的消息头长度字段是下一个消息头的字节
+// 设置了长度上限后被当作无效消息头，跳到下一个消息
+static void testTruncatedHeader()
+{
+    std::vector<uint8_t> full = makeMessageV1(MSGHEADER_STREAM_VIDEO, 32, 0x31);
+    for (size_t keepLength : {size_t(6), size_t(10), size_t(13)})
+    {
+        std::vector<uint8_t> stream(full.begin(), full.begin() + keepLength);
+        append(stream, makeMessageV1(MSGHEADER_STREAM_AUDIO, 40, 0x32));
+        append(stream, makeMessageV1(MSGHEADER_STREAM_VIDEO, 48, 0x33));
+
+        StreamReassembler reassembler(1024);
+        reassembler.setMaxMessageLength(64 * 1024);
+        std::vector<StreamMessage> messages = feed(reassembler, stream, 7);
+
+        CHECK(messages.size() == 2);
+        if (messages.size() == 2)
+        {
+            CHECK(messages[0].m_header.m_subType == MSGHEADER_STREAM_AUDIO);
+            CHECK(messages[0].m_length == 40);
+            CHECK(messages[1].m_length == 48);
+        }
+        CHECK(reassembler.stats().m_resyncCount == 1);
+    }
+}
+
+// 标识正确但长度超过上限的消息头不会让缓冲区扩容，直接重新同步
+static void testOversizedHeader()
+{
+    NetMessageHeader header("ALIVE", MSGHEADER_TYPE_STREAM, MSGHEADER_STREAM_VIDEO, 0x7fffffff);
+    std::vector<uint8_t> stream(sizeof(header));
+    memcpy(stream.data(), &header, sizeof(header));
+    append(stream, makeMessageV1(MSGHEADER_STREAM_VIDEO, 16, 0x41));
+
+    StreamReassembler reassembler(1024);
+    std::vector<StreamMessage> messages = feed(reassembler, stream, 4096);
+
+    CHECK(messages.size() == 1);
+    ReassemblerStats stats = reassembler.stats();
+    CHECK(stats.m_oversizedHeaders == 1);
+    CHECK(stats.m_growCount == 0);
+    CHECK(stats.m_resyncCount == 1);
+}
+
+// 全是垃圾时缓冲区不增长，之后来的正常消息仍然能取出来
+static void testGarbageOnly()
+{
+    std::vector<uint8_t> garbage(64 * 1024);
+    uint32_t seed = 12345;
+    for (uint8_t &value : garbage)
+    {
+        seed = seed * 1103515245 + 12345;
+        value = static_cast<uint8_t>(seed >> 16);
+    }
+
+    StreamReassembler reassembler(4096);
+    std::vector<StreamMessage> messages = feed(reassembler, garbage, 1500);
+    CHECK(messages.empty());
+
+    messages = feed(reassembler, makeMessageV1(MSGHEADER_STREAM_VIDEO, 200, 0x51), 1500);
+    CHECK(messages.size() == 1);
+    CHECK(reassembler.takeDiscontinuity());
+    CHECK(reassembler.stats().m_growCount == 0);
+}
+
+int main()
+{
+    testLeadingGarbage();
+    testGarbageBetweenMessages();
+    testTruncatedHeader();
+    testOversizedHeader();
+    testGarbageOnly();
+
+    return testResult();
+}
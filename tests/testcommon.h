@@ -0,0 +1,38 @@
+#ifndef TESTCOMMON_H
+#define TESTCOMMON_H
+
+// 测试共用的检查宏和结果汇总，检查失败只记录并继续，最后由testResult()汇总
+// 每个测试是一个独立的可执行文件，只包含一次，所以计数直接放在头文件里
+
+#include <cstdio>
+
+inline int &testFailedCount()
+{
+    static int failedCount = 0;
+    return failedCount;
+}
+
+#define CHECK(condition)                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            testFailedCount()++;                                                                \
+        }                                                                                       \
+    } while (0)
+
+// 打印结果，全部通过返回0，否则返回1，直接作为main的返回值
+inline int testResult()
+{
+    if (testFailedCount() != 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", testFailedCount());
+        return 1;
+    }
+
+    std::printf("all tests passed\n");
+    return 0;
+}
+
+#endif // TESTCOMMON_H
@@ -0,0 +1,197 @@
+// 纹理上传的性能测试：1080p和4K的yuv420p帧，每帧更新Y、U、V三个纹理
+// 原来：每次重绘都用glTexImage2D重新分配纹理存储，并且重新设置纹理参数
+// 现在：分辨率不变时只在创建时用glTexStorage2D分配一次，之后每帧用glTexSubImage2D更新，行尾填充由GL_UNPACK_ROW_LENGTH跳过
+// 另外测一次从紧凑数据更新已有存储，区分重新分配和带行宽上传各自的影响
+// 打印每帧上传的时间(包括glFinish等GL执行完)，检查每种方式上传后纹理里的数据和源数据相同
+// 用EGL创建离屏上下文，没有可用的OpenGL 3.3时跳过
+
+#include "offscreengl.h"
+#include "testcommon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// 每种分辨率一共上传这么多像素，分辨率越高帧数越少
+#define BENCH_TOTAL_PIXELS (60LL * 1920 * 1080)
+// 解码器输出的行宽按这个对齐，每行至少留出BENCH_ROW_PADDING字节的填充，检查上传时跳过了行尾
+#define BENCH_LINESIZE_ALIGN 64
+#define BENCH_ROW_PADDING 32
+
+// 解码器输出的一帧，每个平面按自己的行宽存放
+struct SourceFrame
+{
+    int m_widths[3] = {0, 0, 0};
+    int m_heights[3] = {0, 0, 0};
+    int m_linesizes[3] = {0, 0, 0};
+    std::vector<uint8_t> m_planes[3];
+};
+
+static SourceFrame makeFrame(int width, int height)
+{
+    SourceFrame frame;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        frame.m_widths[plane] = plane == 0 ? width : width / 2;
+        frame.m_heights[plane] = plane == 0 ? height : height / 2;
+        frame.m_linesizes[plane] = (frame.m_widths[plane] + BENCH_ROW_PADDING + BENCH_LINESIZE_ALIGN - 1) / BENCH_LINESIZE_ALIGN * BENCH_LINESIZE_ALIGN;
+        frame.m_planes[plane].resize(static_cast<size_t>(frame.m_linesizes[plane]) * frame.m_heights[plane]);
+        for (size_t i = 0; i < frame.m_planes[plane].size(); i++)
+        {
+            frame.m_planes[plane][i] = static_cast<uint8_t>((i * 13 + plane * 71) & 0xFF);
+        }
+    }
+    return frame;
+}
+
+// 原来的paintGL：渲染端先把三个平面紧凑地拷贝到一起，每次重绘重新分配存储、重新设置参数
+// 原来用的GL_LUMINANCE在core profile里没有了，换成传输量相同的GL_RED
+static void uploadByTexImage(const GLuint textures[3], const SourceFrame &frame, const std::vector<uint8_t> &packed)
+{
+    size_t offset = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, frame.m_widths[plane], frame.m_heights[plane], 0, GL_RED, GL_UNSIGNED_BYTE, packed.data() + offset);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        offset += static_cast<size_t>(frame.m_widths[plane]) * frame.m_heights[plane];
+    }
+}
+
+// 现在的OpenGLWidget::allocateTextures，分辨率变化时才调用
+static void allocateStorage(const GLuint textures[3], const SourceFrame &frame)
+{
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, frame.m_widths[plane], frame.m_heights[plane]);
+    }
+}
+
+// 现在的OpenGLWidget::uploadFrame，直接从解码器的帧按行宽更新
+static void uploadBySubImage(const GLuint textures[3], const SourceFrame &frame)
+{
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.m_linesizes[plane]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.m_widths[plane], frame.m_heights[plane], GL_RED, GL_UNSIGNED_BYTE, frame.m_planes[plane].data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+}
+
+// 同样只更新已有的存储，但数据像原来一样是去掉了行尾填充的，用来区分重新分配和带行宽上传各自的影响
+static void uploadPackedBySubImage(const GLuint textures[3], const SourceFrame &frame, const std::vector<uint8_t> &packed)
+{
+    size_t offset = 0;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.m_widths[plane], frame.m_heights[plane], GL_RED, GL_UNSIGNED_BYTE, packed.data() + offset);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        offset += static_cast<size_t>(frame.m_widths[plane]) * frame.m_heights[plane];
+    }
+}
+
+// 读回纹理，和源数据逐行比较
+static bool isTextureEqual(const GLuint textures[3], const SourceFrame &frame)
+{
+    bool isEqual = true;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int plane = 0; plane < 3; plane++)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(frame.m_widths[plane]) * frame.m_heights[plane]);
+        glBindTexture(GL_TEXTURE_2D, textures[plane]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        for (int y = 0; isEqual && y < frame.m_heights[plane]; y++)
+        {
+            isEqual = memcmp(pixels.data() + static_cast<size_t>(y) * frame.m_widths[plane],
+                             frame.m_planes[plane].data() + static_cast<size_t>(y) * frame.m_linesizes[plane], frame.m_widths[plane]) == 0;
+        }
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return isEqual;
+}
+
+// 渲染端原来的上传缓冲区，三个平面去掉行尾填充紧凑存放，不计入上传时间
+static std::vector<uint8_t> packFrame(const SourceFrame &frame)
+{
+    std::vector<uint8_t> packed;
+    for (int plane = 0; plane < 3; plane++)
+    {
+        for (int y = 0; y < frame.m_heights[plane]; y++)
+        {
+            const uint8_t *row = frame.m_planes[plane].data() + static_cast<size_t>(y) * frame.m_linesizes[plane];
+            packed.insert(packed.end(), row, row + frame.m_widths[plane]);
+        }
+    }
+    return packed;
+}
+
+// 每帧上传后glFinish等GL执行完，返回平均每帧的时间，最后检查纹理里的数据
+template <typename Upload>
+static double measure(const SourceFrame &frame, bool isImmutable, Upload upload)
+{
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    if (isImmutable)
+    {
+        allocateStorage(textures, frame);
+    }
+
+    int frameCount = static_cast<int>(BENCH_TOTAL_PIXELS / (static_cast<int64_t>(frame.m_widths[0]) * frame.m_heights[0]));
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < frameCount; i++)
+    {
+        upload(textures);
+        glFinish();
+    }
+    double frameUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+
+    CHECK(isTextureEqual(textures, frame));
+    glDeleteTextures(3, textures);
+    return frameUs;
+}
+
+static void runBench(const char *name, int width, int height)
+{
+    SourceFrame frame = makeFrame(width, height);
+    std::vector<uint8_t> packed = packFrame(frame);
+
+    double texImageUs = measure(frame, false, [&frame, &packed](const GLuint textures[3]) { uploadByTexImage(textures, frame, packed); });
+    double packedSubImageUs = measure(frame, true, [&frame, &packed](const GLuint textures[3]) { uploadPackedBySubImage(textures, frame, packed); });
+    double subImageUs = measure(frame, true, [&frame](const GLuint textures[3]) { uploadBySubImage(textures, frame); });
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    std::printf("%-5s glTexImage2D every frame, packed rows         %8.1f us/frame\n", name, texImageUs);
+    std::printf("%-5s glTexSubImage2D into storage, packed rows     %8.1f us/frame\n", name, packedSubImageUs);
+    std::printf("%-5s glTexSubImage2D into storage, decoder linesize %8.1f us/frame\n", name, subImageUs);
+}
+
+int main()
+{
+    OffscreenGL gl;
+    if (!gl.create(3, 3))
+    {
+        std::printf("skipped: no offscreen OpenGL 3.3 context\n");
+        return 0;
+    }
+    std::printf("renderer: %s\n", gl.renderer());
+
+    runBench("1080p", 1920, 1080);
+    runBench("4K", 3840, 2160);
+
+    return testResult();
+}
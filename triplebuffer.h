@@ -0,0 +1,76 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// 一个线程写、一个线程读的三缓冲，读的一方总是拿到最新写完的那一份
+// 写的一方写后台的那份，写完和中间那份交换；读的一方有新的时候把中间那份换到前台
+// 双方都不会等待对方，没来得及读的旧数据直接被新的覆盖
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // 只能在写的线程调用
+    T &backBuffer()
+    {
+        return m_buffers[m_backIndex];
+    }
+
+    // 发布写好的后台数据，上一次发布的还没被读走时返回true，表示它被覆盖了
+    bool publish()
+    {
+        int previous = m_middle.exchange(m_backIndex | TRIPLE_BUFFER_DIRTY, std::memory_order_acq_rel);
+        m_backIndex = previous & TRIPLE_BUFFER_INDEX_MASK;
+        return (previous & TRIPLE_BUFFER_DIRTY) != 0;
+    }
+
+    // 只能在读的线程调用，有新发布的数据时换到前台并返回true
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_DIRTY) == 0)
+        {
+            return false;
+        }
+
+        int previous = m_middle.exchange(m_frontIndex, std::memory_order_acq_rel);
+        m_frontIndex = previous & TRIPLE_BUFFER_INDEX_MASK;
+        return true;
+    }
+
+    // 只能在读的线程调用
+    T &frontBuffer()
+    {
+        return m_buffers[m_frontIndex];
+    }
+
+    // 清空三份数据，调用时双方都不能再访问
+    void reset()
+    {
+        for (auto &buffer : m_buffers)
+        {
+            buffer = T();
+        }
+        m_middle.store(1, std::memory_order_relaxed);
+        m_backIndex = 0;
+        m_frontIndex = 2;
+    }
+
+private:
+    static const int TRIPLE_BUFFER_INDEX_MASK = 0x3;
+    static const int TRIPLE_BUFFER_DIRTY = 0x4;
+
+    T m_buffers[3];
+    // 中间那份的下标，加上是否有还没读走的新数据的标记
+    std::atomic_int m_middle{1};
+    // 只有写的线程访问
+    int m_backIndex = 0;
+    // 只有读的线程访问
+    int m_frontIndex = 2;
+};
+
+#endif // TRIPLEBUFFER_H
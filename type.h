@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "videoframe.h"
+
 // 这两个用来判断数据是心跳包还是流媒体
 #define MSGHEADER_TYPE_KEEPALIVE 0
 #define MSGHEADER_TYPE_STREAM 1
@@ -14,13 +16,97 @@
 #define MSGHEADER_STREAM_VIDEO 3
 #define MSGHEADER_STREAM_AUDIO 4
 
+// 协议版本，连接后通过心跳包的subType告诉服务端客户端支持的最高版本
+// 服务端不支持时继续发v1的消息头，客户端两种消息头都能解析
+#define PROTOCOL_VERSION_1 1
+#define PROTOCOL_VERSION_2 2
+
+// v2消息头的标志位
+#define MSGHEADER_FLAG_IDR 0x1         // 负载里有IDR帧
+#define MSGHEADER_FLAG_CONFIG 0x2      // 负载只有SPS/PPS等参数集
+#define MSGHEADER_FLAG_DISCARDABLE 0x4 // 不被其他帧参考，解码跟不上时可以丢掉
+#define MSGHEADER_FLAG_CHECKSUM 0x8    // m_checksum有效
+
+// 接收数据的方式，io_uring只在Linux上可用，不支持时自动退回recv
+#define RECEIVE_BACKEND_RECV 0
+#define RECEIVE_BACKEND_IO_URING 1
+
+// 传输方式，UDP时视频按RTP/H.264打包，经过抖动缓冲区排序并用NACK请求重传
+#define TRANSPORT_TCP 0
+#define TRANSPORT_UDP 1
+
+// 解码线程跟不上、包队列满时的处理方式
+#define DECODE_QUEUE_POLICY_BLOCK 0       // 网络线程等待，不丢包，但会拖慢接收
+#define DECODE_QUEUE_POLICY_DROP_OLDEST 1 // 丢掉最老的包，可能花屏直到下一个IDR
+#define DECODE_QUEUE_POLICY_DROP_TO_IDR 2 // 清空队列，从下一个IDR开始解码
+#define DEFAULT_DECODE_QUEUE_CAPACITY 32
+
+// 解码器多线程的配置
+#define DECODER_PROFILE_DEFAULT 0     // 使用FFmpeg的默认设置(单线程)
+// slice多线程加低延迟标记，不增加延迟，但只对多slice的码流有效
+// 低延迟标记让解码器不再等待重排序，码流里有B帧时输出顺序会错，只在确定没有B帧时打开
+#define DECODER_PROFILE_LOW_LATENCY 1
+#define DECODER_PROFILE_THROUGHPUT 2  // frame多线程，吞吐量高，每多一个线程多一帧延迟
+// 单独指定线程类型，值和FFmpeg的FF_THREAD_FRAME/FF_THREAD_SLICE相同
+#define DECODER_THREAD_TYPE_AUTO 0
+#define DECODER_THREAD_TYPE_FRAME 1
+#define DECODER_THREAD_TYPE_SLICE 2
+
+// 解码跟不上时逐级降低解码开销
+#define DECODE_LOAD_LEVEL_NORMAL 0           // 完整解码
+#define DECODE_LOAD_LEVEL_SKIP_LOOP_FILTER 1 // 跳过去块滤波
+#define DECODE_LOAD_LEVEL_SKIP_NONREF 2      // 再丢掉不作为参考的帧
+#define DECODE_LOAD_LEVEL_KEYFRAME_ONLY 3    // 只解关键帧
+#define DECODE_LOAD_LEVEL_COUNT 4
+
+// 默认连接超时时间
+#define DEFAULT_CONNECT_TIMEOUT_MS 5000
+
+// 单个消息负载的默认上限，消息头里的长度来自网络，不能无条件按它分配内存
+#define DEFAULT_MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+
 // C++定义的结构体不需要加typedef也能直接调用
 
+// 解码器配置
+struct DecoderConfig
+{
+    int m_profile = DECODER_PROFILE_DEFAULT;     // 低延迟需要显式打开，见DECODER_PROFILE_LOW_LATENCY
+    int m_threadCount = 0;                       // 0表示按CPU核数自动选择
+    int m_threadType = DECODER_THREAD_TYPE_AUTO; // 不是AUTO时覆盖profile选择的线程类型
+    bool m_isHugePages = false;                  // 4K这样的大帧用大页存放，减少TLB缺失
+    bool m_isLoadShedding = true;                // 解码跟不上时自动降级，有余量后恢复
+    int m_frameRate = 0;                         // 码流里没有帧率时按这个估计帧间隔，0表示用默认值
+
+    // 画面墙的小窗口(tile)模式，只解一部分帧并缩小到窗口大小输出
+    int m_tileWidth = 320;    // 缩小后的最大宽高，保持宽高比
+    int m_tileHeight = 180;
+    int m_tileFrameStep = 0;  // 0表示只解关键帧，N表示丢掉非参考帧并且每N帧输出一帧
+};
+
 // 网络连接信息结构体
 struct NetConnectInfo
 {
     std::string m_serverIP = ""; // 服务端的IP
     int m_port = 0;              // 端口
+    int m_receiveBackend = RECEIVE_BACKEND_RECV; // 接收数据的方式
+    size_t m_maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE; // 单个消息负载的最大长度
+    int m_transport = TRANSPORT_TCP;                    // 传输方式
+    int m_jitterBufferLatencyMs = 50;                   // UDP时等待乱序和重传包的最长时间
+
+    // 套接字参数，0表示使用系统默认值，实际生效的值以连接后读回来的为准
+    int m_receiveBufferSize = 0;  // SO_RCVBUF，高码率时调大可以减少丢包和窗口收缩
+    int m_sendBufferSize = 0;     // SO_SNDBUF
+    bool m_isNoDelay = true;      // TCP_NODELAY，心跳等小包立即发出，不等待合并
+    bool m_isQuickAck = false;    // TCP_QUICKACK，立即回ACK，仅Linux
+    int m_busyPollMicros = 0;     // SO_BUSY_POLL，读数据时忙等的微秒数，仅Linux，通常需要CAP_NET_ADMIN
+    int m_connectTimeoutMs = DEFAULT_CONNECT_TIMEOUT_MS;
+    int m_protocolVersion = PROTOCOL_VERSION_2; // 向服务端声明支持的最高协议版本
+
+    // 没有共享解码线程池时，单独的解码线程前面的包队列
+    size_t m_decodeQueueCapacity = DEFAULT_DECODE_QUEUE_CAPACITY;
+    int m_decodeQueuePolicy = DECODE_QUEUE_POLICY_DROP_TO_IDR;
+
+    DecoderConfig m_decoderConfig;
 
     NetConnectInfo() = default;
     NetConnectInfo(const std::string &ip, int port)
@@ -49,22 +135,44 @@ struct NetMessageHeader
     }
 };
 
+// v2消息头在v1的14字节后面增加的字段，标识从"ALIVE"改为"ALIV2"
+// m_length仍然只表示负载长度，不包括这部分
+struct NetMessageHeaderExt
+{
+    uint32_t m_sequence;      // 同一路视频流里每个消息加1，用来发现丢失的消息
+    uint64_t m_captureTimeUs; // 发送端采集这一帧的时间，Unix时间，微秒
+    uint16_t m_flags;         // MSGHEADER_FLAG_*
+    uint32_t m_checksum;      // 负载的CRC32，和zlib的crc32相同
+};
+
+#pragma pack(pop)
+
+// 一个颜色分量，直接指向解码器输出的帧里的数据，不持有内存
 struct YUVChannel
 {
-    size_t m_length;
-    std::vector<uint8_t> m_dataBuffer;
+    const uint8_t *m_pData = nullptr;
+    int m_linesize = 0; // 每行的字节数，行尾有对齐填充时比m_width大
+    int m_width = 0;    // 像素数，NV12这样交错存放的色度是UV对的个数
+    int m_height = 0;
 };
 
+// 解码出来的一帧，m_frame持有帧数据的引用，三个分量指向它的数据
+// 只能移动不能拷贝，回调里可以std::move整个结构体把帧留下来，不移走的话回调返回后释放
+// 分量按解码器输出的原始格式存放，不做转换：
+// 平面格式(yuv420p、yuv444p、yuv420p10等)三个分量各自一个平面
+// 半平面格式(nv12、p010等)的m_chromaB是交错的UV平面，m_chromaR为空
 struct YUVFrameData
 {
-    int m_width;
-    int m_height;
+    int m_width = 0;
+    int m_height = 0;
     YUVChannel m_luma;
     YUVChannel m_chromaB;
     YUVChannel m_chromaR;
-    long long pts;
+    long long pts = 0;
+    int m_format = AV_PIX_FMT_YUV420P;         // AVPixelFormat
+    int m_colorSpace = AVCOL_SPC_UNSPECIFIED;  // AVColorSpace，决定YUV转RGB的系数
+    int m_colorRange = AVCOL_RANGE_UNSPECIFIED; // AVColorRange，有限范围(16-235)还是全范围
+    VideoFrame m_frame;
 };
 
-#pragma pack(pop)
-
 #endif
@@ -1,15 +1,14 @@
-// attribute限定符只存在于vertex shader中，可以在数据缓冲区中读取数据，全局只读
-attribute vec4 attr_position; // 顶点坐标
-attribute vec2 attr_uv; // uv坐标
+#version 330 core
 
-// uniform全局只读，但在fragment也能使用
-uniform mat4   uni_mat; // 传入的变换矩阵
+// 顶点数据在VBO里，位置和OpenGLWidget里的VIDEO_ATTR_*一致
+layout(location = 0) in vec3 attr_position; // 顶点坐标，已经是裁剪坐标
+layout(location = 1) in vec2 attr_uv; // uv坐标
 
-// varying是vertex和fragment之间传递数据的，可以在vertex中改，在fragment中使用
-varying vec2   out_uv; // 传给片段着色器的uv坐标
+// 传给片段着色器的uv坐标
+out vec2 out_uv;
 
 void main(void)
 {
     out_uv = attr_uv;
-    gl_Position = uni_mat * attr_position; // 顶点坐标左乘变换矩阵
+    gl_Position = vec4(attr_position, 1.0);
 }
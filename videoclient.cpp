@@ -1,7 +1,20 @@
 #include "videoclient.h"
 
-VideoClient::VideoClient()
+VideoClient::VideoClient(EventLoop *pEventLoop, DecodeWorkerPool *pDecodePool)
+    : m_pEventLoop(pEventLoop),
+    m_pDecodePool(pDecodePool)
 {
+    // 没有传入共享的事件循环时自己创建一个，并用单独的线程运行
+    if (m_pEventLoop == nullptr)
+    {
+        m_pOwnedEventLoop = std::make_unique<EventLoop>();
+        m_pEventLoop = m_pOwnedEventLoop.get();
+    }
+
+    if (m_pDecodePool != nullptr)
+    {
+        m_decodeWorkerIndex = m_pDecodePool->assignWorker();
+    }
 }
 
 VideoClient::~VideoClient()
@@ -22,11 +35,98 @@ void VideoClient::startSocketConnection(const NetConnectInfo &netConnectInfo)
         return;
     }
 #endif
+    m_netConnectInfo = netConnectInfo;
+    m_packetPool.setMaxMessageLength(netConnectInfo.m_maxMessageSize);
+    m_reassembler.setMaxMessageLength(netConnectInfo.m_maxMessageSize);
+
+    m_isStopping = false;
+    m_isStarted = true;
+
+    // 这时解码线程还没有这路流的任务，可以重新打开解码器
+    m_decoder.configure(netConnectInfo.m_decoderConfig);
+
+    // 解码放在单独的线程，解码或渲染慢时不会拖住收数据
+    if (m_pDecodePool == nullptr)
+    {
+        m_decodeQueue.open(netConnectInfo.m_decodeQueueCapacity, netConnectInfo.m_decodeQueuePolicy);
+        m_decodeThread = std::thread([this]()
+                                     { this->runDecodeLoop(); });
+    }
+
+    // 连接、接收数据、发送心跳、断线重连都在同一个线程的事件循环里完成
+    m_pEventLoop->post([this]()
+                       { this->connectToServer(); });
+    if (m_pOwnedEventLoop != nullptr)
+    {
+        m_ioThread = std::thread([this]()
+                                 { this->m_pEventLoop->run(); });
+    }
+}
+
+void VideoClient::stopSocketConnection()
+{
+    if (!m_isStarted)
+    {
+        return;
+    }
+    m_isStarted = false;
+
+    // 停止后不再重连
+    m_isStopping = true;
+
+    // 先关闭包队列，阻塞策略下网络线程可能正在等队列空出位置
+    m_decodeQueue.close();
+
+    if (m_ioThread.joinable())
+    {
+        // 先让事件循环退出，再关闭套接字，避免循环线程还在使用它
+        m_pEventLoop->quit();
+        m_ioThread.join();
+        closeConnection();
+    }
+    else if (m_pOwnedEventLoop == nullptr && !m_pEventLoop->isInLoopThread())
+    {
+        // 共享的事件循环还在运行，要在循环线程里关闭连接并等它完成
+        std::promise<void> done;
+        std::future<void> future = done.get_future();
+        m_pEventLoop->post([this, &done]()
+                           {
+            this->closeConnection();
+            done.set_value(); });
+        future.wait();
+    }
+    else
+    {
+        closeConnection();
+    }
+
+    // 等解码线程里这路流剩下的包处理完，之后不会再有回调
+    if (m_pDecodePool != nullptr)
+    {
+        m_pDecodePool->waitIdle(m_decodeWorkerIndex);
+    }
+
+    if (m_decodeThread.joinable())
+    {
+        m_decodeThread.join();
+        m_decodeQueue.clear();
+    }
+
+    std::cout << "stop receive packet from server" << std::endl;
+}
+
+// 发起一次连接，第一次连接和断线重连都走这里
+void VideoClient::connectToServer()
+{
+    m_reconnectTimerID = 0;
+
     // 创建套接字
-    m_socketFD = socket(AF_INET, SOCK_STREAM, 0);
+    bool isUdp = m_netConnectInfo.m_transport == TRANSPORT_UDP;
+    m_socketFD = socket(AF_INET, isUdp ? SOCK_DGRAM : SOCK_STREAM, 0);
     if (m_socketFD < 0)
     {
         std::cerr << "client socket create failed" << std::endl;
+        scheduleReconnect();
         return;
     }
 
@@ -34,11 +134,11 @@ void VideoClient::startSocketConnection(const NetConnectInfo &netConnectInfo)
     memset(&sockAddrIn, 0, sizeof(struct sockaddr_in));
 
     sockAddrIn.sin_family = AF_INET;
-    sockAddrIn.sin_port = htons(netConnectInfo.m_port);
-    sockAddrIn.sin_addr.s_addr = inet_addr(netConnectInfo.m_serverIP.c_str());
+    sockAddrIn.sin_port = htons(m_netConnectInfo.m_port);
+    sockAddrIn.sin_addr.s_addr = inet_addr(m_netConnectInfo.m_serverIP.c_str());
 
     // // 将IPv4地址字符串转换为二进制地址缓冲区指针,存储在前面定义的协议的地址中
-    // if (inet_pton(AF_INET, netConnectInfo.m_serverIP.c_str(), &sockAddrIn.sin_addr.s_addr) < 0)
+    // if (inet_pton(AF_INET, m_netConnectInfo.m_serverIP.c_str(), &sockAddrIn.sin_addr.s_addr) < 0)
     // {
     //     std::cerr << "convert IPv4 address string to binary buffer pointer failed";
     //     return;
@@ -54,43 +154,36 @@ void VideoClient::startSocketConnection(const NetConnectInfo &netConnectInfo)
     ioctlsocket(m_socketFD, FIONBIO, &ul);
 #endif
 
-    connect(m_socketFD, reinterpret_cast<struct sockaddr *>(&sockAddrIn), sizeof(struct sockaddr));
-
-    // 单独用一个线程来监听连接有没有完成并判断状态
-    std::thread runWaitConnectionThread([this]()
-                                        { this->doRunWaitConnection(); });
-    runWaitConnectionThread.detach();
+    applySocketOptions();
 
-    // 再用一个线程接收服务端发来的实际的数据包
-    std::thread receiveDataThread([this]()
-                                  { this->doReceiveData(); });
-    receiveDataThread.detach();
-
-    // 发送心跳包，提醒服务端，此客户端的存活状态
-    // 这是另一种更简单的写法，传入成员函数和对象指针
-    std::thread sendAlivePacketThread(&VideoClient::sendKeepAlivePacket, this);
-    sendAlivePacketThread.detach();
-}
+    m_connectionState = ConnectionState::Connecting;
+    int ret = connect(m_socketFD, reinterpret_cast<struct sockaddr *>(&sockAddrIn), sizeof(struct sockaddr));
 
-void VideoClient::stopSocketConnection()
-{
-    m_isThreadRunning = false;
-    if (m_socketFD >= 0)
+    // UDP的connect只是记下对端地址，立即完成，之后只收这个地址发来的数据报
+    if (isUdp)
     {
-        close(m_socketFD);
-        m_socketFD = -1;
-    }
+        if (ret < 0)
+        {
+            std::cerr << "udp connect failed" << std::endl;
+            closeConnection();
+            return;
+        }
 
-    // 析构时可阻塞等待线程执行完再退出
-    while (m_isKeepAliveThreadRunning)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        m_pEventLoop->addFd(m_socketFD, EVENTLOOP_READ, [this](int events)
+                            { this->onSocketEvent(events); });
+        onConnected();
+        return;
     }
 
-    while (m_isReceiveThreadRunning)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    // 套接字可写时说明连接完成了(成功或失败)，由事件循环通知，不需要单独的线程去等
+    m_pEventLoop->addFd(m_socketFD, EVENTLOOP_WRITE, [this](int events)
+                        { this->onSocketEvent(events); });
+
+    // 连接超时
+    m_connectTimeoutTimerID = m_pEventLoop->addTimer(m_netConnectInfo.m_connectTimeoutMs, false, [this]()
+                                                     {
+        std::cerr << "connect is time out" << std::endl;
+        this->closeConnection(); });
 }
 
 void VideoClient::setupUpdateVideoCallback(updateVideoCallback &&callback)
@@ -98,372 +191,1200 @@ void VideoClient::setupUpdateVideoCallback(updateVideoCallback &&callback)
     m_updateVideoCallback = callback;
 }
 
-void VideoClient::doRunWaitConnection()
+void VideoClient::setFrameAllocator(FrameAllocator *pAllocator)
 {
-    // 文件描述符集合类型
-    // 分别创建读集合和写集合监听套接字的可读和可写状态
-    fd_set rSet, wSet;
+    m_decoder.setFrameAllocator(pAllocator);
+}
 
-    // 清空集合
-    FD_ZERO(&rSet);
-    FD_ZERO(&wSet);
+void VideoClient::setupLoadLevelCallback(loadLevelCallback &&callback)
+{
+    m_decoder.setLoadLevelCallback(std::move(callback));
+}
 
-    // 设置超时时间为10秒+0微秒
-    struct timeval timeout = {1000, 0};
-#ifdef _WIN32
-    SOCKET winSocket = static_cast<SOCKET>(m_socketFD);
-    FD_SET(winSocket, &rSet);
-    FD_SET(winSocket, &wSet);
-    int retValue = select(0, &rSet, &wSet, nullptr, &timeout);
-#else
-    // 将描述符放到集合中
-    FD_SET(m_socketFD, &rSet);
-    FD_SET(m_socketFD, &wSet);
-
-    // 调用select函数等待套接字变成可读或可写状态
-    // 第一个参数传入集合中的最大描述符+1,表示select需要检查范围的上限
-    // 后面分别传入读集合和写集合来监听
-    // 第四个参数传入nullptr表示不监视异常情况
-    // 最后一个参数表示超时时间
-    int retValue = select(m_socketFD + 1, &rSet, &wSet, nullptr, &timeout);
-#endif
+void VideoClient::setTileMode(bool isTileMode)
+{
+    m_decoder.setTileMode(isTileMode);
+}
 
-#ifdef _WIN32
-    if (retValue == SOCKET_ERROR)
-    {
-        std::cerr << "select failed, error: " << WSAGetLastError() << std::endl;
-#else
-    if (retValue == -1)
+ReassemblerStats VideoClient::receiveStats() const
+{
+    return m_reassembler.stats();
+}
+
+ClientStats VideoClient::clientStats() const
+{
+    ClientStats stats;
+    stats.m_videoPackets = m_videoPackets.load(std::memory_order_relaxed);
+    stats.m_droppedWaitingKeyFrame = m_droppedWaitingKeyFrame.load(std::memory_order_relaxed);
+    stats.m_lostMessages = m_lostMessages.load(std::memory_order_relaxed);
+    stats.m_checksumErrors = m_checksumErrors.load(std::memory_order_relaxed);
+    stats.m_droppedDiscardable = m_droppedDiscardable.load(std::memory_order_relaxed);
+    stats.m_lastCaptureLatencyUs = m_lastCaptureLatencyUs.load(std::memory_order_relaxed);
+    stats.m_maxCaptureLatencyUs = m_maxCaptureLatencyUs.load(std::memory_order_relaxed);
+    stats.m_disconnectCount = m_disconnectCount.load(std::memory_order_relaxed);
+    stats.m_stallCount = m_stallCount.load(std::memory_order_relaxed);
+    stats.m_lastTimeToFirstFrameMs = m_lastTimeToFirstFrameMs.load(std::memory_order_relaxed);
+    stats.m_lastOutageMs = m_lastOutageMs.load(std::memory_order_relaxed);
+    stats.m_reconnectCount = m_reconnectCount.load(std::memory_order_relaxed);
+    stats.m_lastReconnectDelayMs = m_lastReconnectDelayMs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+DecodeQueueStats VideoClient::decodeQueueStats() const
+{
+    return m_decodeQueue.stats();
+}
+
+JitterBufferStats VideoClient::jitterStats() const
+{
+    std::lock_guard<std::mutex> lock(m_publishedStatsMutex);
+    return m_jitterStats;
+}
+
+SocketOptions VideoClient::socketOptions() const
+{
+    std::lock_guard<std::mutex> lock(m_publishedStatsMutex);
+    return m_socketOptions;
+}
+
+FramePoolStats VideoClient::framePoolStats() const
+{
+    return m_decoder.framePoolStats();
+}
+
+DecoderLoadStats VideoClient::decoderLoadStats() const
+{
+    return m_decoder.loadStats();
+}
+
+void VideoClient::onSocketEvent(int events)
+{
+    if (!m_isConnected)
     {
-        // 错误
-        std::cerr << "select called failed" << std::endl;
-#endif
+        // 还没连上时可写或出错都代表connect有结果了
+        if (events & (EVENTLOOP_WRITE | EVENTLOOP_ERROR))
+        {
+            doRunWaitConnection();
+        }
         return;
     }
-    else if (retValue == 0)
+
+    if (events & (EVENTLOOP_READ | EVENTLOOP_ERROR))
     {
-        // 超时
-        std::cerr << "select is time out" << std::endl;
-        return;
+        if (m_netConnectInfo.m_transport == TRANSPORT_UDP)
+        {
+            doReceiveDatagrams();
+        }
+        else
+        {
+            doReceiveData();
+        }
     }
 
-#ifdef _WIN32
-    if (!FD_ISSET(winSocket, &wSet)) {
-#else
-    // 检查套接字是否在写集合中(连接完成的关键标志,不在直接return)
-    if (!FD_ISSET(m_socketFD, &wSet)) {
-#endif
-        std::cerr << "no write set" << std::endl;
-        return;
+    // 收数据时可能已经断开了
+    if ((events & EVENTLOOP_WRITE) && m_isConnected)
+    {
+        flushSendBuffer();
     }
+}
+
+void VideoClient::doRunWaitConnection()
+{
+    m_pEventLoop->removeTimer(m_connectTimeoutTimerID);
+    m_connectTimeoutTimerID = 0;
 
     // 获取套接字错误状态去进一步判断
     int error = 0;
     socklen_t len = sizeof(error);
 #ifdef _WIN32
+    SOCKET winSocket = static_cast<SOCKET>(m_socketFD);
     if (getsockopt(winSocket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) == SOCKET_ERROR) {
         std::cerr << "getsockopt failed, error: " << WSAGetLastError() << std::endl;
 #else
     if (getsockopt(m_socketFD, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
         std::cerr << "getsockopt failed" << std::endl;
 #endif
+        closeConnection();
         return;
     }
     if (error != 0)
     {
         std::cerr << "connect failed: " << strerror(error) << std::endl;
+        closeConnection();
         return;
     }
 
+    // 连接完成后只关心可读事件，可写事件会一直触发
+    // 选择了io_uring时由它来收数据，初始化失败就退回普通recv
+    if (m_netConnectInfo.m_receiveBackend != RECEIVE_BACKEND_IO_URING || !startIoUringReceive())
+    {
+        m_pEventLoop->modifyFd(m_socketFD, EVENTLOOP_READ);
+    }
+
+    onConnected();
+}
+
+// 连接建立后重置接收状态并启动定时器，TCP和UDP共用
+void VideoClient::onConnected()
+{
+    m_reassembler.reset();
+    av_buffer_unref(&m_pDirectBuffer);
+
+    // 解码器重复使用，但要清掉上一个连接残留的参考帧，并且从下一个IDR开始解码
+    resetDecoder();
+    m_isWaitingForKeyFrame = true;
+    m_reconnectAttempt = 0;
+    m_lastReceiveTime = std::chrono::steady_clock::now();
+    m_connectedTime = m_lastReceiveTime;
+    m_isWaitingFirstFrame = true;
+
+    // 长时间收不到数据认为连接已经卡死
+    m_stallCheckTimerID = m_pEventLoop->addTimer(STALL_CHECK_INTERVAL_MS, true, [this]()
+                                                 { this->checkStall(); });
+
+    // 心跳由定时器驱动，不再需要单独睡眠的线程
+    m_keepAliveTimerID = m_pEventLoop->addTimer(KEEPALIVE_INTERVAL_SECONDS * 1000, true, [this]()
+                                                { this->sendKeepAlivePacket(); });
+
+    m_peerProtocolVersion = 0;
+    m_hasLastSequence = false;
+
     m_isConnected = true;
+    m_connectionState = ConnectionState::Connected;
+    readSocketOptions();
+
+    // 连上后立即发一个心跳，告诉服务端客户端支持的协议版本
+    sendKeepAlivePacket();
+
+    if (m_netConnectInfo.m_transport == TRANSPORT_UDP)
+    {
+        m_rtpReceiver.reset();
+        m_rtpReceiver.setLatency(m_netConnectInfo.m_jitterBufferLatencyMs);
+        m_datagramBuffer.resize(UDP_DATAGRAM_BUFFER_SIZE);
+
+        // 抖动缓冲区里等待的包即使没有新数据到达也要按时输出，重传请求也要按时发
+        m_rtpProcessTimerID = m_pEventLoop->addTimer(RTP_PROCESS_INTERVAL_MS, true, [this]()
+                                                     { this->processRtp(); });
+    }
+
     std::cout << "connect success" << std::endl;
 }
 
 void VideoClient::doReceiveData()
 {
-    H264Decoder decoder;
-    while (m_isThreadRunning)
+    m_lastReceiveTime = std::chrono::steady_clock::now();
+
+    // 水平触发，一直读到没有数据为止，一次读到的数据可能包含多个消息
+    while (m_isConnected)
     {
-        m_isReceiveThreadRunning = true;
-        // 10ms收取1次，这里不能接收太慢，如果频率太慢会导致大量socket数据丢弃，接收到的数据就是不连续的
-        // 会导致解码不出来
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        if (!m_isConnected)
+        // 大负载的剩余部分直接读到池里的缓冲区
+        if (m_pDirectBuffer != nullptr)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
-        }
+            size_t remainingLength = m_directMessage.m_length - m_directReceivedLength;
+            int nRet = readSocketData(m_pDirectBuffer->data + m_directReceivedLength, remainingLength);
+            if (nRet <= 0)
+            {
+                break;
+            }
 
-        std::vector<uint8_t> buffer(sizeof(NetMessageHeader));
-        if (!receiveSocketData(buffer, sizeof(NetMessageHeader)))
-        {
-            std::cerr << "failed to receive message header" << std::endl;
+            m_directReceivedLength += nRet;
+            if (m_directReceivedLength == m_directMessage.m_length)
+            {
+                AVBufferRef *buffer = m_pDirectBuffer;
+                m_pDirectBuffer = nullptr;
+                handleVideoPacket(m_directMessage, buffer);
+            }
+
+            if (static_cast<size_t>(nRet) < remainingLength)
+            {
+                break;
+            }
             continue;
         }
 
-        // 将接收到的数据转为需要的信息头结构体
-        NetMessageHeader msgHeader;
-        memcpy(&msgHeader, buffer.data(), sizeof(NetMessageHeader));
-
-        // 匹配消息头
-        if (strncmp(msgHeader.m_headerID, "ALIVE", 5) != 0 || msgHeader.m_msgType != MSGHEADER_TYPE_STREAM || msgHeader.m_subType != MSGHEADER_STREAM_VIDEO)
+        size_t writableLength = m_reassembler.writableLength();
+        int nRet = readSocketData(m_reassembler.writePointer(), writableLength);
+        if (nRet <= 0)
         {
-            continue;
+            break;
         }
-        // 消息头匹配成功再处理流媒体包
+        m_reassembler.commitWrite(nRet);
 
-        // 根据传过来的消息头中记录的数据的大小设置空间
-        std::vector<uint8_t> streamBuffer(msgHeader.m_length);
-        receiveSocketData(streamBuffer, msgHeader.m_length);
+        drainMessages();
+        beginDirectReceive();
 
-        YUVFrameData yuvFrameData;
-        int ret = decoder.decodeH264Packet(std::move(streamBuffer), msgHeader.m_length, &yuvFrameData);
-        if (ret != 0)
+        // 没读满说明内核缓冲区已经空了，省掉一次必然返回EAGAIN的recv
+        if (static_cast<size_t>(nRet) < writableLength)
         {
-            continue;
+            break;
         }
-        m_updateVideoCallback(&yuvFrameData);
     }
-    m_isReceiveThreadRunning = false;
-    std::cout << "stop receive packet from server" << std::endl;
+
+#ifdef PLATFORM_LINUX
+    // TCP_QUICKACK不是持久的，内核之后会切回延迟ACK，每次读完重新设置
+    if (m_netConnectInfo.m_isQuickAck && m_isConnected)
+    {
+        int value = 1;
+        setsockopt(m_socketFD, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+    }
+#endif
 }
 
-// 发送心跳包，告诉服务端，此客户端还活着
-// 避免客户端非正常结束，服务端接收不到close信号
-// 检测不到心跳包就直接关闭和此客户端的连接
-void VideoClient::sendKeepAlivePacket()
+void VideoClient::doReceiveDatagrams()
 {
-    while (m_isThreadRunning)
-    {
-        m_isKeepAliveThreadRunning = true;
-        std::cout << "send alive packet..." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+    m_lastReceiveTime = std::chrono::steady_clock::now();
 
-        // 没连接上的时候先空转
-        if (!m_isConnected)
+    // 一次把已经到达的数据报都放进抖动缓冲区，再统一取出
+    while (m_isConnected)
+    {
+        int nRet = readDatagram(m_datagramBuffer.data(), m_datagramBuffer.size());
+        if (nRet <= 0)
         {
-            continue;
+            break;
         }
+        m_rtpReceiver.pushDatagram(m_datagramBuffer.data(), nRet, m_lastReceiveTime);
+    }
 
-        // 这里心跳包后两个参数都是不用的
-        NetMessageHeader msgHeader("ALIVE", MSGHEADER_TYPE_KEEPALIVE, 0, 0);
+    processRtp();
+}
 
-        // 将要传入的对象转换为字节容器的形式
-        std::vector<uint8_t> buffer;
-        buffer.resize(sizeof(NetMessageHeader));
-        memcpy(buffer.data(), &msgHeader, sizeof(NetMessageHeader));
+// 输出抖动缓冲区里已经就绪的帧，并对缺失的包请求重传
+void VideoClient::processRtp()
+{
+    if (!m_isConnected)
+    {
+        return;
+    }
 
-        // 发送数据
-        if (!sendSocketData(buffer, sizeof(NetMessageHeader)))
+    auto now = std::chrono::steady_clock::now();
+    m_rtpReceiver.process(now, [this](AVBufferRef *buffer, size_t length, bool isAfterLoss)
+                          {
+        // 前面有丢包，参考帧不完整，等到下一个IDR
+        if (isAfterLoss)
         {
-            std::cerr << "failed to send message header" << std::endl;
+            this->m_isWaitingForKeyFrame = true;
         }
+        StreamMessage message;
+        message.m_header = NetMessageHeader("ALIVE", MSGHEADER_TYPE_STREAM, MSGHEADER_STREAM_VIDEO, length);
+        message.m_length = length;
+        this->handleVideoPacket(message, buffer); });
+
+    if (m_isConnected && m_rtpReceiver.buildNackPacket(m_nackPacket, now) > 0)
+    {
+        sendSocketData(m_nackPacket, m_nackPacket.size());
     }
-    m_isKeepAliveThreadRunning = false;
 
-    std::cout << "stop send alive packet" << std::endl;
+    std::lock_guard<std::mutex> lock(m_publishedStatsMutex);
+    m_jitterStats = m_rtpReceiver.jitterStats();
 }
-#ifdef PLATFORM_LINUX
-bool VideoClient::receiveSocketData(std::vector<uint8_t> &buffer, size_t length)
-{
-
-    // 第一个信号表示向已关闭的socket写入数据，一般会异常终止进程
-    // 第二个信号表示忽略第一个信号，避免终止
-    std::signal(SIGPIPE, SIG_IGN);
-
 
-    std::lock_guard<std::mutex> lock(m_receiveMutex);
-
-    // 调整buffer大小以容纳指定长度的数据
-    buffer.resize(length);
-
-    // 已成功接收到的数据
-    size_t receiveLength = 0;
-    // 循环接收数据直到达到指定长度
-    while (receiveLength < length)
+// 取出所有已经完整的消息
+void VideoClient::drainMessages()
+{
+    StreamMessage message;
+    while (m_isConnected && m_reassembler.nextMessage(message))
     {
-        // 从socket接收数据，buffer.data() + receiveLength代表从已经接收到的数据的后面开始接收
-        // length - receiveLength表示总共需要的-已经接收的=剩下还需要多少=这次最大接收多少
-        // 最后一个参数代表，模式，0为默认值，代表阻塞模式等待数据到达，但因为之前设置了非阻塞模式，所以这里还是非阻塞
-        // 返回接收数据大小
-        int nRet = recv(m_socketFD, buffer.data() + receiveLength, length - receiveLength, 0);
-
-        // 异常处理
-        if (nRet < 0)
+        // 重新同步过说明前面丢了数据
+        if (m_reassembler.takeDiscontinuity())
         {
-            // 第一个和第三个表示socket无数据可读，第二个表示系统调用被中断
-            // 这三种情况都先短暂休眠
-            if (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
-
-            // 其他错误直接返回false
-            std::cerr << "socket receive error" << std::endl;
-            return false;
+            m_isWaitingForKeyFrame = true;
         }
 
-        // 对方连接关闭则直接返回false
-        if (nRet == 0)
+        if (message.m_version != m_peerProtocolVersion)
         {
-            std::cerr << "connection close, socket receive error" << std::endl;
-            return false;
+            std::cout << "server protocol version " << message.m_version << std::endl;
+            m_peerProtocolVersion = message.m_version;
         }
-
-        receiveLength += nRet;
+        handleMessage(message);
     }
-
-    return true;
 }
 
-bool VideoClient::sendSocketData(const std::vector<uint8_t> &buffer, size_t length)
+// 缓冲区里剩下一个没收完的大视频消息时，之后的负载直接读到池里的缓冲区
+void VideoClient::beginDirectReceive()
 {
-    // 忽略SIGPIPE信号，防止向已关闭的socket写入数据时程序异常终止
-    std::signal(SIGPIPE, SIG_IGN);
-
-    std::lock_guard<std::mutex> lock(m_sendMutex);
-
-    // 不需要调整buffer大小，因为是发送数据，buffer应该是已经准备好的数据
-    // buffer应该至少包含length字节的数据
+    StreamMessage message;
+    size_t bufferedLength = 0;
+    if (!m_isConnected || !m_reassembler.pendingPayload(message, bufferedLength))
+    {
+        return;
+    }
 
-    // 已成功发送的数据
-    size_t sendLength = 0;
-    // 循环发送数据直到达到指定长度
-    while (sendLength < length)
+    const NetMessageHeader &header = message.m_header;
+    if (header.m_length < PACKET_DIRECT_READ_THRESHOLD || header.m_msgType != MSGHEADER_TYPE_STREAM || header.m_subType != MSGHEADER_STREAM_VIDEO)
     {
-        // 从buffer中发送数据，buffer.data() + sendLength代表从未发送的数据开始发送
-        // length - sendLength表示总共需要发送的-已经发送的=剩下还需要发送多少
-        // 最后一个参数0为默认值，表示使用默认行为
-        // send函数返回实际发送的字节数
-        int nRet = send(m_socketFD, buffer.data() + sendLength, length - sendLength, 0);
+        return;
+    }
 
-        // 异常处理
-        if (nRet < 0)
-        {
-            // 第一个和第三个表示socket无数据可读，第二个表示系统调用被中断
-            // 这三种情况都先短暂休眠
-            if (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
+    AVBufferRef *buffer = m_packetPool.acquire(header.m_length);
+    if (buffer == nullptr)
+    {
+        return;
+    }
 
-            // 其他错误则直接返回false
-            std::cerr << "socket send error" << std::endl;
-            return false;
-        }
+    if (m_reassembler.takeDiscontinuity())
+    {
+        m_isWaitingForKeyFrame = true;
+    }
 
-        // 对方连接关闭则直接返回false
-        if (nRet == 0)
-        {
-            std::cerr << "connection close, socket send error" << std::endl;
-            return false;
-        }
+    m_directMessage = message;
+    m_directReceivedLength = m_reassembler.takePendingPayload(buffer->data);
+    m_pDirectBuffer = buffer;
+}
 
-        // 累加已发送的数据长度
-        sendLength += nRet;
+bool VideoClient::startIoUringReceive()
+{
+    if (!m_uringReceiver.init(m_socketFD))
+    {
+        return false;
     }
 
+    // 套接字不再由epoll监听，改为监听io_uring的完成通知
+    m_pEventLoop->removeFd(m_socketFD);
+    m_pEventLoop->addFd(m_uringReceiver.eventFD(), EVENTLOOP_READ, [this](int)
+                        { this->onIoUringEvent(); });
     return true;
 }
 
-#elif PLATFORM_WINDOWS
-bool VideoClient::receiveSocketData(std::vector<uint8_t> &buffer, size_t length)
+void VideoClient::onIoUringEvent()
 {
-    std::lock_guard<std::mutex> lock(m_receiveMutex);
+    m_lastReceiveTime = std::chrono::steady_clock::now();
 
-    // 调整buffer大小以容纳指定长度的数据
-    buffer.resize(length);
-
-    // 已成功接收到的数据
-    size_t receiveLength = 0;
-    // 循环接收数据直到达到指定长度
-    while (receiveLength < length)
+    int ret = m_uringReceiver.processCompletions([this](const uint8_t *data, size_t length)
+                                                 { this->feedReceivedData(data, length); });
+    if (ret == IOURING_RESULT_UNSUPPORTED)
     {
-        // 从socket接收数据，buffer.data() + receiveLength代表从已经接收到的数据的后面开始接收
-        // length - receiveLength表示总共需要的-已经接收的=剩下还需要多少=这次最大接收多少
-        // 最后一个参数代表，模式，0为默认值，代表阻塞模式等待数据到达，但因为之前设置了非阻塞模式，所以这里还是非阻塞
-        // 返回接收数据大小
-        int nRet = recv(m_socketFD, reinterpret_cast<char*>(buffer.data() + receiveLength), static_cast<int>(length - receiveLength), 0);
-
-        // 异常处理 - Windows使用不同的错误检查方式
-        if (nRet == SOCKET_ERROR)
-        {
-            int errorCode = WSAGetLastError();
+        // 内核不支持multishot recv，换回epoll+recv
+        std::cerr << "io_uring recv unsupported, fallback to recv" << std::endl;
+        m_pEventLoop->removeFd(m_uringReceiver.eventFD());
+        m_uringReceiver.close();
+        // 有数据没发完时套接字已经只为可写事件加进了循环，换成同时监听可读
+        m_pEventLoop->removeFd(m_socketFD);
+        m_pEventLoop->addFd(m_socketFD, m_isWaitingWritable ? (EVENTLOOP_READ | EVENTLOOP_WRITE) : EVENTLOOP_READ, [this](int events)
+                            { this->onSocketEvent(events); });
+    }
+    else if (ret == IOURING_RESULT_CLOSED)
+    {
+        closeConnection();
+    }
+}
 
-            // Windows下的非阻塞错误码
-            if (errorCode == WSAEWOULDBLOCK || errorCode == WSAEINTR)
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
+// io_uring收到的数据在内核提供的缓冲区里，拷贝进接收缓冲区后再切分消息
+void VideoClient::feedReceivedData(const uint8_t *data, size_t length)
+{
+    while (length > 0 && m_isConnected)
+    {
+        size_t copyLength = std::min(length, m_reassembler.writableLength());
+        memcpy(m_reassembler.writePointer(), data, copyLength);
+        m_reassembler.commitWrite(copyLength);
+        data += copyLength;
+        length -= copyLength;
 
-            // 其他错误
-            std::cerr << "socket receive error, code: " << errorCode << std::endl;
-            return false;
-        }
+        drainMessages();
+    }
+}
 
-        // 对方连接关闭
-        if (nRet == 0)
-        {
-            std::cerr << "connection close, socket receive error" << std::endl;
-            return false;
-        }
+void VideoClient::handleMessage(const StreamMessage &message)
+{
+    // 只处理视频流消息
+    if (message.m_header.m_msgType != MSGHEADER_TYPE_STREAM || message.m_header.m_subType != MSGHEADER_STREAM_VIDEO)
+    {
+        return;
+    }
 
-        receiveLength += nRet;
+    // 小负载从接收缓冲区拷贝到池里的缓冲区，解码器不用再自己分配一份
+    AVBufferRef *buffer = m_packetPool.acquire(message.m_length);
+    if (buffer == nullptr)
+    {
+        return;
     }
+    memcpy(buffer->data, message.m_payload, message.m_length);
 
-    return true;
+    handleVideoPacket(message, buffer);
 }
 
-bool VideoClient::sendSocketData(const std::vector<uint8_t> &buffer, size_t length)
+void VideoClient::handleVideoPacket(const StreamMessage &message, AVBufferRef *buffer)
 {
-    std::lock_guard<std::mutex> lock(m_sendMutex);
-
-    // 不需要调整buffer大小，因为是发送数据，buffer应该是已经准备好的数据
-    // buffer应该至少包含length字节的数据
+    m_videoPackets++;
 
-    // 已成功发送的数据
-    size_t sendLength = 0;
-    // 循环发送数据直到达到指定长度
-    while (sendLength < length)
+    bool isV2 = message.m_version == PROTOCOL_VERSION_2;
+    uint16_t flags = isV2 ? message.m_extension.m_flags : 0;
+    if (isV2 && !checkMessageV2(message, buffer))
     {
-        // Windows版本：需要类型转换和长度转换
-        int nRet = send(m_socketFD,
-                        reinterpret_cast<const char*>(buffer.data() + sendLength),
-                        static_cast<int>(length - sendLength),
-                        0);
+        av_buffer_unref(&buffer);
+        return;
+    }
+
+    // v2消息头直接带了帧类型，不用再扫描NAL
+    // v1在等待IDR时要扫描；队列满时清空到IDR的策略也要知道这个包是不是IDR，否则IDR会和队列一起被丢掉
+    bool isKeyFrame = (flags & MSGHEADER_FLAG_IDR) != 0;
+    bool isDropToKeyFrame = m_pDecodePool == nullptr && m_netConnectInfo.m_decodeQueuePolicy == DECODE_QUEUE_POLICY_DROP_TO_IDR;
+    if (!isV2 && (m_isWaitingForKeyFrame || isDropToKeyFrame))
+    {
+        isKeyFrame = H264Decoder::isKeyFramePacket(buffer->data, message.m_length);
+    }
+    if (m_isWaitingForKeyFrame)
+    {
+        // 单独发送的参数集要先交给解码器，IDR才能解码
+        bool isConfig = (flags & MSGHEADER_FLAG_CONFIG) != 0;
+        if (!isKeyFrame && !isConfig)
+        {
+            m_droppedWaitingKeyFrame++;
+            av_buffer_unref(&buffer);
+            return;
+        }
+
+        if (isKeyFrame)
+        {
+            m_isWaitingForKeyFrame = false;
+            std::cout << "stream resynchronized at key frame" << std::endl;
+        }
+    }
+
+    // 解码跟不上时先丢掉不被参考的帧，不影响后面的帧
+    size_t pendingCount = m_pDecodePool != nullptr ? m_pendingDecodeCount.load() : m_decodeQueue.depth();
+    if ((flags & MSGHEADER_FLAG_DISCARDABLE) && pendingCount >= DISCARDABLE_DROP_QUEUE_DEPTH)
+    {
+        m_droppedDiscardable++;
+        av_buffer_unref(&buffer);
+        return;
+    }
+
+    // v2消息头的采集时间作为pts，解码后从帧的best_effort_timestamp带出来
+    int64_t pts = isV2 ? static_cast<int64_t>(message.m_extension.m_captureTimeUs) : AV_NOPTS_VALUE;
+
+    // 有解码线程池时交给这路流固定的解码线程，网络线程不等待解码
+    if (m_pDecodePool != nullptr)
+    {
+        size_t length = message.m_length;
+        auto postTime = std::chrono::steady_clock::now();
+        m_pendingDecodeCount++;
+        m_pDecodePool->post(m_decodeWorkerIndex, [this, length, pts, buffer, postTime]()
+                            {
+            auto queueDelay = std::chrono::steady_clock::now() - postTime;
+            this->decodeVideoPacket(length, pts, buffer, std::chrono::duration_cast<std::chrono::microseconds>(queueDelay).count());
+            this->m_pendingDecodeCount--; });
+        return;
+    }
+
+    DecodeQueueItem item;
+    item.m_pBuffer = buffer;
+    item.m_length = message.m_length;
+    item.m_pts = pts;
+    item.m_isKeyFrame = isKeyFrame;
+    item.m_generation = m_decodeGeneration;
+    if (m_decodeQueue.push(std::move(item)) == DECODE_QUEUE_FLUSHED)
+    {
+        // 队列里的包都丢了，之后的包缺少参考帧
+        m_isWaitingForKeyFrame = true;
+    }
+}
+
+// 根据v2消息头统计丢失的消息、校验负载并计算延迟，负载损坏时返回false
+bool VideoClient::checkMessageV2(const StreamMessage &message, const AVBufferRef *buffer)
+{
+    const NetMessageHeaderExt &extension = message.m_extension;
+
+    // 序号不连续说明中间有消息丢了，参考帧不完整，要等下一个IDR
+    if (m_hasLastSequence)
+    {
+        uint32_t gap = extension.m_sequence - m_lastSequence - 1;
+        if (gap != 0 && gap < 0x80000000u)
+        {
+            m_lostMessages += gap;
+            m_isWaitingForKeyFrame = true;
+        }
+    }
+    m_hasLastSequence = true;
+    m_lastSequence = extension.m_sequence;
+
+    if (extension.m_flags & MSGHEADER_FLAG_CHECKSUM)
+    {
+        const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+        uint32_t checksum = av_crc(table, UINT32_MAX, buffer->data, message.m_length) ^ UINT32_MAX;
+        if (checksum != extension.m_checksum)
+        {
+            m_checksumErrors++;
+            m_isWaitingForKeyFrame = true;
+            return false;
+        }
+    }
+
+    if (extension.m_captureTimeUs != 0)
+    {
+        int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        int64_t latencyUs = nowUs - static_cast<int64_t>(extension.m_captureTimeUs);
+        m_lastCaptureLatencyUs.store(latencyUs, std::memory_order_relaxed);
+        if (latencyUs > m_maxCaptureLatencyUs.load(std::memory_order_relaxed))
+        {
+            m_maxCaptureLatencyUs.store(latencyUs, std::memory_order_relaxed);
+        }
+    }
+
+    return true;
+}
+
+// 解码并回调，在解码线程或解码线程池里执行
+void VideoClient::decodeVideoPacket(size_t length, int64_t pts, AVBufferRef *buffer, int64_t queueDelayUs)
+{
+    // 一个包可能解出多帧，也可能一帧都没有
+    m_decoder.decodeH264Packet(buffer, length, pts, queueDelayUs, [this](YUVFrameData *yuvFrameData)
+                               {
+        if (this->m_isWaitingFirstFrame)
+        {
+            this->recordFirstFrame();
+        }
+
+        if (this->m_updateVideoCallback)
+        {
+            this->m_updateVideoCallback(yuvFrameData);
+        } });
+}
+
+// 把上一个连接还缓存在解码器里的帧输出，再从新连接的IDR开始解码
+// 这些帧属于上一个连接，不算作新连接的第一帧
+void VideoClient::drainDecoder()
+{
+    m_decoder.flush([this](YUVFrameData *yuvFrameData)
+                    {
+        if (this->m_updateVideoCallback)
+        {
+            this->m_updateVideoCallback(yuvFrameData);
+        } });
+}
+
+void VideoClient::resetDecoder()
+{
+    if (m_pDecodePool != nullptr)
+    {
+        m_pDecodePool->post(m_decodeWorkerIndex, [this]()
+                            { this->drainDecoder(); });
+        return;
+    }
+
+    // 解码线程按包里带的序号判断，保证和包的顺序一致
+    m_decodeGeneration++;
+}
+
+void VideoClient::runDecodeLoop()
+{
+    uint64_t decodedGeneration = 0;
+    DecodeQueueItem item;
+    while (m_decodeQueue.pop(item))
+    {
+        if (item.m_generation != decodedGeneration)
+        {
+            drainDecoder();
+            decodedGeneration = item.m_generation;
+        }
+
+        auto queueDelay = std::chrono::steady_clock::now() - item.m_enqueueTime;
+        decodeVideoPacket(item.m_length, item.m_pts, item.m_pBuffer, std::chrono::duration_cast<std::chrono::microseconds>(queueDelay).count());
+    }
+}
+
+// 发送心跳包，告诉服务端，此客户端还活着
+// 避免客户端非正常结束，服务端接收不到close信号
+// 检测不到心跳包就直接关闭和此客户端的连接
+void VideoClient::sendKeepAlivePacket()
+{
+    if (!m_isConnected)
+    {
+        return;
+    }
+    std::cout << "send alive packet..." << std::endl;
+
+    // 心跳包的subType用来声明客户端支持的最高协议版本，长度不用
+    NetMessageHeader msgHeader("ALIVE", MSGHEADER_TYPE_KEEPALIVE, m_netConnectInfo.m_protocolVersion, 0);
+
+    // 将要传入的对象转换为字节容器的形式
+    std::vector<uint8_t> buffer;
+    buffer.resize(sizeof(NetMessageHeader));
+    memcpy(buffer.data(), &msgHeader, sizeof(NetMessageHeader));
+
+    // 发送数据
+    if (!sendSocketData(buffer, sizeof(NetMessageHeader)))
+    {
+        std::cerr << "failed to send message header" << std::endl;
+    }
+}
+
+// 连接失败或断开后，把套接字从事件循环里移除并关闭，没有在停止的话稍后重连
+void VideoClient::closeConnection()
+{
+    bool wasConnected = m_isConnected;
+    m_isConnected = false;
+
+    if (m_connectTimeoutTimerID != 0)
+    {
+        m_pEventLoop->removeTimer(m_connectTimeoutTimerID);
+        m_connectTimeoutTimerID = 0;
+    }
+
+    if (m_keepAliveTimerID != 0)
+    {
+        m_pEventLoop->removeTimer(m_keepAliveTimerID);
+        m_keepAliveTimerID = 0;
+    }
+
+    if (m_stallCheckTimerID != 0)
+    {
+        m_pEventLoop->removeTimer(m_stallCheckTimerID);
+        m_stallCheckTimerID = 0;
+    }
+
+    if (m_reconnectTimerID != 0)
+    {
+        m_pEventLoop->removeTimer(m_reconnectTimerID);
+        m_reconnectTimerID = 0;
+    }
+
+    if (m_rtpProcessTimerID != 0)
+    {
+        m_pEventLoop->removeTimer(m_rtpProcessTimerID);
+        m_rtpProcessTimerID = 0;
+    }
+
+    if (m_uringReceiver.isActive())
+    {
+        m_pEventLoop->removeFd(m_uringReceiver.eventFD());
+        m_uringReceiver.close();
+    }
+
+    av_buffer_unref(&m_pDirectBuffer);
+
+    // 没发完的数据属于这个连接，丢掉
+    m_sendBuffer.clear();
+    m_sendOffset = 0;
+    m_isWaitingWritable = false;
+
+    if (m_socketFD >= 0)
+    {
+        m_pEventLoop->removeFd(m_socketFD);
+        close(m_socketFD);
+        m_socketFD = -1;
+    }
+
+    m_connectionState = ConnectionState::Disconnected;
+
+    if (wasConnected)
+    {
+        // 从断开开始计算恢复画面用了多久
+        m_disconnectTime = std::chrono::steady_clock::now();
+        m_disconnectCount++;
+    }
+
+    if (!m_isStopping)
+    {
+        scheduleReconnect();
+    }
+}
+
+// 指数退避加随机抖动，避免很多客户端在服务端恢复时同时重连
+void VideoClient::scheduleReconnect()
+{
+    if (m_reconnectTimerID != 0)
+    {
+        return;
+    }
+
+    int maxDelayMs = RECONNECT_BASE_DELAY_MS << std::min(m_reconnectAttempt, 16);
+    maxDelayMs = std::min(maxDelayMs, RECONNECT_MAX_DELAY_MS);
+    std::uniform_int_distribution<int> distribution(maxDelayMs / 2, maxDelayMs);
+    int delayMs = distribution(m_randomEngine);
+    m_reconnectAttempt++;
+    m_lastReconnectDelayMs.store(delayMs, std::memory_order_relaxed);
+    m_reconnectCount++;
+
+    std::cout << "reconnect in " << delayMs << " ms, attempt " << m_reconnectAttempt << std::endl;
+    m_connectionState = ConnectionState::WaitingReconnect;
+    m_reconnectTimerID = m_pEventLoop->addTimer(delayMs, false, [this]()
+                                                { this->connectToServer(); });
+}
+
+void VideoClient::checkStall()
+{
+    auto idleTime = std::chrono::steady_clock::now() - m_lastReceiveTime;
+    if (m_isConnected && idleTime > std::chrono::seconds(STALL_TIMEOUT_SECONDS))
+    {
+        std::cerr << "no data received for " << STALL_TIMEOUT_SECONDS << " seconds, reconnect" << std::endl;
+        m_stallCount++;
+        closeConnection();
+    }
+}
+
+void VideoClient::recordFirstFrame()
+{
+    m_isWaitingFirstFrame = false;
+
+    auto now = std::chrono::steady_clock::now();
+    int64_t timeToFirstFrameMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_connectedTime.load()).count();
+    m_lastTimeToFirstFrameMs.store(timeToFirstFrameMs, std::memory_order_relaxed);
+
+    // 断线重连的情况下额外记录从断开到恢复画面的时间
+    if (m_disconnectCount.load(std::memory_order_relaxed) > 0)
+    {
+        m_lastOutageMs.store(std::chrono::duration_cast<std::chrono::milliseconds>(now - m_disconnectTime.load()).count(), std::memory_order_relaxed);
+    }
+
+    std::cout << "first frame after " << timeToFirstFrameMs << " ms" << std::endl;
+}
+
+// 在事件循环线程里调用，发不完的部分留在发送缓冲区里，等套接字可写时再发，不会阻塞循环里的其他连接
+bool VideoClient::sendSocketData(const std::vector<uint8_t> &buffer, size_t length)
+{
+    if (m_socketFD < 0)
+    {
+        return false;
+    }
+
+    // 数据报要么整个发出去要么不发，发不出去就丢掉，NACK下一次处理时会重新生成
+    if (m_netConnectInfo.m_transport == TRANSPORT_UDP)
+    {
+        return writeSocketData(buffer.data(), length) > 0;
+    }
+
+    // 前面还有没发完的数据时只能排在后面，保证顺序
+    size_t sentLength = 0;
+    if (m_sendOffset == m_sendBuffer.size())
+    {
+        int nRet = writeSocketData(buffer.data(), length);
+        if (nRet < 0)
+        {
+            closeConnection();
+            return false;
+        }
+        sentLength = static_cast<size_t>(nRet);
+        if (sentLength == length)
+        {
+            return true;
+        }
+    }
+
+    // 对端长时间不读，积压太多时不再缓存，之后由卡死检测断开重连
+    if (m_sendBuffer.size() - m_sendOffset + length - sentLength > SEND_BUFFER_MAX_SIZE)
+    {
+        std::cerr << "send buffer is full, drop " << length - sentLength << " bytes" << std::endl;
+        return false;
+    }
+
+    m_sendBuffer.insert(m_sendBuffer.end(), buffer.begin() + sentLength, buffer.begin() + length);
+    updateWriteInterest();
+    return true;
+}
+
+// 套接字可写时把发送缓冲区里剩下的数据发出去
+void VideoClient::flushSendBuffer()
+{
+    while (m_sendOffset < m_sendBuffer.size())
+    {
+        int nRet = writeSocketData(m_sendBuffer.data() + m_sendOffset, m_sendBuffer.size() - m_sendOffset);
+        if (nRet < 0)
+        {
+            closeConnection();
+            return;
+        }
+        if (nRet == 0)
+        {
+            break;
+        }
+        m_sendOffset += nRet;
+    }
+
+    if (m_sendOffset == m_sendBuffer.size())
+    {
+        m_sendBuffer.clear();
+        m_sendOffset = 0;
+    }
+    updateWriteInterest();
+}
+
+// 只在有数据没发完时监听可写事件，否则可写事件会一直触发
+void VideoClient::updateWriteInterest()
+{
+    bool isWaitingWritable = m_sendOffset < m_sendBuffer.size();
+    if (isWaitingWritable == m_isWaitingWritable || m_socketFD < 0)
+    {
+        return;
+    }
+    m_isWaitingWritable = isWaitingWritable;
+
+    // 用io_uring收数据时套接字不在事件循环里，临时加进去只监听可写
+    if (m_uringReceiver.isActive())
+    {
+        if (isWaitingWritable)
+        {
+            m_pEventLoop->addFd(m_socketFD, EVENTLOOP_WRITE, [this](int)
+                                { this->flushSendBuffer(); });
+        }
+        else
+        {
+            m_pEventLoop->removeFd(m_socketFD);
+        }
+        return;
+    }
+
+    m_pEventLoop->modifyFd(m_socketFD, isWaitingWritable ? (EVENTLOOP_READ | EVENTLOOP_WRITE) : EVENTLOOP_READ);
+}
+
+#ifdef PLATFORM_LINUX
+static void setSocketOption(int socketFD, int level, int optionName, int value, const char *name)
+{
+    if (setsockopt(socketFD, level, optionName, &value, sizeof(value)) < 0)
+    {
+        std::cerr << "set " << name << " failed: " << strerror(errno) << std::endl;
+    }
+}
+
+static int getSocketOption(int socketFD, int level, int optionName)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (getsockopt(socketFD, level, optionName, &value, &len) < 0)
+    {
+        return -1;
+    }
+    return value;
+}
+
+void VideoClient::applySocketOptions()
+{
+    bool isTcp = m_netConnectInfo.m_transport == TRANSPORT_TCP;
+
+    // 缓冲区大小要在connect之前设置，TCP握手时要根据接收缓冲区确定窗口扩大因子
+    if (m_netConnectInfo.m_receiveBufferSize > 0)
+    {
+        setSocketOption(m_socketFD, SOL_SOCKET, SO_RCVBUF, m_netConnectInfo.m_receiveBufferSize, "SO_RCVBUF");
+    }
+    if (m_netConnectInfo.m_sendBufferSize > 0)
+    {
+        setSocketOption(m_socketFD, SOL_SOCKET, SO_SNDBUF, m_netConnectInfo.m_sendBufferSize, "SO_SNDBUF");
+    }
+
+    if (isTcp)
+    {
+        setSocketOption(m_socketFD, IPPROTO_TCP, TCP_NODELAY, m_netConnectInfo.m_isNoDelay ? 1 : 0, "TCP_NODELAY");
+        if (m_netConnectInfo.m_isQuickAck)
+        {
+            setSocketOption(m_socketFD, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+        }
+    }
+
+    if (m_netConnectInfo.m_busyPollMicros > 0)
+    {
+#ifdef SO_BUSY_POLL
+        setSocketOption(m_socketFD, SOL_SOCKET, SO_BUSY_POLL, m_netConnectInfo.m_busyPollMicros, "SO_BUSY_POLL");
+#else
+        // 每次重连都会走到这里，画面墙里还有很多个客户端，只提示一次
+        static std::atomic_bool s_isReported{false};
+        if (!s_isReported.exchange(true))
+        {
+            std::cerr << "SO_BUSY_POLL is not supported" << std::endl;
+        }
+#endif
+    }
+}
+
+void VideoClient::readSocketOptions()
+{
+    bool isTcp = m_netConnectInfo.m_transport == TRANSPORT_TCP;
+
+    std::lock_guard<std::mutex> lock(m_publishedStatsMutex);
+    m_socketOptions = SocketOptions();
+    m_socketOptions.m_receiveBufferSize = getSocketOption(m_socketFD, SOL_SOCKET, SO_RCVBUF);
+    m_socketOptions.m_sendBufferSize = getSocketOption(m_socketFD, SOL_SOCKET, SO_SNDBUF);
+    if (isTcp)
+    {
+        m_socketOptions.m_isNoDelay = getSocketOption(m_socketFD, IPPROTO_TCP, TCP_NODELAY) > 0;
+        m_socketOptions.m_isQuickAck = getSocketOption(m_socketFD, IPPROTO_TCP, TCP_QUICKACK) > 0;
+    }
+#ifdef SO_BUSY_POLL
+    m_socketOptions.m_busyPollMicros = getSocketOption(m_socketFD, SOL_SOCKET, SO_BUSY_POLL);
+#endif
+
+    std::cout << "socket options: rcvbuf " << m_socketOptions.m_receiveBufferSize
+              << ", sndbuf " << m_socketOptions.m_sendBufferSize
+              << ", nodelay " << m_socketOptions.m_isNoDelay
+              << ", quickack " << m_socketOptions.m_isQuickAck
+              << ", busy poll " << m_socketOptions.m_busyPollMicros << " us" << std::endl;
+}
+
+int VideoClient::readSocketData(uint8_t *buffer, size_t length)
+{
+    while (true)
+    {
+        // 套接字是非阻塞的，只在事件循环通知可读后才调用，不需要再休眠等待数据
+        int nRet = recv(m_socketFD, buffer, length, 0);
+
+        // 异常处理
+        if (nRet < 0)
+        {
+            // 系统调用被中断就重试
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // socket无数据可读，等下一次可读事件
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+
+            // 其他错误直接关闭连接
+            std::cerr << "socket receive error" << std::endl;
+            closeConnection();
+            return -1;
+        }
+
+        // 对方连接关闭
+        if (nRet == 0)
+        {
+            std::cerr << "connection close, socket receive error" << std::endl;
+            closeConnection();
+            return -1;
+        }
+
+        return nRet;
+    }
+}
+
+int VideoClient::readDatagram(uint8_t *buffer, size_t length)
+{
+    while (true)
+    {
+        int nRet = recv(m_socketFD, buffer, length, 0);
+        if (nRet < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+
+            // 服务端还没启动时会收到ICMP端口不可达，不算断开，由卡死检测负责重连
+            if (errno == ECONNREFUSED)
+            {
+                continue;
+            }
+
+            std::cerr << "datagram receive error" << std::endl;
+            closeConnection();
+            return -1;
+        }
+
+        // UDP的空数据报不代表连接关闭
+        if (nRet == 0)
+        {
+            continue;
+        }
+
+        return nRet;
+    }
+}
+
+int VideoClient::writeSocketData(const uint8_t *buffer, size_t length)
+{
+    // 忽略SIGPIPE信号，防止向已关闭的socket写入数据时程序异常终止
+    std::signal(SIGPIPE, SIG_IGN);
+
+    while (true)
+    {
+        int nRet = send(m_socketFD, buffer, length, 0);
+        if (nRet < 0)
+        {
+            // 系统调用被中断就重试
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // 内核发送缓冲区满了，等下一次可写事件，不能在事件循环线程里休眠
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+
+            std::cerr << "socket send error" << std::endl;
+            return -1;
+        }
+
+        return nRet;
+    }
+}
+
+#elif PLATFORM_WINDOWS
+static void setSocketOption(int socketFD, int level, int optionName, int value, const char *name)
+{
+    if (setsockopt(socketFD, level, optionName, reinterpret_cast<const char*>(&value), sizeof(value)) == SOCKET_ERROR)
+    {
+        std::cerr << "set " << name << " failed, code: " << WSAGetLastError() << std::endl;
+    }
+}
+
+static int getSocketOption(int socketFD, int level, int optionName)
+{
+    int value = 0;
+    int len = sizeof(value);
+    if (getsockopt(socketFD, level, optionName, reinterpret_cast<char*>(&value), &len) == SOCKET_ERROR)
+    {
+        return -1;
+    }
+    return value;
+}
+
+void VideoClient::applySocketOptions()
+{
+    bool isTcp = m_netConnectInfo.m_transport == TRANSPORT_TCP;
+
+    if (m_netConnectInfo.m_receiveBufferSize > 0)
+    {
+        setSocketOption(m_socketFD, SOL_SOCKET, SO_RCVBUF, m_netConnectInfo.m_receiveBufferSize, "SO_RCVBUF");
+    }
+    if (m_netConnectInfo.m_sendBufferSize > 0)
+    {
+        setSocketOption(m_socketFD, SOL_SOCKET, SO_SNDBUF, m_netConnectInfo.m_sendBufferSize, "SO_SNDBUF");
+    }
+
+    if (isTcp)
+    {
+        setSocketOption(m_socketFD, IPPROTO_TCP, TCP_NODELAY, m_netConnectInfo.m_isNoDelay ? 1 : 0, "TCP_NODELAY");
+    }
+
+    // Windows没有对应的选项
+    // 每次重连都会走到这里，只提示一次
+    static std::atomic_bool s_isReported{false};
+    if ((m_netConnectInfo.m_isQuickAck || m_netConnectInfo.m_busyPollMicros > 0) && !s_isReported.exchange(true))
+    {
+        std::cerr << "TCP_QUICKACK and SO_BUSY_POLL are not supported on Windows" << std::endl;
+    }
+}
+
+void VideoClient::readSocketOptions()
+{
+    std::lock_guard<std::mutex> lock(m_publishedStatsMutex);
+    m_socketOptions = SocketOptions();
+    m_socketOptions.m_receiveBufferSize = getSocketOption(m_socketFD, SOL_SOCKET, SO_RCVBUF);
+    m_socketOptions.m_sendBufferSize = getSocketOption(m_socketFD, SOL_SOCKET, SO_SNDBUF);
+    if (m_netConnectInfo.m_transport == TRANSPORT_TCP)
+    {
+        m_socketOptions.m_isNoDelay = getSocketOption(m_socketFD, IPPROTO_TCP, TCP_NODELAY) > 0;
+    }
+
+    std::cout << "socket options: rcvbuf " << m_socketOptions.m_receiveBufferSize
+              << ", sndbuf " << m_socketOptions.m_sendBufferSize
+              << ", nodelay " << m_socketOptions.m_isNoDelay << std::endl;
+}
+
+int VideoClient::readSocketData(uint8_t *buffer, size_t length)
+{
+    while (true)
+    {
+        int nRet = recv(m_socketFD, reinterpret_cast<char*>(buffer), static_cast<int>(length), 0);
 
         // 异常处理 - Windows使用不同的错误检查方式
         if (nRet == SOCKET_ERROR)
         {
             int errorCode = WSAGetLastError();
 
-            // Windows下的非阻塞错误码
-            if (errorCode == WSAEWOULDBLOCK || errorCode == WSAEINTR)
+            if (errorCode == WSAEINTR)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
                 continue;
             }
 
+            // Windows下的非阻塞错误码，等下一次可读事件
+            if (errorCode == WSAEWOULDBLOCK)
+            {
+                return 0;
+            }
+
             // 其他错误
-            std::cerr << "Windows socket send error, code: " << errorCode << std::endl;
-            return false;
+            std::cerr << "socket receive error, code: " << errorCode << std::endl;
+            closeConnection();
+            return -1;
         }
 
-        // 对方连接关闭则直接返回false
+        // 对方连接关闭
         if (nRet == 0)
         {
-            std::cerr << "connection close, socket send error" << std::endl;
-            return false;
+            std::cerr << "connection close, socket receive error" << std::endl;
+            closeConnection();
+            return -1;
         }
 
-        // 累加已发送的数据长度
-        sendLength += nRet;
+        return nRet;
     }
+}
 
-    return true;
+int VideoClient::readDatagram(uint8_t *buffer, size_t length)
+{
+    while (true)
+    {
+        int nRet = recv(m_socketFD, reinterpret_cast<char*>(buffer), static_cast<int>(length), 0);
+        if (nRet == SOCKET_ERROR)
+        {
+            int errorCode = WSAGetLastError();
+
+            if (errorCode == WSAEINTR)
+            {
+                continue;
+            }
+
+            if (errorCode == WSAEWOULDBLOCK)
+            {
+                return 0;
+            }
+
+            // Windows下ICMP端口不可达报WSAECONNRESET，超长的数据报报WSAEMSGSIZE，都跳过这个数据报
+            if (errorCode == WSAECONNRESET || errorCode == WSAEMSGSIZE)
+            {
+                continue;
+            }
+
+            std::cerr << "datagram receive error, code: " << errorCode << std::endl;
+            closeConnection();
+            return -1;
+        }
+
+        // UDP的空数据报不代表连接关闭
+        if (nRet == 0)
+        {
+            continue;
+        }
+
+        return nRet;
+    }
+}
+
+int VideoClient::writeSocketData(const uint8_t *buffer, size_t length)
+{
+    while (true)
+    {
+        int nRet = send(m_socketFD, reinterpret_cast<const char*>(buffer), static_cast<int>(length), 0);
+        if (nRet == SOCKET_ERROR)
+        {
+            int errorCode = WSAGetLastError();
+
+            if (errorCode == WSAEINTR)
+            {
+                continue;
+            }
+
+            // Windows下的非阻塞错误码，等下一次可写事件
+            if (errorCode == WSAEWOULDBLOCK)
+            {
+                return 0;
+            }
+
+            std::cerr << "Windows socket send error, code: " << errorCode << std::endl;
+            return -1;
+        }
+
+        return nRet;
+    }
 }
 
 #endif
@@ -3,6 +3,7 @@
 
 #ifdef PLATFORM_LINUX
 #include <sys/socket.h>
+#include <netinet/tcp.h>
 #include <sys/select.h>
 #include <netinet/in.h>
 #include <arpa/inet.h> // 包含IPv4和IPv6地址的文本表示与二进制格式之间的转换的函数
@@ -20,43 +21,248 @@
 #include <mutex>
 #include <atomic>
 #include <functional>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
 
 #include "type.h"
+#include "eventloop.h"
+#include "streamreassembler.h"
+#include "iouringreceiver.h"
+#include "rtpreceiver.h"
+#include "packetbufferpool.h"
+#include "decodeworkerpool.h"
+#include "decodequeue.h"
 #include "h264decoder.h"
 
+extern "C"
+{
+#include <libavutil/crc.h>
+}
+
+// 心跳包发送间隔
+#define KEEPALIVE_INTERVAL_SECONDS 2
+// 断线重连的退避时间，每失败一次翻倍，直到上限
+#define RECONNECT_BASE_DELAY_MS 200
+#define RECONNECT_MAX_DELAY_MS 10000
+// 连接上以后超过这个时间没有收到任何数据就认为连接卡死，主动断开重连
+#define STALL_TIMEOUT_SECONDS 5
+#define STALL_CHECK_INTERVAL_MS 1000
+// 负载超过这个大小时剩余部分直接从套接字读到缓冲区池里，不经过接收缓冲区
+#define PACKET_DIRECT_READ_THRESHOLD (64 * 1024)
+// UDP传输时检查抖动缓冲区和发送NACK的间隔
+#define RTP_PROCESS_INTERVAL_MS 10
+// 一个UDP数据报的最大长度
+#define UDP_DATAGRAM_BUFFER_SIZE (64 * 1024)
+// 发送缓冲区里最多积压的数据，只有心跳和NACK这样的小包，超过说明对端已经不读了
+#define SEND_BUFFER_MAX_SIZE (64 * 1024)
+// 解码线程里排队的包超过这个数量时，丢掉v2消息头标记为可丢弃的帧
+#define DISCARDABLE_DROP_QUEUE_DEPTH 2
+
+// 客户端的统计信息
+struct ClientStats
+{
+    uint64_t m_videoPackets = 0;
+    uint64_t m_droppedWaitingKeyFrame = 0; // 数据丢失后等待IDR期间丢弃的包
+
+    // 以下只有服务端使用v2消息头时才有
+    uint64_t m_lostMessages = 0;           // 根据序号发现缺失的消息
+    uint64_t m_checksumErrors = 0;         // 负载校验失败丢弃的消息
+    uint64_t m_droppedDiscardable = 0;     // 解码跟不上时主动丢弃的可丢弃帧
+    // 从发送端采集到客户端收完一帧的时间，依赖两端时钟同步(比如NTP)
+    int64_t m_lastCaptureLatencyUs = 0;
+    int64_t m_maxCaptureLatencyUs = 0;
+
+    uint64_t m_disconnectCount = 0;
+    uint64_t m_stallCount = 0;             // 因为长时间没有数据而主动断开的次数
+    int64_t m_lastTimeToFirstFrameMs = 0;  // 最近一次连接成功到第一帧画面的时间
+    int64_t m_lastOutageMs = 0;            // 最近一次断开到重新出画面的时间
+    uint64_t m_reconnectCount = 0;         // 安排过的重连次数，包括连接失败后的重试
+    int64_t m_lastReconnectDelayMs = 0;    // 最近一次重连前等待的时间
+};
+
+// 连接后从套接字读回来的实际参数，内核可能会调整设置的值(比如Linux会把缓冲区大小翻倍)
+struct SocketOptions
+{
+    int m_receiveBufferSize = 0;
+    int m_sendBufferSize = 0;
+    bool m_isNoDelay = false;
+    bool m_isQuickAck = false;
+    int m_busyPollMicros = 0;
+};
+
+enum class ConnectionState
+{
+    Disconnected,
+    Connecting,
+    Connected,
+    WaitingReconnect
+};
+
 using updateVideoCallback = std::function<void(YUVFrameData *yuvFrameData)>;
 
+// 一路视频流的连接
+// 默认自己创建事件循环线程和解码线程，中间用无锁队列传递包；多路流时可以传入共享的事件循环和解码线程池
 class VideoClient
 {
 public:
-    VideoClient();
+    explicit VideoClient(EventLoop *pEventLoop = nullptr, DecodeWorkerPool *pDecodePool = nullptr);
     ~VideoClient();
 
     void startSocketConnection(const NetConnectInfo &netConnectInfo);
     void stopSocketConnection();
 
     void setupUpdateVideoCallback(updateVideoCallback &&callback);
+    // 解码输出帧的分配器，见H264Decoder::setFrameAllocator
+    void setFrameAllocator(FrameAllocator *pAllocator);
+    // 解码降级的级别变化时回调，在解码线程里执行，需要在开始连接之前设置
+    void setupLoadLevelCallback(loadLevelCallback &&callback);
+    // 画面墙的小窗口只解关键帧并缩小输出，见H264Decoder::setTileMode
+    void setTileMode(bool isTileMode);
+
+    // 接收统计，返回的是快照，可以在任意线程调用
+    ReassemblerStats receiveStats() const;
+    ClientStats clientStats() const;
+    DecodeQueueStats decodeQueueStats() const;
+    JitterBufferStats jitterStats() const;
+    SocketOptions socketOptions() const;
+    FramePoolStats framePoolStats() const;
+    DecoderLoadStats decoderLoadStats() const;
 
 private:
+    // 以下函数都在事件循环线程里执行
+    void connectToServer();
+    void onSocketEvent(int events);
     void doRunWaitConnection();
+    void onConnected();
     void doReceiveData();
+    void doReceiveDatagrams();
+    void processRtp();
+    bool startIoUringReceive();
+    void onIoUringEvent();
+    void feedReceivedData(const uint8_t *data, size_t length);
+    void drainMessages();
+    void beginDirectReceive();
+    void handleMessage(const StreamMessage &message);
+    void handleVideoPacket(const StreamMessage &message, AVBufferRef *buffer);
+    bool checkMessageV2(const StreamMessage &message, const AVBufferRef *buffer);
+    // queueDelayUs是包在队列里等待的时间，交给解码器判断是否跟得上
+    void decodeVideoPacket(size_t length, int64_t pts, AVBufferRef *buffer, int64_t queueDelayUs);
+    void drainDecoder();
+    // 让解码器在处理这次连接的第一个包之前重置
+    void resetDecoder();
+    // 单独的解码线程，从包队列里取包解码
+    void runDecodeLoop();
     void sendKeepAlivePacket();
+    void closeConnection();
+    void scheduleReconnect();
+    void checkStall();
+    void recordFirstFrame();
+
+    // 连接前设置套接字参数，连接后读回实际生效的值
+    void applySocketOptions();
+    void readSocketOptions();
 
     // 数据收发函数
-    bool receiveSocketData(std::vector<uint8_t> &buffer, size_t length);
+    // 非阻塞读取，返回读到的字节数，0表示暂时没有数据，-1表示连接关闭或出错
+    int readSocketData(uint8_t *buffer, size_t length);
+    // 读取一个UDP数据报，返回值含义同上，空数据报直接跳过
+    int readDatagram(uint8_t *buffer, size_t length);
+    // 非阻塞写入，返回写入的字节数，0表示发送缓冲区满了，-1表示出错
+    int writeSocketData(const uint8_t *buffer, size_t length);
+    // TCP发不完的部分缓存起来，等可写事件再发，返回false表示出错或者积压太多
     bool sendSocketData(const std::vector<uint8_t> &buffer, size_t length);
+    void flushSendBuffer();
+    void updateWriteInterest();
 
 private:
     int m_socketFD = -1;
+    NetConnectInfo m_netConnectInfo;
+
+    // 一个线程跑事件循环，负责连接、收数据和心跳
+    // 使用共享的事件循环时不创建线程
+    EventLoop *m_pEventLoop = nullptr;
+    std::unique_ptr<EventLoop> m_pOwnedEventLoop;
+    std::thread m_ioThread;
+    bool m_isStarted = false;
+
+    DecodeWorkerPool *m_pDecodePool = nullptr;
+    size_t m_decodeWorkerIndex = 0;
+    // 没有共享的解码线程池时使用
+    DecodeQueue m_decodeQueue;
+    std::thread m_decodeThread;
+    uint64_t m_decodeGeneration = 0;
+    int m_connectTimeoutTimerID = 0;
+    int m_keepAliveTimerID = 0;
+    int m_stallCheckTimerID = 0;
+    int m_reconnectTimerID = 0;
+    int m_rtpProcessTimerID = 0;
+
+    // 连接状态机，只在事件循环线程里修改
+    ConnectionState m_connectionState = ConnectionState::Disconnected;
+    std::atomic_bool m_isConnected = false;
+    std::atomic_bool m_isStopping = false;
+    int m_reconnectAttempt = 0;
+    std::mt19937 m_randomEngine{std::random_device{}()};
+
+    std::chrono::steady_clock::time_point m_lastReceiveTime;
+    // 解码线程出第一帧时读取
+    std::atomic<std::chrono::steady_clock::time_point> m_connectedTime;
+    std::atomic<std::chrono::steady_clock::time_point> m_disconnectTime;
+    std::atomic_bool m_isWaitingFirstFrame = false;
+
+    // 还没发出去的数据，只在事件循环线程里访问
+    std::vector<uint8_t> m_sendBuffer;
+    size_t m_sendOffset = 0;
+    bool m_isWaitingWritable = false;
+
+    // 接收缓冲区，一次recv读一大块，再从里面按消息头切分出消息
+    StreamReassembler m_reassembler;
+    // 可选的io_uring接收后端
+    IoUringReceiver m_uringReceiver;
+
+    // 负载缓冲区池，解码器直接使用其中的缓冲区
+    PacketBufferPool m_packetPool;
+    // 正在直接读取的大负载
+    StreamMessage m_directMessage;
+    AVBufferRef *m_pDirectBuffer = nullptr;
+    size_t m_directReceivedLength = 0;
+
+    // UDP传输时的RTP接收端，组装好的帧也放在缓冲区池里
+    RtpReceiver m_rtpReceiver{&m_packetPool};
+    std::vector<uint8_t> m_datagramBuffer;
+    std::vector<uint8_t> m_nackPacket;
 
-    std::atomic_bool m_isThreadRunning = true;
-    // 用两个标志来使线程优雅的退出
-    std::atomic_bool m_isKeepAliveThreadRunning = false;
-    std::atomic_bool m_isReceiveThreadRunning = false;
+    // 流里有数据丢失后，等到下一个IDR才送去解码，避免花屏
+    bool m_isWaitingForKeyFrame = false;
+    // 服务端实际使用的协议版本和上一个视频消息的序号
+    int m_peerProtocolVersion = 0;
+    bool m_hasLastSequence = false;
+    uint32_t m_lastSequence = 0;
+    // 已经交给解码线程池还没解码完的包
+    std::atomic_int m_pendingDecodeCount = 0;
+    // ClientStats的各项，网络线程和解码线程都会写，clientStats()在其他线程读取
+    std::atomic<uint64_t> m_videoPackets{0};
+    std::atomic<uint64_t> m_droppedWaitingKeyFrame{0};
+    std::atomic<uint64_t> m_lostMessages{0};
+    std::atomic<uint64_t> m_checksumErrors{0};
+    std::atomic<uint64_t> m_droppedDiscardable{0};
+    std::atomic<uint64_t> m_disconnectCount{0};
+    std::atomic<uint64_t> m_stallCount{0};
+    std::atomic<int64_t> m_lastCaptureLatencyUs{0};
+    std::atomic<int64_t> m_maxCaptureLatencyUs{0};
+    std::atomic<int64_t> m_lastTimeToFirstFrameMs{0};
+    std::atomic<int64_t> m_lastOutageMs{0};
+    std::atomic<uint64_t> m_reconnectCount{0};
+    std::atomic<int64_t> m_lastReconnectDelayMs{0};
+    // 事件循环线程写，其他线程通过socketOptions()和jitterStats()读取
+    mutable std::mutex m_publishedStatsMutex;
+    SocketOptions m_socketOptions;
+    JitterBufferStats m_jitterStats;
 
-    bool m_isConnected = false;
-    std::mutex m_receiveMutex;
-    std::mutex m_sendMutex;
+    H264Decoder m_decoder;
 
     updateVideoCallback m_updateVideoCallback;
 };
@@ -0,0 +1,102 @@
+#include "videoframe.h"
+
+#include <iostream>
+#include <utility>
+
+VideoFrame::VideoFrame(const AVFrame *frame)
+{
+    m_pFrame = av_frame_alloc();
+    if (m_pFrame == nullptr)
+    {
+        std::cerr << "av_frame_alloc error" << std::endl;
+        return;
+    }
+
+    // 只增加缓冲区的引用计数，像素数据不拷贝
+    int ret = av_frame_ref(m_pFrame, frame);
+    if (ret < 0)
+    {
+        std::cerr << "av_frame_ref error: " << ret << std::endl;
+        av_frame_free(&m_pFrame);
+        m_pFrame = nullptr;
+    }
+}
+
+VideoFrame::~VideoFrame()
+{
+    reset();
+}
+
+VideoFrame::VideoFrame(VideoFrame &&other) noexcept
+    : m_pFrame(other.m_pFrame)
+{
+    other.m_pFrame = nullptr;
+}
+
+VideoFrame &VideoFrame::operator=(VideoFrame &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        std::swap(m_pFrame, other.m_pFrame);
+    }
+    return *this;
+}
+
+VideoFrame VideoFrame::ref() const
+{
+    if (m_pFrame == nullptr)
+    {
+        return VideoFrame();
+    }
+    return VideoFrame(m_pFrame);
+}
+
+bool VideoFrame::isValid() const
+{
+    return m_pFrame != nullptr;
+}
+
+void VideoFrame::reset()
+{
+    if (m_pFrame != nullptr)
+    {
+        av_frame_free(&m_pFrame);
+        m_pFrame = nullptr;
+    }
+}
+
+int VideoFrame::width() const
+{
+    return m_pFrame != nullptr ? m_pFrame->width : 0;
+}
+
+int VideoFrame::height() const
+{
+    return m_pFrame != nullptr ? m_pFrame->height : 0;
+}
+
+int VideoFrame::format() const
+{
+    return m_pFrame != nullptr ? m_pFrame->format : -1;
+}
+
+long long VideoFrame::pts() const
+{
+    return m_pFrame != nullptr ? m_pFrame->best_effort_timestamp : AV_NOPTS_VALUE;
+}
+
+const uint8_t *VideoFrame::data(int plane) const
+{
+    return m_pFrame != nullptr ? m_pFrame->data[plane] : nullptr;
+}
+
+int VideoFrame::linesize(int plane) const
+{
+    return m_pFrame != nullptr ? m_pFrame->linesize[plane] : 0;
+}
+
+const AVFrame *VideoFrame::avFrame() const
+{
+    return m_pFrame;
+}
@@ -0,0 +1,47 @@
+#ifndef VIDEOFRAME_H
+#define VIDEOFRAME_H
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+// 解码出来的一帧的句柄，持有AVFrame的引用(av_frame_ref)，不拷贝像素数据
+// 只能移动不能拷贝，句柄销毁时释放引用，最后一个引用释放后缓冲区才回到解码器的缓冲池
+// 每个分量按解码器原始的行宽(linesize)存放，行尾可能有对齐填充
+class VideoFrame
+{
+public:
+    VideoFrame() = default;
+    // 引用frame的数据，frame本身仍归调用方所有
+    explicit VideoFrame(const AVFrame *frame);
+    ~VideoFrame();
+
+    VideoFrame(VideoFrame &&other) noexcept;
+    VideoFrame &operator=(VideoFrame &&other) noexcept;
+
+    VideoFrame(const VideoFrame &) = delete;
+    VideoFrame &operator=(const VideoFrame &) = delete;
+
+    // 显式地再引用一次同一帧，比如GPU还在读这一帧的数据时要把它留住
+    VideoFrame ref() const;
+
+    bool isValid() const;
+    // 释放持有的引用
+    void reset();
+
+    int width() const;
+    int height() const;
+    // AVPixelFormat
+    int format() const;
+    long long pts() const;
+    const uint8_t *data(int plane) const;
+    int linesize(int plane) const;
+
+    const AVFrame *avFrame() const;
+
+private:
+    AVFrame *m_pFrame = nullptr;
+};
+
+#endif // VIDEOFRAME_H
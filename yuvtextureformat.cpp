@@ -0,0 +1,166 @@
+#include "yuvtextureformat.h"
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+// 标清和高清的分界，没有标明色彩空间时使用
+#define YUV_SD_MAX_HEIGHT 576
+
+bool YUVTextureFormat::fromPixelFormat(int pixelFormat, YUVTextureFormat &textureFormat)
+{
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(pixelFormat));
+    if (descriptor == nullptr || descriptor->nb_components != 3)
+    {
+        return false;
+    }
+
+    // GL按本机字节序读16位数据，只接受小端
+    const uint64_t unsupportedFlags = AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BITSTREAM;
+    if ((descriptor->flags & unsupportedFlags) != 0 || (descriptor->flags & AV_PIX_FMT_FLAG_PLANAR) == 0)
+    {
+        return false;
+    }
+
+    int depth = descriptor->comp[0].depth;
+    int shift = descriptor->comp[0].shift;
+    for (int i = 1; i < 3; i++)
+    {
+        if (descriptor->comp[i].depth != depth || descriptor->comp[i].shift != shift)
+        {
+            return false;
+        }
+    }
+    if (depth < 8 || depth > 16)
+    {
+        return false;
+    }
+
+    int bytesPerSample = depth > 8 ? 2 : 1;
+    bool isSemiPlanar = descriptor->comp[1].plane == 1 && descriptor->comp[2].plane == 1;
+    GLenum dataType = bytesPerSample == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+    if (descriptor->comp[0].plane != 0 || descriptor->comp[0].step != bytesPerSample)
+    {
+        return false;
+    }
+
+    YUVPlaneFormat singleChannel;
+    singleChannel.m_internalFormat = bytesPerSample == 2 ? GL_R16 : GL_R8;
+    singleChannel.m_uploadFormat = GL_RED;
+    singleChannel.m_dataType = dataType;
+    singleChannel.m_bytesPerPixel = bytesPerSample;
+
+    if (isSemiPlanar)
+    {
+        // U在前V在后(nv12、p010)，V在前的nv21不支持
+        if (descriptor->comp[1].step != bytesPerSample * 2 || descriptor->comp[2].step != bytesPerSample * 2 || descriptor->comp[1].offset >= descriptor->comp[2].offset)
+        {
+            return false;
+        }
+
+        YUVPlaneFormat twoChannel;
+        twoChannel.m_internalFormat = bytesPerSample == 2 ? GL_RG16 : GL_RG8;
+        twoChannel.m_uploadFormat = GL_RG;
+        twoChannel.m_dataType = dataType;
+        twoChannel.m_bytesPerPixel = bytesPerSample * 2;
+
+        textureFormat.m_planeCount = 2;
+        textureFormat.m_shaderVariant = YUV_SHADER_SEMI_PLANAR;
+        textureFormat.m_planes[0] = singleChannel;
+        textureFormat.m_planes[1] = twoChannel;
+    }
+    else
+    {
+        if (descriptor->comp[1].plane != 1 || descriptor->comp[2].plane != 2 || descriptor->comp[1].step != bytesPerSample || descriptor->comp[2].step != bytesPerSample)
+        {
+            return false;
+        }
+
+        textureFormat.m_planeCount = 3;
+        textureFormat.m_shaderVariant = YUV_SHADER_PLANAR;
+        for (int i = 0; i < 3; i++)
+        {
+            textureFormat.m_planes[i] = singleChannel;
+        }
+    }
+
+    // 16位纹理按65535归一化，数据只占低depth位(yuv420p10)或者高depth位(p010)时换算到按位深归一化
+    textureFormat.m_bitDepth = depth;
+    textureFormat.m_sampleScale = 1.0f;
+    if (bytesPerSample == 2)
+    {
+        double maxStored = static_cast<double>(((1 << depth) - 1) << shift);
+        textureFormat.m_sampleScale = static_cast<float>(65535.0 / maxStored);
+    }
+    return true;
+}
+
+void YUVTextureFormat::colorMatrix(int colorSpace, int colorRange, int height, const YUVTextureFormat &textureFormat, float matrix[9], float offset[3])
+{
+    if (colorSpace == AVCOL_SPC_UNSPECIFIED)
+    {
+        colorSpace = height <= YUV_SD_MAX_HEIGHT ? AVCOL_SPC_SMPTE170M : AVCOL_SPC_BT709;
+    }
+
+    // 亮度里红色和蓝色的权重
+    double kr = 0.299;
+    double kb = 0.114;
+    if (colorSpace == AVCOL_SPC_BT709)
+    {
+        kr = 0.2126;
+        kb = 0.0722;
+    }
+    else if (colorSpace == AVCOL_SPC_BT2020_NCL || colorSpace == AVCOL_SPC_BT2020_CL)
+    {
+        kr = 0.2627;
+        kb = 0.0593;
+    }
+    else if (colorSpace == AVCOL_SPC_SMPTE240M)
+    {
+        kr = 0.212;
+        kb = 0.087;
+    }
+    double kg = 1.0 - kr - kb;
+
+    // 先把采样值换算成Y在0到1、UV在-0.5到0.5的范围
+    double maxValue = (1 << textureFormat.m_bitDepth) - 1;
+    double unit = 1 << (textureFormat.m_bitDepth - 8);
+    double scales[3];
+    double offsets[3];
+    if (colorRange == AVCOL_RANGE_JPEG)
+    {
+        scales[0] = 1.0;
+        offsets[0] = 0.0;
+        scales[1] = 1.0;
+        offsets[1] = (1 << (textureFormat.m_bitDepth - 1)) / maxValue;
+    }
+    else
+    {
+        // 有限范围：Y是16到235，UV是16到240，按位深放大
+        scales[0] = maxValue / (219.0 * unit);
+        offsets[0] = 16.0 * unit / maxValue;
+        scales[1] = maxValue / (224.0 * unit);
+        offsets[1] = 128.0 * unit / maxValue;
+    }
+    scales[2] = scales[1];
+    offsets[2] = offsets[1];
+
+    // 每一行是R、G、B，每一列是Y、U、V的系数
+    const double coefficients[3][3] = {
+        {1.0, 0.0, 2.0 * (1.0 - kr)},
+        {1.0, -2.0 * kb * (1.0 - kb) / kg, -2.0 * kr * (1.0 - kr) / kg},
+        {1.0, 2.0 * (1.0 - kb), 0.0}};
+
+    for (int row = 0; row < 3; row++)
+    {
+        double rowOffset = 0.0;
+        for (int column = 0; column < 3; column++)
+        {
+            double coefficient = coefficients[row][column] * scales[column];
+            matrix[column * 3 + row] = static_cast<float>(coefficient * textureFormat.m_sampleScale);
+            rowOffset -= coefficient * offsets[column];
+        }
+        offset[row] = static_cast<float>(rowOffset);
+    }
+}
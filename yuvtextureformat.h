@@ -0,0 +1,38 @@
+#ifndef YUVTEXTUREFORMAT_H
+#define YUVTEXTUREFORMAT_H
+
+#include <QOpenGLFunctions>
+
+#define YUV_SHADER_PLANAR 0      // 三个分量各一个单通道纹理
+#define YUV_SHADER_SEMI_PLANAR 1 // 亮度一个单通道纹理，交错的UV一个双通道纹理
+#define YUV_SHADER_VARIANT_COUNT 2
+
+// 一个平面对应的纹理格式
+struct YUVPlaneFormat
+{
+    GLenum m_internalFormat = GL_R8; // GL_R8、GL_RG8、GL_R16或GL_RG16
+    GLenum m_uploadFormat = GL_RED;
+    GLenum m_dataType = GL_UNSIGNED_BYTE;
+    int m_bytesPerPixel = 1; // 一个纹素的字节数，用来把linesize换算成GL_UNPACK_ROW_LENGTH
+};
+
+// 解码器输出的像素格式怎样原样上传成纹理，以及用哪个着色器把它转换成RGB
+// 只描述，不做任何CPU上的转换
+struct YUVTextureFormat
+{
+    int m_planeCount = 0;
+    int m_shaderVariant = YUV_SHADER_PLANAR;
+    YUVPlaneFormat m_planes[3];
+    int m_bitDepth = 8;
+    // 采样得到的归一化值乘以它才是按位深归一化的值，10位数据放在16位的低位时需要放大
+    float m_sampleScale = 1.0f;
+
+    // 支持8到16位、小端、平面或者UV顺序交错的半平面YUV，其他格式返回false
+    static bool fromPixelFormat(int pixelFormat, YUVTextureFormat &textureFormat);
+
+    // 按色彩空间和范围计算rgb = matrix * 采样值 + offset，matrix按列存放，可以直接交给glUniformMatrix3fv
+    // 没有标明色彩空间时标清按BT.601、高清按BT.709，没有标明范围时按有限范围
+    static void colorMatrix(int colorSpace, int colorRange, int height, const YUVTextureFormat &textureFormat, float matrix[9], float offset[3]);
+};
+
+#endif // YUVTEXTUREFORMAT_H